@@ -0,0 +1,3 @@
+DELETE FROM command WHERE name='debug mapupdate';
+INSERT INTO `command` (`name`,`security`,`help`) VALUES
+('debug mapupdate', 3, 'Syntax: .debug mapupdate\r\n\r\nShow the last and average update time of your current map, the number of grid regions it was split into, the map updater queue statistics, the grid prefetch statistics and the memory used by loaded terrain.');
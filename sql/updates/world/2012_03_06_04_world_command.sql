@@ -0,0 +1,3 @@
+DELETE FROM command WHERE name='debug terrain';
+INSERT INTO `command` (`name`,`security`,`help`) VALUES
+('debug terrain', 3, 'Syntax: .debug terrain [#count]\r\n\r\nTime #count (default 10000) terrain height and liquid queries around your position, once point by point and once as a batch, and report any difference between the results.');
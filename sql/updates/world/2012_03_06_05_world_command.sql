@@ -0,0 +1,3 @@
+DELETE FROM command WHERE name='debug mmap';
+INSERT INTO `command` (`name`,`security`,`help`) VALUES
+('debug mmap', 3, 'Syntax: .debug mmap [#count]\r\n\r\nShow the loaded navmesh tiles and time #count (default 1000) paths from your position to random points up to 40 yards away.');
@@ -0,0 +1,3 @@
+DELETE FROM command WHERE name='debug los';
+INSERT INTO `command` (`name`,`security`,`help`) VALUES
+('debug los', 3, 'Syntax: .debug los [#count]\r\n\r\nShow the line of sight cache hit rate and time #count (default 1000) line of sight checks from your position to random points up to 40 yards away, twice in a row to show the cached case.');
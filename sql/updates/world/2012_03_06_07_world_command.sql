@@ -0,0 +1,3 @@
+DELETE FROM command WHERE name='debug los';
+INSERT INTO `command` (`name`,`security`,`help`) VALUES
+('debug los', 3, 'Syntax: .debug los [#count]\r\n\r\nShow the line of sight cache hit rate and check line of sight from your position to #count (default 1000) random points up to 40 yards away: one by one and batched without the cache, then twice through the cache.');
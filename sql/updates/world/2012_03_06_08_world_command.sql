@@ -0,0 +1,3 @@
+DELETE FROM command WHERE name='debug broadcast';
+INSERT INTO `command` (`name`,`security`,`help`) VALUES
+('debug broadcast', 3, 'Syntax: .debug broadcast [#size [#count]]\r\n\r\nSend #count (default 10) invisible addon messages of #size (default 512) bytes to every player in your visibility range, once copied into every socket and once as a shared packet, and show the time and the bytes copied per broadcast for both.');
@@ -0,0 +1,3 @@
+DELETE FROM command WHERE name='debug netstats';
+INSERT INTO `command` (`name`,`security`,`help`) VALUES
+('debug netstats', 3, 'Syntax: .debug netstats\r\n\r\nShow the packets sent to all player sessions, the send calls it took and the payload bytes copied and referenced by their sockets.');
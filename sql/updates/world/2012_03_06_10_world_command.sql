@@ -0,0 +1,3 @@
+DELETE FROM command WHERE name='debug opcodestats';
+INSERT INTO `command` (`name`,`security`,`help`) VALUES
+('debug opcodestats', 3, 'Syntax: .debug opcodestats [#count|reset|dump]\r\n\r\nShow the handler calls and time per packet processing path and the #count (10 by default) opcodes with the most handler time, with their average, 99th percentile and maximum handler time.\r\nreset clears the statistics, dump writes them to OpcodeStats.DumpFile.');
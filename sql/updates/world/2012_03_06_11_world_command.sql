@@ -0,0 +1,3 @@
+DELETE FROM command WHERE name='debug recvqueue';
+INSERT INTO `command` (`name`,`security`,`help`) VALUES
+('debug recvqueue', 3, 'Syntax: .debug recvqueue [#producers [#count]]\r\n\r\nLet #producers threads (4 by default) add #count items each (1000000 by default) to a mutex locked and to a lock-free receive queue while one thread takes them out, and show the time both queues needed.');
@@ -0,0 +1,3 @@
+DELETE FROM command WHERE name='debug valuesupdate';
+INSERT INTO `command` (`name`,`security`,`help`) VALUES
+('debug valuesupdate', 3, 'Syntax: .debug valuesupdate [#count]\r\n\r\nBuild the value update of the selected unit (or yourself) for all players in visibility range #count times (100 by default), once for every player and once per observer class with the player dependent fields patched in, and show the time both ways needed. Run it in a raid or a crowded city.');
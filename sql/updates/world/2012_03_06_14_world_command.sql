@@ -0,0 +1,3 @@
+DELETE FROM command WHERE name='debug areasearch';
+INSERT INTO `command` (`name`,`security`,`help`) VALUES
+('debug areasearch', 3, 'Syntax: .debug areasearch [#count [#radius]]\r\n\r\nRun #count (default 1000) searches for alive units within #radius (default 30) yards of you, once walking the cell lists and once through the cell indexes, and show the time per search of both. Use it in a crowd, e.g. of load generator bots, to compare both ways against the number of units around.');
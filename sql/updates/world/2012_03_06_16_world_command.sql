@@ -0,0 +1,3 @@
+DELETE FROM command WHERE name='debug broadcast';
+INSERT INTO `command` (`name`,`security`,`help`) VALUES
+('debug broadcast', 3, 'Syntax: .debug broadcast [#size [#count [#receivers]]]\r\n\r\nSend #count (default 10) broadcasts of an invisible addon message of #size (default 512) bytes, each as #receivers copies (default the number of players in your visibility range) to your own client, once copied for every send and once as a shared packet, and show the time and the bytes copied per broadcast for both.');
@@ -18,6 +18,39 @@
  */
 
 #include "BoundingIntervalHierarchy.h"
+#include "VMapDefinitions.h"
+
+BIH::BIH(const BIH &other): tree(0), objects(0), treeSize(0), objectCount(0)
+{
+    *this = other;
+}
+
+BIH& BIH::operator=(const BIH &other)
+{
+    if (this == &other)
+        return *this;
+    treeStorage = other.treeStorage;
+    objectStorage = other.objectStorage;
+    bounds = other.bounds;
+    // arrays of a mapped file are shared, copied storage has to be pointed to again
+    tree = other.treeStorage.empty() ? other.tree : 0;
+    objects = other.objectStorage.empty() ? other.objects : 0;
+    treeSize = other.treeSize;
+    objectCount = other.objectCount;
+    if (!treeStorage.empty())
+        tree = &treeStorage[0];
+    if (!objectStorage.empty())
+        objects = &objectStorage[0];
+    return *this;
+}
+
+void BIH::useStorage()
+{
+    treeSize = treeStorage.size();
+    objectCount = objectStorage.size();
+    tree = treeSize ? &treeStorage[0] : 0;
+    objects = objectCount ? &objectStorage[0] : 0;
+}
 
 void BIH::buildHierarchy(std::vector<uint32> &tempTree, buildData &dat, BuildStats &stats)
 {
@@ -241,35 +274,49 @@ void BIH::subdivide(int left, int right, std::vector<uint32> &tempTree, buildDat
 
 bool BIH::writeToFile(FILE* wf) const
 {
-    uint32 treeSize = tree.size();
     uint32 check=0, count=0;
     check += fwrite(&bounds.low(), sizeof(float), 3, wf);
     check += fwrite(&bounds.high(), sizeof(float), 3, wf);
     check += fwrite(&treeSize, sizeof(uint32), 1, wf);
-    check += fwrite(&tree[0], sizeof(uint32), treeSize, wf);
-    count = objects.size();
+    check += fwrite(tree, sizeof(uint32), treeSize, wf);
+    count = objectCount;
     check += fwrite(&count, sizeof(uint32), 1, wf);
-    check += fwrite(&objects[0], sizeof(uint32), count, wf);
+    check += fwrite(objects, sizeof(uint32), count, wf);
     return check == (3 + 3 + 2 + treeSize + count);
 }
 
 bool BIH::readFromFile(FILE* rf)
 {
-    uint32 treeSize;
     Vector3 lo, hi;
     uint32 check=0, count=0;
     check += fread(&lo, sizeof(float), 3, rf);
     check += fread(&hi, sizeof(float), 3, rf);
     bounds = AABox(lo, hi);
     check += fread(&treeSize, sizeof(uint32), 1, rf);
-    tree.resize(treeSize);
-    check += fread(&tree[0], sizeof(uint32), treeSize, rf);
+    treeStorage.resize(treeSize);
+    check += fread(&treeStorage[0], sizeof(uint32), treeSize, rf);
     check += fread(&count, sizeof(uint32), 1, rf);
-    objects.resize(count); // = new uint32[nObjects];
-    check += fread(&objects[0], sizeof(uint32), count, rf);
+    objectStorage.resize(count); // = new uint32[nObjects];
+    check += fread(&objectStorage[0], sizeof(uint32), count, rf);
+    useStorage();
     return check == (3 + 3 + 2 + treeSize + count);
 }
 
+bool BIH::readFromMemory(VMAP::MappedFileReader &reader)
+{
+    Vector3 lo, hi;
+    uint32 count = 0;
+    if (!reader.read(&lo, sizeof(float) * 3) || !reader.read(&hi, sizeof(float) * 3))
+        return false;
+    bounds = AABox(lo, hi);
+    if (!reader.read(&treeSize, sizeof(uint32)) || !reader.readArray(tree, treeSize, treeStorage))
+        return false;
+    if (!reader.read(&count, sizeof(uint32)) || !reader.readArray(objects, count, objectStorage))
+        return false;
+    objectCount = count;
+    return true;
+}
+
 void BIH::BuildStats::updateLeaf(int depth, int n)
 {
     numLeaves++;
@@ -25,6 +25,7 @@
 #include "G3D/AABox.h"
 
 #include "Define.h"
+#include "RayPacket.h"
 
 #include <stdexcept>
 #include <vector>
@@ -46,6 +47,11 @@ using G3D::Vector3;
 using G3D::AABox;
 using G3D::Ray;
 
+namespace VMAP
+{
+    class MappedFileReader;
+}
+
 static inline uint32 floatToRawIntBits(float f)
 {
     union
@@ -83,7 +89,9 @@ struct AABound
 class BIH
 {
     public:
-        BIH() {};
+        BIH(): tree(0), objects(0), treeSize(0), objectCount(0) {};
+        BIH(const BIH &other);
+        BIH& operator=(const BIH &other);
         template< class T, class BoundsFunc >
         void build(const std::vector<T> &primitives, BoundsFunc &getBounds, uint32 leafSize = 3, bool printStats=false)
         {
@@ -108,15 +116,16 @@ class BIH
             if (printStats)
                 stats.printStats();
 
-            objects.resize(dat.numPrims);
+            objectStorage.resize(dat.numPrims);
             for (uint32 i=0; i<dat.numPrims; ++i)
-                objects[i] = dat.indices[i];
+                objectStorage[i] = dat.indices[i];
             //nObjects = dat.numPrims;
-            tree = tempTree;
+            treeStorage.swap(tempTree);
+            useStorage();
             delete[] dat.primBound;
             delete[] dat.indices;
         }
-        uint32 primCount() { return objects.size(); }
+        uint32 primCount() { return objectCount; }
 
         template<typename RayCallback>
         void intersectRay(const Ray &r, RayCallback& intersectCallback, float &maxDist, bool stopAtFirst=false) const
@@ -257,6 +266,204 @@ class BIH
             }
         }
 
+        /**
+        Traverses the rays of a packet together, lanes only split up where their intervals do.
+        The callback is called for the lanes reaching a leaf as
+            uint32 callback(const RayPacket &packet, uint32 entry, float* maxDist, uint32 laneMask, bool stopAtFirst)
+        and returns the mask of lanes that hit, with maxDist updated for them.
+        Returns the lanes that hit anything.
+        */
+        template<typename RayCallback>
+        uint32 intersectRayPacket(const RayPacket &packet, RayCallback& intersectCallback, float* maxDist, uint32 laneMask, bool stopAtFirst=false) const
+        {
+            if (!treeSize)
+                return 0;
+
+            // clip every ray against the scene bounds, like intersectRay()
+            float tNear[RAY_PACKET_SIZE] = { 0.f };
+            float tFar[RAY_PACKET_SIZE] = { 0.f };
+            uint32 active = 0;
+            for (uint32 lane = 0; lane < RAY_PACKET_SIZE; ++lane)
+            {
+                if (!(laneMask & (1 << lane)))
+                    continue;
+
+                float intervalMin = -1.f;
+                float intervalMax = -1.f;
+                Vector3 org = packet.origin(lane);
+                Vector3 dir = packet.direction(lane);
+                bool outside = false;
+                for (int i=0; i<3 && !outside; ++i)
+                {
+                    if (G3D::fuzzyNe(dir[i], 0.0f))
+                    {
+                        float invDir = 1.f / dir[i];
+                        float t1 = (bounds.low()[i]  - org[i]) * invDir;
+                        float t2 = (bounds.high()[i] - org[i]) * invDir;
+                        if (t1 > t2)
+                            std::swap(t1, t2);
+                        if (t1 > intervalMin)
+                            intervalMin = t1;
+                        if (t2 < intervalMax || intervalMax < 0.f)
+                            intervalMax = t2;
+                        if (intervalMax <= 0 || intervalMin >= maxDist[lane])
+                            outside = true;
+                    }
+                }
+
+                if (outside || intervalMin > intervalMax)
+                    continue;
+
+                tNear[lane] = std::max(intervalMin, 0.f);
+                tFar[lane] = std::min(intervalMax, maxDist[lane]);
+                active |= 1 << lane;
+            }
+
+            if (!active)
+                return 0;
+
+            uint32 pending = active;
+            PacketFloat org[3] = { PacketFloat::load(packet.orgX), PacketFloat::load(packet.orgY), PacketFloat::load(packet.orgZ) };
+            PacketFloat dir[3] = { PacketFloat::load(packet.dirX), PacketFloat::load(packet.dirY), PacketFloat::load(packet.dirZ) };
+            PacketFloat invDir[3];
+            PacketFloat negative[3];
+            for (int i=0; i<3; ++i)
+            {
+                invDir[i] = PacketFloat::reciprocal(dir[i]);
+                negative[i] = PacketFloat::signMask(dir[i]);
+            }
+
+            PacketFloat intervalMin = PacketFloat::load(tNear);
+            PacketFloat intervalMax = PacketFloat::load(tFar);
+            uint32 hits = 0;
+
+            PacketStackNode stack[MAX_STACK_SIZE];
+            int stackPos = 0;
+            int node = 0;
+
+            while (true) {
+                while (true)
+                {
+                    uint32 tn = tree[node];
+                    uint32 axis = (tn & (3 << 30)) >> 30;
+                    bool BVH2 = tn & (1 << 29);
+                    int offset = tn & ~(7 << 29);
+                    if (!BVH2)
+                    {
+                        if (axis < 3)
+                        {
+                            // "normal" interior node, the left child ends at the first plane and the right one starts at the second
+                            PacketFloat tl = (PacketFloat::splat(intBitsToFloat(tree[node + 1])) - org[axis]) * invDir[axis];
+                            PacketFloat tr = (PacketFloat::splat(intBitsToFloat(tree[node + 2])) - org[axis]) * invDir[axis];
+                            PacketFloat leftMin = PacketFloat::select(negative[axis], PacketFloat::max(intervalMin, tl), intervalMin);
+                            PacketFloat leftMax = PacketFloat::select(negative[axis], intervalMax, PacketFloat::min(intervalMax, tl));
+                            PacketFloat rightMin = PacketFloat::select(negative[axis], intervalMin, PacketFloat::max(intervalMin, tr));
+                            PacketFloat rightMax = PacketFloat::select(negative[axis], PacketFloat::min(intervalMax, tr), intervalMax);
+                            uint32 leftActive = active & PacketFloat::lessEqual(leftMin, leftMax).bits();
+                            uint32 rightActive = active & PacketFloat::lessEqual(rightMin, rightMax).bits();
+
+                            // all rays pass between clip zones
+                            if (!leftActive && !rightActive)
+                                break;
+                            if (!leftActive)
+                            {
+                                node = offset + 3;
+                                intervalMin = rightMin;
+                                intervalMax = rightMax;
+                                active = rightActive;
+                                continue;
+                            }
+                            if (!rightActive)
+                            {
+                                node = offset;
+                                intervalMin = leftMin;
+                                intervalMax = leftMax;
+                                active = leftActive;
+                                continue;
+                            }
+
+                            // rays pass through both nodes, visit the one most of them reach first
+                            uint32 negativeLanes = active & negative[axis].bits();
+                            bool rightFirst = countBits(negativeLanes) * 2 > countBits(active);
+                            PacketStackNode& farNode = stack[stackPos++];
+                            if (rightFirst)
+                            {
+                                farNode.node = offset;
+                                leftMin.store(farNode.tnear);
+                                leftMax.store(farNode.tfar);
+                                farNode.mask = leftActive;
+                                node = offset + 3;
+                                intervalMin = rightMin;
+                                intervalMax = rightMax;
+                                active = rightActive;
+                            }
+                            else
+                            {
+                                farNode.node = offset + 3;
+                                rightMin.store(farNode.tnear);
+                                rightMax.store(farNode.tfar);
+                                farNode.mask = rightActive;
+                                node = offset;
+                                intervalMin = leftMin;
+                                intervalMax = leftMax;
+                                active = leftActive;
+                            }
+                            continue;
+                        }
+                        else
+                        {
+                            // leaf - test some objects
+                            int n = tree[node + 1];
+                            while (n > 0 && active) {
+                                uint32 hit = intersectCallback(packet, objects[offset], maxDist, active, stopAtFirst);
+                                hits |= hit;
+                                if (stopAtFirst)
+                                {
+                                    active &= ~hit;
+                                    if ((hits & pending) == pending)
+                                        return hits;
+                                }
+                                --n;
+                                ++offset;
+                            }
+                            break;
+                        }
+                    }
+                    else
+                    {
+                        if (axis>2)
+                            return hits; // should not happen
+                        PacketFloat t1 = (PacketFloat::splat(intBitsToFloat(tree[node + 1])) - org[axis]) * invDir[axis];
+                        PacketFloat t2 = (PacketFloat::splat(intBitsToFloat(tree[node + 2])) - org[axis]) * invDir[axis];
+                        node = offset;
+                        intervalMin = PacketFloat::max(PacketFloat::select(negative[axis], t2, t1), intervalMin);
+                        intervalMax = PacketFloat::min(PacketFloat::select(negative[axis], t1, t2), intervalMax);
+                        active &= PacketFloat::lessEqual(intervalMin, intervalMax).bits();
+                        if (!active)
+                            break;
+                        continue;
+                    }
+                } // traversal loop
+                do
+                {
+                    // stack is empty?
+                    if (stackPos == 0)
+                        return hits;
+                    // move back up the stack, dropping lanes that are done or already hit something closer
+                    stackPos--;
+                    intervalMin = PacketFloat::load(stack[stackPos].tnear);
+                    active = stack[stackPos].mask & PacketFloat::lessEqual(intervalMin, PacketFloat::load(maxDist)).bits();
+                    if (stopAtFirst)
+                        active &= ~hits;
+                    if (!active)
+                        continue;
+                    node = stack[stackPos].node;
+                    intervalMax = PacketFloat::load(stack[stackPos].tfar);
+                    break;
+                } while (true);
+            }
+        }
+
         template<typename IsectCallback>
         void intersectPoint(const Vector3 &p, IsectCallback& intersectCallback) const
         {
@@ -337,12 +544,21 @@ class BIH
 
         bool writeToFile(FILE* wf) const;
         bool readFromFile(FILE* rf);
+        //! uses the node and object arrays in place when they are aligned, the mapping has to outlive the tree
+        bool readFromMemory(VMAP::MappedFileReader &reader);
 
     protected:
-        std::vector<uint32> tree;
-        std::vector<uint32> objects;
+        // tree and objects either point into the storage vectors or into a memory mapped file
+        const uint32* tree;
+        const uint32* objects;
+        uint32 treeSize;
+        uint32 objectCount;
+        std::vector<uint32> treeStorage;
+        std::vector<uint32> objectStorage;
         AABox bounds;
 
+        void useStorage();
+
         struct buildData
         {
             uint32 *indices;
@@ -356,6 +572,21 @@ class BIH
             float tnear;
             float tfar;
         };
+        struct PacketStackNode
+        {
+            uint32 node;
+            uint32 mask;
+            float tnear[RAY_PACKET_SIZE];
+            float tfar[RAY_PACKET_SIZE];
+        };
+
+        static uint32 countBits(uint32 mask)
+        {
+            uint32 count = 0;
+            for (; mask; mask &= mask - 1)
+                ++count;
+            return count;
+        }
 
         class BuildStats
         {
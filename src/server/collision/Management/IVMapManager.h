@@ -47,9 +47,10 @@ namespace VMAP
         private:
             bool iEnableLineOfSightCalc;
             bool iEnableHeightCalc;
+            uint32 iLineOfSightCacheSize;
 
         public:
-            IVMapManager() : iEnableLineOfSightCalc(true), iEnableHeightCalc(true) {}
+            IVMapManager() : iEnableLineOfSightCalc(true), iEnableHeightCalc(true), iLineOfSightCacheSize(0) {}
 
             virtual ~IVMapManager(void) {}
 
@@ -60,7 +61,26 @@ namespace VMAP
             virtual void unloadMap(unsigned int pMapId, int x, int y) = 0;
             virtual void unloadMap(unsigned int pMapId) = 0;
 
-            virtual bool isInLineOfSight(unsigned int pMapId, float x1, float y1, float z1, float x2, float y2, float z2) = 0;
+            /**
+            Load the models of a tile ahead of loadMap(), may be called from any thread.
+            The model references are handed over to the tile by loadMap() or dropped by releasePrefetchedTile().
+            */
+            virtual bool prefetchMapTile(const char* pBasePath, unsigned int pMapId, int x, int y) = 0;
+            virtual void releasePrefetchedTile(unsigned int pMapId, int x, int y) = 0;
+
+            /**
+            pUseCache false skips the line of sight cache of the map, e.g. to measure the raw collision
+            */
+            virtual bool isInLineOfSight(unsigned int pMapId, float x1, float y1, float z1, float x2, float y2, float z2, bool pUseCache = true) = 0;
+            /**
+            Line of sight from one point to count targets, results[i] is set for target i.
+            The rays are traversed together, which is cheaper than count single checks.
+            */
+            virtual void isInLineOfSight(unsigned int pMapId, float x1, float y1, float z1, uint32 count, const float* x2, const float* y2, const float* z2, bool* results, bool pUseCache = true) = 0;
+            /**
+            Sum of the line of sight cache counters of all loaded maps, must not run concurrently with map updates
+            */
+            virtual void getLineOfSightCacheStats(uint32& maps, uint64& hits, uint64& misses) const = 0;
             virtual float getHeight(unsigned int pMapId, float x, float y, float z, float maxSearchDist) = 0;
             /**
             test if we hit an object. return true if we hit one. rx, ry, rz will hold the hit position or the dest position, if no intersection was found
@@ -82,9 +102,15 @@ namespace VMAP
             It is enabled by default. If it is enabled in mid game the maps have to loaded manualy
             */
             void setEnableHeightCalc(bool pVal) { iEnableHeightCalc = pVal; }
+            /**
+            Entries of the line of sight cache of each map, 0 disables the cache
+            Only maps loaded after the call are affected, set it from the config before loading maps
+            */
+            void setLineOfSightCacheSize(uint32 pVal) { iLineOfSightCacheSize = pVal; }
 
             bool isLineOfSightCalcEnabled() const { return(iEnableLineOfSightCalc); }
             bool isHeightCalcEnabled() const { return(iEnableHeightCalc); }
+            uint32 getLineOfSightCacheSize() const { return(iLineOfSightCacheSize); }
             bool isMapLoadingEnabled() const { return(iEnableLineOfSightCalc || iEnableHeightCalc  ); }
 
             virtual std::string getDirFileName(unsigned int pMapId, int x, int y) const =0;
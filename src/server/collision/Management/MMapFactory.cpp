@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ * Copyright (C) 2008-2012 TrinityCore <http://www.trinitycore.org/>
+ * Copyright (C) 2005-2012 MaNGOS <http://getmangos.com/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "MMapFactory.h"
+
+namespace MMAP
+{
+    MMapManager* gMMapManager = NULL;
+    bool gPathfindingEnabled = false;
+
+    //===============================================
+    // just return the instance
+    MMapManager* MMapFactory::createOrGetMMapManager()
+    {
+        if (gMMapManager == NULL)
+            gMMapManager = new MMapManager();
+        return gMMapManager;
+    }
+
+    //===============================================
+
+    void MMapFactory::setPathfindingEnabled(bool enabled)
+    {
+        gPathfindingEnabled = enabled;
+    }
+
+    bool MMapFactory::isPathfindingEnabled()
+    {
+        return gPathfindingEnabled;
+    }
+
+    //===============================================
+    // delete all internal data structures
+    void MMapFactory::clear()
+    {
+        delete gMMapManager;
+        gMMapManager = NULL;
+    }
+}
@@ -0,0 +1,342 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ * Copyright (C) 2008-2012 TrinityCore <http://www.trinitycore.org/>
+ * Copyright (C) 2005-2012 MaNGOS <http://getmangos.com/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Common.h"
+#include "MMapManager.h"
+#include "MMapDefines.h"
+#include "Log.h"
+
+namespace MMAP
+{
+    // nodes a query may visit when searching a path, bounds the cost of a single search
+    #define MMAP_MAX_QUERY_NODES    2048
+
+    MMapData::~MMapData()
+    {
+        for (NavMeshQueryPool::iterator itr = freeQueries.begin(); itr != freeQueries.end(); ++itr)
+            dtFreeNavMeshQuery(*itr);
+
+        dtFreeNavMesh(navMesh);
+    }
+
+    MMapManager::~MMapManager()
+    {
+        for (MMapDataSet::iterator i = loadedMMaps.begin(); i != loadedMMaps.end(); ++i)
+            delete i->second;
+
+    }
+
+    MMapData* MMapManager::getMMapData(uint32 mapId)
+    {
+        TRINITY_GUARD(ACE_Thread_Mutex, MMapsLock);
+        MMapDataSet::iterator itr = loadedMMaps.find(mapId);
+        return itr != loadedMMaps.end() ? itr->second : NULL;
+    }
+
+    bool MMapManager::loadMapData(const std::string& basePath, uint32 mapId)
+    {
+        // we already have this map loaded?
+        if (getMMapData(mapId))
+            return true;
+
+        // load and init dtNavMesh - read parameters from file
+        std::string fileName = basePath + "mmaps/";
+        char name[16];
+        snprintf(name, sizeof(name), "%03u.mmap", mapId);
+        fileName += name;
+
+        FILE* file = fopen(fileName.c_str(), "rb");
+        if (!file)
+        {
+            sLog->outDebug(LOG_FILTER_MAPS, "MMAP:loadMapData: Error: Could not open mmap file '%s'", fileName.c_str());
+            return false;
+        }
+
+        dtNavMeshParams params;
+        size_t count = fread(&params, sizeof(dtNavMeshParams), 1, file);
+        fclose(file);
+        if (count != 1)
+        {
+            sLog->outError("MMAP:loadMapData: Error: Could not read params from file '%s'", fileName.c_str());
+            return false;
+        }
+
+        dtNavMesh* mesh = dtAllocNavMesh();
+        ASSERT(mesh);
+        if (mesh->init(&params) != DT_SUCCESS)
+        {
+            dtFreeNavMesh(mesh);
+            sLog->outError("MMAP:loadMapData: Failed to initialize dtNavMesh for mmap %03u from file %s", mapId, fileName.c_str());
+            return false;
+        }
+
+        sLog->outDetail("MMAP:loadMapData: Loaded %03u.mmap", mapId);
+
+        TRINITY_GUARD(ACE_Thread_Mutex, MMapsLock);
+        // another map thread may have been faster
+        if (loadedMMaps.find(mapId) != loadedMMaps.end())
+        {
+            dtFreeNavMesh(mesh);
+            return true;
+        }
+
+        loadedMMaps.insert(MMapDataSet::value_type(mapId, new MMapData(mesh)));
+        return true;
+    }
+
+    bool MMapManager::loadMap(const std::string& basePath, uint32 mapId, int32 x, int32 y)
+    {
+        // make sure the mmap is loaded and ready to load tiles
+        if (!loadMapData(basePath, mapId))
+            return false;
+
+        MMapData* mmap = getMMapData(mapId);
+        ASSERT(mmap->navMesh);
+
+        uint32 packedGridPos = packTileID(x, y);
+        {
+            TRINITY_READ_GUARD(ACE_RW_Thread_Mutex, mmap->meshLock);
+            if (mmap->loadedTileRefs.find(packedGridPos) != mmap->loadedTileRefs.end())
+                return false;
+        }
+
+        // load this tile :: mmaps/MMMXXYY.mmtile
+        std::string fileName = basePath + "mmaps/";
+        char name[20];
+        snprintf(name, sizeof(name), "%03u%02i%02i.mmtile", mapId, x, y);
+        fileName += name;
+
+        FILE* file = fopen(fileName.c_str(), "rb");
+        if (!file)
+        {
+            sLog->outDebug(LOG_FILTER_MAPS, "MMAP:loadMap: Could not open mmtile file '%s'", fileName.c_str());
+            return false;
+        }
+
+        // read header
+        MmapTileHeader fileHeader;
+        if (fread(&fileHeader, sizeof(MmapTileHeader), 1, file) != 1 || fileHeader.mmapMagic != MMAP_MAGIC)
+        {
+            sLog->outError("MMAP:loadMap: Bad header in mmap %03u%02i%02i.mmtile", mapId, x, y);
+            fclose(file);
+            return false;
+        }
+
+        if (fileHeader.mmapVersion != MMAP_VERSION || fileHeader.dtVersion != DT_NAVMESH_VERSION)
+        {
+            sLog->outError("MMAP:loadMap: %03u%02i%02i.mmtile was built with generator v%u and Detour v%u, expected v%u and v%u",
+                mapId, x, y, fileHeader.mmapVersion, fileHeader.dtVersion, MMAP_VERSION, DT_NAVMESH_VERSION);
+            fclose(file);
+            return false;
+        }
+
+        // the generator marks tiles without any walkable polygon with an empty body
+        if (!fileHeader.size)
+        {
+            fclose(file);
+            return false;
+        }
+
+        unsigned char* data = (unsigned char*)dtAlloc(fileHeader.size, DT_ALLOC_PERM);
+        ASSERT(data);
+
+        size_t result = fread(data, fileHeader.size, 1, file);
+        fclose(file);
+        if (!result)
+        {
+            sLog->outError("MMAP:loadMap: Bad header or data in mmap %03u%02i%02i.mmtile", mapId, x, y);
+            dtFree(data);
+            return false;
+        }
+
+        dtMeshHeader* header = (dtMeshHeader*)data;
+        dtTileRef tileRef = 0;
+
+        TRINITY_WRITE_GUARD(ACE_RW_Thread_Mutex, mmap->meshLock);
+        if (mmap->loadedTileRefs.find(packedGridPos) != mmap->loadedTileRefs.end())
+        {
+            dtFree(data);
+            return false;
+        }
+
+        // memory allocated for data is now managed by detour, and will be deallocated when the tile is removed
+        if (mmap->navMesh->addTile(data, fileHeader.size, DT_TILE_FREE_DATA, 0, &tileRef) != DT_SUCCESS)
+        {
+            sLog->outError("MMAP:loadMap: Could not load %03u%02i%02i.mmtile into navmesh", mapId, x, y);
+            dtFree(data);
+            return false;
+        }
+
+        mmap->loadedTileRefs.insert(MMapTileSet::value_type(packedGridPos, tileRef));
+        ++loadedTiles;
+        sLog->outDetail("MMAP:loadMap: Loaded mmtile %03u[%02i, %02i] into %03u[%02i, %02i]", mapId, x, y, mapId, header->x, header->y);
+        return true;
+    }
+
+    bool MMapManager::unloadMap(uint32 mapId, int32 x, int32 y)
+    {
+        // check if we have this map loaded
+        MMapData* mmap = getMMapData(mapId);
+        if (!mmap)
+            return false;
+
+        // check if we have this tile loaded
+        uint32 packedGridPos = packTileID(x, y);
+
+        TRINITY_WRITE_GUARD(ACE_RW_Thread_Mutex, mmap->meshLock);
+        MMapTileSet::iterator itr = mmap->loadedTileRefs.find(packedGridPos);
+        if (itr == mmap->loadedTileRefs.end())
+            return false;
+
+        // unload, and mark as non loaded
+        if (mmap->navMesh->removeTile(itr->second, NULL, NULL) != DT_SUCCESS)
+        {
+            // this is technically a memory leak
+            // if the grid is later reloaded, dtNavMesh::addTile will return error but no extra memory is used
+            // we cannot recover from this error - assert out
+            sLog->outError("MMAP:unloadMap: Could not unload %03u%02i%02i.mmtile from navmesh", mapId, x, y);
+            ASSERT(false);
+        }
+
+        mmap->loadedTileRefs.erase(itr);
+        --loadedTiles;
+        sLog->outDetail("MMAP:unloadMap: Unloaded mmtile %03u[%02i, %02i] from %03u", mapId, x, y, mapId);
+        return true;
+    }
+
+    bool MMapManager::unloadMap(uint32 mapId)
+    {
+        MMapData* mmap;
+        {
+            // queries in use still look the map up on release, wait for them under the same lock
+            TRINITY_GUARD(ACE_Thread_Mutex, MMapsLock);
+            MMapDataSet::iterator itr = loadedMMaps.find(mapId);
+            if (itr == loadedMMaps.end())
+                return false;
+
+            mmap = itr->second;
+            while (mmap->queryUsers)
+                MMapsCondition.wait();
+
+            loadedMMaps.erase(mapId);
+        }
+
+        // wait for tiles still being loaded into the navmesh
+        {
+            TRINITY_WRITE_GUARD(ACE_RW_Thread_Mutex, mmap->meshLock);
+            for (MMapTileSet::iterator i = mmap->loadedTileRefs.begin(); i != mmap->loadedTileRefs.end(); ++i)
+            {
+                if (mmap->navMesh->removeTile(i->second, NULL, NULL) != DT_SUCCESS)
+                    sLog->outError("MMAP:unloadMap: Could not unload %03u%02u%02u.mmtile from navmesh", mapId, i->first >> 16, i->first & 0xFFFF);
+                else
+                    --loadedTiles;
+            }
+        }
+
+        delete mmap;
+        sLog->outDetail("MMAP:unloadMap: Unloaded %03u.mmap", mapId);
+        return true;
+    }
+
+    dtNavMeshQuery const* MMapManager::acquireNavMeshQuery(uint32 mapId)
+    {
+        MMapData* mmap;
+        {
+            TRINITY_GUARD(ACE_Thread_Mutex, MMapsLock);
+            MMapDataSet::iterator itr = loadedMMaps.find(mapId);
+            if (itr == loadedMMaps.end())
+                return NULL;
+
+            mmap = itr->second;
+            ++mmap->queryUsers;
+        }
+
+        mmap->meshLock.acquire_read();
+
+        dtNavMeshQuery* query = NULL;
+        {
+            TRINITY_GUARD(ACE_Thread_Mutex, mmap->poolLock);
+            if (!mmap->freeQueries.empty())
+            {
+                query = mmap->freeQueries.back();
+                mmap->freeQueries.pop_back();
+            }
+        }
+
+        if (!query)
+        {
+            // allocate mesh query
+            query = dtAllocNavMeshQuery();
+            ASSERT(query);
+            if (query->init(mmap->navMesh, MMAP_MAX_QUERY_NODES) != DT_SUCCESS)
+            {
+                dtFreeNavMeshQuery(query);
+                sLog->outError("MMAP:acquireNavMeshQuery: Failed to initialize dtNavMeshQuery for map %03u", mapId);
+                releaseMMapData(mmap);
+                return NULL;
+            }
+
+            TRINITY_GUARD(ACE_Thread_Mutex, mmap->poolLock);
+            ++mmap->queryCount;
+        }
+
+        return query;
+    }
+
+    void MMapManager::releaseNavMeshQuery(uint32 mapId, dtNavMeshQuery const* query)
+    {
+        // unloadMap waits for this query, so the map is still there
+        MMapData* mmap = getMMapData(mapId);
+        ASSERT(mmap);
+
+        {
+            TRINITY_GUARD(ACE_Thread_Mutex, mmap->poolLock);
+            mmap->freeQueries.push_back(const_cast<dtNavMeshQuery*>(query));
+        }
+
+        releaseMMapData(mmap);
+    }
+
+    void MMapManager::releaseMMapData(MMapData* mmap)
+    {
+        mmap->meshLock.release();
+
+        TRINITY_GUARD(ACE_Thread_Mutex, MMapsLock);
+        if (!--mmap->queryUsers)
+            MMapsCondition.broadcast();
+    }
+
+    uint32 MMapManager::getLoadedMapsCount()
+    {
+        TRINITY_GUARD(ACE_Thread_Mutex, MMapsLock);
+        return uint32(loadedMMaps.size());
+    }
+
+    uint32 MMapManager::getQueryCount()
+    {
+        uint32 count = 0;
+
+        TRINITY_GUARD(ACE_Thread_Mutex, MMapsLock);
+        for (MMapDataSet::iterator itr = loadedMMaps.begin(); itr != loadedMMaps.end(); ++itr)
+        {
+            TRINITY_GUARD(ACE_Thread_Mutex, itr->second->poolLock);
+            count += itr->second->queryCount;
+        }
+        return count;
+    }
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ * Copyright (C) 2008-2012 TrinityCore <http://www.trinitycore.org/>
+ * Copyright (C) 2005-2012 MaNGOS <http://getmangos.com/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _MMAPMANAGER_H
+#define _MMAPMANAGER_H
+
+#include "Define.h"
+#include "Dynamic/UnorderedMap.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+
+#include <string>
+#include <vector>
+
+#include <ace/Atomic_Op.h>
+#include <ace/RW_Thread_Mutex.h>
+#include <ace/Thread_Mutex.h>
+#include <ace/Condition_Thread_Mutex.h>
+
+//===========================================================
+
+namespace MMAP
+{
+    typedef UNORDERED_MAP<uint32, dtTileRef> MMapTileSet;
+    typedef std::vector<dtNavMeshQuery*> NavMeshQueryPool;
+
+    // navmesh of one map id, shared by all instances of that map
+    struct MMapData
+    {
+        MMapData(dtNavMesh* mesh) : navMesh(mesh), queryCount(0), queryUsers(0) { }
+        ~MMapData();
+
+        dtNavMesh* navMesh;
+        MMapTileSet loadedTileRefs;                         // maps packed grid coords to the Detour tile
+
+        // tiles are added and removed under the write lock, queries hold the read lock while in use
+        ACE_RW_Thread_Mutex meshLock;
+
+        // queries are not thread safe, maps updated in parallel each take their own from the pool
+        ACE_Thread_Mutex poolLock;
+        NavMeshQueryPool freeQueries;
+        uint32 queryCount;
+
+        // queries acquired and not yet released, guarded by MMapManager::MMapsLock,
+        // the map is not unloaded before they are all back
+        uint32 queryUsers;
+    };
+
+    typedef UNORDERED_MAP<uint32, MMapData*> MMapDataSet;
+
+    class MMapManager
+    {
+        public:
+            MMapManager() : MMapsCondition(MMapsLock), loadedTiles(0) { }
+            ~MMapManager();
+
+            bool loadMap(const std::string& basePath, uint32 mapId, int32 x, int32 y);
+            bool unloadMap(uint32 mapId, int32 x, int32 y);
+            bool unloadMap(uint32 mapId);
+
+            // takes a query from the pool of the map, the navmesh is not modified until it is released
+            dtNavMeshQuery const* acquireNavMeshQuery(uint32 mapId);
+            void releaseNavMeshQuery(uint32 mapId, dtNavMeshQuery const* query);
+
+            uint32 getLoadedTilesCount() const { return uint32(loadedTiles.value()); }
+            uint32 getLoadedMapsCount();
+            uint32 getQueryCount();
+
+        private:
+            MMapData* getMMapData(uint32 mapId);
+            void releaseMMapData(MMapData* mmap);
+            bool loadMapData(const std::string& basePath, uint32 mapId);
+            static uint32 packTileID(int32 x, int32 y) { return uint32(x << 16 | y); }
+
+            MMapDataSet loadedMMaps;
+            ACE_Thread_Mutex MMapsLock;
+            ACE_Condition_Thread_Mutex MMapsCondition;          // signaled when the last query of a map is released
+            ACE_Atomic_Op<ACE_Thread_Mutex, long> loadedTiles;   // tiles of different maps load concurrently
+    };
+}
+
+#endif
@@ -97,10 +97,67 @@ namespace VMAP
             StaticMapTree* newTree = new StaticMapTree(mapId, basePath);
             if (!newTree->InitMap(mapFileName, this))
                 return false;
+            newTree->getLineOfSightCache().SetSize(getLineOfSightCacheSize());
             instanceTree = iInstanceMapTrees.insert(InstanceTreeMap::value_type(mapId, newTree)).first;
         }
 
-        return instanceTree->second->LoadMapTile(tileX, tileY, this);
+        bool result = instanceTree->second->LoadMapTile(tileX, tileY, this);
+        // the tile holds its own model references now
+        releasePrefetchedTile(mapId, tileX, tileY);
+        return result;
+    }
+
+    bool VMapManager2::prefetchMapTile(const char* basePath, unsigned int mapId, int x, int y)
+    {
+        if (!isMapLoadingEnabled())
+            return false;
+
+        std::string path = basePath;
+        if (path.length() > 0 && path[path.length()-1] != '/' && path[path.length()-1] != '\\')
+            path.push_back('/');
+
+        std::vector<std::string> names;
+        if (!StaticMapTree::GetTileModelNames(path, mapId, x, y, names))
+            return false;
+
+        std::vector<std::string> acquired;
+        for (std::vector<std::string>::const_iterator itr = names.begin(); itr != names.end(); ++itr)
+            if (acquireModelInstance(path, *itr))
+                acquired.push_back(*itr);
+
+        uint64 key = (uint64(mapId) << 32) | StaticMapTree::packTileID(x, y);
+        {
+            TRINITY_GUARD(ACE_Thread_Mutex, PrefetchedTilesLock);
+            std::vector<std::string>& tile = iPrefetchedTiles[key];
+            if (tile.empty())
+            {
+                tile.swap(acquired);
+                return true;
+            }
+        }
+
+        // tile was prefetched twice, keep the first set of references only
+        for (std::vector<std::string>::const_iterator itr = acquired.begin(); itr != acquired.end(); ++itr)
+            releaseModelInstance(*itr);
+
+        return true;
+    }
+
+    void VMapManager2::releasePrefetchedTile(unsigned int mapId, int x, int y)
+    {
+        std::vector<std::string> names;
+        {
+            TRINITY_GUARD(ACE_Thread_Mutex, PrefetchedTilesLock);
+            PrefetchedTileMap::iterator tile = iPrefetchedTiles.find((uint64(mapId) << 32) | StaticMapTree::packTileID(x, y));
+            if (tile == iPrefetchedTiles.end())
+                return;
+
+            names.swap(tile->second);
+            iPrefetchedTiles.erase(tile);
+        }
+
+        for (std::vector<std::string>::const_iterator itr = names.begin(); itr != names.end(); ++itr)
+            releaseModelInstance(*itr);
     }
 
     void VMapManager2::unloadMap(unsigned int mapId)
@@ -131,7 +188,7 @@ namespace VMAP
         }
     }
 
-    bool VMapManager2::isInLineOfSight(unsigned int mapId, float x1, float y1, float z1, float x2, float y2, float z2)
+    bool VMapManager2::isInLineOfSight(unsigned int mapId, float x1, float y1, float z1, float x2, float y2, float z2, bool useCache)
     {
         if (!isLineOfSightCalcEnabled() || DisableMgr::IsDisabledFor(DISABLE_TYPE_VMAP, mapId, NULL, VMAP_DISABLE_LOS))
             return true;
@@ -143,13 +200,96 @@ namespace VMAP
             Vector3 pos2 = convertPositionToInternalRep(x2, y2, z2);
             if (pos1 != pos2)
             {
-                return instanceTree->second->isInLineOfSight(pos1, pos2);
+                // spell casts and aggro checks repeat nearly the same rays every update
+                LineOfSightCache& cache = instanceTree->second->getLineOfSightCache();
+                if (!useCache || !cache.IsEnabled())
+                    return instanceTree->second->isInLineOfSight(pos1, pos2);
+
+                LineOfSightCache::Key key;
+                bool result;
+                if (cache.Lookup(pos1, pos2, key, result))
+                    return result;
+
+                result = instanceTree->second->isInLineOfSight(pos1, pos2);
+                cache.Store(key, result);
+                return result;
             }
         }
 
         return true;
     }
 
+    void VMapManager2::isInLineOfSight(unsigned int mapId, float x1, float y1, float z1, uint32 count, const float* x2, const float* y2, const float* z2, bool* results, bool useCache)
+    {
+        InstanceTreeMap::iterator instanceTree = iInstanceMapTrees.end();
+        if (isLineOfSightCalcEnabled() && !DisableMgr::IsDisabledFor(DISABLE_TYPE_VMAP, mapId, NULL, VMAP_DISABLE_LOS))
+            instanceTree = iInstanceMapTrees.find(mapId);
+
+        if (instanceTree == iInstanceMapTrees.end())
+        {
+            for (uint32 i = 0; i < count; ++i)
+                results[i] = true;
+            return;
+        }
+
+        StaticMapTree* tree = instanceTree->second;
+        LineOfSightCache& cache = tree->getLineOfSightCache();
+        useCache = useCache && cache.IsEnabled();
+        Vector3 pos1 = convertPositionToInternalRep(x1, y1, z1);
+
+        // rays missing the cache are collected and traversed together, a few packets at a time
+        const uint32 BATCH_SIZE = RAY_PACKET_SIZE * 4;
+        Vector3 targets[BATCH_SIZE];
+        LineOfSightCache::Key keys[BATCH_SIZE];
+        uint32 index[BATCH_SIZE];
+        bool batchResults[BATCH_SIZE];
+        uint32 pending = 0;
+
+        for (uint32 i = 0; i < count; ++i)
+        {
+            Vector3 pos2 = convertPositionToInternalRep(x2[i], y2[i], z2[i]);
+            if (pos1 == pos2)
+                results[i] = true;
+            else if (!useCache || !cache.Lookup(pos1, pos2, keys[pending], results[i]))
+            {
+                targets[pending] = pos2;
+                index[pending] = i;
+                ++pending;
+            }
+
+            if (pending == BATCH_SIZE || (pending && i + 1 == count))
+            {
+                tree->isInLineOfSight(pos1, targets, pending, batchResults);
+                for (uint32 j = 0; j < pending; ++j)
+                {
+                    results[index[j]] = batchResults[j];
+                    if (useCache)
+                        cache.Store(keys[j], batchResults[j]);
+                }
+                pending = 0;
+            }
+        }
+    }
+
+    void VMapManager2::getLineOfSightCacheStats(uint32& maps, uint64& hits, uint64& misses) const
+    {
+        maps = 0;
+        hits = 0;
+        misses = 0;
+        for (InstanceTreeMap::const_iterator itr = iInstanceMapTrees.begin(); itr != iInstanceMapTrees.end(); ++itr)
+        {
+            LineOfSightCache const& cache = itr->second->getLineOfSightCache();
+            if (!cache.IsEnabled())
+                continue;
+
+            uint64 mapHits, mapMisses;
+            cache.GetStats(mapHits, mapMisses);
+            hits += mapHits;
+            misses += mapMisses;
+            ++maps;
+        }
+    }
+
     /**
     get the hit position and return true if we hit something
     otherwise the result pos will be the dest pos
@@ -248,43 +388,65 @@ namespace VMAP
 
     WorldModel* VMapManager2::acquireModelInstance(const std::string& basepath, const std::string& filename)
     {
-        //! Critical section, thread safe access to iLoadedModelFiles
-        TRINITY_GUARD(ACE_Thread_Mutex, LoadedModelFilesLock);
+        // models shared by many tiles are usually loaded already, only take a reference then
+        {
+            TRINITY_READ_GUARD(ACE_RW_Thread_Mutex, LoadedModelFilesLock);
+            ModelFileMap::iterator model = iLoadedModelFiles.find(filename);
+            if (model != iLoadedModelFiles.end())
+            {
+                model->second.incRefCount();
+                return model->second.getModel();
+            }
+        }
 
+        // map the file outside of the lock so other maps keep loading their tiles meanwhile
+        WorldModel* worldmodel = new WorldModel();
+        if (!worldmodel->readFile(basepath + filename + ".vmo"))
+        {
+            sLog->outError("VMapManager2: could not load '%s%s.vmo'", basepath.c_str(), filename.c_str());
+            delete worldmodel;
+            return NULL;
+        }
+
+        //! Critical section, thread safe access to iLoadedModelFiles
+        TRINITY_WRITE_GUARD(ACE_RW_Thread_Mutex, LoadedModelFilesLock);
         ModelFileMap::iterator model = iLoadedModelFiles.find(filename);
         if (model == iLoadedModelFiles.end())
         {
-            WorldModel* worldmodel = new WorldModel();
-            if (!worldmodel->readFile(basepath + filename + ".vmo"))
-            {
-                sLog->outError("VMapManager2: could not load '%s%s.vmo'", basepath.c_str(), filename.c_str());
-                delete worldmodel;
-                return NULL;
-            }
             sLog->outDebug(LOG_FILTER_MAPS, "VMapManager2: loading file '%s%s'", basepath.c_str(), filename.c_str());
             model = iLoadedModelFiles.insert(std::pair<std::string, ManagedModel>(filename, ManagedModel())).first;
             model->second.setModel(worldmodel);
         }
+        else // another thread loaded the same file meanwhile
+            delete worldmodel;
         model->second.incRefCount();
         return model->second.getModel();
     }
 
     void VMapManager2::releaseModelInstance(const std::string &filename)
     {
+        {
+            TRINITY_READ_GUARD(ACE_RW_Thread_Mutex, LoadedModelFilesLock);
+            ModelFileMap::iterator model = iLoadedModelFiles.find(filename);
+            if (model == iLoadedModelFiles.end())
+            {
+                sLog->outError("VMapManager2: trying to unload non-loaded file '%s'", filename.c_str());
+                return;
+            }
+            if (model->second.decRefCount() > 0)
+                return;
+        }
+
         //! Critical section, thread safe access to iLoadedModelFiles
-        TRINITY_GUARD(ACE_Thread_Mutex, LoadedModelFilesLock);
+        TRINITY_WRITE_GUARD(ACE_RW_Thread_Mutex, LoadedModelFilesLock);
         ModelFileMap::iterator model = iLoadedModelFiles.find(filename);
-        if (model == iLoadedModelFiles.end())
-        {
-            sLog->outError("VMapManager2: trying to unload non-loaded file '%s'", filename.c_str());
+        // the model may have been acquired again or unloaded by another thread before we got here
+        if (model == iLoadedModelFiles.end() || model->second.getRefCount() > 0)
             return;
-        }
-        if (model->second.decRefCount() == 0)
-        {
-            sLog->outDebug(LOG_FILTER_MAPS, "VMapManager2: unloading file '%s'", filename.c_str());
-            delete model->second.getModel();
-            iLoadedModelFiles.erase(model);
-        }
+
+        sLog->outDebug(LOG_FILTER_MAPS, "VMapManager2: unloading file '%s'", filename.c_str());
+        delete model->second.getModel();
+        iLoadedModelFiles.erase(model);
     }
 
     bool VMapManager2::existsMap(const char* basePath, unsigned int mapId, int x, int y)
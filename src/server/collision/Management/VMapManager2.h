@@ -24,6 +24,10 @@
 #include "Dynamic/UnorderedMap.h"
 #include "Define.h"
 
+#include <vector>
+
+#include <ace/Atomic_Op.h>
+#include <ace/RW_Thread_Mutex.h>
 #include <ace/Thread_Mutex.h>
 //===========================================================
 
@@ -57,15 +61,18 @@ namespace VMAP
             ManagedModel() : iModel(0), iRefCount(0) {}
             void setModel(WorldModel* model) { iModel = model; }
             WorldModel* getModel() { return iModel; }
+            // atomic, references are taken and dropped under the read lock of the model map
             void incRefCount() { ++iRefCount; }
-            int decRefCount() { return --iRefCount; }
+            long decRefCount() { return --iRefCount; }
+            long getRefCount() const { return iRefCount.value(); }
         protected:
             WorldModel* iModel;
-            int iRefCount;
+            ACE_Atomic_Op<ACE_Thread_Mutex, long> iRefCount;
     };
 
     typedef UNORDERED_MAP<uint32, StaticMapTree*> InstanceTreeMap;
     typedef UNORDERED_MAP<std::string, ManagedModel> ModelFileMap;
+    typedef UNORDERED_MAP<uint64, std::vector<std::string> > PrefetchedTileMap;
 
     class VMapManager2 : public IVMapManager
     {
@@ -73,8 +80,11 @@ namespace VMAP
             // Tree to check collision
             ModelFileMap iLoadedModelFiles;
             InstanceTreeMap iInstanceMapTrees;
-            // Mutex for iLoadedModelFiles
-            ACE_Thread_Mutex LoadedModelFilesLock;
+            // Lock for iLoadedModelFiles, only loading and unloading a model file takes it exclusively
+            ACE_RW_Thread_Mutex LoadedModelFilesLock;
+            // model references held for tiles that are prefetched but not loaded yet
+            PrefetchedTileMap iPrefetchedTiles;
+            ACE_Thread_Mutex PrefetchedTilesLock;
 
             bool _loadMap(uint32 mapId, const std::string& basePath, uint32 tileX, uint32 tileY);
             /* void _unloadMap(uint32 pMapId, uint32 x, uint32 y); */
@@ -92,7 +102,12 @@ namespace VMAP
             void unloadMap(unsigned int mapId, int x, int y);
             void unloadMap(unsigned int mapId);
 
-            bool isInLineOfSight(unsigned int mapId, float x1, float y1, float z1, float x2, float y2, float z2) ;
+            bool prefetchMapTile(const char* pBasePath, unsigned int mapId, int x, int y);
+            void releasePrefetchedTile(unsigned int mapId, int x, int y);
+
+            bool isInLineOfSight(unsigned int mapId, float x1, float y1, float z1, float x2, float y2, float z2, bool useCache = true);
+            void isInLineOfSight(unsigned int mapId, float x1, float y1, float z1, uint32 count, const float* x2, const float* y2, const float* z2, bool* results, bool useCache = true);
+            void getLineOfSightCacheStats(uint32& maps, uint64& hits, uint64& misses) const;
             /**
             fill the hit pos and return true, if an object was hit
             */
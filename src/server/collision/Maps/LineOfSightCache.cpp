@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ * Copyright (C) 2008-2012 TrinityCore <http://www.trinitycore.org/>
+ * Copyright (C) 2005-2012 MaNGOS <http://getmangos.com/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Common.h"
+#include "LineOfSightCache.h"
+
+#include <G3D/Vector3.h>
+
+#include <algorithm>
+#include <string.h>
+
+namespace
+{
+    // endpoints closer than this (in yards) share a cache entry
+    const float LOS_CACHE_PRECISION = 0.25f;
+    const float GRID_SIZE = 533.33333f;
+
+    // internal x and y cover 0 .. 64 grids, 18 bits each, z is biased by Z_BIAS into 16 bits
+    const float Z_BIAS = 8192.0f;
+    const uint64 XY_MAX = (1 << 18) - 1;
+    const uint64 Z_MAX = (1 << 16) - 1;
+
+    uint64 Quantize(float value, float bias, uint64 max)
+    {
+        float scaled = (value + bias) / LOS_CACHE_PRECISION;
+        if (!(scaled > 0.0f))                               // also catches NaN
+            return 0;
+        if (scaled >= float(max))
+            return max;
+        return uint64(scaled + 0.5f) & max;
+    }
+
+    uint32 TileIndex(float value)
+    {
+        int tile = int(value / GRID_SIZE);
+        if (tile < 0)
+            return 0;
+        return tile > 63 ? 63 : uint32(tile);
+    }
+}
+
+namespace VMAP
+{
+    LineOfSightCache::LineOfSightCache() : _entries(NULL), _mask(0)
+    {
+        memset(_hits, 0, sizeof(_hits));
+        memset(_misses, 0, sizeof(_misses));
+        for (uint32 i = 0; i < TILES_PER_SIDE * TILES_PER_SIDE; ++i)
+            _tileGenerations[i] = 0;
+    }
+
+    LineOfSightCache::~LineOfSightCache()
+    {
+        delete[] _entries;
+    }
+
+    void LineOfSightCache::SetSize(uint32 size)
+    {
+        delete[] _entries;
+        _entries = NULL;
+        _mask = 0;
+
+        if (size < LOCK_STRIPES)
+            return;
+
+        uint32 slots = LOCK_STRIPES;
+        while (slots <= size / 2)
+            slots <<= 1;
+
+        _entries = new Entry[slots];
+        memset(_entries, 0, sizeof(Entry) * slots);
+        _mask = slots - 1;
+    }
+
+    void LineOfSightCache::MakeKey(G3D::Vector3 const& pos1, G3D::Vector3 const& pos2, Key& key) const
+    {
+        uint64 point1 = (Quantize(pos1.x, 0.0f, XY_MAX) << 34) | (Quantize(pos1.y, 0.0f, XY_MAX) << 16) | Quantize(pos1.z, Z_BIAS, Z_MAX);
+        uint64 point2 = (Quantize(pos2.x, 0.0f, XY_MAX) << 34) | (Quantize(pos2.y, 0.0f, XY_MAX) << 16) | Quantize(pos2.z, Z_BIAS, Z_MAX);
+        uint32 tile1 = TileIndex(pos1.x) * TILES_PER_SIDE + TileIndex(pos1.y);
+        uint32 tile2 = TileIndex(pos2.x) * TILES_PER_SIDE + TileIndex(pos2.y);
+
+        // a caster checking its target and the target checking back share the entry
+        if (point2 < point1)
+        {
+            std::swap(point1, point2);
+            std::swap(tile1, tile2);
+        }
+
+        key.points[0] = point1;
+        key.points[1] = point2;
+        key.generation[0] = _tileGenerations[tile1];
+        key.generation[1] = _tileGenerations[tile2];
+
+        uint64 hash = (point1 ^ (point2 * UI64LIT(0x9E3779B97F4A7C15))) * UI64LIT(0xBF58476D1CE4E5B9);
+        key.slot = uint32(hash >> 32) & _mask;
+    }
+
+    bool LineOfSightCache::Lookup(G3D::Vector3 const& pos1, G3D::Vector3 const& pos2, Key& key, bool& inLineOfSight)
+    {
+        MakeKey(pos1, pos2, key);
+
+        uint32 stripe = key.slot % LOCK_STRIPES;
+        TRINITY_GUARD(ACE_Thread_Mutex, _locks[stripe]);
+
+        Entry const& entry = _entries[key.slot];
+        if (entry.valid && entry.points[0] == key.points[0] && entry.points[1] == key.points[1] &&
+            entry.generation[0] == key.generation[0] && entry.generation[1] == key.generation[1])
+        {
+            inLineOfSight = entry.inLineOfSight;
+            ++_hits[stripe];
+            return true;
+        }
+
+        ++_misses[stripe];
+        return false;
+    }
+
+    void LineOfSightCache::Store(Key const& key, bool inLineOfSight)
+    {
+        TRINITY_GUARD(ACE_Thread_Mutex, _locks[key.slot % LOCK_STRIPES]);
+
+        Entry& entry = _entries[key.slot];
+        entry.points[0] = key.points[0];
+        entry.points[1] = key.points[1];
+        entry.generation[0] = key.generation[0];
+        entry.generation[1] = key.generation[1];
+        entry.valid = true;
+        entry.inLineOfSight = inLineOfSight;
+    }
+
+    void LineOfSightCache::InvalidateTile(uint32 tileX, uint32 tileY)
+    {
+        // models of a tile may reach into its neighbours
+        TRINITY_GUARD(ACE_Thread_Mutex, _tileLock);
+        for (uint32 x = tileX ? tileX - 1 : 0; x <= tileX + 1 && x < TILES_PER_SIDE; ++x)
+            for (uint32 y = tileY ? tileY - 1 : 0; y <= tileY + 1 && y < TILES_PER_SIDE; ++y)
+                _tileGenerations[x * TILES_PER_SIDE + y] = uint16(_tileGenerations[x * TILES_PER_SIDE + y] + 1);
+    }
+
+    void LineOfSightCache::GetStats(uint64& hits, uint64& misses) const
+    {
+        hits = 0;
+        misses = 0;
+        for (uint32 i = 0; i < LOCK_STRIPES; ++i)
+        {
+            hits += _hits[i];
+            misses += _misses[i];
+        }
+    }
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ * Copyright (C) 2008-2012 TrinityCore <http://www.trinitycore.org/>
+ * Copyright (C) 2005-2012 MaNGOS <http://getmangos.com/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LINEOFSIGHTCACHE_H
+#define _LINEOFSIGHTCACHE_H
+
+#include "Define.h"
+
+#include <ace/Thread_Mutex.h>
+
+namespace G3D
+{
+    class Vector3;
+}
+
+namespace VMAP
+{
+    /**
+    Direct mapped cache of line of sight results of one map tree.
+    Endpoints are quantized to LOS_CACHE_PRECISION yards in internal coordinates and the pair is stored
+    in a fixed order, rays are tested against both triangle sides so LOS(a, b) == LOS(b, a).
+    Every entry remembers the generation of the tiles holding its endpoints, loading or unloading a tile
+    bumps the generation of that tile and its neighbours which invalidates all entries touching them.
+    The cache is shared by all instances of a map and may be used from several map threads at once.
+    */
+    class LineOfSightCache
+    {
+        public:
+            // quantized endpoints of a ray and the tile generations seen when it was looked up
+            struct Key
+            {
+                uint64 points[2];
+                uint16 generation[2];
+                uint32 slot;
+            };
+
+            LineOfSightCache();
+            ~LineOfSightCache();
+
+            // size is rounded down to a power of two, 0 disables the cache; call before the first lookup
+            void SetSize(uint32 size);
+            bool IsEnabled() const { return _entries != 0; }
+
+            // fills key, store the computed result with the same key on a miss
+            bool Lookup(G3D::Vector3 const& pos1, G3D::Vector3 const& pos2, Key& key, bool& inLineOfSight);
+            void Store(Key const& key, bool inLineOfSight);
+
+            void InvalidateTile(uint32 tileX, uint32 tileY);
+
+            // read without locking, the counters may lag behind busy map threads
+            void GetStats(uint64& hits, uint64& misses) const;
+
+        private:
+            struct Entry
+            {
+                uint64 points[2];
+                uint16 generation[2];
+                bool valid;
+                bool inLineOfSight;
+            };
+
+            enum
+            {
+                LOCK_STRIPES    = 16,
+                TILES_PER_SIDE  = 64
+            };
+
+            void MakeKey(G3D::Vector3 const& pos1, G3D::Vector3 const& pos2, Key& key) const;
+
+            Entry* _entries;
+            uint32 _mask;
+
+            // entry i is guarded by _locks[i % LOCK_STRIPES], the counters of a stripe by the same lock
+            ACE_Thread_Mutex _locks[LOCK_STRIPES];
+            uint64 _hits[LOCK_STRIPES];
+            uint64 _misses[LOCK_STRIPES];
+
+            // read without locking, a stale read only costs a miss or a store that is never hit
+            uint16 volatile _tileGenerations[TILES_PER_SIDE * TILES_PER_SIDE];
+            ACE_Thread_Mutex _tileLock;
+
+            LineOfSightCache(LineOfSightCache const&);
+            LineOfSightCache& operator=(LineOfSightCache const&);
+    };
+}
+
+#endif
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ * Copyright (C) 2008-2012 TrinityCore <http://www.trinitycore.org/>
+ * Copyright (C) 2005-2012 MaNGOS <http://getmangos.com/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _MMAPDEFINES_H
+#define _MMAPDEFINES_H
+
+#include "Define.h"
+#include "DetourNavMesh.h"
+
+// mmaps/<map>.mmap holds the dtNavMeshParams of the map,
+// mmaps/<map><x><y>.mmtile a MmapTileHeader followed by the Detour tile data.
+// Tiles use the same numbering as the maps/*.map grid files.
+
+#define MMAP_MAGIC      0x4D4D4150                          // 'MMAP'
+#define MMAP_VERSION    1
+
+struct MmapTileHeader
+{
+    uint32 mmapMagic;
+    uint32 dtVersion;
+    uint32 mmapVersion;
+    uint32 size;                                            // size of the tile data following the header, 0 if the tile has no polygons
+    uint8  usesLiquids;
+    uint8  padding[3];
+
+    MmapTileHeader() : mmapMagic(MMAP_MAGIC), dtVersion(DT_NAVMESH_VERSION), mmapVersion(MMAP_VERSION), size(0), usesLiquids(1)
+    {
+        padding[0] = padding[1] = padding[2] = 0;
+    }
+};
+
+// polygon area ids and flags of the generated navmesh
+enum NavTerrain
+{
+    NAV_EMPTY   = 0x00,
+    NAV_GROUND  = 0x01,
+    NAV_MAGMA   = 0x02,
+    NAV_SLIME   = 0x04,
+    NAV_WATER   = 0x08
+};
+
+#endif
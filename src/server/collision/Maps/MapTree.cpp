@@ -49,6 +49,10 @@ namespace VMAP
                     hit = true;
                 return result;
             }
+            uint32 operator()(const RayPacket& packet, uint32 entry, float* distance, uint32 laneMask, bool pStopAtFirstHit)
+            {
+                return prims[entry].intersectRayPacket(packet, distance, laneMask, pStopAtFirstHit);
+            }
         bool didHit() { return hit; }
     protected:
         ModelInstance* prims;
@@ -170,6 +174,58 @@ namespace VMAP
 
         return true;
     }
+    //=========================================================
+
+    uint32 StaticMapTree::getIntersectionTimes(const RayPacket& pPacket, float* pMaxDist, uint32 pLaneMask, bool pStopAtFirstHit) const
+    {
+        MapRayCallback intersectionCallBack(iTreeValues);
+        return iTree.intersectRayPacket(pPacket, intersectionCallBack, pMaxDist, pLaneMask, pStopAtFirstHit);
+    }
+
+    //=========================================================
+
+    void StaticMapTree::isInLineOfSight(const Vector3& origin, const Vector3* targets, uint32 count, bool* results) const
+    {
+#ifndef VMAP_RAY_PACKET_SSE
+        // emulated packets are slower than tracing the rays one by one
+        for (uint32 i = 0; i < count; ++i)
+            results[i] = isInLineOfSight(origin, targets[i]);
+#else
+        RayPacket packet;
+        float maxDist[RAY_PACKET_SIZE];
+        uint32 index[RAY_PACKET_SIZE];
+
+        for (uint32 i = 0; i < count; ++i)
+        {
+            results[i] = true;
+
+            Vector3 dir = targets[i] - origin;
+            float dist = dir.magnitude();
+            ASSERT(dist < std::numeric_limits<float>::max());
+            // same NaN guard as the single ray version
+            if (dist < 1e-10f)
+                continue;
+
+            index[packet.count] = i;
+            maxDist[packet.count] = dist;
+            packet.add(origin, dir / dist);
+
+            if (packet.count == RAY_PACKET_SIZE || i + 1 == count)
+            {
+                for (uint32 lane = packet.count; lane < RAY_PACKET_SIZE; ++lane)
+                    maxDist[lane] = 0.0f;
+
+                uint32 hits = getIntersectionTimes(packet, maxDist, packet.laneMask(), true);
+                for (uint32 lane = 0; lane < packet.count; ++lane)
+                    if (hits & (1 << lane))
+                        results[index[lane]] = false;
+
+                packet = RayPacket();
+            }
+        }
+#endif
+    }
+
     //=========================================================
     /**
     When moving from pos1 to pos2 check if we hit an object. Return true and the position if we hit one
@@ -271,6 +327,38 @@ namespace VMAP
         return success;
     }
 
+    //=========================================================
+    // reads the model names referenced by a tile file without touching any tree, used for prefetching
+
+    bool StaticMapTree::GetTileModelNames(const std::string &vmapPath, uint32 mapID, uint32 tileX, uint32 tileY, std::vector<std::string> &names)
+    {
+        std::string basePath = vmapPath;
+        if (basePath.length() > 0 && basePath[basePath.length()-1] != '/' && basePath[basePath.length()-1] != '\\')
+            basePath.push_back('/');
+        std::string tilefile = basePath + getTileFileName(mapID, tileX, tileY);
+        FILE* tf = fopen(tilefile.c_str(), "rb");
+        if (!tf)
+            return false;
+
+        bool result = true;
+        char chunk[8];
+        if (!readChunk(tf, chunk, VMAP_MAGIC, 8))
+            result = false;
+        uint32 numSpawns = 0;
+        if (result && fread(&numSpawns, sizeof(uint32), 1, tf) != 1)
+            result = false;
+        for (uint32 i=0; i<numSpawns && result; ++i)
+        {
+            ModelSpawn spawn;
+            uint32 referencedVal;
+            result = ModelSpawn::readFromFile(tf, spawn) && fread(&referencedVal, sizeof(uint32), 1, tf) == 1;
+            if (result)
+                names.push_back(spawn.name);
+        }
+        fclose(tf);
+        return result;
+    }
+
     //=========================================================
 
     bool StaticMapTree::InitMap(const std::string &fname, VMapManager2* vm)
@@ -415,6 +503,7 @@ namespace VMAP
                 }
             }
             iLoadedTiles[packTileID(tileX, tileY)] = true;
+            iLosCache.InvalidateTile(tileX, tileY);
             fclose(tf);
         }
         else
@@ -475,6 +564,7 @@ namespace VMAP
                 }
                 fclose(tf);
             }
+            iLosCache.InvalidateTile(tileX, tileY);
         }
         iLoadedTiles.erase(tile);
     }
@@ -23,6 +23,7 @@
 #include "Define.h"
 #include "Dynamic/UnorderedMap.h"
 #include "BoundingIntervalHierarchy.h"
+#include "LineOfSightCache.h"
 
 namespace VMAP
 {
@@ -56,20 +57,26 @@ namespace VMAP
             // stores <tree_index, reference_count> to invalidate tree values, unload map, and to be able to report errors
             loadedSpawnMap iLoadedSpawns;
             std::string iBasePath;
+            // results of isInLineOfSight() queries, see VMapManager2::isInLineOfSight()
+            LineOfSightCache iLosCache;
 
         private:
             bool getIntersectionTime(const G3D::Ray& pRay, float &pMaxDist, bool pStopAtFirstHit) const;
+            uint32 getIntersectionTimes(const RayPacket& pPacket, float* pMaxDist, uint32 pLaneMask, bool pStopAtFirstHit) const;
             //bool containsLoadedMapTile(unsigned int pTileIdent) const { return(iLoadedMapTiles.containsKey(pTileIdent)); }
         public:
             static std::string getTileFileName(uint32 mapID, uint32 tileX, uint32 tileY);
             static uint32 packTileID(uint32 tileX, uint32 tileY) { return tileX<<16 | tileY; }
             static void unpackTileID(uint32 ID, uint32 &tileX, uint32 &tileY) { tileX = ID>>16; tileY = ID&0xFF; }
             static bool CanLoadMap(const std::string &basePath, uint32 mapID, uint32 tileX, uint32 tileY);
+            static bool GetTileModelNames(const std::string &basePath, uint32 mapID, uint32 tileX, uint32 tileY, std::vector<std::string> &names);
 
             StaticMapTree(uint32 mapID, const std::string &basePath);
             ~StaticMapTree();
 
             bool isInLineOfSight(const G3D::Vector3& pos1, const G3D::Vector3& pos2) const;
+            // line of sight from one origin to count targets, traversed in packets of RAY_PACKET_SIZE rays
+            void isInLineOfSight(const G3D::Vector3& origin, const G3D::Vector3* targets, uint32 count, bool* results) const;
             bool getObjectHitPos(const G3D::Vector3& pos1, const G3D::Vector3& pos2, G3D::Vector3& pResultHitPos, float pModifyDist) const;
             float getHeight(const G3D::Vector3& pPos, float maxSearchDist) const;
             bool getAreaInfo(G3D::Vector3 &pos, uint32 &flags, int32 &adtId, int32 &rootId, int32 &groupId) const;
@@ -81,6 +88,8 @@ namespace VMAP
             void UnloadMapTile(uint32 tileX, uint32 tileY, VMapManager2* vm);
             bool isTiled() const { return iIsTiled; }
             uint32 numLoadedTiles() const { return iLoadedTiles.size(); }
+            LineOfSightCache& getLineOfSightCache() { return iLosCache; }
+            LineOfSightCache const& getLineOfSightCache() const { return iLosCache; }
     };
 
     struct AreaInfo
@@ -66,6 +66,32 @@ namespace VMAP
         return hit;
     }
 
+    uint32 ModelInstance::intersectRayPacket(const RayPacket& pPacket, float* pMaxDist, uint32 pLaneMask, bool pStopAtFirstHit) const
+    {
+        if (!iModel)
+            return 0;
+
+        pLaneMask = pPacket.intersectBox(iBound, pMaxDist, pLaneMask);
+        if (!pLaneMask)
+            return 0;
+
+        // child bounds are defined in object space, the transformation is the same for all lanes
+        RayPacket modPacket;
+        float distance[RAY_PACKET_SIZE];
+        for (uint32 lane = 0; lane < RAY_PACKET_SIZE; ++lane)
+        {
+            if (lane < pPacket.count)
+                modPacket.add(iInvRot * (pPacket.origin(lane) - iPos) * iInvScale, iInvRot * pPacket.direction(lane));
+            distance[lane] = pMaxDist[lane] * iInvScale;
+        }
+
+        uint32 hits = iModel->IntersectRayPacket(modPacket, distance, pLaneMask, pStopAtFirstHit);
+        for (uint32 lane = 0; lane < RAY_PACKET_SIZE; ++lane)
+            if (hits & (1 << lane))
+                pMaxDist[lane] = distance[lane] * iScale;
+        return hits;
+    }
+
     void ModelInstance::intersectPoint(const G3D::Vector3& p, AreaInfo &info) const
     {
         if (!iModel)
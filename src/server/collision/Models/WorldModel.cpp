@@ -21,6 +21,8 @@
 #include "VMapDefinitions.h"
 #include "MapTree.h"
 
+#include <ace/Mem_Map.h>
+
 using G3D::Vector3;
 using G3D::Ray;
 
@@ -31,7 +33,7 @@ template<> struct BoundsTrait<VMAP::GroupModel>
 
 namespace VMAP
 {
-    bool IntersectTriangle(const MeshTriangle &tri, std::vector<Vector3>::const_iterator points, const G3D::Ray &ray, float &distance)
+    bool IntersectTriangle(const MeshTriangle &tri, const Vector3* points, const G3D::Ray &ray, float &distance)
     {
         static const float EPS = 1e-5f;
 
@@ -81,10 +83,68 @@ namespace VMAP
         return false;
     }
 
+    // IntersectTriangle() for all lanes of a packet at once, returns the lanes that hit closer than their distance
+    uint32 IntersectTrianglePacket(const MeshTriangle &tri, const Vector3* points, const RayPacket &packet, float* distance, uint32 laneMask)
+    {
+        static const float EPS = 1e-5f;
+
+        const Vector3 e1 = points[tri.idx1] - points[tri.idx0];
+        const Vector3 e2 = points[tri.idx2] - points[tri.idx0];
+        const Vector3& v0 = points[tri.idx0];
+
+        PacketFloat dirX = PacketFloat::load(packet.dirX), dirY = PacketFloat::load(packet.dirY), dirZ = PacketFloat::load(packet.dirZ);
+        PacketFloat e1X = PacketFloat::splat(e1.x), e1Y = PacketFloat::splat(e1.y), e1Z = PacketFloat::splat(e1.z);
+        PacketFloat e2X = PacketFloat::splat(e2.x), e2Y = PacketFloat::splat(e2.y), e2Z = PacketFloat::splat(e2.z);
+
+        // p = direction x e2
+        PacketFloat pX = dirY * e2Z - dirZ * e2Y;
+        PacketFloat pY = dirZ * e2X - dirX * e2Z;
+        PacketFloat pZ = dirX * e2Y - dirY * e2X;
+        PacketFloat a = e1X * pX + e1Y * pY + e1Z * pZ;
+
+        PacketFloat zero = PacketFloat::splat(0.0f);
+        PacketFloat one = PacketFloat::splat(1.0f);
+        // lanes with an ill-conditioned determinant are masked out, their garbage results do not matter
+        PacketFloat valid = PacketFloat::lessEqual(PacketFloat::splat(EPS), PacketFloat::abs(a));
+        PacketFloat f = PacketFloat::reciprocal(a);
+
+        // s = origin - v0
+        PacketFloat sX = PacketFloat::load(packet.orgX) - PacketFloat::splat(v0.x);
+        PacketFloat sY = PacketFloat::load(packet.orgY) - PacketFloat::splat(v0.y);
+        PacketFloat sZ = PacketFloat::load(packet.orgZ) - PacketFloat::splat(v0.z);
+        PacketFloat u = f * (sX * pX + sY * pY + sZ * pZ);
+        valid = PacketFloat::both(valid, PacketFloat::both(PacketFloat::lessEqual(zero, u), PacketFloat::lessEqual(u, one)));
+        if (!(valid.bits() & laneMask))
+            return 0;
+
+        // q = s x e1
+        PacketFloat qX = sY * e1Z - sZ * e1Y;
+        PacketFloat qY = sZ * e1X - sX * e1Z;
+        PacketFloat qZ = sX * e1Y - sY * e1X;
+        PacketFloat v = f * (dirX * qX + dirY * qY + dirZ * qZ);
+        valid = PacketFloat::both(valid, PacketFloat::both(PacketFloat::lessEqual(zero, v), PacketFloat::lessEqual(u + v, one)));
+
+        PacketFloat t = f * (e2X * qX + e2Y * qY + e2Z * qZ);
+        PacketFloat dist = PacketFloat::load(distance);
+        valid = PacketFloat::both(valid, PacketFloat::both(PacketFloat::less(zero, t), PacketFloat::less(t, dist)));
+
+        uint32 hits = valid.bits() & laneMask;
+        if (hits)
+        {
+            // only lanes of the mask may be updated, the others belong to rays that are done or not traversing this node
+            float times[RAY_PACKET_SIZE];
+            t.store(times);
+            for (uint32 lane = 0; lane < RAY_PACKET_SIZE; ++lane)
+                if (hits & (1 << lane))
+                    distance[lane] = times[lane];
+        }
+        return hits;
+    }
+
     class TriBoundFunc
     {
         public:
-            TriBoundFunc(std::vector<Vector3> &vert): vertices(vert.begin()) {}
+            TriBoundFunc(const Vector3* vert): vertices(vert) {}
             void operator()(const MeshTriangle &tri, G3D::AABox &out) const
             {
                 G3D::Vector3 lo = vertices[tri.idx0];
@@ -96,7 +156,7 @@ namespace VMAP
                 out = G3D::AABox(lo, hi);
             }
         protected:
-            const std::vector<Vector3>::const_iterator vertices;
+            const Vector3* const vertices;
     };
 
     // ===================== WmoLiquid ==================================
@@ -217,22 +277,32 @@ namespace VMAP
         return result;
     }
 
-    bool WmoLiquid::readFromFile(FILE* rf, WmoLiquid* &out)
+    bool WmoLiquid::readFromMemory(MappedFileReader &reader, WmoLiquid* &out)
     {
         bool result = true;
         WmoLiquid* liquid = new WmoLiquid();
-        if (result && fread(&liquid->iTilesX, sizeof(uint32), 1, rf) != 1) result = false;
-        if (result && fread(&liquid->iTilesY, sizeof(uint32), 1, rf) != 1) result = false;
-        if (result && fread(&liquid->iCorner, sizeof(Vector3), 1, rf) != 1) result = false;
-        if (result && fread(&liquid->iType, sizeof(uint32), 1, rf) != 1) result = false;
-        uint32 size = (liquid->iTilesX + 1)*(liquid->iTilesY + 1);
-        liquid->iHeight = new float[size];
-        if (result && fread(liquid->iHeight, sizeof(float), size, rf) != size) result = false;
-        size = liquid->iTilesX * liquid->iTilesY;
-        liquid->iFlags = new uint8[size];
-        if (result && fread(liquid->iFlags, sizeof(uint8), size, rf) != size) result = false;
+        if (result && !reader.read(&liquid->iTilesX, sizeof(uint32))) result = false;
+        if (result && !reader.read(&liquid->iTilesY, sizeof(uint32))) result = false;
+        if (result && !reader.read(&liquid->iCorner, sizeof(Vector3))) result = false;
+        if (result && !reader.read(&liquid->iType, sizeof(uint32))) result = false;
+        // liquids are small and sparse, they keep their own copy of heights and flags
+        if (result)
+        {
+            uint32 size = (liquid->iTilesX + 1)*(liquid->iTilesY + 1);
+            liquid->iHeight = new float[size];
+            if (!reader.read(liquid->iHeight, sizeof(float) * size)) result = false;
+        }
+        if (result)
+        {
+            uint32 size = liquid->iTilesX * liquid->iTilesY;
+            liquid->iFlags = new uint8[size];
+            if (!reader.read(liquid->iFlags, sizeof(uint8) * size)) result = false;
+        }
         if (!result)
+        {
             delete liquid;
+            liquid = NULL;
+        }
         out = liquid;
         return result;
     }
@@ -240,19 +310,41 @@ namespace VMAP
     // ===================== GroupModel ==================================
 
     GroupModel::GroupModel(const GroupModel &other):
-        iBound(other.iBound), iMogpFlags(other.iMogpFlags), iGroupWMOID(other.iGroupWMOID),
-        vertices(other.vertices), triangles(other.triangles), meshTree(other.meshTree), iLiquid(0)
+        vertices(0), triangles(0), vertexCount(0), triangleCount(0), iLiquid(0)
+    {
+        *this = other;
+    }
+
+    GroupModel& GroupModel::operator=(const GroupModel &other)
     {
-        if (other.iLiquid)
-            iLiquid = new WmoLiquid(*other.iLiquid);
+        if (this == &other)
+            return *this;
+        iBound = other.iBound;
+        iMogpFlags = other.iMogpFlags;
+        iGroupWMOID = other.iGroupWMOID;
+        vertexStorage = other.vertexStorage;
+        triangleStorage = other.triangleStorage;
+        // geometry of a mapped file is shared, copied storage has to be pointed to again
+        vertices = vertexStorage.empty() ? other.vertices : &vertexStorage[0];
+        triangles = triangleStorage.empty() ? other.triangles : &triangleStorage[0];
+        vertexCount = other.vertexCount;
+        triangleCount = other.triangleCount;
+        meshTree = other.meshTree;
+        delete iLiquid;
+        iLiquid = other.iLiquid ? new WmoLiquid(*other.iLiquid) : 0;
+        return *this;
     }
 
     void GroupModel::setMeshData(std::vector<Vector3> &vert, std::vector<MeshTriangle> &tri)
     {
-        vertices.swap(vert);
-        triangles.swap(tri);
+        vertexStorage.swap(vert);
+        triangleStorage.swap(tri);
+        vertexCount = vertexStorage.size();
+        triangleCount = triangleStorage.size();
+        vertices = vertexCount ? &vertexStorage[0] : 0;
+        triangles = triangleCount ? &triangleStorage[0] : 0;
         TriBoundFunc bFunc(vertices);
-        meshTree.build(triangles, bFunc);
+        meshTree.build(triangleStorage, bFunc);
     }
 
     bool GroupModel::writeToFile(FILE* wf)
@@ -266,21 +358,21 @@ namespace VMAP
 
         // write vertices
         if (result && fwrite("VERT", 1, 4, wf) != 4) result = false;
-        count = vertices.size();
+        count = vertexCount;
         chunkSize = sizeof(uint32)+ sizeof(Vector3)*count;
         if (result && fwrite(&chunkSize, sizeof(uint32), 1, wf) != 1) result = false;
         if (result && fwrite(&count, sizeof(uint32), 1, wf) != 1) result = false;
         if (!count) // models without (collision) geometry end here, unsure if they are useful
             return result;
-        if (result && fwrite(&vertices[0], sizeof(Vector3), count, wf) != count) result = false;
+        if (result && fwrite(vertices, sizeof(Vector3), count, wf) != count) result = false;
 
         // write triangle mesh
         if (result && fwrite("TRIM", 1, 4, wf) != 4) result = false;
-        count = triangles.size();
+        count = triangleCount;
         chunkSize = sizeof(uint32)+ sizeof(MeshTriangle)*count;
         if (result && fwrite(&chunkSize, sizeof(uint32), 1, wf) != 1) result = false;
         if (result && fwrite(&count, sizeof(uint32), 1, wf) != 1) result = false;
-        if (result && fwrite(&triangles[0], sizeof(MeshTriangle), count, wf) != count) result = false;
+        if (result && fwrite(triangles, sizeof(MeshTriangle), count, wf) != count) result = false;
 
         // write mesh BIH
         if (result && fwrite("MBIH", 1, 4, wf) != 4) result = false;
@@ -301,76 +393,99 @@ namespace VMAP
         return result;
     }
 
-    bool GroupModel::readFromFile(FILE* rf)
+    bool GroupModel::readFromMemory(MappedFileReader &reader)
     {
-        char chunk[8];
         bool result = true;
         uint32 chunkSize = 0;
         uint32 count = 0;
-        triangles.clear();
-        vertices.clear();
+        vertexStorage.clear();
+        triangleStorage.clear();
+        vertices = 0;
+        triangles = 0;
+        vertexCount = 0;
+        triangleCount = 0;
         delete iLiquid;
         iLiquid = NULL;
 
-        if (result && fread(&iBound, sizeof(G3D::AABox), 1, rf) != 1) result = false;
-        if (result && fread(&iMogpFlags, sizeof(uint32), 1, rf) != 1) result = false;
-        if (result && fread(&iGroupWMOID, sizeof(uint32), 1, rf) != 1) result = false;
+        if (result && !reader.read(&iBound, sizeof(G3D::AABox))) result = false;
+        if (result && !reader.read(&iMogpFlags, sizeof(uint32))) result = false;
+        if (result && !reader.read(&iGroupWMOID, sizeof(uint32))) result = false;
 
         // read vertices
-        if (result && !readChunk(rf, chunk, "VERT", 4)) result = false;
-        if (result && fread(&chunkSize, sizeof(uint32), 1, rf) != 1) result = false;
-        if (result && fread(&count, sizeof(uint32), 1, rf) != 1) result = false;
+        if (result && !reader.readChunk("VERT", 4)) result = false;
+        if (result && !reader.read(&chunkSize, sizeof(uint32))) result = false;
+        if (result && !reader.read(&count, sizeof(uint32))) result = false;
         if (!count) // models without (collision) geometry end here, unsure if they are useful
             return result;
-        if (result) vertices.resize(count);
-        if (result && fread(&vertices[0], sizeof(Vector3), count, rf) != count) result = false;
+        if (result && !reader.readArray(vertices, count, vertexStorage)) result = false;
+        if (result) vertexCount = count;
 
         // read triangle mesh
-        if (result && !readChunk(rf, chunk, "TRIM", 4)) result = false;
-        if (result && fread(&chunkSize, sizeof(uint32), 1, rf) != 1) result = false;
-        if (result && fread(&count, sizeof(uint32), 1, rf) != 1) result = false;
-        if (result) triangles.resize(count);
-        if (result && fread(&triangles[0], sizeof(MeshTriangle), count, rf) != count) result = false;
+        if (result && !reader.readChunk("TRIM", 4)) result = false;
+        if (result && !reader.read(&chunkSize, sizeof(uint32))) result = false;
+        if (result && !reader.read(&count, sizeof(uint32))) result = false;
+        if (result && !reader.readArray(triangles, count, triangleStorage)) result = false;
+        if (result) triangleCount = count;
 
         // read mesh BIH
-        if (result && !readChunk(rf, chunk, "MBIH", 4)) result = false;
-        if (result) result = meshTree.readFromFile(rf);
+        if (result && !reader.readChunk("MBIH", 4)) result = false;
+        if (result) result = meshTree.readFromMemory(reader);
 
-        // write liquid data
-        if (result && !readChunk(rf, chunk, "LIQU", 4)) result = false;
-        if (result && fread(&chunkSize, sizeof(uint32), 1, rf) != 1) result = false;
+        // read liquid data
+        if (result && !reader.readChunk("LIQU", 4)) result = false;
+        if (result && !reader.read(&chunkSize, sizeof(uint32))) result = false;
         if (result && chunkSize > 0)
-            result = WmoLiquid::readFromFile(rf, iLiquid);
+            result = WmoLiquid::readFromMemory(reader, iLiquid);
         return result;
     }
 
     struct GModelRayCallback
     {
-        GModelRayCallback(const std::vector<MeshTriangle> &tris, const std::vector<Vector3> &vert):
-            vertices(vert.begin()), triangles(tris.begin()), hit(false) {}
+        GModelRayCallback(const MeshTriangle* tris, const Vector3* vert):
+            vertices(vert), triangles(tris), hit(false) {}
         bool operator()(const G3D::Ray& ray, uint32 entry, float& distance, bool /*pStopAtFirstHit*/)
         {
             bool result = IntersectTriangle(triangles[entry], vertices, ray, distance);
             if (result)  hit=true;
             return hit;
         }
-        std::vector<Vector3>::const_iterator vertices;
-        std::vector<MeshTriangle>::const_iterator triangles;
+        const Vector3* vertices;
+        const MeshTriangle* triangles;
         bool hit;
     };
 
     bool GroupModel::IntersectRay(const G3D::Ray &ray, float &distance, bool stopAtFirstHit) const
     {
-        if (triangles.empty())
+        if (!triangleCount)
             return false;
         GModelRayCallback callback(triangles, vertices);
         meshTree.intersectRay(ray, callback, distance, stopAtFirstHit);
         return callback.hit;
     }
 
+    struct GModelRayPacketCallback
+    {
+        GModelRayPacketCallback(const MeshTriangle* tris, const Vector3* vert):
+            vertices(vert), triangles(tris) {}
+        uint32 operator()(const RayPacket& packet, uint32 entry, float* distance, uint32 laneMask, bool /*pStopAtFirstHit*/)
+        {
+            return IntersectTrianglePacket(triangles[entry], vertices, packet, distance, laneMask);
+        }
+        const Vector3* vertices;
+        const MeshTriangle* triangles;
+    };
+
+    uint32 GroupModel::IntersectRayPacket(const RayPacket &packet, float* distance, uint32 laneMask, bool stopAtFirstHit) const
+    {
+        if (!triangleCount)
+            return 0;
+        GModelRayPacketCallback callback(triangles, vertices);
+        return meshTree.intersectRayPacket(packet, callback, distance, laneMask, stopAtFirstHit);
+    }
+
     bool GroupModel::IsInsideObject(const Vector3 &pos, const Vector3 &down, float &z_dist) const
     {
-        if (triangles.empty() || !iBound.contains(pos))
+        if (!triangleCount || !iBound.contains(pos))
             return false;
         GModelRayCallback callback(triangles, vertices);
         Vector3 rPos = pos - 0.1f * down;
@@ -430,6 +545,25 @@ namespace VMAP
         return isc.hit;
     }
 
+    struct WModelRayPacketCallBack
+    {
+        WModelRayPacketCallBack(const std::vector<GroupModel> &mod): models(mod.begin()) {}
+        uint32 operator()(const RayPacket& packet, uint32 entry, float* distance, uint32 laneMask, bool pStopAtFirstHit)
+        {
+            return models[entry].IntersectRayPacket(packet, distance, laneMask, pStopAtFirstHit);
+        }
+        std::vector<GroupModel>::const_iterator models;
+    };
+
+    uint32 WorldModel::IntersectRayPacket(const RayPacket &packet, float* distance, uint32 laneMask, bool stopAtFirstHit) const
+    {
+        if (groupModels.size() == 1)
+            return groupModels[0].IntersectRayPacket(packet, distance, laneMask, stopAtFirstHit);
+
+        WModelRayPacketCallBack isc(groupModels);
+        return groupTree.intersectRayPacket(packet, isc, distance, laneMask, stopAtFirstHit);
+    }
+
     class WModelAreaCallback {
         public:
             WModelAreaCallback(const std::vector<GroupModel> &vals, const Vector3 &down):
@@ -533,39 +667,52 @@ namespace VMAP
         return result;
     }
 
+    WorldModel::~WorldModel()
+    {
+        // group models may still point into the mapping
+        groupModels.clear();
+        groupTree = BIH();
+        delete iMappedFile;
+    }
+
+    // Maps the model file read-only, aligned geometry and trees are then used in place and
+    // shared through the page cache instead of being copied into the heap for every model.
     bool WorldModel::readFile(const std::string &filename)
     {
-        FILE* rf = fopen(filename.c_str(), "rb");
-        if (!rf)
+        groupModels.clear();
+        delete iMappedFile;
+        iMappedFile = new ACE_Mem_Map();
+        if (iMappedFile->map(filename.c_str(), static_cast<size_t>(-1), O_RDONLY, ACE_DEFAULT_FILE_PERMS, PROT_READ, ACE_MAP_PRIVATE) == -1)
+        {
+            delete iMappedFile;
+            iMappedFile = NULL;
             return false;
+        }
 
+        MappedFileReader reader(iMappedFile->addr(), iMappedFile->size());
         bool result = true;
         uint32 chunkSize = 0;
         uint32 count = 0;
-        char chunk[8];                          // Ignore the added magic header
-        if (!readChunk(rf, chunk, VMAP_MAGIC, 8)) result = false;
+        // Ignore the added magic header
+        if (!reader.readChunk(VMAP_MAGIC, 8)) result = false;
 
-        if (result && !readChunk(rf, chunk, "WMOD", 4)) result = false;
-        if (result && fread(&chunkSize, sizeof(uint32), 1, rf) != 1) result = false;
-        if (result && fread(&RootWMOID, sizeof(uint32), 1, rf) != 1) result = false;
+        if (result && !reader.readChunk("WMOD", 4)) result = false;
+        if (result && !reader.read(&chunkSize, sizeof(uint32))) result = false;
+        if (result && !reader.read(&RootWMOID, sizeof(uint32))) result = false;
 
         // read group models
-        if (result && readChunk(rf, chunk, "GMOD", 4))
+        if (result && reader.readChunk("GMOD", 4))
         {
-            //if (fread(&chunkSize, sizeof(uint32), 1, rf) != 1) result = false;
-
-            if (result && fread(&count, sizeof(uint32), 1, rf) != 1) result = false;
+            if (result && !reader.read(&count, sizeof(uint32))) result = false;
             if (result) groupModels.resize(count);
-            //if (result && fread(&groupModels[0], sizeof(GroupModel), count, rf) != count) result = false;
             for (uint32 i=0; i<count && result; ++i)
-                result = groupModels[i].readFromFile(rf);
+                result = groupModels[i].readFromMemory(reader);
 
             // read group BIH
-            if (result && !readChunk(rf, chunk, "GBIH", 4)) result = false;
-            if (result) result = groupTree.readFromFile(rf);
+            if (result && !reader.readChunk("GBIH", 4)) result = false;
+            if (result) result = groupTree.readFromMemory(reader);
         }
 
-        fclose(rf);
         return result;
     }
 }
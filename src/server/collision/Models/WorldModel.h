@@ -28,8 +28,11 @@
 
 #include "Define.h"
 
+class ACE_Mem_Map;
+
 namespace VMAP
 {
+    class MappedFileReader;
     class TreeNode;
     struct AreaInfo;
     struct LocationInfo;
@@ -58,7 +61,7 @@ namespace VMAP
             uint8 *GetFlagsStorage() { return iFlags; }
             uint32 GetFileSize();
             bool writeToFile(FILE* wf);
-            static bool readFromFile(FILE* rf, WmoLiquid* &liquid);
+            static bool readFromMemory(MappedFileReader &reader, WmoLiquid* &liquid);
         private:
             WmoLiquid(): iHeight(0), iFlags(0) {};
             uint32 iTilesX;  //!< number of tiles in x direction, each
@@ -73,30 +76,44 @@ namespace VMAP
     class GroupModel
     {
         public:
-            GroupModel(): iLiquid(0) {}
+            GroupModel(): vertices(0), triangles(0), vertexCount(0), triangleCount(0), iLiquid(0) {}
             GroupModel(const GroupModel &other);
             GroupModel(uint32 mogpFlags, uint32 groupWMOID, const AABox &bound):
-                        iBound(bound), iMogpFlags(mogpFlags), iGroupWMOID(groupWMOID), iLiquid(0) {}
+                        iBound(bound), iMogpFlags(mogpFlags), iGroupWMOID(groupWMOID),
+                        vertices(0), triangles(0), vertexCount(0), triangleCount(0), iLiquid(0) {}
             ~GroupModel() { delete iLiquid; }
+            GroupModel& operator=(const GroupModel &other);
 
             //! pass mesh data to object and create BIH. Passed vectors get get swapped with old geometry!
             void setMeshData(std::vector<Vector3> &vert, std::vector<MeshTriangle> &tri);
             void setLiquidData(WmoLiquid* liquid) { iLiquid = liquid; }
             bool IntersectRay(const G3D::Ray &ray, float &distance, bool stopAtFirstHit) const;
+            //! packet version of IntersectRay(), returns the lanes of laneMask that hit
+            uint32 IntersectRayPacket(const RayPacket &packet, float* distance, uint32 laneMask, bool stopAtFirstHit) const;
             bool IsInsideObject(const Vector3 &pos, const Vector3 &down, float &z_dist) const;
             bool GetLiquidLevel(const Vector3 &pos, float &liqHeight) const;
             uint32 GetLiquidType() const;
             bool writeToFile(FILE* wf);
-            bool readFromFile(FILE* rf);
+            //! geometry is used in place where aligned, the mapping has to outlive the group model
+            bool readFromMemory(MappedFileReader &reader);
             const G3D::AABox& GetBound() const { return iBound; }
             uint32 GetMogpFlags() const { return iMogpFlags; }
             uint32 GetWmoID() const { return iGroupWMOID; }
+            const Vector3* GetVertices() const { return vertices; }
+            uint32 GetVertexCount() const { return vertexCount; }
+            const MeshTriangle* GetTriangles() const { return triangles; }
+            uint32 GetTriangleCount() const { return triangleCount; }
         protected:
             G3D::AABox iBound;
             uint32 iMogpFlags;// 0x8 outdor; 0x2000 indoor
             uint32 iGroupWMOID;
-            std::vector<Vector3> vertices;
-            std::vector<MeshTriangle> triangles;
+            // vertices and triangles either point into the storage vectors or into the mapped model file
+            const Vector3* vertices;
+            const MeshTriangle* triangles;
+            uint32 vertexCount;
+            uint32 triangleCount;
+            std::vector<Vector3> vertexStorage;
+            std::vector<MeshTriangle> triangleStorage;
             BIH meshTree;
             WmoLiquid* iLiquid;
     };
@@ -104,20 +121,27 @@ namespace VMAP
     class WorldModel
     {
         public:
-            WorldModel(): RootWMOID(0) {}
+            WorldModel(): RootWMOID(0), iMappedFile(0) {}
+            ~WorldModel();
 
             //! pass group models to WorldModel and create BIH. Passed vector is swapped with old geometry!
             void setGroupModels(std::vector<GroupModel> &models);
             void setRootWmoID(uint32 id) { RootWMOID = id; }
             bool IntersectRay(const G3D::Ray &ray, float &distance, bool stopAtFirstHit) const;
+            uint32 IntersectRayPacket(const RayPacket &packet, float* distance, uint32 laneMask, bool stopAtFirstHit) const;
             bool IntersectPoint(const G3D::Vector3 &p, const G3D::Vector3 &down, float &dist, AreaInfo &info) const;
             bool GetLocationInfo(const G3D::Vector3 &p, const G3D::Vector3 &down, float &dist, LocationInfo &info) const;
             bool writeFile(const std::string &filename);
             bool readFile(const std::string &filename);
+            const std::vector<GroupModel>& GetGroupModels() const { return groupModels; }
         protected:
             uint32 RootWMOID;
             std::vector<GroupModel> groupModels;
             BIH groupTree;
+            ACE_Mem_Map* iMappedFile;
+        private:
+            WorldModel(const WorldModel&);
+            WorldModel& operator=(const WorldModel&);
     };
 } // namespace VMAP
 
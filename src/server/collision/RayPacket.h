@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ * Copyright (C) 2008-2012 TrinityCore <http://www.trinitycore.org/>
+ * Copyright (C) 2005-2012 MaNGOS <http://getmangos.com/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _RAYPACKET_H
+#define _RAYPACKET_H
+
+#include "G3D/Vector3.h"
+#include "G3D/Ray.h"
+#include "G3D/AABox.h"
+
+#include "Define.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define VMAP_RAY_PACKET_SSE
+    #include <emmintrin.h>
+#endif
+
+// rays traversed together by BIH::intersectRayPacket, one SSE register per component
+#define RAY_PACKET_SIZE 4
+#define RAY_PACKET_FULL_MASK 0xF
+
+/**
+Four floats processed at once, backed by an SSE register when the compiler targets SSE2
+and by a plain array otherwise. Masks are floats with all bits of a lane set or cleared.
+*/
+struct PacketFloat
+{
+#ifdef VMAP_RAY_PACKET_SSE
+    __m128 v;
+
+    static PacketFloat load(const float* f) { PacketFloat r; r.v = _mm_loadu_ps(f); return r; }
+    static PacketFloat splat(float f) { PacketFloat r; r.v = _mm_set1_ps(f); return r; }
+    void store(float* f) const { _mm_storeu_ps(f, v); }
+
+    PacketFloat operator+(PacketFloat const& o) const { PacketFloat r; r.v = _mm_add_ps(v, o.v); return r; }
+    PacketFloat operator-(PacketFloat const& o) const { PacketFloat r; r.v = _mm_sub_ps(v, o.v); return r; }
+    PacketFloat operator*(PacketFloat const& o) const { PacketFloat r; r.v = _mm_mul_ps(v, o.v); return r; }
+
+    static PacketFloat min(PacketFloat const& a, PacketFloat const& b) { PacketFloat r; r.v = _mm_min_ps(a.v, b.v); return r; }
+    static PacketFloat max(PacketFloat const& a, PacketFloat const& b) { PacketFloat r; r.v = _mm_max_ps(a.v, b.v); return r; }
+    static PacketFloat reciprocal(PacketFloat const& a) { PacketFloat r; r.v = _mm_div_ps(_mm_set1_ps(1.0f), a.v); return r; }
+    static PacketFloat abs(PacketFloat const& a) { PacketFloat r; r.v = _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); return r; }
+
+    static PacketFloat lessEqual(PacketFloat const& a, PacketFloat const& b) { PacketFloat r; r.v = _mm_cmple_ps(a.v, b.v); return r; }
+    static PacketFloat less(PacketFloat const& a, PacketFloat const& b) { PacketFloat r; r.v = _mm_cmplt_ps(a.v, b.v); return r; }
+    static PacketFloat both(PacketFloat const& a, PacketFloat const& b) { PacketFloat r; r.v = _mm_and_ps(a.v, b.v); return r; }
+    // lanes of a where mask is set, lanes of b elsewhere
+    static PacketFloat select(PacketFloat const& mask, PacketFloat const& a, PacketFloat const& b)
+    {
+        PacketFloat r;
+        r.v = _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+        return r;
+    }
+    // lanes whose sign bit is set, -0.0f included
+    static PacketFloat signMask(PacketFloat const& a) { PacketFloat r; r.v = _mm_castsi128_ps(_mm_srai_epi32(_mm_castps_si128(a.v), 31)); return r; }
+    // one bit per lane
+    uint32 bits() const { return uint32(_mm_movemask_ps(v)); }
+#else
+    float v[RAY_PACKET_SIZE];
+
+    static PacketFloat load(const float* f) { PacketFloat r; for (int i = 0; i < RAY_PACKET_SIZE; ++i) r.v[i] = f[i]; return r; }
+    static PacketFloat splat(float f) { PacketFloat r; for (int i = 0; i < RAY_PACKET_SIZE; ++i) r.v[i] = f; return r; }
+    void store(float* f) const { for (int i = 0; i < RAY_PACKET_SIZE; ++i) f[i] = v[i]; }
+
+    PacketFloat operator+(PacketFloat const& o) const { PacketFloat r; for (int i = 0; i < RAY_PACKET_SIZE; ++i) r.v[i] = v[i] + o.v[i]; return r; }
+    PacketFloat operator-(PacketFloat const& o) const { PacketFloat r; for (int i = 0; i < RAY_PACKET_SIZE; ++i) r.v[i] = v[i] - o.v[i]; return r; }
+    PacketFloat operator*(PacketFloat const& o) const { PacketFloat r; for (int i = 0; i < RAY_PACKET_SIZE; ++i) r.v[i] = v[i] * o.v[i]; return r; }
+
+    // same NaN behaviour as minps/maxps: the second operand is returned
+    static PacketFloat min(PacketFloat const& a, PacketFloat const& b) { PacketFloat r; for (int i = 0; i < RAY_PACKET_SIZE; ++i) r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]; return r; }
+    static PacketFloat max(PacketFloat const& a, PacketFloat const& b) { PacketFloat r; for (int i = 0; i < RAY_PACKET_SIZE; ++i) r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return r; }
+    static PacketFloat reciprocal(PacketFloat const& a) { PacketFloat r; for (int i = 0; i < RAY_PACKET_SIZE; ++i) r.v[i] = 1.0f / a.v[i]; return r; }
+    static PacketFloat abs(PacketFloat const& a) { PacketFloat r; for (int i = 0; i < RAY_PACKET_SIZE; ++i) r.v[i] = a.v[i] < 0.0f ? -a.v[i] : a.v[i]; return r; }
+
+    static PacketFloat lessEqual(PacketFloat const& a, PacketFloat const& b) { PacketFloat r; for (int i = 0; i < RAY_PACKET_SIZE; ++i) r.v[i] = laneMask(a.v[i] <= b.v[i]); return r; }
+    static PacketFloat less(PacketFloat const& a, PacketFloat const& b) { PacketFloat r; for (int i = 0; i < RAY_PACKET_SIZE; ++i) r.v[i] = laneMask(a.v[i] < b.v[i]); return r; }
+    static PacketFloat both(PacketFloat const& a, PacketFloat const& b) { PacketFloat r; for (int i = 0; i < RAY_PACKET_SIZE; ++i) r.v[i] = laneMask(laneSet(a.v[i]) && laneSet(b.v[i])); return r; }
+    static PacketFloat select(PacketFloat const& mask, PacketFloat const& a, PacketFloat const& b)
+    {
+        PacketFloat r;
+        for (int i = 0; i < RAY_PACKET_SIZE; ++i)
+            r.v[i] = laneSet(mask.v[i]) ? a.v[i] : b.v[i];
+        return r;
+    }
+    static PacketFloat signMask(PacketFloat const& a) { PacketFloat r; for (int i = 0; i < RAY_PACKET_SIZE; ++i) r.v[i] = laneMask(laneSet(a.v[i])); return r; }
+    uint32 bits() const
+    {
+        uint32 mask = 0;
+        for (int i = 0; i < RAY_PACKET_SIZE; ++i)
+            if (laneSet(v[i]))
+                mask |= 1 << i;
+        return mask;
+    }
+
+  private:
+    static float laneMask(bool set)
+    {
+        union { uint32 i; float f; } lane;
+        lane.i = set ? 0xFFFFFFFF : 0;
+        return lane.f;
+    }
+    static bool laneSet(float f)
+    {
+        union { uint32 i; float f; } lane;
+        lane.f = f;
+        return (lane.i >> 31) != 0;
+    }
+#endif
+};
+
+/**
+Up to RAY_PACKET_SIZE rays stored as structure of arrays. Directions are normalized,
+lanes past count are filled with copies of the last ray and never reported as hits.
+*/
+struct RayPacket
+{
+    float orgX[RAY_PACKET_SIZE], orgY[RAY_PACKET_SIZE], orgZ[RAY_PACKET_SIZE];
+    float dirX[RAY_PACKET_SIZE], dirY[RAY_PACKET_SIZE], dirZ[RAY_PACKET_SIZE];
+    uint32 count;
+
+    RayPacket() : count(0) { }
+
+    void add(G3D::Vector3 const& origin, G3D::Vector3 const& direction)
+    {
+        for (uint32 i = count; i < RAY_PACKET_SIZE; ++i)
+        {
+            orgX[i] = origin.x; orgY[i] = origin.y; orgZ[i] = origin.z;
+            dirX[i] = direction.x; dirY[i] = direction.y; dirZ[i] = direction.z;
+        }
+        ++count;
+    }
+
+    uint32 laneMask() const { return (1 << count) - 1; }
+
+    G3D::Vector3 origin(uint32 lane) const { return G3D::Vector3(orgX[lane], orgY[lane], orgZ[lane]); }
+    G3D::Vector3 direction(uint32 lane) const { return G3D::Vector3(dirX[lane], dirY[lane], dirZ[lane]); }
+    G3D::Ray ray(uint32 lane) const { return G3D::Ray::fromOriginAndDirection(origin(lane), direction(lane)); }
+
+    // lanes of mask whose ray enters box before maxDist, same slab test as G3D::Ray::intersectionTime
+    uint32 intersectBox(G3D::AABox const& box, const float* maxDist, uint32 mask) const
+    {
+        PacketFloat tMin = PacketFloat::splat(0.0f);
+        PacketFloat tMax = PacketFloat::load(maxDist);
+        intersectSlab(PacketFloat::load(orgX), PacketFloat::load(dirX), box.low().x, box.high().x, tMin, tMax);
+        intersectSlab(PacketFloat::load(orgY), PacketFloat::load(dirY), box.low().y, box.high().y, tMin, tMax);
+        intersectSlab(PacketFloat::load(orgZ), PacketFloat::load(dirZ), box.low().z, box.high().z, tMin, tMax);
+        return mask & PacketFloat::lessEqual(tMin, tMax).bits();
+    }
+
+  private:
+    static void intersectSlab(PacketFloat const& org, PacketFloat const& dir, float lo, float hi, PacketFloat& tMin, PacketFloat& tMax)
+    {
+        PacketFloat invDir = PacketFloat::reciprocal(dir);
+        PacketFloat t1 = (PacketFloat::splat(lo) - org) * invDir;
+        PacketFloat t2 = (PacketFloat::splat(hi) - org) * invDir;
+        // an axis parallel ray gives +-inf for both planes unless it starts on one, the NaN
+        // of that case is dropped by min/max returning their second operand
+        tMin = PacketFloat::max(PacketFloat::min(t1, t2), tMin);
+        tMax = PacketFloat::min(PacketFloat::max(t1, t2), tMax);
+    }
+};
+
+#endif // _RAYPACKET_H
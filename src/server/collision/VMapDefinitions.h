@@ -20,6 +20,7 @@
 #ifndef _VMAPDEFINITIONS_H
 #define _VMAPDEFINITIONS_H
 #include <cstring>
+#include <vector>
 
 #define LIQUID_TILE_SIZE (533.333f / 128.f)
 
@@ -29,5 +30,57 @@ namespace VMAP
 
     // defined in TileAssembler.cpp currently...
     bool readChunk(FILE* rf, char *dest, const char *compare, uint32 len);
+
+    //! bounds checked cursor over a memory mapped vmap file
+    class MappedFileReader
+    {
+        public:
+            MappedFileReader(const void* data, size_t size):
+                iPos(static_cast<const char*>(data)), iEnd(static_cast<const char*>(data) + size) {}
+
+            bool read(void* dest, size_t size)
+            {
+                if (size_t(iEnd - iPos) < size)
+                    return false;
+                memcpy(dest, iPos, size);
+                iPos += size;
+                return true;
+            }
+
+            bool readChunk(const char* compare, uint32 len)
+            {
+                if (size_t(iEnd - iPos) < len || strncmp(iPos, compare, len))
+                    return false;
+                iPos += len;
+                return true;
+            }
+
+            /*! Points array at count elements inside the file. Liquid flags are stored byte wise and can leave the
+                arrays following them unaligned, those are copied into storage instead of being used in place. */
+            template<class T>
+            bool readArray(const T* &array, uint32 count, std::vector<T> &storage)
+            {
+                size_t size = size_t(count) * sizeof(T);
+                if (size_t(iEnd - iPos) < size)
+                    return false;
+                storage.clear();
+                if (!count)
+                    array = 0;
+                else if (reinterpret_cast<size_t>(iPos) % sizeof(uint32))
+                {
+                    storage.resize(count);
+                    memcpy(&storage[0], iPos, size);
+                    array = &storage[0];
+                }
+                else
+                    array = reinterpret_cast<const T*>(iPos);
+                iPos += size;
+                return true;
+            }
+
+        private:
+            const char* iPos;
+            const char* iEnd;
+    };
 }
 #endif
@@ -145,7 +145,7 @@ lootForPickPocketed(false), lootForBody(false), _groupLootTimer(0), lootingGroup
 _PlayerDamageReq(0), _lootRecipient(0), _lootRecipientGroup(0), _corpseRemoveTime(0), _respawnTime(0),
 _respawnDelay(300), _corpseDelay(60), _respawnradius(0.0f), _reactState(REACT_AGGRESSIVE),
 _defaultMovementType(IDLE_MOTION_TYPE), _DBTableGuid(0), _equipmentId(0), _AlreadyCallAssistance(false),
-_AlreadySearchedAssistance(false), _regenHealth(true), _AI_locked(false), _meleeDamageSchoolMask(SPELL_SCHOOL_MASK_NORMAL),
+_AlreadySearchedAssistance(false), _regenHealth(true), _AI_locked(false), _AI_initializedBeforeAdd(false), _meleeDamageSchoolMask(SPELL_SCHOOL_MASK_NORMAL),
 _creatureInfo(NULL), _creatureData(NULL), _formation(NULL), _path_id(0)
 {
     _regenTimer = CREATURE_REGEN_INTERVAL;
@@ -187,7 +187,10 @@ void Creature::AddToWorld()
         sObjectAccessor->AddObject(this);
         Unit::AddToWorld();
         SearchFormation();
-        AIM_Initialize();
+        if (_AI_initializedBeforeAdd)
+            _AI_initializedBeforeAdd = false;
+        else
+            AIM_Initialize();
         if (IsVehicle())
             GetVehicleKit()->Install();
     }
@@ -1578,7 +1581,7 @@ void Creature::Respawn(bool force)
 
         uint32 poolid = GetDBTableGUIDLow() ? sPoolMgr->IsPartOfAPool<Creature>(GetDBTableGUIDLow()) : 0;
         if (poolid)
-            sPoolMgr->UpdatePool<Creature>(poolid, GetDBTableGUIDLow());
+            GetMap()->UpdatePool(this, poolid);
 
         //Re-initialize reactstate that could be altered by movementgenerators
         InitializeReactState();
@@ -517,6 +517,8 @@ class Creature : public Unit, public GridObject<Creature>, public MapCreature
         bool IsInEvadeMode() const { return HasUnitState(UNIT_STATE_EVADE); }
 
         bool AIM_Initialize(CreatureAI* ai = NULL);
+        // for a creature whose Map::AddToMap is postponed by a grid region update, AddToWorld keeps this AI
+        void AIM_InitializeBeforeAdd() { _AI_initializedBeforeAdd = AIM_Initialize(); }
         void Motion_Initialize();
 
         void AI_SendMoveToPacket(float x, float y, float z, uint32 time, uint32 MovementFlags, uint8 type);
@@ -746,6 +748,7 @@ class Creature : public Unit, public GridObject<Creature>, public MapCreature
         bool _AlreadySearchedAssistance;
         bool _regenHealth;
         bool _AI_locked;
+        bool _AI_initializedBeforeAdd;
 
         SpellSchoolMask _meleeDamageSchoolMask;
         uint32 _originalEntry;
@@ -370,7 +370,7 @@ void GameObject::Update(uint32 diff)
                                                             // respawn timer
                             uint32 poolid = GetDBTableGUIDLow() ? sPoolMgr->IsPartOfAPool<GameObject>(GetDBTableGUIDLow()) : 0;
                             if (poolid)
-                                sPoolMgr->UpdatePool<GameObject>(poolid, GetDBTableGUIDLow());
+                                GetMap()->UpdatePool(this, poolid);
                             else
                                 GetMap()->AddToMap(this);
                             break;
@@ -608,7 +608,7 @@ void GameObject::Delete()
 
     uint32 poolid = GetDBTableGUIDLow() ? sPoolMgr->IsPartOfAPool<GameObject>(GetDBTableGUIDLow()) : 0;
     if (poolid)
-        sPoolMgr->UpdatePool<GameObject>(poolid, GetDBTableGUIDLow());
+        GetMap()->UpdatePool(this, poolid);
     else
         AddObjectToRemoveList();
 }
@@ -1699,7 +1699,7 @@ bool GameObject::IsInRange(float x, float y, float z, float radius) const
 void GameObject::EventInform(uint32 eventId)
 {
     if (eventId && _zoneScript)
-        _zoneScript->ProcessEvent(this, eventId);
+        GetMap()->ProcessZoneScriptEvent(_zoneScript, this, eventId);
 }
 
 // overwrite WorldObject function for proper name localization
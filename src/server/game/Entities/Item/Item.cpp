@@ -1115,6 +1115,12 @@ void Item::BuildUpdate(UpdateDataMapType& data_map)
     ClearUpdateMask(false);
 }
 
+Map* Item::FindUpdateMap() const
+{
+    Player* owner = GetOwner();
+    return owner ? owner->FindMap() : NULL;
+}
+
 void Item::SaveRefundDataToDB()
 {
     SQLTransaction trans = CharacterDatabase.BeginTransaction();
@@ -361,6 +361,9 @@ class Item : public Object
         void BuildUpdate(UpdateDataMapType&);
 
         uint32 GetScriptId() const { return GetTemplate()->ScriptId; }
+    protected:
+        // the changes are sent to the owner by the map of the owner
+        Map* FindUpdateMap() const;
     private:
         std::string m_text;
         uint8 m_slot;
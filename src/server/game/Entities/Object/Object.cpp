@@ -74,11 +74,11 @@ Object::Object() : m_PackGUID(sizeof(uint64)+1)
     _objectType        = TYPEMASK_OBJECT;
 
     _uint32Values      = NULL;
-    _changedFields      = NULL;
     _valuesCount       = 0;
 
     m_inWorld           = false;
     m_objectUpdated     = false;
+    m_updateMap         = NULL;
 
     m_PackGUID.appendPackGUID(0);
 }
@@ -95,6 +95,8 @@ WorldObject::~WorldObject()
         }
         ResetMap();
     }
+
+    RemoveFromCellIndex();
 }
 
 Object::~Object()
@@ -112,11 +114,10 @@ Object::~Object()
     {
         sLog->outCrash("Object::~Object - guid="UI64FMTD", typeid=%d, entry=%u deleted but still in update list!!", GetGUID(), GetTypeId(), GetEntry());
         ASSERT(false);
-        sObjectAccessor->RemoveUpdateObject(this);
+        RemoveFromObjectUpdate();
     }
 
     delete [] _uint32Values;
-    delete [] _changedFields;
 }
 
 void Object::_InitValues()
@@ -124,8 +125,7 @@ void Object::_InitValues()
     _uint32Values = new uint32[_valuesCount];
     memset(_uint32Values, 0, _valuesCount*sizeof(uint32));
 
-    _changedFields = new bool[_valuesCount];
-    memset(_changedFields, 0, _valuesCount*sizeof(bool));
+    _changedFields.SetCount(_valuesCount);
 
     m_objectUpdated = false;
 }
@@ -277,6 +277,44 @@ void Object::BuildValuesUpdateBlockForPlayer(UpdateData* data, Player* target) c
     data->AddUpdateBlock(buf);
 }
 
+void Object::BuildValuesUpdateBlockForPlayer(UpdateData* data, Player* target, ValuesUpdateCache& cache) const
+{
+    ValuesUpdateCache::Block& block = cache.blocks[target == this ? UPDATE_OBSERVER_SELF : UPDATE_OBSERVER_OTHER];
+    if (!block.built)
+    {
+        block.built = true;
+        block.data.reserve(500);
+        block.data << (uint8) UPDATETYPE_VALUES;
+        block.data.append(GetPackGUID());
+
+        UpdateMask updateMask;
+        updateMask.SetCount(_valuesCount);
+
+        // the mask of a class is the same for all of its players
+        _SetUpdateBits(&updateMask, target);
+        size_t pos = block.data.wpos() + 1 + updateMask.GetLength();
+        _BuildValuesUpdate(UPDATETYPE_VALUES, &block.data, &updateMask, target);
+
+        for (uint32 index = updateMask.GetNextBit(0); index < _valuesCount; index = updateMask.GetNextBit(index + 1))
+        {
+            if (_IsTargetDependentField(index))
+                block.targetFields.push_back(std::make_pair(index, pos));
+            pos += sizeof(uint32);
+        }
+    }
+    else if (!block.targetFields.empty())
+    {
+        bool activateToQuest = _IsActivateToQuestFor(UPDATETYPE_VALUES, target);
+        for (std::vector<std::pair<uint16, size_t> >::const_iterator itr = block.targetFields.begin(); itr != block.targetFields.end(); ++itr)
+        {
+            uint32 value = isType(TYPEMASK_UNIT) ? _GetUnitFieldValueFor(itr->first, target) : _GetGameObjectFieldValueFor(itr->first, target, activateToQuest);
+            block.data.put<uint32>(itr->second, value);
+        }
+    }
+
+    data->AddUpdateBlock(block.data);
+}
+
 void Object::BuildOutOfRangeUpdateBlock(UpdateData* data) const
 {
     data->AddOutOfRangeGUID(GetGUID());
@@ -403,19 +441,33 @@ void Object::_BuildMovementUpdate(ByteBuffer * data, uint16 flags) const
    }
 }
 
+bool Object::_IsActivateToQuestFor(uint8 updatetype, Player* target) const
+{
+    if (!isType(TYPEMASK_GAMEOBJECT))
+        return false;
+
+    GameObject const* go = (GameObject const*)this;
+    if (updatetype == UPDATETYPE_CREATE_OBJECT || updatetype == UPDATETYPE_CREATE_OBJECT2)
+    {
+        if (go->IsDynTransport())
+            return false;
+    }
+    else if (go->IsTransport())
+        return false;
+
+    return go->ActivateToQuest(target) || target->isGameMaster();
+}
+
 void Object::_BuildValuesUpdate(uint8 updatetype, ByteBuffer * data, UpdateMask* updateMask, Player* target) const
 {
     if (!target)
         return;
 
-    bool IsActivateToQuest = false;
+    bool IsActivateToQuest = _IsActivateToQuestFor(updatetype, target);
     if (updatetype == UPDATETYPE_CREATE_OBJECT || updatetype == UPDATETYPE_CREATE_OBJECT2)
     {
         if (isType(TYPEMASK_GAMEOBJECT) && !((GameObject*)this)->IsDynTransport())
         {
-            if (((GameObject*)this)->ActivateToQuest(target) || target->isGameMaster())
-                IsActivateToQuest = true;
-
             updateMask->SetBit(GAMEOBJECT_DYNAMIC);
 
             if (((GameObject*)this)->GetGoArtKit())
@@ -433,10 +485,6 @@ void Object::_BuildValuesUpdate(uint8 updatetype, ByteBuffer * data, UpdateMask*
     {
         if (isType(TYPEMASK_GAMEOBJECT) && !((GameObject*)this)->IsTransport())
         {
-            if (((GameObject*)this)->ActivateToQuest(target) || target->isGameMaster())
-            {
-                IsActivateToQuest = true;
-            }
             updateMask->SetBit(GAMEOBJECT_DYNAMIC);
             updateMask->SetBit(GAMEOBJECT_BYTES_1);
         }
@@ -454,244 +502,254 @@ void Object::_BuildValuesUpdate(uint8 updatetype, ByteBuffer * data, UpdateMask*
     *data << (uint8)updateMask->GetBlockCount();
     data->append(updateMask->GetMask(), updateMask->GetLength());
 
-    // 2 specialized loops for speed optimization in non-unit case
+    // 2 specialized loops for speed optimization in non-unit case, all of them visit the set bits only
     if (isType(TYPEMASK_UNIT))                               // unit (creature/player) case
     {
-        for (uint16 index = 0; index < _valuesCount; ++index)
+        for (uint32 index = updateMask->GetNextBit(0); index < _valuesCount; index = updateMask->GetNextBit(index + 1))
+            *data << _GetUnitFieldValueFor(index, target);
+    }
+    else if (isType(TYPEMASK_GAMEOBJECT))                    // gameobject case
+    {
+        for (uint32 index = updateMask->GetNextBit(0); index < _valuesCount; index = updateMask->GetNextBit(index + 1))
+            *data << _GetGameObjectFieldValueFor(index, target, IsActivateToQuest);
+    }
+    else                                                    // other objects case (no special index checks)
+    {
+        // send in current format (float as float, uint32 as uint32)
+        for (uint32 index = updateMask->GetNextBit(0); index < _valuesCount; index = updateMask->GetNextBit(index + 1))
+            *data << _uint32Values[index];
+    }
+}
+
+uint32 Object::_GetUnitFieldValueFor(uint16 index, Player* target) const
+{
+    if (index == UNIT_NPC_FLAGS)
+    {
+        // remove custom flag before sending
+        uint32 appendValue = _uint32Values[index];
+
+        if (GetTypeId() == TYPEID_UNIT)
         {
-            if (updateMask->GetBit(index))
+            if (!target->canSeeSpellClickOn(this->ToCreature()))
+                appendValue &= ~UNIT_NPC_FLAG_SPELLCLICK;
+
+            if (appendValue & UNIT_NPC_FLAG_TRAINER)
             {
-                if (index == UNIT_NPC_FLAGS)
-                {
-                    // remove custom flag before sending
-                    uint32 appendValue = _uint32Values[index];
+                if (!this->ToCreature()->isCanTrainingOf(target, false))
+                    appendValue &= ~(UNIT_NPC_FLAG_TRAINER | UNIT_NPC_FLAG_TRAINER_CLASS | UNIT_NPC_FLAG_TRAINER_PROFESSION);
+            }
+        }
 
-                    if (GetTypeId() == TYPEID_UNIT)
-                    {
-                        if (!target->canSeeSpellClickOn(this->ToCreature()))
-                            appendValue &= ~UNIT_NPC_FLAG_SPELLCLICK;
+        return appendValue;
+    }
+    else if (index == UNIT_FIELD_AURASTATE)
+    {
+        // Check per caster aura states to not enable using a pell in client if specified aura is not by target
+        return ((Unit*)this)->BuildAuraStateUpdateForTarget(target);
+    }
+    // FIXME: Some values at server stored in float format but must be sent to client in uint32 format
+    else if (index >= UNIT_FIELD_BASEATTACKTIME && index <= UNIT_FIELD_RANGEDATTACKTIME)
+    {
+        // convert from float to uint32 and send
+        return uint32(m_floatValues[index] < 0 ? 0 : m_floatValues[index]);
+    }
+    // there are some float values which may be negative or can't get negative due to other checks
+    else if ((index >= UNIT_FIELD_NEGSTAT0   && index <= UNIT_FIELD_NEGSTAT4) ||
+        (index >= UNIT_FIELD_RESISTANCEBUFFMODSPOSITIVE  && index <= (UNIT_FIELD_RESISTANCEBUFFMODSPOSITIVE + 6)) ||
+        (index >= UNIT_FIELD_RESISTANCEBUFFMODSNEGATIVE  && index <= (UNIT_FIELD_RESISTANCEBUFFMODSNEGATIVE + 6)) ||
+        (index >= UNIT_FIELD_POSSTAT0   && index <= UNIT_FIELD_POSSTAT4))
+    {
+        return uint32(m_floatValues[index]);
+    }
+    // Gamemasters should be always able to select units - remove not selectable flag
+    else if (index == UNIT_FIELD_FLAGS)
+    {
+        if (target->isGameMaster())
+            return _uint32Values[index] & ~UNIT_FLAG_NOT_SELECTABLE;
+        else
+            return _uint32Values[index];
+    }
+    // use modelid_a if not gm, _h if gm for CREATURE_FLAG_EXTRA_TRIGGER creatures
+    else if (index == UNIT_FIELD_DISPLAYID)
+    {
+        if (GetTypeId() == TYPEID_UNIT)
+        {
+            CreatureTemplate const* cinfo = ToCreature()->GetCreatureTemplate();
 
-                        if (appendValue & UNIT_NPC_FLAG_TRAINER)
+            // this also applies for transform auras
+            if (SpellInfo const* transform = sSpellMgr->GetSpellInfo(ToUnit()->getTransForm()))
+                for (uint8 i = 0; i < MAX_SPELL_EFFECTS; ++i)
+                    if (transform->Effects[i].IsAura(SPELL_AURA_TRANSFORM))
+                        if (CreatureTemplate const* transformInfo = sObjectMgr->GetCreatureTemplate(transform->Effects[i].MiscValue))
                         {
-                            if (!this->ToCreature()->isCanTrainingOf(target, false))
-                                appendValue &= ~(UNIT_NPC_FLAG_TRAINER | UNIT_NPC_FLAG_TRAINER_CLASS | UNIT_NPC_FLAG_TRAINER_PROFESSION);
+                            cinfo = transformInfo;
+                            break;
                         }
-                    }
 
-                    *data << uint32(appendValue);
-                }
-                else if (index == UNIT_FIELD_AURASTATE)
-                {
-                    // Check per caster aura states to not enable using a pell in client if specified aura is not by target
-                    *data << ((Unit*)this)->BuildAuraStateUpdateForTarget(target);
-                }
-                // FIXME: Some values at server stored in float format but must be sent to client in uint32 format
-                else if (index >= UNIT_FIELD_BASEATTACKTIME && index <= UNIT_FIELD_RANGEDATTACKTIME)
-                {
-                    // convert from float to uint32 and send
-                    *data << uint32(m_floatValues[index] < 0 ? 0 : m_floatValues[index]);
-                }
-                // there are some float values which may be negative or can't get negative due to other checks
-                else if ((index >= UNIT_FIELD_NEGSTAT0   && index <= UNIT_FIELD_NEGSTAT4) ||
-                    (index >= UNIT_FIELD_RESISTANCEBUFFMODSPOSITIVE  && index <= (UNIT_FIELD_RESISTANCEBUFFMODSPOSITIVE + 6)) ||
-                    (index >= UNIT_FIELD_RESISTANCEBUFFMODSNEGATIVE  && index <= (UNIT_FIELD_RESISTANCEBUFFMODSNEGATIVE + 6)) ||
-                    (index >= UNIT_FIELD_POSSTAT0   && index <= UNIT_FIELD_POSSTAT4))
-                {
-                    *data << uint32(m_floatValues[index]);
-                }
-                // Gamemasters should be always able to select units - remove not selectable flag
-                else if (index == UNIT_FIELD_FLAGS)
+            if (cinfo->flags_extra & CREATURE_FLAG_EXTRA_TRIGGER)
+            {
+                if (target->isGameMaster())
                 {
-                    if (target->isGameMaster())
-                        *data << (_uint32Values[index] & ~UNIT_FLAG_NOT_SELECTABLE);
+                    if (cinfo->Modelid1)
+                        return cinfo->Modelid1;//Modelid1 is a visible model for gms
                     else
-                        *data << _uint32Values[index];
+                        return 17519; // world invisible trigger's model
                 }
-                // use modelid_a if not gm, _h if gm for CREATURE_FLAG_EXTRA_TRIGGER creatures
-                else if (index == UNIT_FIELD_DISPLAYID)
+                else
                 {
-                    if (GetTypeId() == TYPEID_UNIT)
-                    {
-                        CreatureTemplate const* cinfo = ToCreature()->GetCreatureTemplate();
-
-                        // this also applies for transform auras
-                        if (SpellInfo const* transform = sSpellMgr->GetSpellInfo(ToUnit()->getTransForm()))
-                            for (uint8 i = 0; i < MAX_SPELL_EFFECTS; ++i)
-                                if (transform->Effects[i].IsAura(SPELL_AURA_TRANSFORM))
-                                    if (CreatureTemplate const* transformInfo = sObjectMgr->GetCreatureTemplate(transform->Effects[i].MiscValue))
-                                    {
-                                        cinfo = transformInfo;
-                                        break;
-                                    }
-
-                        if (cinfo->flags_extra & CREATURE_FLAG_EXTRA_TRIGGER)
-                        {
-                            if (target->isGameMaster())
-                            {
-                                if (cinfo->Modelid1)
-                                    *data << cinfo->Modelid1;//Modelid1 is a visible model for gms
-                                else
-                                    *data << 17519; // world invisible trigger's model
-                            }
-                            else
-                            {
-                                if (cinfo->Modelid2)
-                                    *data << cinfo->Modelid2;//Modelid2 is an invisible model for players
-                                else
-                                    *data << 11686; // world invisible trigger's model
-                            }
-                        }
-                        else
-                            *data << _uint32Values[index];
-                    }
+                    if (cinfo->Modelid2)
+                        return cinfo->Modelid2;//Modelid2 is an invisible model for players
                     else
-                        *data << _uint32Values[index];
+                        return 11686; // world invisible trigger's model
                 }
-                // hide lootable animation for unallowed players
-                else if (index == UNIT_DYNAMIC_FLAGS)
-                {
-                    uint32 dynamicFlags = _uint32Values[index];
-
-                    if (const Creature* creature = ToCreature())
-                    {
-                        if (creature->hasLootRecipient())
-                        {
-                            if (creature->isTappedBy(target))
-                            {
-                                dynamicFlags |= (UNIT_DYNFLAG_TAPPED | UNIT_DYNFLAG_TAPPED_BY_PLAYER);
-                            }
-                            else
-                            {
-                                dynamicFlags |= UNIT_DYNFLAG_TAPPED;
-                                dynamicFlags &= ~UNIT_DYNFLAG_TAPPED_BY_PLAYER;
-                            }
-                        }
-                        else
-                        {
-                            dynamicFlags &= ~UNIT_DYNFLAG_TAPPED;
-                            dynamicFlags &= ~UNIT_DYNFLAG_TAPPED_BY_PLAYER;
-                        }
+            }
+        }
 
-                        if (!target->isAllowedToLoot(creature))
-                            dynamicFlags &= ~UNIT_DYNFLAG_LOOTABLE;
-                    }
+        return _uint32Values[index];
+    }
+    // hide lootable animation for unallowed players
+    else if (index == UNIT_DYNAMIC_FLAGS)
+    {
+        uint32 dynamicFlags = _uint32Values[index];
 
-                    *data << dynamicFlags;
-                }
-                // FG: pretend that OTHER players in own group are friendly ("blue")
-                else if (index == UNIT_FIELD_BYTES_2 || index == UNIT_FIELD_FACTIONTEMPLATE)
+        if (const Creature* creature = ToCreature())
+        {
+            if (creature->hasLootRecipient())
+            {
+                if (creature->isTappedBy(target))
                 {
-                    Unit const* unit = ToUnit();
-                    if (unit->IsControlledByPlayer() && target != this && sWorld->getBoolConfig(CONFIG_ALLOW_TWO_SIDE_INTERACTION_GROUP) && unit->IsInRaidWith(target))
-                    {
-                        FactionTemplateEntry const* ft1 = unit->getFactionTemplateEntry();
-                        FactionTemplateEntry const* ft2 = target->getFactionTemplateEntry();
-                        if (ft1 && ft2 && !ft1->IsFriendlyTo(*ft2))
-                        {
-                            if (index == UNIT_FIELD_BYTES_2)
-                            {
-                                // Allow targetting opposite faction in party when enabled in config
-                                *data << (_uint32Values[index] & ((UNIT_BYTE2_FLAG_SANCTUARY /*| UNIT_BYTE2_FLAG_AURAS | UNIT_BYTE2_FLAG_UNK5*/) << 8)); // this flag is at uint8 offset 1 !!
-                            }
-                            else
-                            {
-                                // pretend that all other HOSTILE players have own faction, to allow follow, heal, rezz (trade wont work)
-                                uint32 faction = target->getFaction();
-                                *data << uint32(faction);
-                            }
-                        }
-                        else
-                            *data << _uint32Values[index];
-                    }
-                    else
-                        *data << _uint32Values[index];
+                    dynamicFlags |= (UNIT_DYNFLAG_TAPPED | UNIT_DYNFLAG_TAPPED_BY_PLAYER);
                 }
                 else
                 {
-                    // send in current format (float as float, uint32 as uint32)
-                    *data << _uint32Values[index];
+                    dynamicFlags |= UNIT_DYNFLAG_TAPPED;
+                    dynamicFlags &= ~UNIT_DYNFLAG_TAPPED_BY_PLAYER;
                 }
             }
+            else
+            {
+                dynamicFlags &= ~UNIT_DYNFLAG_TAPPED;
+                dynamicFlags &= ~UNIT_DYNFLAG_TAPPED_BY_PLAYER;
+            }
+
+            if (!target->isAllowedToLoot(creature))
+                dynamicFlags &= ~UNIT_DYNFLAG_LOOTABLE;
         }
+
+        return dynamicFlags;
     }
-    else if (isType(TYPEMASK_GAMEOBJECT))                    // gameobject case
+    // FG: pretend that OTHER players in own group are friendly ("blue")
+    else if (index == UNIT_FIELD_BYTES_2 || index == UNIT_FIELD_FACTIONTEMPLATE)
     {
-        for (uint16 index = 0; index < _valuesCount; ++index)
+        Unit const* unit = ToUnit();
+        if (unit->IsControlledByPlayer() && target != this && sWorld->getBoolConfig(CONFIG_ALLOW_TWO_SIDE_INTERACTION_GROUP) && unit->IsInRaidWith(target))
         {
-            if (updateMask->GetBit(index))
+            FactionTemplateEntry const* ft1 = unit->getFactionTemplateEntry();
+            FactionTemplateEntry const* ft2 = target->getFactionTemplateEntry();
+            if (ft1 && ft2 && !ft1->IsFriendlyTo(*ft2))
             {
-                // send in current format (float as float, uint32 as uint32)
-                if (index == GAMEOBJECT_DYNAMIC)
+                if (index == UNIT_FIELD_BYTES_2)
                 {
-                    if (IsActivateToQuest)
-                    {
-                        switch (ToGameObject()->GetGoType())
-                        {
-                            case GAMEOBJECT_TYPE_CHEST:
-                                if (target->isGameMaster())
-                                    *data << uint16(GO_DYNFLAG_LO_ACTIVATE);
-                                else
-                                    *data << uint16(GO_DYNFLAG_LO_ACTIVATE | GO_DYNFLAG_LO_SPARKLE);
-                                *data << uint16(-1);
-                                break;
-                            case GAMEOBJECT_TYPE_GENERIC:
-                                if (target->isGameMaster())
-                                    *data << uint16(0);
-                                else
-                                    *data << uint16(GO_DYNFLAG_LO_SPARKLE);
-                                *data << uint16(-1);
-                                break;
-                            case GAMEOBJECT_TYPE_GOOBER:
-                                if (target->isGameMaster())
-                                    *data << uint16(GO_DYNFLAG_LO_ACTIVATE);
-                                else
-                                    *data << uint16(GO_DYNFLAG_LO_ACTIVATE | GO_DYNFLAG_LO_SPARKLE);
-                                *data << uint16(-1);
-                                break;
-                            default:
-                                // unknown, not happen.
-                                *data << uint16(0);
-                                *data << uint16(-1);
-                                break;
-                        }
-                    }
-                    else
-                    {
-                        // disable quest object
-                        *data << uint16(0);
-                        *data << uint16(-1);
-                    }
+                    // Allow targetting opposite faction in party when enabled in config
+                    return _uint32Values[index] & ((UNIT_BYTE2_FLAG_SANCTUARY /*| UNIT_BYTE2_FLAG_AURAS | UNIT_BYTE2_FLAG_UNK5*/) << 8); // this flag is at uint8 offset 1 !!
                 }
                 else
-                    *data << _uint32Values[index];                // other cases
+                {
+                    // pretend that all other HOSTILE players have own faction, to allow follow, heal, rezz (trade wont work)
+                    return target->getFaction();
+                }
             }
         }
+
+        return _uint32Values[index];
     }
-    else                                                    // other objects case (no special index checks)
+
+    // send in current format (float as float, uint32 as uint32)
+    return _uint32Values[index];
+}
+
+uint32 Object::_GetGameObjectFieldValueFor(uint16 index, Player* target, bool activateToQuest) const
+{
+    if (index != GAMEOBJECT_DYNAMIC)
+        return _uint32Values[index];                        // other cases
+
+    // low half: the dynamic flags, high half: all bits set
+    if (!activateToQuest)
+        return 0xFFFF0000;                                  // disable quest object
+
+    switch (ToGameObject()->GetGoType())
     {
-        for (uint16 index = 0; index < _valuesCount; ++index)
+        case GAMEOBJECT_TYPE_CHEST:
+        case GAMEOBJECT_TYPE_GOOBER:
+            if (target->isGameMaster())
+                return 0xFFFF0000 | GO_DYNFLAG_LO_ACTIVATE;
+            return 0xFFFF0000 | GO_DYNFLAG_LO_ACTIVATE | GO_DYNFLAG_LO_SPARKLE;
+        case GAMEOBJECT_TYPE_GENERIC:
+            if (target->isGameMaster())
+                return 0xFFFF0000;
+            return 0xFFFF0000 | GO_DYNFLAG_LO_SPARKLE;
+        default:
+            // unknown, not happen.
+            return 0xFFFF0000;
+    }
+}
+
+bool Object::_IsTargetDependentField(uint16 index) const
+{
+    if (isType(TYPEMASK_UNIT))
+    {
+        switch (index)
         {
-            if (updateMask->GetBit(index))
-            {
-                // send in current format (float as float, uint32 as uint32)
-                *data << _uint32Values[index];
-            }
+            case UNIT_NPC_FLAGS:
+            case UNIT_FIELD_AURASTATE:
+            case UNIT_FIELD_FLAGS:
+            case UNIT_FIELD_DISPLAYID:
+            case UNIT_DYNAMIC_FLAGS:
+            case UNIT_FIELD_BYTES_2:
+            case UNIT_FIELD_FACTIONTEMPLATE:
+                return true;
+            default:
+                return false;
         }
     }
+
+    if (isType(TYPEMASK_GAMEOBJECT))
+        return index == GAMEOBJECT_DYNAMIC;
+
+    return false;
 }
 
 void Object::ClearUpdateMask(bool remove)
 {
-    memset(_changedFields, 0, _valuesCount*sizeof(bool));
+    _changedFields.Clear();
 
     if (m_objectUpdated)
     {
         if (remove)
-            sObjectAccessor->RemoveUpdateObject(this);
+            RemoveFromObjectUpdate();
         m_objectUpdated = false;
     }
 }
 
+void Object::AddToObjectUpdate()
+{
+    // remembered, the object may not find the map anymore when it leaves the world
+    m_updateMap = FindUpdateMap();
+    if (m_updateMap)
+        m_updateMap->AddUpdateObject(this);
+    else
+        sObjectAccessor->AddUpdateObject(this);
+}
+
+void Object::RemoveFromObjectUpdate()
+{
+    if (m_updateMap)
+        m_updateMap->RemoveUpdateObject(this);
+    else
+        sObjectAccessor->RemoveUpdateObject(this);
+    m_updateMap = NULL;
+}
+
 void Object::BuildFieldsUpdate(Player* player, UpdateDataMapType& data_map) const
 {
     UpdateDataMapType::iterator iter = data_map.find(player);
@@ -706,6 +764,20 @@ void Object::BuildFieldsUpdate(Player* player, UpdateDataMapType& data_map) cons
     BuildValuesUpdateBlockForPlayer(&iter->second, iter->first);
 }
 
+void Object::BuildFieldsUpdate(Player* player, UpdateDataMapType& data_map, ValuesUpdateCache& cache) const
+{
+    UpdateDataMapType::iterator iter = data_map.find(player);
+
+    if (iter == data_map.end())
+    {
+        std::pair<UpdateDataMapType::iterator, bool> p = data_map.insert(UpdateDataMapType::value_type(player, UpdateData(player->GetMapId())));
+        ASSERT(p.second);
+        iter = p.first;
+    }
+
+    BuildValuesUpdateBlockForPlayer(&iter->second, iter->first, cache);
+}
+
 void Object::_LoadIntoDataField(char const* data, uint32 startOffset, uint32 count)
 {
     if (!data)
@@ -719,19 +791,13 @@ void Object::_LoadIntoDataField(char const* data, uint32 startOffset, uint32 cou
     for (uint32 index = 0; index < count; ++index)
     {
         _uint32Values[startOffset + index] = atol(tokens[index]);
-        _changedFields[startOffset + index] = true;
+        _changedFields.SetBitAtomic(startOffset + index);
     }
 }
 
 void Object::_SetUpdateBits(UpdateMask* updateMask, Player* /*target*/) const
 {
-    bool* indexes = _changedFields;
-
-    for (uint16 index = 0; index < _valuesCount; ++index, ++indexes)
-    {
-        if (*indexes)
-            updateMask->SetBit(index);
-    }
+    *updateMask |= _changedFields;
 }
 
 void Object::_SetCreateBits(UpdateMask* updateMask, Player* /*target*/) const
@@ -752,11 +818,11 @@ void Object::SetInt32Value(uint16 index, int32 value)
     if (m_int32Values[index] != value)
     {
         m_int32Values[index] = value;
-        _changedFields[index] = true;
+        _changedFields.SetBitAtomic(index);
 
         if (m_inWorld && !m_objectUpdated)
         {
-            sObjectAccessor->AddUpdateObject(this);
+            AddToObjectUpdate();
             m_objectUpdated = true;
         }
     }
@@ -769,11 +835,11 @@ void Object::SetUInt32Value(uint16 index, uint32 value)
     if (_uint32Values[index] != value)
     {
         _uint32Values[index] = value;
-        _changedFields[index] = true;
+        _changedFields.SetBitAtomic(index);
 
         if (m_inWorld && !m_objectUpdated)
         {
-            sObjectAccessor->AddUpdateObject(this);
+            AddToObjectUpdate();
             m_objectUpdated = true;
         }
     }
@@ -784,7 +850,7 @@ void Object::UpdateUInt32Value(uint16 index, uint32 value)
     ASSERT(index < _valuesCount || PrintIndexError(index, true));
 
     _uint32Values[index] = value;
-    _changedFields[index] = true;
+    _changedFields.SetBitAtomic(index);
 }
 
 void Object::SetUInt64Value(uint16 index, uint64 value)
@@ -794,12 +860,12 @@ void Object::SetUInt64Value(uint16 index, uint64 value)
     {
         _uint32Values[index] = PAIR64_LOPART(value);
         _uint32Values[index + 1] = PAIR64_HIPART(value);
-        _changedFields[index] = true;
-        _changedFields[index + 1] = true;
+        _changedFields.SetBitAtomic(index);
+        _changedFields.SetBitAtomic(index + 1);
 
         if (m_inWorld && !m_objectUpdated)
         {
-            sObjectAccessor->AddUpdateObject(this);
+            AddToObjectUpdate();
             m_objectUpdated = true;
         }
     }
@@ -812,12 +878,12 @@ bool Object::AddUInt64Value(uint16 index, uint64 value)
     {
         _uint32Values[index] = PAIR64_LOPART(value);
         _uint32Values[index + 1] = PAIR64_HIPART(value);
-        _changedFields[index] = true;
-        _changedFields[index + 1] = true;
+        _changedFields.SetBitAtomic(index);
+        _changedFields.SetBitAtomic(index + 1);
 
         if (m_inWorld && !m_objectUpdated)
         {
-            sObjectAccessor->AddUpdateObject(this);
+            AddToObjectUpdate();
             m_objectUpdated = true;
         }
 
@@ -834,12 +900,12 @@ bool Object::RemoveUInt64Value(uint16 index, uint64 value)
     {
         _uint32Values[index] = 0;
         _uint32Values[index + 1] = 0;
-        _changedFields[index] = true;
-        _changedFields[index + 1] = true;
+        _changedFields.SetBitAtomic(index);
+        _changedFields.SetBitAtomic(index + 1);
 
         if (m_inWorld && !m_objectUpdated)
         {
-            sObjectAccessor->AddUpdateObject(this);
+            AddToObjectUpdate();
             m_objectUpdated = true;
         }
 
@@ -856,11 +922,15 @@ void Object::SetFloatValue(uint16 index, float value)
     if (m_floatValues[index] != value)
     {
         m_floatValues[index] = value;
-        _changedFields[index] = true;
+        _changedFields.SetBitAtomic(index);
+
+        // range searches extend their radius by the combat reach kept in the cell index
+        if (index == UNIT_FIELD_COMBATREACH && isType(TYPEMASK_UNIT))
+            ((WorldObject*)this)->UpdateCellIndex();
 
         if (m_inWorld && !m_objectUpdated)
         {
-            sObjectAccessor->AddUpdateObject(this);
+            AddToObjectUpdate();
             m_objectUpdated = true;
         }
     }
@@ -880,11 +950,11 @@ void Object::SetByteValue(uint16 index, uint8 offset, uint8 value)
     {
         _uint32Values[index] &= ~uint32(uint32(0xFF) << (offset * 8));
         _uint32Values[index] |= uint32(uint32(value) << (offset * 8));
-        _changedFields[index] = true;
+        _changedFields.SetBitAtomic(index);
 
         if (m_inWorld && !m_objectUpdated)
         {
-            sObjectAccessor->AddUpdateObject(this);
+            AddToObjectUpdate();
             m_objectUpdated = true;
         }
     }
@@ -904,11 +974,11 @@ void Object::SetUInt16Value(uint16 index, uint8 offset, uint16 value)
     {
         _uint32Values[index] &= ~uint32(uint32(0xFFFF) << (offset * 16));
         _uint32Values[index] |= uint32(uint32(value) << (offset * 16));
-        _changedFields[index] = true;
+        _changedFields.SetBitAtomic(index);
 
         if (m_inWorld && !m_objectUpdated)
         {
-            sObjectAccessor->AddUpdateObject(this);
+            AddToObjectUpdate();
             m_objectUpdated = true;
         }
     }
@@ -971,11 +1041,11 @@ void Object::SetFlag(uint16 index, uint32 newFlag)
     if (oldval != newval)
     {
         _uint32Values[index] = newval;
-        _changedFields[index] = true;
+        _changedFields.SetBitAtomic(index);
 
         if (m_inWorld && !m_objectUpdated)
         {
-            sObjectAccessor->AddUpdateObject(this);
+            AddToObjectUpdate();
             m_objectUpdated = true;
         }
     }
@@ -992,11 +1062,11 @@ void Object::RemoveFlag(uint16 index, uint32 oldFlag)
     if (oldval != newval)
     {
         _uint32Values[index] = newval;
-        _changedFields[index] = true;
+        _changedFields.SetBitAtomic(index);
 
         if (m_inWorld && !m_objectUpdated)
         {
-            sObjectAccessor->AddUpdateObject(this);
+            AddToObjectUpdate();
             m_objectUpdated = true;
         }
     }
@@ -1015,11 +1085,11 @@ void Object::SetByteFlag(uint16 index, uint8 offset, uint8 newFlag)
     if (!(uint8(_uint32Values[index] >> (offset * 8)) & newFlag))
     {
         _uint32Values[index] |= uint32(uint32(newFlag) << (offset * 8));
-        _changedFields[index] = true;
+        _changedFields.SetBitAtomic(index);
 
         if (m_inWorld && !m_objectUpdated)
         {
-            sObjectAccessor->AddUpdateObject(this);
+            AddToObjectUpdate();
             m_objectUpdated = true;
         }
     }
@@ -1038,11 +1108,11 @@ void Object::RemoveByteFlag(uint16 index, uint8 offset, uint8 oldFlag)
     if (uint8(_uint32Values[index] >> (offset * 8)) & oldFlag)
     {
         _uint32Values[index] &= ~uint32(uint32(oldFlag) << (offset * 8));
-        _changedFields[index] = true;
+        _changedFields.SetBitAtomic(index);
 
         if (m_inWorld && !m_objectUpdated)
         {
-            sObjectAccessor->AddUpdateObject(this);
+            AddToObjectUpdate();
             m_objectUpdated = true;
         }
     }
@@ -1136,7 +1206,8 @@ void MovementInfo::OutDebug()
 WorldObject::WorldObject(bool isWorldObject): WorldLocation(),
 m_name(""), _isActive(false), m_isWorldObject(isWorldObject), _zoneScript(NULL),
 _transport(NULL), m_currMap(NULL), m_InstanceId(0),
-m_phaseMask(PHASEMASK_NORMAL), m_notifyflags(0), m_executed_notifies(0)
+m_phaseMask(PHASEMASK_NORMAL), m_notifyflags(0), m_executed_notifies(0),
+_cellIndex(NULL), _cellIndexRow(0), _deferredUpdate(false)
 {
     _serverSideVisibility.SetValue(SERVERSIDE_VISIBILITY_GHOST, GHOST_VISIBILITY_ALIVE | GHOST_VISIBILITY_GHOST);
     _serverSideVisibilityDetect.SetValue(SERVERSIDE_VISIBILITY_GHOST, GHOST_VISIBILITY_ALIVE);
@@ -1282,6 +1353,51 @@ bool WorldObject::IsWithinLOS(float ox, float oy, float oz) const
     z += 2.0f;
     oz += 2.0f;
 
+    if (!IsWithinTerrainLOS(x, y, z, ox, oy, oz))
+        return false;
+
+    VMAP::IVMapManager *vMapManager = VMAP::VMapFactory::createOrGetVMapManager();
+    return vMapManager->isInLineOfSight(GetMapId(), x, y, z, ox, oy, oz);
+}
+
+void WorldObject::SelectWithinLOSInMap(std::list<Unit*>& units) const
+{
+    float x, y, z;
+    GetPosition(x, y, z);
+    z += 2.0f;
+
+    // units passing the terrain check are collected and their vmap rays traced together
+    const uint32 BATCH_SIZE = 32;
+    std::list<Unit*>::iterator batch[BATCH_SIZE];
+    float ox[BATCH_SIZE], oy[BATCH_SIZE], oz[BATCH_SIZE];
+    bool results[BATCH_SIZE];
+    uint32 pending = 0;
+
+    VMAP::IVMapManager *vMapManager = VMAP::VMapFactory::createOrGetVMapManager();
+    for (std::list<Unit*>::iterator itr = units.begin(); itr != units.end();)
+    {
+        std::list<Unit*>::iterator unit = itr++;
+        (*unit)->GetPosition(ox[pending], oy[pending], oz[pending]);
+        oz[pending] += 2.0f;
+
+        if (!IsInMap(*unit) || !IsWithinTerrainLOS(x, y, z, ox[pending], oy[pending], oz[pending]))
+            units.erase(unit);
+        else
+            batch[pending++] = unit;
+
+        if (pending == BATCH_SIZE || (pending && itr == units.end()))
+        {
+            vMapManager->isInLineOfSight(GetMapId(), x, y, z, pending, ox, oy, oz, results);
+            for (uint32 i = 0; i < pending; ++i)
+                if (!results[i])
+                    units.erase(batch[i]);
+            pending = 0;
+        }
+    }
+}
+
+bool WorldObject::IsWithinTerrainLOS(float x, float y, float z, float ox, float oy, float oz) const
+{
     // check for line of sight because of terrain height differences
     if (!GetMap()->IsDungeon()) // avoid unnecessary calculation inside raid/dungeons
     {
@@ -1305,8 +1421,7 @@ bool WorldObject::IsWithinLOS(float ox, float oy, float oz) const
         }
     }
 
-    VMAP::IVMapManager *vMapManager = VMAP::VMapFactory::createOrGetVMapManager();
-    return vMapManager->isInLineOfSight(GetMapId(), x, y, z, ox, oy, oz);
+    return true;
 }
 
 bool WorldObject::GetDistanceOrder(WorldObject const* obj1, WorldObject const* obj2, bool is3D /* = true */) const
@@ -1841,10 +1956,10 @@ void WorldObject::SendPlaySound(uint32 Sound, bool OnlySelf)
 
 void Object::ForceValuesUpdateAtIndex(uint32 i)
 {
-    _changedFields[i] = true;
+    _changedFields.SetBitAtomic(i);
     if (m_inWorld && !m_objectUpdated)
     {
-        sObjectAccessor->AddUpdateObject(this);
+        AddToObjectUpdate();
         m_objectUpdated = true;
     }
 }
@@ -2637,6 +2752,18 @@ void WorldObject::MovePosition(Position &pos, float dist, float angle)
     pos._orientation = _orientation;
 }
 
+// surface height below the sky and below z at the same point, looked up in one batch
+void WorldObject::GetGroundAndFloorHeight(float x, float y, float z, float &ground, float &floor) const
+{
+    float xs[2] = { x, x };
+    float ys[2] = { y, y };
+    float zs[2] = { MAX_HEIGHT, z };
+    float heights[2];
+    GetMap()->GetHeights(2, xs, ys, zs, heights, true);
+    ground = heights[0];
+    floor = heights[1];
+}
+
 void WorldObject::MovePositionToFirstCollision(Position &pos, float dist, float angle)
 {
     angle += _orientation;
@@ -2644,8 +2771,7 @@ void WorldObject::MovePositionToFirstCollision(Position &pos, float dist, float
 
     destx = pos.m_positionX + dist * cos(angle);
     desty = pos.m_positionY + dist * sin(angle);
-    ground = GetMap()->GetHeight(destx, desty, MAX_HEIGHT, true);
-    floor = GetMap()->GetHeight(destx, desty, pos.m_positionZ, true);
+    GetGroundAndFloorHeight(destx, desty, pos.m_positionZ, ground, floor);
     destz = fabs(ground - pos.m_positionZ) <= fabs(floor - pos.m_positionZ) ? ground : floor;
 
     bool col = VMAP::VMapFactory::createOrGetVMapManager()->getObjectHitPos(GetMapId(), pos.m_positionX, pos.m_positionY, pos.m_positionZ+0.5f, destx, desty, destz+0.5f, destx, desty, destz, -0.5f);
@@ -2668,8 +2794,7 @@ void WorldObject::MovePositionToFirstCollision(Position &pos, float dist, float
         {
             destx -= step * cos(angle);
             desty -= step * sin(angle);
-            ground = GetMap()->GetHeight(destx, desty, MAX_HEIGHT, true);
-            floor = GetMap()->GetHeight(destx, desty, pos.m_positionZ, true);
+            GetGroundAndFloorHeight(destx, desty, pos.m_positionZ, ground, floor);
             destz = fabs(ground - pos.m_positionZ) <= fabs(floor - pos.m_positionZ) ? ground : floor;
         }
         // we have correct destz now
@@ -2690,6 +2815,9 @@ void WorldObject::SetPhaseMask(uint32 newPhaseMask, bool update)
 {
     m_phaseMask = newPhaseMask;
 
+    if (_cellIndex)
+        _cellIndex->SetPhaseMask(this);
+
     if (update && IsInWorld())
         UpdateObjectVisibility();
 }
@@ -2754,6 +2882,7 @@ struct WorldObjectChangeAccumulator
     UpdateDataMapType& i_updateDatas;
     WorldObject& i_object;
     std::set<uint64> player_list;
+    ValuesUpdateCache i_cache;
     WorldObjectChangeAccumulator(WorldObject &obj, UpdateDataMapType &d) : i_updateDatas(d), i_object(obj) {}
     void Visit(PlayerMapType &m)
     {
@@ -2811,7 +2940,7 @@ struct WorldObjectChangeAccumulator
         // Only send update once to a player
         if (player_list.find(player->GetGUID()) == player_list.end() && player->HaveAtClient(&i_object))
         {
-            i_object.BuildFieldsUpdate(player, i_updateDatas);
+            i_object.BuildFieldsUpdate(player, i_updateDatas, i_cache);
             player_list.insert(player->GetGUID());
         }
     }
@@ -23,9 +23,11 @@
 #include "Common.h"
 #include "UpdateFields.h"
 #include "UpdateData.h"
+#include "UpdateMask.h"
 #include "GridReference.h"
 #include "ObjectDefines.h"
 #include "GridDefines.h"
+#include "CellObjectIndex.h"
 #include "Map.h"
 
 #include <set>
@@ -121,6 +123,30 @@ class Transport;
 
 typedef UNORDERED_MAP<Player*, UpdateData> UpdateDataMapType;
 
+// players sharing the value update block of an object, the fields depending on the
+// player (party, GM, quest and loot state) are patched in for every one of them
+enum UpdateObserverClass
+{
+    UPDATE_OBSERVER_SELF    = 0,                            // the object itself, sees every changed field
+    UPDATE_OBSERVER_OTHER   = 1,                            // any other player, sees the visible fields
+    MAX_UPDATE_OBSERVERS
+};
+
+// value update blocks of one object, built once per tick for each observer class
+struct ValuesUpdateCache
+{
+    struct Block
+    {
+        Block() : built(false), data(0) { }
+
+        bool built;
+        ByteBuffer data;
+        std::vector<std::pair<uint16, size_t> > targetFields; // field index and its position in data
+    };
+
+    Block blocks[MAX_UPDATE_OBSERVERS];
+};
+
 class Object
 {
     public:
@@ -141,11 +167,13 @@ class Object
 
         TypeID GetTypeId() const { return _objectTypeId; }
         bool isType(uint16 mask) const { return (mask & _objectType); }
+        uint16 GetTypeMask() const { return _objectType; }
 
         virtual void BuildCreateUpdateBlockForPlayer(UpdateData* data, Player* target) const;
         void SendUpdateToPlayer(Player* player);
 
         void BuildValuesUpdateBlockForPlayer(UpdateData* data, Player* target) const;
+        void BuildValuesUpdateBlockForPlayer(UpdateData* data, Player* target, ValuesUpdateCache& cache) const;
         void BuildOutOfRangeUpdateBlock(UpdateData* data) const;
         void BuildMovementUpdateBlock(UpdateData* data, uint32 flags = 0) const;
 
@@ -297,6 +325,7 @@ class Object
         virtual bool hasInvolvedQuest(uint32 /* quest_id */) const { return false; }
         virtual void BuildUpdate(UpdateDataMapType&) {}
         void BuildFieldsUpdate(Player*, UpdateDataMapType &) const;
+        void BuildFieldsUpdate(Player*, UpdateDataMapType &, ValuesUpdateCache &) const;
 
         // FG: some hacky helpers
         void ForceValuesUpdateAtIndex(uint32);
@@ -327,6 +356,10 @@ class Object
         virtual void _SetCreateBits(UpdateMask* updateMask, Player* target) const;
         void _BuildMovementUpdate(ByteBuffer * data, uint16 flags) const;
         void _BuildValuesUpdate(uint8 updatetype, ByteBuffer *data, UpdateMask* updateMask, Player* target) const;
+        bool _IsActivateToQuestFor(uint8 updatetype, Player* target) const;
+        uint32 _GetUnitFieldValueFor(uint16 index, Player* target) const;
+        uint32 _GetGameObjectFieldValueFor(uint16 index, Player* target, bool activateToQuest) const;
+        bool _IsTargetDependentField(uint16 index) const;
 
         uint16 _objectType;
 
@@ -340,14 +373,21 @@ class Object
             float  *m_floatValues;
         };
 
-        bool* _changedFields;
+        UpdateMask _changedFields;
 
         uint16 _valuesCount;
 
         bool m_objectUpdated;
 
+        // map collecting the changes of the object, NULL for ObjectAccessor
+        virtual Map* FindUpdateMap() const { return NULL; }
+
     private:
+        void AddToObjectUpdate();
+        void RemoveFromObjectUpdate();
+
         bool m_inWorld;
+        Map* m_updateMap;
 
         ByteBuffer m_PackGUID;
 
@@ -533,7 +573,7 @@ class GridObject
     public:
         bool IsInGrid() const { return _gridRef.isValid(); }
         void AddToGrid(GridRefManager<T>& m) { ASSERT(!IsInGrid()); _gridRef.link(&m, (T*)this); }
-        void RemoveFromGrid() { ASSERT(IsInGrid()); _gridRef.unlink(); }
+        void RemoveFromGrid() { ASSERT(IsInGrid()); ((T*)this)->RemoveFromCellIndex(); _gridRef.unlink(); }
     private:
         GridReference<T> _gridRef;
 };
@@ -564,11 +604,31 @@ class FlaggedValuesArray32
 
 class WorldObject : public Object, public WorldLocation
 {
+    friend class CellObjectIndex;
     protected:
         explicit WorldObject(bool isWorldObject); //note: here it means if it is in grid object list or world object list
     public:
         virtual ~WorldObject();
 
+        // hide Position::Relocate, the row of the object in its cell index follows every move
+        void Relocate(float x, float y)
+            { Position::Relocate(x, y); UpdateCellIndex(); }
+        void Relocate(float x, float y, float z)
+            { Position::Relocate(x, y, z); UpdateCellIndex(); }
+        void Relocate(float x, float y, float z, float orientation)
+            { Position::Relocate(x, y, z, orientation); UpdateCellIndex(); }
+        void Relocate(const Position &pos)
+            { Position::Relocate(pos); UpdateCellIndex(); }
+        void Relocate(const Position* pos)
+            { Position::Relocate(pos); UpdateCellIndex(); }
+        void UpdateCellIndex() { if (_cellIndex) _cellIndex->Relocate(this); }
+        void RemoveFromCellIndex() { if (_cellIndex) _cellIndex->Remove(this); }
+        CellObjectIndex* GetCellIndex() const { return _cellIndex; }
+
+        // updated by Map after the grid regions instead of within them
+        bool HasDeferredUpdate() const { return _deferredUpdate; }
+        void SetDeferredUpdate(bool deferred) { _deferredUpdate = deferred; }
+
         virtual void Update (uint32 /*time_diff*/) { }
 
         void _Create(uint32 guidlow, HighGuid guidhigh, uint32 phaseMask);
@@ -597,6 +657,7 @@ class WorldObject : public Object, public WorldLocation
             MovePosition(pos, dist, angle);
         }
         void MovePositionToFirstCollision(Position &pos, float dist, float angle);
+        void GetGroundAndFloorHeight(float x, float y, float z, float &ground, float &floor) const;
         void GetFirstCollisionPosition(Position &pos, float dist, float angle)
         {
             GetPosition(&pos);
@@ -705,6 +766,8 @@ class WorldObject : public Object, public WorldLocation
         }
         bool IsWithinLOS(float x, float y, float z) const;
         bool IsWithinLOSInMap(const WorldObject* obj) const;
+        // removes the units out of line of sight, cheaper than IsWithinLOSInMap for each of them
+        void SelectWithinLOSInMap(std::list<Unit*>& units) const;
         bool GetDistanceOrder(WorldObject const* obj1, WorldObject const* obj2, bool is3D = true) const;
         bool IsInRange(WorldObject const* obj, float minRange, float maxRange, bool is3D = true) const;
         bool IsInRange2d(float x, float y, float minRange, float maxRange) const;
@@ -811,6 +874,18 @@ class WorldObject : public Object, public WorldLocation
         template<class NOTIFIER> void VisitNearbyObject(float const& radius, NOTIFIER& notifier) const { if (IsInWorld()) GetMap()->VisitAll(GetPositionX(), GetPositionY(), radius, notifier); }
         template<class NOTIFIER> void VisitNearbyGridObject(float const& radius, NOTIFIER& notifier) const { if (IsInWorld()) GetMap()->VisitGrid(GetPositionX(), GetPositionY(), radius, notifier); }
         template<class NOTIFIER> void VisitNearbyWorldObject(float const& radius, NOTIFIER& notifier) const { if (IsInWorld()) GetMap()->VisitWorld(GetPositionX(), GetPositionY(), radius, notifier); }
+        // the objects of typeMask whose cell index rows are in range, the notifier still checks them, see Map::VisitIndexed;
+        // excludeSelf leaves this object out for checks that reject it anyway, e.g. the unfriendly unit ones
+        template<class NOTIFIER> void VisitNearbyIndexedObject(float const& radius, uint32 typeMask, NOTIFIER& notifier, bool excludeSelf = false) const
+        {
+            if (!IsInWorld())
+                return;
+
+            CellObjectIndexQuery query(GetPositionX(), GetPositionY(), GetPositionZ(), radius + GetObjectSize(), GetPhaseMask(), typeMask);
+            if (excludeSelf)
+                query.excludeGuid = GetGUID();
+            GetMap()->VisitIndexed(query, notifier);
+        }
 
 #ifdef MAP_BASED_RAND_GEN
         int32 irand(int32 min, int32 max) const     { return int32 (GetMap()->mtRand.randInt(max - min)) + min; }
@@ -843,6 +918,8 @@ class WorldObject : public Object, public WorldLocation
         // transports
         Transport* _transport;
 
+        Map* FindUpdateMap() const { return m_currMap; }
+
         //these functions are used mostly for Relocate() and Corpse/Player specific stuff...
         //use them ONLY in LoadFromDB()/Create() funcs and nowhere else!
         //mapId/instanceId should be set in SetMap() function!
@@ -864,7 +941,14 @@ class WorldObject : public Object, public WorldLocation
         uint16 m_notifyflags;
         uint16 m_executed_notifies;
 
+        // set by the index of the cell holding the object
+        CellObjectIndex* _cellIndex;
+        uint32 _cellIndexRow;
+
+        bool _deferredUpdate;
+
         virtual bool _IsWithinDist(WorldObject const* obj, float dist2compare, bool is3D) const;
+        bool IsWithinTerrainLOS(float x, float y, float z, float ox, float oy, float oz) const;
 
         bool CanNeverSee(WorldObject const* obj) const { return GetMap() != obj->GetMap() || !InSamePhase(obj); }
         virtual bool CanAlwaysSee(WorldObject const* /*obj*/) const { return false; }
@@ -64,12 +64,27 @@ bool UpdateData::BuildPacket(WorldPacket* packet)
 
     packet->append(m_data);
 
-    if (packet->wpos() > 100)
-        packet->compress(SMSG_COMPRESSED_UPDATE_OBJECT);
+    // with Compression.Async the network thread sending the packet compresses it
+    if (!sWorld->getBoolConfig(CONFIG_COMPRESSION_ASYNC))
+        if (int level = GetCompressionLevel(packet->wpos()))
+            packet->compress(SMSG_COMPRESSED_UPDATE_OBJECT, level);
 
     return true;
 }
 
+int UpdateData::GetCompressionLevel(size_t size)
+{
+    if (size <= sWorld->getIntConfig(CONFIG_COMPRESSION_THRESHOLD))
+        return 0;
+
+    // While the world update runs late, only the packets where it pays off are compressed, as fast as possible.
+    uint32 budget = sWorld->getIntConfig(CONFIG_COMPRESSION_ADAPTIVE_BUDGET);
+    if (budget && sWorld->GetUpdateTime() > budget)
+        return size > sWorld->getIntConfig(CONFIG_COMPRESSION_ADAPTIVE_THRESHOLD) ? Z_BEST_SPEED : 0;
+
+    return int(sWorld->getIntConfig(CONFIG_COMPRESSION));
+}
+
 void UpdateData::Clear()
 {
     m_data.clear();
@@ -63,6 +63,9 @@ class UpdateData
 
         std::set<uint64> const& GetOutOfRangeGUIDs() const { return m_outOfRangeGUIDs; }
 
+        /// zlib level an update packet of this size is compressed with, 0 if it's sent uncompressed
+        static int GetCompressionLevel(size_t size);
+
     protected:
         uint16 m_map;
         uint32 m_blockCount;
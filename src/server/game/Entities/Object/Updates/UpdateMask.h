@@ -20,9 +20,15 @@
 #ifndef __UPDATEMASK_H
 #define __UPDATEMASK_H
 
+#include "Define.h"
 #include "UpdateFields.h"
 #include "Errors.h"
 
+#if COMPILER == COMPILER_MICROSOFT
+#  include <intrin.h>
+#endif
+
+// bits are set on whole blocks, the mask is sent as is and matches the client layout on little-endian hosts
 class UpdateMask
 {
     public:
@@ -36,17 +42,60 @@ class UpdateMask
 
         void SetBit (uint32 index)
         {
-            ((uint8 *)mUpdateMask)[ index >> 3 ] |= 1 << (index & 0x7);
+            mUpdateMask[ index >> 5 ] |= 1u << (index & 0x1F);
+        }
+
+        // for masks threads set bits of concurrently, e.g. the changed fields of an object that
+        // another map region or a session domain modifies; a plain |= would lose the other bits of the block
+        void SetBitAtomic (uint32 index)
+        {
+            uint32 bit = 1u << (index & 0x1F);
+            uint32* block = &mUpdateMask[ index >> 5 ];
+            if (*block & bit)                               // bits are only cleared while no thread sets any
+                return;
+
+#if COMPILER == COMPILER_MICROSOFT
+            _InterlockedOr((long volatile*)block, long(bit));
+#else
+            __sync_fetch_and_or(block, bit);
+#endif
         }
 
         void UnsetBit (uint32 index)
         {
-            ((uint8 *)mUpdateMask)[ index >> 3 ] &= (0xff ^ (1 <<  (index & 0x7)));
+            mUpdateMask[ index >> 5 ] &= ~(1u << (index & 0x1F));
         }
 
         bool GetBit (uint32 index) const
         {
-            return (((uint8 *)mUpdateMask)[ index >> 3 ] & (1 << (index & 0x7))) != 0;
+            return (mUpdateMask[ index >> 5 ] & (1u << (index & 0x1F))) != 0;
+        }
+
+        // first set bit at or after index, GetCount() if there is none; empty blocks are skipped whole
+        uint32 GetNextBit (uint32 index) const
+        {
+            uint32 block = index >> 5;
+            if (block >= mBlocks)
+                return mCount;
+
+            uint32 bits = mUpdateMask[block] & (0xFFFFFFFF << (index & 0x1F));
+            while (!bits)
+            {
+                if (++block >= mBlocks)
+                    return mCount;
+                bits = mUpdateMask[block];
+            }
+
+            uint32 next = (block << 5) + FindFirstBit(bits);
+            return next < mCount ? next : mCount;
+        }
+
+        bool IsEmpty() const
+        {
+            for (uint32 i = 0; i < mBlocks; ++i)
+                if (mUpdateMask[i])
+                    return false;
+            return true;
         }
 
         uint32 GetBlockCount() const { return mBlocks; }
@@ -119,6 +168,18 @@ class UpdateMask
         }
 
     private:
+        // bits must not be 0
+        static uint32 FindFirstBit(uint32 bits)
+        {
+#if COMPILER == COMPILER_MICROSOFT
+            unsigned long index;
+            _BitScanForward(&index, bits);
+            return uint32(index);
+#else
+            return uint32(__builtin_ctz(bits));
+#endif
+        }
+
         uint32 mCount;
         uint32 mBlocks;
         uint32 *mUpdateMask;
@@ -22124,7 +22124,7 @@ template void Player::UpdateVisibilityOf(DynamicObject* target, UpdateData& data
 void Player::UpdateObjectVisibility(bool forced)
 {
     if (!forced)
-        AddToNotify(NOTIFY_VISIBILITY_CHANGED);
+        Unit::UpdateObjectVisibility(false);
     else
     {
         Unit::UpdateObjectVisibility(true);
@@ -13748,6 +13748,10 @@ void Unit::RemoveFromWorld()
             }
         }
 
+        // also while the map processes its notifies, the flags of that batch may already be reset
+        GetMap()->RemoveUnitFromNotify(this);
+        ResetAllNotifies();
+
         WorldObject::RemoveFromWorld();
         m_duringRemoveFromWorld = false;
     }
@@ -14878,7 +14882,7 @@ Unit* Unit::SelectNearbyTarget(Unit* exclude, float dist) const
     std::list<Unit*> targets;
     Trinity::AnyUnfriendlyUnitInObjectRangeCheck u_check(this, this, dist);
     Trinity::UnitListSearcher<Trinity::AnyUnfriendlyUnitInObjectRangeCheck> searcher(this, targets, u_check);
-    VisitNearbyObject(dist, searcher);
+    VisitNearbyIndexedObject(dist, TYPEMASK_UNIT, searcher, true);
 
     // remove current target
     if (getVictim())
@@ -16528,7 +16532,14 @@ void Unit::SetPhaseMask(uint32 newPhaseMask, bool update)
 void Unit::UpdateObjectVisibility(bool forced)
 {
     if (!forced)
-        AddToNotify(NOTIFY_VISIBILITY_CHANGED);
+    {
+        // the map visits the unit with the next relocation notify of its grid
+        if (IsInWorld() && !isNeedNotify(NOTIFY_VISIBILITY_CHANGED))
+        {
+            AddToNotify(NOTIFY_VISIBILITY_CHANGED);
+            GetMap()->AddUnitToNotify(this);
+        }
+    }
     else
     {
         WorldObject::UpdateObjectVisibility(true);
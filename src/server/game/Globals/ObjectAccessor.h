@@ -227,6 +227,7 @@ class ObjectAccessor
         static void SaveAllPlayers();
 
         //non-static functions
+        //changed objects without a map, the others are collected by their map
         void AddUpdateObject(Object* obj)
         {
             TRINITY_GUARD(ACE_Thread_Mutex, i_objectLock);
@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ * Copyright (C) 2008-2012 TrinityCore <http://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CellObjectIndex.h"
+#include "Object.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define CELL_OBJECT_INDEX_SSE
+    #include <emmintrin.h>
+#endif
+
+CellObjectIndex::~CellObjectIndex()
+{
+    // the cell goes away before the objects still linked to it, e.g. on map unload
+    for (ObjectList::const_iterator itr = _objects.begin(); itr != _objects.end(); ++itr)
+        (*itr)->_cellIndex = NULL;
+}
+
+void CellObjectIndex::Insert(WorldObject* obj)
+{
+    ASSERT(!obj->_cellIndex);
+
+    obj->_cellIndex = this;
+    obj->_cellIndexRow = uint32(_objects.size());
+
+    _x.push_back(obj->GetPositionX());
+    _y.push_back(obj->GetPositionY());
+    _z.push_back(obj->GetPositionZ());
+    _size.push_back(obj->GetObjectSize());
+    _phaseMask.push_back(obj->GetPhaseMask());
+    _typeMask.push_back(obj->GetTypeMask());
+    _guid.push_back(obj->GetGUID());
+    _objects.push_back(obj);
+}
+
+void CellObjectIndex::Remove(WorldObject* obj)
+{
+    ASSERT(obj->_cellIndex == this);
+
+    // the last row takes the place of the removed one
+    uint32 row = obj->_cellIndexRow;
+    uint32 last = uint32(_objects.size()) - 1;
+    if (row != last)
+    {
+        _x[row] = _x[last];
+        _y[row] = _y[last];
+        _z[row] = _z[last];
+        _size[row] = _size[last];
+        _phaseMask[row] = _phaseMask[last];
+        _typeMask[row] = _typeMask[last];
+        _guid[row] = _guid[last];
+        _objects[row] = _objects[last];
+        _objects[row]->_cellIndexRow = row;
+    }
+
+    _x.pop_back();
+    _y.pop_back();
+    _z.pop_back();
+    _size.pop_back();
+    _phaseMask.pop_back();
+    _typeMask.pop_back();
+    _guid.pop_back();
+    _objects.pop_back();
+
+    obj->_cellIndex = NULL;
+}
+
+void CellObjectIndex::Relocate(WorldObject* obj)
+{
+    uint32 row = obj->_cellIndexRow;
+    _x[row] = obj->GetPositionX();
+    _y[row] = obj->GetPositionY();
+    _z[row] = obj->GetPositionZ();
+    _size[row] = obj->GetObjectSize();
+}
+
+void CellObjectIndex::SetPhaseMask(WorldObject* obj)
+{
+    _phaseMask[obj->_cellIndexRow] = obj->GetPhaseMask();
+}
+
+void CellObjectIndex::Append(CellObjectIndexQuery const& query, uint32 row, ObjectList& result) const
+{
+    if (_guid[row] != query.excludeGuid)
+        result.push_back(_objects[row]);
+}
+
+void CellObjectIndex::Search(CellObjectIndexQuery const& query, ObjectList& result) const
+{
+    uint32 count = uint32(_objects.size());
+    float radius = query.radius > 0.0f ? query.radius : 0.0f;
+    uint32 row = 0;
+
+#ifdef CELL_OBJECT_INDEX_SSE
+    __m128 const x = _mm_set1_ps(query.x);
+    __m128 const y = _mm_set1_ps(query.y);
+    __m128 const z = _mm_set1_ps(query.z);
+    __m128 const r = _mm_set1_ps(radius);
+    __m128i const phaseMask = _mm_set1_epi32(int32(query.phaseMask));
+    __m128i const typeMask = _mm_set1_epi32(int32(query.typeMask));
+    __m128i const zero = _mm_setzero_si128();
+
+    for (; row + 4 <= count; row += 4)
+    {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(&_x[row]), x);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(&_y[row]), y);
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(&_z[row]), z);
+        __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        __m128 reach = _mm_add_ps(r, _mm_loadu_ps(&_size[row]));
+
+        uint32 inRange = uint32(_mm_movemask_ps(_mm_cmple_ps(dist, _mm_mul_ps(reach, reach))));
+        if (!inRange)
+            continue;
+
+        __m128i phase = _mm_and_si128(_mm_loadu_si128((__m128i const*)&_phaseMask[row]), phaseMask);
+        __m128i type = _mm_and_si128(_mm_loadu_si128((__m128i const*)&_typeMask[row]), typeMask);
+        uint32 outOfPhase = uint32(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(phase, zero))));
+        uint32 otherType = uint32(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(type, zero))));
+
+        uint32 found = inRange & ~outOfPhase & ~otherType;
+        for (uint32 i = 0; found; ++i, found >>= 1)
+            if (found & 1)
+                Append(query, row + i, result);
+    }
+#endif
+
+    for (; row < count; ++row)
+    {
+        if (!(_phaseMask[row] & query.phaseMask) || !(_typeMask[row] & query.typeMask))
+            continue;
+
+        float dx = _x[row] - query.x;
+        float dy = _y[row] - query.y;
+        float dz = _z[row] - query.z;
+        float reach = radius + _size[row];
+        if (dx * dx + dy * dy + dz * dz <= reach * reach)
+            Append(query, row, result);
+    }
+}
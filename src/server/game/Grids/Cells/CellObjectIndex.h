@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ * Copyright (C) 2008-2012 TrinityCore <http://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_CELLOBJECTINDEX_H
+#define TRINITY_CELLOBJECTINDEX_H
+
+#include "Define.h"
+
+#include <vector>
+
+class WorldObject;
+
+/// Range query against the cell indexes, the radius is extended by the size of every indexed object.
+struct CellObjectIndexQuery
+{
+    CellObjectIndexQuery(float x, float y, float z, float radius, uint32 phaseMask, uint32 typeMask)
+        : x(x), y(y), z(z), radius(radius), phaseMask(phaseMask), typeMask(typeMask), excludeGuid(0) { }
+
+    float x;
+    float y;
+    float z;
+    float radius;
+    uint32 phaseMask;
+    uint32 typeMask;
+    uint64 excludeGuid;                                     // usually the searcher itself
+};
+
+/**
+ * Positions, sizes, phase and type masks of the objects in a cell, one array per field, so a
+ * range query only reads the few floats it compares (four rows at once with SSE2) and touches
+ * the objects it returns. Rows follow the objects: WorldObject refreshes its row on every
+ * Relocate, phase or combat reach change, and the Grid adds and removes them with the object.
+ */
+class CellObjectIndex
+{
+    public:
+        typedef std::vector<WorldObject*> ObjectList;
+
+        CellObjectIndex() { }
+        ~CellObjectIndex();
+
+        void Insert(WorldObject* obj);
+        void Remove(WorldObject* obj);
+        void Relocate(WorldObject* obj);
+        void SetPhaseMask(WorldObject* obj);
+
+        uint32 GetSize() const { return uint32(_objects.size()); }
+
+        /// Appends the objects in range of the query, in no particular order.
+        void Search(CellObjectIndexQuery const& query, ObjectList& result) const;
+
+    private:
+        CellObjectIndex(CellObjectIndex const&);
+        CellObjectIndex& operator=(CellObjectIndex const&);
+
+        void Append(CellObjectIndexQuery const& query, uint32 row, ObjectList& result) const;
+
+        std::vector<float> _x;
+        std::vector<float> _y;
+        std::vector<float> _z;
+        std::vector<float> _size;
+        std::vector<uint32> _phaseMask;
+        std::vector<uint32> _typeMask;
+        std::vector<uint64> _guid;
+        std::vector<WorldObject*> _objects;
+};
+
+#endif
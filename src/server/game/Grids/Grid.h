@@ -34,6 +34,7 @@
 #include "Define.h"
 #include "TypeContainer.h"
 #include "TypeContainerVisitor.h"
+#include "CellObjectIndex.h"
 
 // forward declaration
 template<class A, class T, class O> class GridLoader;
@@ -61,6 +62,7 @@ class Grid
         {
             i_objects.template insert<SPECIFIC_OBJECT>(obj);
             ASSERT(obj->IsInGrid());
+            i_index.Insert(obj);
         }
 
         /** an object of interested exits the grid
@@ -108,12 +110,21 @@ class Grid
             return i_objects.template Count<T>();
         }
 
+        /** Positions of the objects of both containers, for range searches
+         */
+        CellObjectIndex const& GetObjectIndex() const { return i_index; }
+
+        /** Indexes an object a loader linked to one of the containers itself
+         */
+        void AddToObjectIndex(WorldObject* obj) { i_index.Insert(obj); }
+
         /** Inserts a container type object into the grid.
          */
         template<class SPECIFIC_OBJECT> void AddGridObject(SPECIFIC_OBJECT *obj)
         {
             i_container.template insert<SPECIFIC_OBJECT>(obj);
             ASSERT(obj->IsInGrid());
+            i_index.Insert(obj);
         }
 
         /** Removes a containter type object from the grid
@@ -138,6 +149,8 @@ class Grid
 
         TypeMapContainer<GRID_OBJECT_TYPES> i_container;
         TypeMapContainer<WORLD_OBJECT_TYPES> i_objects;
+        // declared last, it is destroyed before the containers unlink the objects left
+        CellObjectIndex i_index;
         //typedef std::set<void*> ActiveGridObjects;
         //ActiveGridObjects m_activeGridObjects;
 };
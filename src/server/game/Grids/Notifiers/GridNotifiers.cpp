@@ -29,18 +29,25 @@
 #include "CellImpl.h"
 #include "SpellInfo.h"
 
+#include <algorithm>
+#include <iterator>
+
 using namespace Trinity;
 
 void VisibleNotifier::SendToSelf()
 {
-    // at this moment i_clientGUIDs have guids that not iterate at grid level checks
+    std::sort(i_visited.begin(), i_visited.end());
+
+    // at this moment the client's guids not in i_visited were not met at grid level checks
     // but exist one case when this possible and object not out of range: transports
     if (Transport* transport = i_player.GetTransport())
         for (Transport::PlayerSet::const_iterator itr = transport->GetPassengers().begin();itr != transport->GetPassengers().end();++itr)
         {
-            if (vis_guids.find((*itr)->GetGUID()) != vis_guids.end())
+            uint64 guid = (*itr)->GetGUID();
+            std::vector<uint64>::iterator pos = std::lower_bound(i_visited.begin(), i_visited.end(), guid);
+            if ((pos == i_visited.end() || *pos != guid) && i_player.m_clientGUIDs.find(guid) != i_player.m_clientGUIDs.end())
             {
-                vis_guids.erase((*itr)->GetGUID());
+                i_visited.insert(pos, guid);
 
                 i_player.UpdateVisibilityOf((*itr), i_data, i_visibleNow);
 
@@ -49,7 +56,12 @@ void VisibleNotifier::SendToSelf()
             }
         }
 
-    for (Player::ClientGUIDs::const_iterator it = vis_guids.begin();it != vis_guids.end(); ++it)
+    // both are sorted, what the client has and the visit did not meet is out of range
+    std::vector<uint64> outOfRange;
+    std::set_difference(i_player.m_clientGUIDs.begin(), i_player.m_clientGUIDs.end(), i_visited.begin(), i_visited.end(),
+        std::back_inserter(outOfRange));
+
+    for (std::vector<uint64>::const_iterator it = outOfRange.begin();it != outOfRange.end(); ++it)
     {
         i_player.m_clientGUIDs.erase(*it);
         i_data.AddOutOfRangeGUID(*it);
@@ -125,7 +137,7 @@ void PlayerRelocationNotifier::Visit(PlayerMapType &m)
     {
         Player* player = iter->getSource();
 
-        vis_guids.erase(player->GetGUID());
+        i_visited.push_back(player->GetGUID());
 
         i_player.UpdateVisibilityOf(player, i_data, i_visibleNow);
 
@@ -144,7 +156,7 @@ void PlayerRelocationNotifier::Visit(CreatureMapType &m)
     {
         Creature* c = iter->getSource();
 
-        vis_guids.erase(c->GetGUID());
+        i_visited.push_back(c->GetGUID());
 
         i_player.UpdateVisibilityOf(c, i_data, i_visibleNow);
 
@@ -181,50 +193,54 @@ void CreatureRelocationNotifier::Visit(CreatureMapType &m)
     }
 }
 
-void DelayedUnitRelocation::Visit(CreatureMapType &m)
+void DelayedUnitRelocation::Relocate(Unit* unit)
 {
-    for (CreatureMapType::iterator iter = m.begin(); iter != m.end(); ++iter)
-    {
-        Creature* unit = iter->getSource();
-        if (!unit->isNeedNotify(NOTIFY_VISIBILITY_CHANGED))
-            continue;
+    if (Creature* creature = unit->ToCreature())
+        RelocateCreature(creature);
+    else if (Player* player = unit->ToPlayer())
+        if (player->_seer == player)
+            RelocateViewer(player);
+
+    // players looking through the eyes of the unit
+    for (SharedVisionList::const_iterator itr = unit->GetSharedVisionList().begin(); itr != unit->GetSharedVisionList().end(); ++itr)
+        if ((*itr)->_seer == unit)
+            RelocateViewer(*itr);
+}
 
-        CreatureRelocationNotifier relocate(*unit);
+void DelayedUnitRelocation::RelocateCreature(Creature* creature)
+{
+    CellCoord pair(Trinity::ComputeCellCoord(creature->GetPositionX(), creature->GetPositionY()));
+    Cell cell(pair);
+    cell.SetNoCreate();
 
-        TypeContainerVisitor<CreatureRelocationNotifier, WorldTypeMapContainer > c2world_relocation(relocate);
-        TypeContainerVisitor<CreatureRelocationNotifier, GridTypeMapContainer >  c2grid_relocation(relocate);
+    CreatureRelocationNotifier relocate(*creature);
 
-        cell.Visit(p, c2world_relocation, i_map, *unit, i_radius);
-        cell.Visit(p, c2grid_relocation, i_map, *unit, i_radius);
-    }
+    TypeContainerVisitor<CreatureRelocationNotifier, WorldTypeMapContainer > c2world_relocation(relocate);
+    TypeContainerVisitor<CreatureRelocationNotifier, GridTypeMapContainer >  c2grid_relocation(relocate);
+
+    cell.Visit(pair, c2world_relocation, i_map, *creature, i_radius);
+    cell.Visit(pair, c2grid_relocation, i_map, *creature, i_radius);
 }
 
-void DelayedUnitRelocation::Visit(PlayerMapType &m)
+void DelayedUnitRelocation::RelocateViewer(Player* player)
 {
-    for (PlayerMapType::iterator iter = m.begin(); iter != m.end(); ++iter)
-    {
-        Player* player = iter->getSource();
-        WorldObject const* viewPoint = player->_seer;
+    WorldObject const* viewPoint = player->_seer;
 
-        if (!viewPoint->isNeedNotify(NOTIFY_VISIBILITY_CHANGED))
-            continue;
-
-        if (player != viewPoint && !viewPoint->IsPositionValid())
-            continue;
+    if (player != viewPoint && !viewPoint->IsPositionValid())
+        return;
 
-        CellCoord pair2(Trinity::ComputeCellCoord(viewPoint->GetPositionX(), viewPoint->GetPositionY()));
-        Cell cell2(pair2);
-        //cell.SetNoCreate(); need load cells around viewPoint or player, that's why its commented
+    CellCoord pair2(Trinity::ComputeCellCoord(viewPoint->GetPositionX(), viewPoint->GetPositionY()));
+    Cell cell2(pair2);
+    //cell.SetNoCreate(); need load cells around viewPoint or player, that's why its commented
 
-        PlayerRelocationNotifier relocate(*player);
-        TypeContainerVisitor<PlayerRelocationNotifier, WorldTypeMapContainer > c2world_relocation(relocate);
-        TypeContainerVisitor<PlayerRelocationNotifier, GridTypeMapContainer >  c2grid_relocation(relocate);
+    PlayerRelocationNotifier relocate(*player);
+    TypeContainerVisitor<PlayerRelocationNotifier, WorldTypeMapContainer > c2world_relocation(relocate);
+    TypeContainerVisitor<PlayerRelocationNotifier, GridTypeMapContainer >  c2grid_relocation(relocate);
 
-        cell2.Visit(pair2, c2world_relocation, i_map, *viewPoint, i_radius);
-        cell2.Visit(pair2, c2grid_relocation, i_map, *viewPoint, i_radius);
+    cell2.Visit(pair2, c2world_relocation, i_map, *viewPoint, i_radius);
+    cell2.Visit(pair2, c2grid_relocation, i_map, *viewPoint, i_radius);
 
-        relocate.SendToSelf();
-    }
+    relocate.SendToSelf();
 }
 
 void AIRelocationNotifier::Visit(CreatureMapType &m)
@@ -322,7 +338,7 @@ void ObjectUpdater::Visit(GridRefManager<T> &m)
 {
     for (typename GridRefManager<T>::iterator iter = m.begin(); iter != m.end(); ++iter)
     {
-        if (iter->getSource()->IsInWorld())
+        if (iter->getSource()->IsInWorld() && !iter->getSource()->HasDeferredUpdate())
             iter->getSource()->Update(i_timeDiff);
     }
 }
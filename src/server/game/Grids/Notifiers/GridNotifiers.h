@@ -31,6 +31,7 @@
 #include "Player.h"
 #include "Unit.h"
 #include "CreatureAI.h"
+#include "SharedPacket.h"
 
 class Player;
 //class Map;
@@ -42,9 +43,13 @@ namespace Trinity
         Player &i_player;
         UpdateData i_data;
         std::set<Unit*> i_visibleNow;
-        Player::ClientGUIDs vis_guids;
+        // objects met by the visit, the client's other objects are out of range
+        std::vector<uint64> i_visited;
 
-        VisibleNotifier(Player &player) : i_player(player), i_data(player.GetMapId()), vis_guids(player.m_clientGUIDs) {}
+        VisibleNotifier(Player &player) : i_player(player), i_data(player.GetMapId())
+        {
+            i_visited.reserve(player.m_clientGUIDs.size());
+        }
         template<class T> void Visit(GridRefManager<T> &m);
         void SendToSelf(void);
     };
@@ -78,17 +83,16 @@ namespace Trinity
         void Visit(PlayerMapType &);
     };
 
+    // visibility and AI updates for a unit that moved since the last relocation notify
     struct DelayedUnitRelocation
     {
         Map &i_map;
-        Cell &cell;
-        CellCoord &p;
         const float i_radius;
-        DelayedUnitRelocation(Cell &c, CellCoord &pair, Map &map, float radius) :
-            i_map(map), cell(c), p(pair), i_radius(radius) {}
-        template<class T> void Visit(GridRefManager<T> &) {}
-        void Visit(CreatureMapType &);
-        void Visit(PlayerMapType   &);
+        DelayedUnitRelocation(Map &map, float radius) : i_map(map), i_radius(radius) {}
+        void Relocate(Unit* unit);
+        void RelocateCreature(Creature* creature);
+        // the player sees the world from its viewpoint, which moved
+        void RelocateViewer(Player* player);
     };
 
     struct AIRelocationNotifier
@@ -127,6 +131,7 @@ namespace Trinity
         float i_distSq;
         uint32 team;
         Player const* skipped_receiver;
+        SharedPacket i_shared;
         MessageDistDeliverer(WorldObject* src, WorldPacket* msg, float dist, bool own_team_only = false, Player const* skipped = NULL)
             : i_source(src), i_message(msg), i_phaseMask(src->GetPhaseMask()), i_distSq(dist * dist)
             , team((own_team_only && src->GetTypeId() == TYPEID_PLAYER) ? ((Player*)src)->GetTeam() : 0)
@@ -147,8 +152,19 @@ namespace Trinity
             if (!player->HaveAtClient(i_source))
                 return;
 
-            if (WorldSession* session = player->GetSession())
+            WorldSession* session = player->GetSession();
+            if (!session)
+                return;
+
+            // large payloads are copied once and only referenced by the receivers' sockets
+            if (i_message->size() < SHARED_PACKET_MIN_SIZE)
                 session->SendPacket(i_message);
+            else
+            {
+                if (i_shared.IsNull())
+                    i_shared = SharedPacket(*i_message);
+                session->SendPacket(i_shared);
+            }
         }
     };
 
@@ -350,6 +366,7 @@ namespace Trinity
 
         void Visit(CreatureMapType &m);
         void Visit(PlayerMapType &m);
+        void Visit(CellObjectIndex::ObjectList const& units);
 
         template<class NOT_INTERESTED> void Visit(GridRefManager<NOT_INTERESTED> &) {}
     };
@@ -367,6 +384,7 @@ namespace Trinity
 
         void Visit(PlayerMapType &m);
         void Visit(CreatureMapType &m);
+        void Visit(CellObjectIndex::ObjectList const& units);
 
         template<class NOT_INTERESTED> void Visit(GridRefManager<NOT_INTERESTED> &) {}
     };
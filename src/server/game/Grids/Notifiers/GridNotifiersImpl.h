@@ -33,7 +33,7 @@ inline void Trinity::VisibleNotifier::Visit(GridRefManager<T> &m)
 {
     for (typename GridRefManager<T>::iterator iter = m.begin(); iter != m.end(); ++iter)
     {
-        vis_guids.erase(iter->getSource()->GetGUID());
+        i_visited.push_back(iter->getSource()->GetGUID());
         i_player.UpdateVisibilityOf(iter->getSource(), i_data, i_visibleNow);
     }
 }
@@ -41,7 +41,7 @@ inline void Trinity::VisibleNotifier::Visit(GridRefManager<T> &m)
 inline void Trinity::ObjectUpdater::Visit(CreatureMapType &m)
 {
     for (CreatureMapType::iterator iter = m.begin(); iter != m.end(); ++iter)
-        if (iter->getSource()->IsInWorld())
+        if (iter->getSource()->IsInWorld() && !iter->getSource()->HasDeferredUpdate())
             iter->getSource()->Update(i_timeDiff);
 }
 
@@ -167,6 +167,14 @@ void Trinity::WorldObjectListSearcher<Check>::Visit(CreatureMapType &m)
                 i_objects.push_back(itr->getSource());
 }
 
+template<class Check>
+void Trinity::UnitListSearcher<Check>::Visit(CellObjectIndex::ObjectList const& units)
+{
+    for (CellObjectIndex::ObjectList::const_iterator itr = units.begin(); itr != units.end(); ++itr)
+        if ((*itr)->InSamePhase(i_phaseMask) && i_check((Unit*)*itr))
+            i_objects.push_back((Unit*)*itr);
+}
+
 template<class Check>
 void Trinity::WorldObjectListSearcher<Check>::Visit(CorpseMapType &m)
 {
@@ -306,6 +314,14 @@ void Trinity::UnitLastSearcher<Check>::Visit(PlayerMapType &m)
     }
 }
 
+template<class Check>
+void Trinity::UnitLastSearcher<Check>::Visit(CellObjectIndex::ObjectList const& units)
+{
+    for (CellObjectIndex::ObjectList::const_iterator itr = units.begin(); itr != units.end(); ++itr)
+        if ((*itr)->InSamePhase(i_phaseMask) && i_check((Unit*)*itr))
+            i_object = (Unit*)*itr;
+}
+
 template<class Check>
 void Trinity::UnitListSearcher<Check>::Visit(PlayerMapType &m)
 {
@@ -31,6 +31,7 @@
 #include "NPCHandler.h"
 #include "Pet.h"
 #include "MapManager.h"
+#include "QueryResponseCache.h"
 
 void WorldSession::SendNameQueryOpcode(uint64 guid)
 {
@@ -100,6 +101,45 @@ void WorldSession::SendQueryTimeResponse()
 }
 
 /// Only _static_ data is sent in this packet !!!
+static void BuildCreatureQueryResponse(WorldPacket& data, uint32 entry, CreatureTemplate const* ci, int loc_idx)
+{
+    std::string Name, SubName;
+    Name = ci->Name;
+    SubName = ci->SubName;
+
+    if (loc_idx >= 0)
+    {
+        if (CreatureLocale const* cl = sObjectMgr->GetCreatureLocale(entry))
+        {
+            ObjectMgr::GetLocaleString(cl->Name, loc_idx, Name);
+            ObjectMgr::GetLocaleString(cl->SubName, loc_idx, SubName);
+        }
+    }
+
+    data << uint32(entry);                                  // creature entry
+    data << Name;
+    data << uint8(0) << uint8(0) << uint8(0);               // name2, name3, name4, always empty
+    data << SubName;
+    data << ci->IconName;                                   // "Directions" for guard, string for Icons 2.3.0
+    data << uint32(ci->type_flags);                         // flags
+    data << uint32(ci->type);                               // CreatureType.dbc
+    data << uint32(ci->family);                             // CreatureFamily.dbc
+    data << uint32(ci->rank);                               // Creature Rank (elite, boss, etc)
+    data << uint32(ci->KillCredit[0]);                      // new in 3.1, kill credit
+    data << uint32(ci->KillCredit[1]);                      // new in 3.1, kill credit
+    data << uint32(ci->Modelid1);                           // Modelid1
+    data << uint32(ci->Modelid2);                           // Modelid2
+    data << uint32(ci->Modelid3);                           // Modelid3
+    data << uint32(ci->Modelid4);                           // Modelid4
+    data << float(ci->ModHealth);                           // dmg/hp modifier
+    data << float(ci->ModMana);                             // dmg/mana modifier
+    data << uint8(ci->RacialLeader);
+    for (uint32 i = 0; i < MAX_CREATURE_QUEST_ITEMS; ++i)
+        data << uint32(ci->questItems[i]);                  // itemId[6], quest drop
+    data << uint32(ci->movementId);                         // CreatureMovementInfo.dbc
+    data << uint32(ci->expansion);                          // client will not allow interaction if this value is not in line with its stored exp
+}
+
 void WorldSession::HandleCreatureQueryOpcode(WorldPacket & recv_data)
 {
     uint32 entry;
@@ -107,62 +147,64 @@ void WorldSession::HandleCreatureQueryOpcode(WorldPacket & recv_data)
     uint64 guid;
     recv_data >> guid;
 
-    CreatureTemplate const* ci = sObjectMgr->GetCreatureTemplate(entry);
-    if (ci)
+    int loc_idx = GetSessionDbLocaleIndex();
+    SharedPacket response = sQueryResponseCache->Find(QUERY_RESPONSE_CREATURE, entry, loc_idx);
+    if (response.IsNull())
     {
-        std::string Name, SubName;
-        Name = ci->Name;
-        SubName = ci->SubName;
-
-        int loc_idx = GetSessionDbLocaleIndex();
-        if (loc_idx >= 0)
+        CreatureTemplate const* ci = sObjectMgr->GetCreatureTemplate(entry);
+        if (!ci)
         {
-            if (CreatureLocale const* cl = sObjectMgr->GetCreatureLocale(entry))
-            {
-                ObjectMgr::GetLocaleString(cl->Name, loc_idx, Name);
-                ObjectMgr::GetLocaleString(cl->SubName, loc_idx, SubName);
-            }
+            sLog->outDebug(LOG_FILTER_NETWORKIO, "WORLD: CMSG_CREATURE_QUERY - NO CREATURE INFO! (GUID: %u, ENTRY: %u)",
+                GUID_LOPART(guid), entry);
+            WorldPacket data(SMSG_CREATURE_QUERY_RESPONSE, 4);
+            data << uint32(entry | 0x80000000);
+            SendPacket(&data);
+            return;
         }
-        sLog->outDetail("WORLD: CMSG_CREATURE_QUERY '%s' - Entry: %u.", ci->Name.c_str(), entry);
                                                             // guess size
         WorldPacket data(SMSG_CREATURE_QUERY_RESPONSE, 100);
-        data << uint32(entry);                              // creature entry
-        data << Name;
-        data << uint8(0) << uint8(0) << uint8(0);           // name2, name3, name4, always empty
-        data << SubName;
-        data << ci->IconName;                               // "Directions" for guard, string for Icons 2.3.0
-        data << uint32(ci->type_flags);                     // flags
-        data << uint32(ci->type);                           // CreatureType.dbc
-        data << uint32(ci->family);                         // CreatureFamily.dbc
-        data << uint32(ci->rank);                           // Creature Rank (elite, boss, etc)
-        data << uint32(ci->KillCredit[0]);                  // new in 3.1, kill credit
-        data << uint32(ci->KillCredit[1]);                  // new in 3.1, kill credit
-        data << uint32(ci->Modelid1);                       // Modelid1
-        data << uint32(ci->Modelid2);                       // Modelid2
-        data << uint32(ci->Modelid3);                       // Modelid3
-        data << uint32(ci->Modelid4);                       // Modelid4
-        data << float(ci->ModHealth);                       // dmg/hp modifier
-        data << float(ci->ModMana);                         // dmg/mana modifier
-        data << uint8(ci->RacialLeader);
-        for (uint32 i = 0; i < MAX_CREATURE_QUEST_ITEMS; ++i)
-            data << uint32(ci->questItems[i]);              // itemId[6], quest drop
-        data << uint32(ci->movementId);                     // CreatureMovementInfo.dbc
-        data << uint32(ci->expansion);                      // client will not allow interaction if this value is not in line with its stored exp
-        SendPacket(&data);
-        sLog->outDebug(LOG_FILTER_NETWORKIO, "WORLD: Sent SMSG_CREATURE_QUERY_RESPONSE");
+        BuildCreatureQueryResponse(data, entry, ci, loc_idx);
+        response = sQueryResponseCache->Store(QUERY_RESPONSE_CREATURE, entry, loc_idx, data);
     }
-    else
+
+    SendPacket(response);
+}
+
+/// Only _static_ data is sent in this packet !!!
+static void BuildGameObjectQueryResponse(WorldPacket& data, uint32 entry, GameObjectTemplate const* info, int loc_idx)
+{
+    std::string Name;
+    std::string IconName;
+    std::string CastBarCaption;
+
+    Name = info->name;
+    IconName = info->IconName;
+    CastBarCaption = info->castBarCaption;
+
+    if (loc_idx >= 0)
     {
-        sLog->outDebug(LOG_FILTER_NETWORKIO, "WORLD: CMSG_CREATURE_QUERY - NO CREATURE INFO! (GUID: %u, ENTRY: %u)",
-            GUID_LOPART(guid), entry);
-        WorldPacket data(SMSG_CREATURE_QUERY_RESPONSE, 4);
-        data << uint32(entry | 0x80000000);
-        SendPacket(&data);
-        sLog->outDebug(LOG_FILTER_NETWORKIO, "WORLD: Sent SMSG_CREATURE_QUERY_RESPONSE");
+        if (GameObjectLocale const* gl = sObjectMgr->GetGameObjectLocale(entry))
+        {
+            ObjectMgr::GetLocaleString(gl->Name, loc_idx, Name);
+            ObjectMgr::GetLocaleString(gl->CastBarCaption, loc_idx, CastBarCaption);
+        }
     }
+
+    data << uint32(entry);
+    data << uint32(info->type);
+    data << uint32(info->displayId);
+    data << Name;
+    data << uint8(0) << uint8(0) << uint8(0);               // name2, name3, name4
+    data << IconName;                                       // 2.0.3, string. Icon name to use instead of default icon for go's (ex: "Attack" makes sword)
+    data << CastBarCaption;                                 // 2.0.3, string. Text will appear in Cast Bar when using GO (ex: "Collecting")
+    data << info->unk1;                                     // 2.0.3, string
+    data.append(info->raw.data, 32);
+    data << float(info->size);                              // go size
+    for (uint32 i = 0; i < MAX_GAMEOBJECT_QUEST_ITEMS; ++i)
+        data << uint32(info->questItems[i]);                // itemId[6], quest drop
+    data << uint32(0);                                      // go expansion field
 }
 
-/// Only _static_ data is sent in this packet !!!
 void WorldSession::HandleGameObjectQueryOpcode(WorldPacket & recv_data)
 {
     uint32 entry;
@@ -170,53 +212,27 @@ void WorldSession::HandleGameObjectQueryOpcode(WorldPacket & recv_data)
     uint64 guid;
     recv_data >> guid;
 
-    const GameObjectTemplate* info = sObjectMgr->GetGameObjectTemplate(entry);
-    if (info)
+    int loc_idx = GetSessionDbLocaleIndex();
+    SharedPacket response = sQueryResponseCache->Find(QUERY_RESPONSE_GAMEOBJECT, entry, loc_idx);
+    if (response.IsNull())
     {
-        std::string Name;
-        std::string IconName;
-        std::string CastBarCaption;
-
-        Name = info->name;
-        IconName = info->IconName;
-        CastBarCaption = info->castBarCaption;
-
-        int loc_idx = GetSessionDbLocaleIndex();
-        if (loc_idx >= 0)
+        GameObjectTemplate const* info = sObjectMgr->GetGameObjectTemplate(entry);
+        if (!info)
         {
-            if (GameObjectLocale const* gl = sObjectMgr->GetGameObjectLocale(entry))
-            {
-                ObjectMgr::GetLocaleString(gl->Name, loc_idx, Name);
-                ObjectMgr::GetLocaleString(gl->CastBarCaption, loc_idx, CastBarCaption);
-            }
+            sLog->outDebug(LOG_FILTER_NETWORKIO, "WORLD: CMSG_GAMEOBJECT_QUERY - Missing gameobject info for (GUID: %u, ENTRY: %u)",
+                GUID_LOPART(guid), entry);
+            WorldPacket data (SMSG_GAMEOBJECT_QUERY_RESPONSE, 4);
+            data << uint32(entry | 0x80000000);
+            SendPacket(&data);
+            return;
         }
-        sLog->outDetail("WORLD: CMSG_GAMEOBJECT_QUERY '%s' - Entry: %u. ", info->name.c_str(), entry);
+
         WorldPacket data (SMSG_GAMEOBJECT_QUERY_RESPONSE, 150);
-        data << uint32(entry);
-        data << uint32(info->type);
-        data << uint32(info->displayId);
-        data << Name;
-        data << uint8(0) << uint8(0) << uint8(0);           // name2, name3, name4
-        data << IconName;                                   // 2.0.3, string. Icon name to use instead of default icon for go's (ex: "Attack" makes sword)
-        data << CastBarCaption;                             // 2.0.3, string. Text will appear in Cast Bar when using GO (ex: "Collecting")
-        data << info->unk1;                                 // 2.0.3, string
-        data.append(info->raw.data, 32);
-        data << float(info->size);                          // go size
-        for (uint32 i = 0; i < MAX_GAMEOBJECT_QUEST_ITEMS; ++i)
-            data << uint32(info->questItems[i]);            // itemId[6], quest drop
-        data << uint32(0);                                  // go expansion field
-        SendPacket(&data);
-        sLog->outDebug(LOG_FILTER_NETWORKIO, "WORLD: Sent SMSG_GAMEOBJECT_QUERY_RESPONSE");
-    }
-    else
-    {
-        sLog->outDebug(LOG_FILTER_NETWORKIO, "WORLD: CMSG_GAMEOBJECT_QUERY - Missing gameobject info for (GUID: %u, ENTRY: %u)",
-            GUID_LOPART(guid), entry);
-        WorldPacket data (SMSG_GAMEOBJECT_QUERY_RESPONSE, 4);
-        data << uint32(entry | 0x80000000);
-        SendPacket(&data);
-        sLog->outDebug(LOG_FILTER_NETWORKIO, "WORLD: Sent SMSG_GAMEOBJECT_QUERY_RESPONSE");
+        BuildGameObjectQueryResponse(data, entry, info, loc_idx);
+        response = sQueryResponseCache->Store(QUERY_RESPONSE_GAMEOBJECT, entry, loc_idx, data);
     }
+
+    SendPacket(response);
 }
 
 void WorldSession::HandleCorpseQueryOpcode(WorldPacket & /*recv_data*/)
@@ -270,128 +286,136 @@ void WorldSession::HandleCorpseQueryOpcode(WorldPacket & /*recv_data*/)
     SendPacket(&data);
 }
 
-void WorldSession::HandleNpcTextQueryOpcode(WorldPacket & recv_data)
+static void BuildNpcTextUpdate(WorldPacket& data, uint32 textID, GossipText const* pGossip, int loc_idx)
 {
-    uint32 textID;
-    uint64 guid;
-
-    recv_data >> textID;
-    sLog->outDetail("WORLD: CMSG_NPC_TEXT_QUERY ID '%u'", textID);
-
-    recv_data >> guid;
-    GetPlayer()->SetSelection(guid);
-
-    GossipText const* pGossip = sObjectMgr->GetGossipText(textID);
-
-    WorldPacket data(SMSG_NPC_TEXT_UPDATE, 100);          // guess size
-    data << textID;
-
-    if (!pGossip)
+    std::string Text_0[MAX_LOCALES], Text_1[MAX_LOCALES];
+    for (int i = 0; i < MAX_GOSSIP_TEXT_OPTIONS; ++i)
     {
-        for (uint32 i = 0; i < MAX_GOSSIP_TEXT_OPTIONS; ++i)
-        {
-            data << float(0);
-            data << "Greetings $N";
-            data << "Greetings $N";
-            data << uint32(0);
-            data << uint32(0);
-            data << uint32(0);
-            data << uint32(0);
-            data << uint32(0);
-            data << uint32(0);
-            data << uint32(0);
-        }
+        Text_0[i] = pGossip->Options[i].Text_0;
+        Text_1[i] = pGossip->Options[i].Text_1;
     }
-    else
-    {
-        std::string Text_0[MAX_LOCALES], Text_1[MAX_LOCALES];
-        for (int i = 0; i < MAX_GOSSIP_TEXT_OPTIONS; ++i)
-        {
-            Text_0[i] = pGossip->Options[i].Text_0;
-            Text_1[i] = pGossip->Options[i].Text_1;
-        }
 
-        int loc_idx = GetSessionDbLocaleIndex();
-        if (loc_idx >= 0)
+    if (loc_idx >= 0)
+    {
+        if (NpcTextLocale const* nl = sObjectMgr->GetNpcTextLocale(textID))
         {
-            if (NpcTextLocale const* nl = sObjectMgr->GetNpcTextLocale(textID))
+            for (int i = 0; i < MAX_LOCALES; ++i)
             {
-                for (int i = 0; i < MAX_LOCALES; ++i)
-                {
-                    ObjectMgr::GetLocaleString(nl->Text_0[i], loc_idx, Text_0[i]);
-                    ObjectMgr::GetLocaleString(nl->Text_1[i], loc_idx, Text_1[i]);
-                }
+                ObjectMgr::GetLocaleString(nl->Text_0[i], loc_idx, Text_0[i]);
+                ObjectMgr::GetLocaleString(nl->Text_1[i], loc_idx, Text_1[i]);
             }
         }
+    }
+
+    data << textID;
+    for (int i = 0; i < MAX_GOSSIP_TEXT_OPTIONS; ++i)
+    {
+        data << pGossip->Options[i].Probability;
 
-        for (int i = 0; i < MAX_GOSSIP_TEXT_OPTIONS; ++i)
+        if (Text_0[i].empty())
+            data << Text_1[i];
+        else
+            data << Text_0[i];
+
+        if (Text_1[i].empty())
+            data << Text_0[i];
+        else
+            data << Text_1[i];
+
+        data << pGossip->Options[i].Language;
+
+        for (int j = 0; j < MAX_GOSSIP_TEXT_EMOTES; ++j)
         {
-            data << pGossip->Options[i].Probability;
+            data << pGossip->Options[i].Emotes[j]._Delay;
+            data << pGossip->Options[i].Emotes[j]._Emote;
+        }
+    }
+}
 
-            if (Text_0[i].empty())
-                data << Text_1[i];
-            else
-                data << Text_0[i];
+void WorldSession::HandleNpcTextQueryOpcode(WorldPacket & recv_data)
+{
+    uint32 textID;
+    uint64 guid;
 
-            if (Text_1[i].empty())
-                data << Text_0[i];
-            else
-                data << Text_1[i];
+    recv_data >> textID;
+    recv_data >> guid;
+    GetPlayer()->SetSelection(guid);
 
-            data << pGossip->Options[i].Language;
+    int loc_idx = GetSessionDbLocaleIndex();
+    SharedPacket response = sQueryResponseCache->Find(QUERY_RESPONSE_NPC_TEXT, textID, loc_idx);
+    if (response.IsNull())
+    {
+        WorldPacket data(SMSG_NPC_TEXT_UPDATE, 100);        // guess size
 
-            for (int j = 0; j < MAX_GOSSIP_TEXT_EMOTES; ++j)
+        GossipText const* pGossip = sObjectMgr->GetGossipText(textID);
+        if (!pGossip)
+        {
+            data << textID;
+            for (uint32 i = 0; i < MAX_GOSSIP_TEXT_OPTIONS; ++i)
             {
-                data << pGossip->Options[i].Emotes[j]._Delay;
-                data << pGossip->Options[i].Emotes[j]._Emote;
+                data << float(0);
+                data << "Greetings $N";
+                data << "Greetings $N";
+                data << uint32(0);
+                data << uint32(0);
+                data << uint32(0);
+                data << uint32(0);
+                data << uint32(0);
+                data << uint32(0);
+                data << uint32(0);
             }
+            SendPacket(&data);
+            return;
         }
-    }
 
-    SendPacket(&data);
+        BuildNpcTextUpdate(data, textID, pGossip, loc_idx);
+        response = sQueryResponseCache->Store(QUERY_RESPONSE_NPC_TEXT, textID, loc_idx, data);
+    }
 
-    sLog->outDebug(LOG_FILTER_NETWORKIO, "WORLD: Sent SMSG_NPC_TEXT_UPDATE");
+    SendPacket(response);
 }
 
 /// Only _static_ data is sent in this packet !!!
 void WorldSession::HandlePageTextQueryOpcode(WorldPacket & recv_data)
 {
-    sLog->outDetail("WORLD: Received CMSG_PAGE_TEXT_QUERY");
-    recv_data.hexlike();
-
     uint32 pageID;
     recv_data >> pageID;
     recv_data.read_skip<uint64>();                          // guid
 
+    int loc_idx = GetSessionDbLocaleIndex();
     while (pageID)
     {
-        PageText const* pageText = sObjectMgr->GetPageText(pageID);
+        SharedPacket response = sQueryResponseCache->Find(QUERY_RESPONSE_PAGE_TEXT, pageID, loc_idx);
+        if (response.IsNull())
+        {
+            PageText const* pageText = sObjectMgr->GetPageText(pageID);
                                                             // guess size
-        WorldPacket data(SMSG_PAGE_TEXT_QUERY_RESPONSE, 50);
-        data << pageID;
+            WorldPacket data(SMSG_PAGE_TEXT_QUERY_RESPONSE, 50);
+            data << pageID;
 
-        if (!pageText)
-        {
-            data << "Item page missing.";
-            data << uint32(0);
-            pageID = 0;
-        }
-        else
-        {
-            std::string Text = pageText->Text;
+            if (!pageText)
+            {
+                data << "Item page missing.";
+                data << uint32(0);
+                SendPacket(&data);
+                return;
+            }
 
-            int loc_idx = GetSessionDbLocaleIndex();
+            std::string Text = pageText->Text;
             if (loc_idx >= 0)
-                if (PageTextLocale const* player = sObjectMgr->GetPageTextLocale(pageID))
-                    ObjectMgr::GetLocaleString(player->Text, loc_idx, Text);
+                if (PageTextLocale const* pl = sObjectMgr->GetPageTextLocale(pageID))
+                    ObjectMgr::GetLocaleString(pl->Text, loc_idx, Text);
 
             data << Text;
             data << uint32(pageText->NextPage);
-            pageID = pageText->NextPage;
+            response = sQueryResponseCache->Store(QUERY_RESPONSE_PAGE_TEXT, pageID, loc_idx, data);
         }
-        SendPacket(&data);
 
-        sLog->outDebug(LOG_FILTER_NETWORKIO, "WORLD: Sent SMSG_PAGE_TEXT_QUERY_RESPONSE");
+        SendPacket(response);
+
+        // the next page id closes the cached response
+        WorldPacket const& page = response.GetPacket();
+        pageID = page.read<uint32>(page.size() - sizeof(uint32));
     }
 }
 
@@ -410,6 +434,30 @@ void WorldSession::HandleCorpseMapPositionQuery(WorldPacket & recv_data)
     SendPacket(&data);
 }
 
+static void BuildQuestPOIBlock(ByteBuffer& data, uint32 questId, QuestPOIVector const* POI)
+{
+    data << uint32(questId); // quest ID
+    data << uint32(POI->size()); // POI count
+
+    for (QuestPOIVector::const_iterator itr = POI->begin(); itr != POI->end(); ++itr)
+    {
+        data << uint32(itr->Id);                // POI index
+        data << int32(itr->ObjectiveIndex);     // objective index
+        data << uint32(itr->MapId);             // mapid
+        data << uint32(itr->AreaId);            // areaid
+        data << uint32(itr->Unk2);              // unknown
+        data << uint32(itr->Unk3);              // unknown
+        data << uint32(itr->Unk4);              // unknown
+        data << uint32(itr->points.size());     // POI points count
+
+        for (std::vector<QuestPOIPoint>::const_iterator itr2 = itr->points.begin(); itr2 != itr->points.end(); ++itr2)
+        {
+            data << int32(itr2->x); // POI point x
+            data << int32(itr2->y); // POI point y
+        }
+    }
+}
+
 void WorldSession::HandleQuestPOIQuery(WorldPacket& recv_data)
 {
     uint32 count;
@@ -438,42 +486,27 @@ void WorldSession::HandleQuestPOIQuery(WorldPacket& recv_data)
 
         if (questOk)
         {
-            QuestPOIVector const* POI = sObjectMgr->GetQuestPOIVector(questId);
-
-            if (POI)
+            // the POI block only depends on the quest, it is cached without locale
+            SharedPacket block = sQueryResponseCache->Find(QUERY_RESPONSE_QUEST_POI, questId, -1);
+            if (block.IsNull())
             {
-                data << uint32(questId); // quest ID
-                data << uint32(POI->size()); // POI count
-
-                for (QuestPOIVector::const_iterator itr = POI->begin(); itr != POI->end(); ++itr)
+                if (QuestPOIVector const* POI = sObjectMgr->GetQuestPOIVector(questId))
                 {
-                    data << uint32(itr->Id);                // POI index
-                    data << int32(itr->ObjectiveIndex);     // objective index
-                    data << uint32(itr->MapId);             // mapid
-                    data << uint32(itr->AreaId);            // areaid
-                    data << uint32(itr->Unk2);              // unknown
-                    data << uint32(itr->Unk3);              // unknown
-                    data << uint32(itr->Unk4);              // unknown
-                    data << uint32(itr->points.size());     // POI points count
-
-                    for (std::vector<QuestPOIPoint>::const_iterator itr2 = itr->points.begin(); itr2 != itr->points.end(); ++itr2)
-                    {
-                        data << int32(itr2->x); // POI point x
-                        data << int32(itr2->y); // POI point y
-                    }
+                    WorldPacket blockData(SMSG_QUEST_POI_QUERY_RESPONSE, 4+4+POI->size()*(8*4+2*4));
+                    BuildQuestPOIBlock(blockData, questId, POI);
+                    block = sQueryResponseCache->Store(QUERY_RESPONSE_QUEST_POI, questId, -1, blockData);
                 }
             }
-            else
+
+            if (!block.IsNull())
             {
-                data << uint32(questId); // quest ID
-                data << uint32(0); // POI count
+                data.append(block.GetPacket());
+                continue;
             }
         }
-        else
-        {
-            data << uint32(questId); // quest ID
-            data << uint32(0); // POI count
-        }
+
+        data << uint32(questId); // quest ID
+        data << uint32(0); // POI count
     }
 
     SendPacket(&data);
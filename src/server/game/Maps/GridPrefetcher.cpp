@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ * Copyright (C) 2008-2012 TrinityCore <http://www.trinitycore.org/>
+ * Copyright (C) 2005-2012 MaNGOS <http://getmangos.com/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "GridPrefetcher.h"
+#include "Map.h"
+#include "World.h"
+#include "Log.h"
+#include "Timer.h"
+#include "VMapFactory.h"
+
+#include <ace/OS_NS_sys_time.h>
+
+// prefetched grids nobody asked for are dropped after this time
+#define GRID_PREFETCH_EXPIRY    (60 * IN_MILLISECONDS)
+
+GridPrefetcher::GridPrefetcher() : _enabled(false), _condition(_lock), _hits(0), _misses(0), _expired(0), _stallTime(0)
+{
+}
+
+GridPrefetcher::~GridPrefetcher()
+{
+}
+
+void GridPrefetcher::Initialize()
+{
+    if (_enabled || !sWorld->getBoolConfig(CONFIG_GRID_PREFETCH))
+        return;
+
+    _enabled = true;
+    if (ACE_Task_Base::activate(THR_NEW_LWP | THR_JOINABLE | THR_INHERIT_SCHED, 1) == -1)
+    {
+        sLog->outError("GridPrefetcher: could not start the prefetch thread, grids are loaded synchronously.");
+        _enabled = false;
+    }
+}
+
+void GridPrefetcher::Unload()
+{
+    if (!_enabled)
+        return;
+
+    {
+        TRINITY_GUARD(ACE_Thread_Mutex, _lock);
+        _enabled = false;
+        _condition.broadcast();
+    }
+
+    ACE_Task_Base::wait();
+
+    TRINITY_GUARD(ACE_Thread_Mutex, _lock);
+    for (PrefetchedGridMap::iterator itr = _ready.begin(); itr != _ready.end(); ++itr)
+        Drop(itr->second, itr->first);
+
+    _ready.clear();
+    _requests.clear();
+    _pending.clear();
+}
+
+void GridPrefetcher::Prefetch(uint32 mapId, int gx, int gy)
+{
+    uint32 key = MakeKey(mapId, gx, gy);
+
+    TRINITY_GUARD(ACE_Thread_Mutex, _lock);
+    if (!_enabled || _pending.count(key) || _ready.count(key))
+        return;
+
+    _pending.insert(key);
+    _requests.push_back(key);
+    _condition.signal();
+}
+
+bool GridPrefetcher::IsReady(uint32 mapId, int gx, int gy)
+{
+    TRINITY_GUARD(ACE_Thread_Mutex, _lock);
+    return _ready.count(MakeKey(mapId, gx, gy)) != 0;
+}
+
+GridMap* GridPrefetcher::TakeGridMap(uint32 mapId, int gx, int gy)
+{
+    if (!_enabled)
+        return NULL;
+
+    TRINITY_GUARD(ACE_Thread_Mutex, _lock);
+    PrefetchedGridMap::iterator itr = _ready.find(MakeKey(mapId, gx, gy));
+    if (itr == _ready.end())
+    {
+        ++_misses;
+        return NULL;
+    }
+
+    // vmap models are handed over to the tile by VMapManager2::loadMap, the GridMap
+    // may be NULL when the .map file is missing, LoadMap reports that itself
+    GridMap* gridMap = itr->second.gridMap;
+    _ready.erase(itr);
+    ++_hits;
+    return gridMap;
+}
+
+void GridPrefetcher::AddStallTime(uint32 diff)
+{
+    TRINITY_GUARD(ACE_Thread_Mutex, _lock);
+    _stallTime += diff;
+}
+
+int GridPrefetcher::svc()
+{
+    for (;;)
+    {
+        uint32 key;
+        {
+            TRINITY_GUARD(ACE_Thread_Mutex, _lock);
+            if (_requests.empty() && _enabled)
+            {
+                // wake up once a second to expire unused grids
+                ACE_Time_Value timeout = ACE_OS::gettimeofday() + ACE_Time_Value(1);
+                _condition.wait(&timeout);
+            }
+
+            if (!_enabled)
+                break;
+
+            ExpireReady();
+
+            if (_requests.empty())
+                continue;
+
+            key = _requests.front();
+            _requests.pop_front();
+        }
+
+        Load(key);
+    }
+
+    return 0;
+}
+
+void GridPrefetcher::Load(uint32 key)
+{
+    uint32 mapId = key >> 12;
+    int gx = (key >> 6) & 0x3F;
+    int gy = key & 0x3F;
+
+    PrefetchedGrid grid;
+
+    int len = sWorld->GetDataPath().length() + strlen("maps/%03u%02u%02u.map") + 1;
+    char* tmp = new char[len];
+    snprintf(tmp, len, (char *)(sWorld->GetDataPath() + "maps/%03u%02u%02u.map").c_str(), mapId, gx, gy);
+
+    grid.gridMap = new GridMap();
+    if (!grid.gridMap->loadData(tmp))
+    {
+        // leave the error reporting to the synchronous load
+        delete grid.gridMap;
+        grid.gridMap = NULL;
+    }
+    delete [] tmp;
+
+    if (VMAP::IVMapManager* vmgr = VMAP::VMapFactory::createOrGetVMapManager())
+        grid.vmapPrefetched = vmgr->prefetchMapTile((sWorld->GetDataPath() + "vmaps").c_str(), mapId, gx, gy);
+
+    grid.readyTime = getMSTime();
+
+    TRINITY_GUARD(ACE_Thread_Mutex, _lock);
+    _pending.erase(key);
+    _ready[key] = grid;
+}
+
+void GridPrefetcher::Drop(PrefetchedGrid& grid, uint32 key)
+{
+    delete grid.gridMap;
+    grid.gridMap = NULL;
+
+    if (grid.vmapPrefetched)
+        VMAP::VMapFactory::createOrGetVMapManager()->releasePrefetchedTile(key >> 12, (key >> 6) & 0x3F, key & 0x3F);
+}
+
+void GridPrefetcher::ExpireReady()
+{
+    for (PrefetchedGridMap::iterator itr = _ready.begin(); itr != _ready.end();)
+    {
+        if (GetMSTimeDiffToNow(itr->second.readyTime) < GRID_PREFETCH_EXPIRY)
+        {
+            ++itr;
+            continue;
+        }
+
+        Drop(itr->second, itr->first);
+        _ready.erase(itr++);
+        ++_expired;
+    }
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ * Copyright (C) 2008-2012 TrinityCore <http://www.trinitycore.org/>
+ * Copyright (C) 2005-2012 MaNGOS <http://getmangos.com/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TRINITY_GRIDPREFETCHER_H
+#define TRINITY_GRIDPREFETCHER_H
+
+#include "Define.h"
+#include <ace/Singleton.h>
+#include <ace/Task.h>
+#include <ace/Thread_Mutex.h>
+#include <ace/Condition_Thread_Mutex.h>
+
+#include <deque>
+#include <map>
+#include <set>
+
+class GridMap;
+
+// Loads the terrain (.map file) and vmap models of grids in a background thread before
+// the map thread needs them. Maps request the grids ahead of moving players and publish
+// finished ones at the start of Map::Update, Map::LoadMap then picks up the prepared GridMap.
+// Spawns are still created by ObjectGridLoader on the map thread.
+class GridPrefetcher : protected ACE_Task_Base
+{
+    friend class ACE_Singleton<GridPrefetcher, ACE_Thread_Mutex>;
+
+    public:
+        void Initialize();
+        void Unload();
+
+        bool IsEnabled() const { return _enabled; }
+
+        // coordinates are GridMaps coordinates, not NGrid ones
+        void Prefetch(uint32 mapId, int gx, int gy);
+        bool IsReady(uint32 mapId, int gx, int gy);
+        // hands over a prefetched GridMap to the caller, NULL if the grid was not prefetched
+        GridMap* TakeGridMap(uint32 mapId, int gx, int gy);
+
+        // time the map threads spent loading grids synchronously
+        void AddStallTime(uint32 diff);
+
+        uint32 GetHits() const { return _hits; }
+        uint32 GetMisses() const { return _misses; }
+        uint32 GetExpired() const { return _expired; }
+        uint32 GetStallTime() const { return _stallTime; }
+
+    protected:
+        virtual int svc();
+
+    private:
+        GridPrefetcher();
+        ~GridPrefetcher();
+
+        struct PrefetchedGrid
+        {
+            PrefetchedGrid() : gridMap(NULL), vmapPrefetched(false), readyTime(0) { }
+
+            GridMap* gridMap;
+            bool vmapPrefetched;
+            uint32 readyTime;
+        };
+
+        typedef std::map<uint32, PrefetchedGrid> PrefetchedGridMap;
+
+        static uint32 MakeKey(uint32 mapId, int gx, int gy) { return (mapId << 12) | (uint32(gx) << 6) | uint32(gy); }
+
+        void Load(uint32 key);
+        void Drop(PrefetchedGrid& grid, uint32 key);
+        void ExpireReady();
+
+        bool _enabled;
+        ACE_Thread_Mutex _lock;
+        ACE_Condition_Thread_Mutex _condition;
+        std::deque<uint32> _requests;
+        std::set<uint32> _pending;                          // queued or loading
+        PrefetchedGridMap _ready;
+
+        uint32 _hits;
+        uint32 _misses;
+        uint32 _expired;
+        uint32 _stallTime;
+};
+
+#define sGridPrefetcher ACE_Singleton<GridPrefetcher, ACE_Thread_Mutex>::instance()
+
+#endif
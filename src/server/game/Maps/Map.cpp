@@ -21,6 +21,7 @@
 #include "GridStates.h"
 #include "ScriptMgr.h"
 #include "VMapFactory.h"
+#include "MMapFactory.h"
 #include "MapInstanced.h"
 #include "CellImpl.h"
 #include "GridNotifiers.h"
@@ -32,6 +33,15 @@
 #include "ObjectMgr.h"
 #include "Group.h"
 #include "LFGMgr.h"
+#include "GridPrefetcher.h"
+#include "SpellAuras.h"
+#include "Vehicle.h"
+#include "PoolMgr.h"
+#include "ZoneScript.h"
+
+#include <ace/Atomic_Op.h>
+#include <ace/Mem_Map.h>
+#include <ace/OS_NS_sys_time.h>
 
 union u_map_magic
 {
@@ -134,6 +144,18 @@ void Map::LoadVMap(int gx, int gy)
     }
 }
 
+void Map::LoadMMap(int gx, int gy)
+{
+    if (!MMAP::MMapFactory::isPathfindingEnabled())
+        return;
+
+    // navmesh tiles use the numbering of the grid map files
+    if (MMAP::MMapFactory::createOrGetMMapManager()->loadMap(sWorld->GetDataPath(), GetId(), gx, gy))
+        sLog->outDetail("MMAP loaded name:%s, id:%d, x:%d, y:%d (mmap rep.: x:%d, y:%d)", GetMapName(), GetId(), gx, gy, gx, gy);
+    else
+        sLog->outDetail("Could not load MMAP name:%s, id:%d, x:%d, y:%d (mmap rep.: x:%d, y:%d)", GetMapName(), GetId(), gx, gy, gx, gy);
+}
+
 void Map::LoadMap(int gx, int gy, bool reload)
 {
     if (i_InstanceId != 0)
@@ -163,6 +185,18 @@ void Map::LoadMap(int gx, int gy, bool reload)
         GridMaps[gx][gy]=NULL;
     }
 
+    // terrain loaded in advance by the grid prefetcher
+    if (!reload)
+    {
+        if (GridMap* gridMap = sGridPrefetcher->TakeGridMap(GetId(), gx, gy))
+        {
+            sLog->outDetail("Using prefetched map %03u%02u%02u", GetId(), gx, gy);
+            GridMaps[gx][gy] = gridMap;
+            sScriptMgr->OnLoadGridMap(this, GridMaps[gx][gy], gx, gy);
+            return;
+        }
+    }
+
     // map file name
     char *tmp=NULL;
     int len = sWorld->GetDataPath().length()+strlen("maps/%03u%02u%02u.map")+1;
@@ -184,7 +218,10 @@ void Map::LoadMapAndVMap(int gx, int gy)
 {
     LoadMap(gx, gy);
     if (i_InstanceId == 0)
+    {
         LoadVMap(gx, gy);                                   // Only load the data for the base map
+        LoadMMap(gx, gy);
+    }
 }
 
 void Map::InitStateMachine()
@@ -208,7 +245,9 @@ _creatureToMoveLock(false), i_mapEntry (sMapStore.LookupEntry(id)), i_spawnMode(
 m_unloadTimer(0), m_VisibleDistance(DEFAULT_VISIBILITY_DISTANCE),
 m_VisibilityNotifyPeriod(DEFAULT_VISIBILITY_NOTIFY_PERIOD),
 m_activeNonPlayersIter(m_activeNonPlayers.end()), i_gridExpiry(expiry),
-i_scriptLock(false)
+i_scriptLock(false), _updateTime(0), _averageUpdateTime(0), _relocationNotifyCount(0), _relocationNotifyTime(0),
+_gridRegionNext(0), _gridRegionEnd(0), _gridRegionPending(0), _gridRegionCount(0), _gridRegionDiff(0),
+_gridRegionCondition(_gridRegionLock), _parallelUpdate(false)
 {
     m_parentMap = (_parent ? _parent : this);
     for (unsigned int idx=0; idx < MAX_NUMBER_OF_GRIDS; ++idx)
@@ -302,7 +341,7 @@ template<>
 void Map::DeleteFromWorld(Player* player)
 {
     sObjectAccessor->RemoveObject(player);
-    sObjectAccessor->RemoveUpdateObject(player); //TODO: I do not know why we need this, it should be removed in ~Object anyway
+    player->ClearUpdateMask(true); //TODO: I do not know why we need this, it should be removed in ~Object anyway
     delete player;
 }
 
@@ -312,6 +351,15 @@ void Map::EnsureGridCreated(const GridCoord &p)
 {
     if (!getNGrid(p.x_coord, p.y_coord))
     {
+        // the grid links itself to the map and loads the terrain, a grid region leaves that to the serial phase
+        // and does without the terrain of the grid for this tick, every GetGrid caller copes with NULL
+        if (_parallelUpdate)
+        {
+            TRINITY_GUARD(ACE_Thread_Mutex, _deferredLock);
+            _gridsToCreate.push_back(p);
+            return;
+        }
+
         TRINITY_GUARD(ACE_Thread_Mutex, Lock);
         if (!getNGrid(p.x_coord, p.y_coord))
         {
@@ -330,7 +378,12 @@ void Map::EnsureGridCreated(const GridCoord &p)
             int gy = (MAX_NUMBER_OF_GRIDS - 1) - p.y_coord;
 
             if (!GridMaps[gx][gy])
+            {
+                uint32 loadStartTime = getMSTime();
                 LoadMapAndVMap(gx, gy);
+                if (sGridPrefetcher->IsEnabled())
+                    sGridPrefetcher->AddStallTime(GetMSTimeDiffToNow(loadStartTime));
+            }
         }
     }
 }
@@ -354,6 +407,18 @@ void Map::EnsureGridLoadedForActiveObject(const Cell &cell, WorldObject* object)
 //Create NGrid and load the object data in it
 bool Map::EnsureGridLoaded(const Cell &cell)
 {
+    // objects loaded now could belong to a region updated by another thread, load them in the deferred phase
+    if (_parallelUpdate)
+    {
+        NGridType* grid = getNGrid(cell.GridX(), cell.GridY());
+        if (!grid || !grid->isGridObjectDataLoaded())
+        {
+            TRINITY_GUARD(ACE_Thread_Mutex, _deferredLock);
+            _gridsToLoad.push_back(cell);
+        }
+        return false;
+    }
+
     EnsureGridCreated(GridCoord(cell.GridX(), cell.GridY()));
     NGridType *grid = getNGrid(cell.GridX(), cell.GridY());
 
@@ -362,6 +427,8 @@ bool Map::EnsureGridLoaded(const Cell &cell)
     {
         sLog->outDebug(LOG_FILTER_MAPS, "Loading grid[%u, %u] for map %u instance %u", cell.GridX(), cell.GridY(), GetId(), i_InstanceId);
 
+        uint32 loadStartTime = getMSTime();
+
         setGridObjectDataLoaded(true, cell.GridX(), cell.GridY());
 
         ObjectGridLoader loader(*grid, this, cell);
@@ -369,6 +436,9 @@ bool Map::EnsureGridLoaded(const Cell &cell)
 
         // Add resurrectable corpses to world object list in grid
         sObjectAccessor->AddCorpsesToGrid(GridCoord(cell.GridX(), cell.GridY()), grid->GetGridType(cell.CellX(), cell.CellY()), this);
+
+        if (sGridPrefetcher->IsEnabled())
+            sGridPrefetcher->AddStallTime(GetMSTimeDiffToNow(loadStartTime));
         return true;
     }
 
@@ -419,9 +489,32 @@ void Map::InitializeObject(Creature* obj)
     obj->_moveState = CREATURE_CELL_MOVE_NONE;
 }
 
+template<class T>
+void Map::InitializeDeferredObject(T* /*obj*/)
+{
+}
+
+template<>
+void Map::InitializeDeferredObject(Creature* obj)
+{
+    // scripts command their summons right after summoning them
+    if (!obj->IsInWorld())
+        obj->AIM_InitializeBeforeAdd();
+}
+
 template<class T>
 bool Map::AddToMap(T *obj)
 {
+    // objects spawned by a grid region enter the map once all regions are done
+    if (_parallelUpdate)
+    {
+        InitializeDeferredObject(obj);
+
+        TRINITY_GUARD(ACE_Thread_Mutex, _deferredLock);
+        _objectsToAdd.push_back(obj);
+        return true;
+    }
+
     //TODO: Needs clean up. An object should not be added to map twice.
     if (obj->IsInWorld())
     {
@@ -464,6 +557,28 @@ bool Map::AddToMap(T *obj)
     return true;
 }
 
+void Map::SearchCellIndexes(CellObjectIndexQuery const& query, CellObjectIndex::ObjectList& result) const
+{
+    CellCoord standing = Trinity::ComputeCellCoord(query.x, query.y);
+    if (!standing.IsCoordValid())
+        return;
+
+    // same bounds as Cell::Visit, only loaded grids are searched
+    CellArea area = Cell::CalculateCellArea(query.x, query.y, std::min(query.radius, float(SIZE_OF_GRIDS)));
+    for (uint32 x = area.low_bound.x_coord; x <= area.high_bound.x_coord; ++x)
+    {
+        for (uint32 y = area.low_bound.y_coord; y <= area.high_bound.y_coord; ++y)
+        {
+            Cell cell(CellCoord(x, y));
+            NGridType* grid = getNGrid(cell.GridX(), cell.GridY());
+            if (!grid || !grid->isGridObjectDataLoaded())
+                continue;
+
+            grid->GetGridType(cell.CellX(), cell.CellY()).GetObjectIndex().Search(query, result);
+        }
+    }
+}
+
 bool Map::IsGridLoaded(const GridCoord &p) const
 {
     return (getNGrid(p.x_coord, p.y_coord) && isGridObjectDataLoaded(p.x_coord, p.y_coord));
@@ -497,8 +612,479 @@ void Map::VisitNearbyCellsOf(WorldObject* obj, TypeContainerVisitor<Trinity::Obj
     }
 }
 
+bool Map::CanUpdateGridRegions() const
+{
+    // instances are small enough, they are spread over the map updater threads as a whole
+    if (Instanceable() || !sWorld->getBoolConfig(CONFIG_MAP_PARALLEL_GRID_UPDATE))
+        return false;
+
+    return sWorld->getIntConfig(CONFIG_NUMTHREADS) > 1 && sMapMgr->GetMapUpdater()->activated();
+}
+
+void Map::MarkNearbyCellsOf(WorldObject* obj)
+{
+    if (!obj->IsPositionValid())
+        return;
+
+    CellArea area = Cell::CalculateCellArea(obj->GetPositionX(), obj->GetPositionY(), obj->GetGridActivationRange());
+
+    for (uint32 x = area.low_bound.x_coord; x <= area.high_bound.x_coord; ++x)
+    {
+        for (uint32 y = area.low_bound.y_coord; y <= area.high_bound.y_coord; ++y)
+        {
+            uint32 cell_id = (y * TOTAL_NUMBER_OF_CELLS_PER_MAP) + x;
+            if (isCellMarked(cell_id))
+                continue;
+
+            markCell(cell_id);
+            CellCoord pair(x, y);
+            // grids are loaded here, never from inside the region update
+            EnsureGridLoaded(Cell(pair));
+            _markedCells.push_back(pair);
+        }
+    }
+}
+
+// regions of the same phase have two whole grids between them
+static inline uint32 GetGridRegionPhase(CellCoord const& p)
+{
+    return ((p.x_coord / MAX_NUMBER_OF_CELLS) % 3) + ((p.y_coord / MAX_NUMBER_OF_CELLS) % 3) * 3;
+}
+
+static inline uint32 GetGridRegionId(CellCoord const& p)
+{
+    return (p.x_coord / MAX_NUMBER_OF_CELLS) * MAX_NUMBER_OF_GRIDS + p.y_coord / MAX_NUMBER_OF_CELLS;
+}
+
+static inline uint32 GetGridRegionId(WorldObject const* obj)
+{
+    return GetGridRegionId(Trinity::ComputeCellCoord(obj->GetPositionX(), obj->GetPositionY()));
+}
+
+/*
+    What a region update may touch:
+    - anything within one grid of its own grid. Searches are limited to SIZE_OF_GRIDS (Cell::Visit)
+      and regions of a phase are two grids apart, so no two regions reach the same object by range.
+    - objects it is linked to (victim, attackers, threat and hostile references, owner, charm,
+      minions, summons, vehicle, auras cast on or by it, dynamic object caster, game object owner)
+      only if they are in its own grid. An object linked to anything in another grid, e.g. a DoT
+      whose caster flew more than a grid away, is updated alone after all regions.
+    - players through a unit it fights only if the player is in its own grid and has no group, kill
+      credit and loot go to the player and its group. Units a group has the loot of wait as well.
+    - map-wide lists only through _deferredLock, see AddObjectToRemoveList and friends. Adding
+      objects, grid creation and loading, pools and zone scripts wait for the serial phase, see
+      ProcessDeferredActions. Instance maps and their scripts are never split into regions.
+    Players are updated before the regions, session handlers before that.
+*/
+class GridRegionLinkCheck
+{
+    public:
+        GridRegionLinkCheck(uint32 region, std::vector<WorldObject*>& deferred) : i_region(region), i_deferred(deferred) { }
+
+        void Visit(CreatureMapType& m)
+        {
+            for (CreatureMapType::iterator itr = m.begin(); itr != m.end(); ++itr)
+                if (!HasLocalLinksOnly(itr->getSource()))
+                    Defer(itr->getSource());
+        }
+
+        void Visit(GameObjectMapType& m)
+        {
+            for (GameObjectMapType::iterator itr = m.begin(); itr != m.end(); ++itr)
+                if (!IsLocal(itr->getSource(), itr->getSource()->GetOwnerGUID()))
+                    Defer(itr->getSource());
+        }
+
+        void Visit(DynamicObjectMapType& m)
+        {
+            for (DynamicObjectMapType::iterator itr = m.begin(); itr != m.end(); ++itr)
+                if (!IsLocal(itr->getSource()->GetCaster()))
+                    Defer(itr->getSource());
+        }
+
+        template<class T> void Visit(GridRefManager<T>&) { }
+
+    private:
+        void Defer(WorldObject* obj)
+        {
+            if (obj->IsInWorld() && !obj->HasDeferredUpdate())
+            {
+                obj->SetDeferredUpdate(true);
+                i_deferred.push_back(obj);
+            }
+        }
+
+        bool IsLocal(WorldObject const* other) const
+        {
+            return !other || GetGridRegionId(other) == i_region;
+        }
+
+        bool IsLocal(WorldObject const* obj, uint64 guid) const
+        {
+            return !guid || IsLocal(ObjectAccessor::GetUnit(*obj, guid));
+        }
+
+        // a kill rewards the player controlling the killer and its group
+        bool IsLocalOpponent(Unit const* other) const
+        {
+            if (!other)
+                return true;
+
+            if (!IsLocal(other))
+                return false;
+
+            Player const* player = other->GetCharmerOrOwnerPlayerOrPlayerItself();
+            return !player || (IsLocal(player) && !player->GetGroup());
+        }
+
+        bool HasLocalLinksOnly(Unit* unit) const
+        {
+            if (!IsLocalOpponent(unit->getVictim()))
+                return false;
+
+            for (Unit::AttackerSet::const_iterator itr = unit->getAttackers().begin(); itr != unit->getAttackers().end(); ++itr)
+                if (!IsLocalOpponent(*itr))
+                    return false;
+
+            std::list<HostileReference*> const& threatList = unit->getThreatManager().getThreatList();
+            for (std::list<HostileReference*>::const_iterator itr = threatList.begin(); itr != threatList.end(); ++itr)
+                if (!IsLocalOpponent((*itr)->getTarget()))
+                    return false;
+
+            std::list<HostileReference*> const& offlineList = unit->getThreatManager().getOfflieThreatList();
+            for (std::list<HostileReference*>::const_iterator itr = offlineList.begin(); itr != offlineList.end(); ++itr)
+                if (!IsLocalOpponent((*itr)->getTarget()))
+                    return false;
+
+            if (Creature* creature = unit->ToCreature())
+                if (creature->hasLootRecipient() && creature->GetLootRecipientGroup())
+                    return false;
+
+            for (HostileReference* ref = unit->getHostileRefManager().getFirst(); ref; ref = ref->next())
+                if (!IsLocal(ref->getSource()->getOwner()))
+                    return false;
+
+            if (!IsLocal(unit, unit->GetOwnerGUID()) || !IsLocal(unit, unit->GetCharmerGUID()) ||
+                !IsLocal(unit, unit->GetCharmGUID()) || !IsLocal(unit, unit->GetMinionGUID()))
+                return false;
+
+            for (Unit::ControlList::const_iterator itr = unit->m_Controlled.begin(); itr != unit->m_Controlled.end(); ++itr)
+                if (!IsLocal(*itr))
+                    return false;
+
+            for (uint8 i = 0; i < MAX_SUMMON_SLOT; ++i)
+                if (!IsLocal(unit, unit->m_SummonSlot[i]))
+                    return false;
+
+            if (!IsLocal(unit->GetVehicleBase()))
+                return false;
+
+            if (Vehicle* vehicle = unit->GetVehicleKit())
+                for (SeatMap::const_iterator itr = vehicle->Seats.begin(); itr != vehicle->Seats.end(); ++itr)
+                    if (!IsLocal(unit, itr->second.Passenger))
+                        return false;
+
+            Unit::AuraApplicationMap const& applied = unit->GetAppliedAuras();
+            for (Unit::AuraApplicationMap::const_iterator itr = applied.begin(); itr != applied.end(); ++itr)
+            {
+                uint64 casterGuid = itr->second->GetBase()->GetCasterGUID();
+                if (casterGuid != unit->GetGUID() && !IsLocal(unit, casterGuid))
+                    return false;
+            }
+
+            Unit::AuraMap& owned = unit->GetOwnedAuras();
+            for (Unit::AuraMap::iterator itr = owned.begin(); itr != owned.end(); ++itr)
+            {
+                Aura::ApplicationMap const& targets = itr->second->GetApplicationMap();
+                for (Aura::ApplicationMap::const_iterator target = targets.begin(); target != targets.end(); ++target)
+                    if (!IsLocal(target->second->GetTarget()))
+                        return false;
+            }
+
+            return true;
+        }
+
+        uint32 i_region;
+        std::vector<WorldObject*>& i_deferred;
+};
+
+struct GridRegionOrder
+{
+    bool operator()(CellCoord const& a, CellCoord const& b) const
+    {
+        uint32 phaseA = GetGridRegionPhase(a), phaseB = GetGridRegionPhase(b);
+        if (phaseA != phaseB)
+            return phaseA < phaseB;
+
+        return GetGridRegionId(a) < GetGridRegionId(b);
+    }
+};
+
+void Map::UpdateGridRegions(const uint32 t_diff)
+{
+    std::sort(_markedCells.begin(), _markedCells.end(), GridRegionOrder());
+
+    _gridRegions.clear();
+    for (size_t i = 0; i < _markedCells.size(); ++i)
+        if (!i || GetGridRegionId(_markedCells[i]) != GetGridRegionId(_markedCells[i - 1]))
+            _gridRegions.push_back(i);
+
+    size_t regionCount = _gridRegions.size();
+    _gridRegions.push_back(_markedCells.size());
+    _gridRegionCount = uint32(regionCount);
+    _gridRegionDiff = t_diff;
+
+    size_t helpers = sWorld->getIntConfig(CONFIG_NUMTHREADS) - 1;
+
+    // objects linked to other grids wait until all regions are done
+    _gridRegionDeferred.clear();
+    for (size_t region = 0; region < regionCount; ++region)
+    {
+        GridRegionLinkCheck check(GetGridRegionId(_markedCells[_gridRegions[region]]), _gridRegionDeferred);
+        TypeContainerVisitor<GridRegionLinkCheck, GridTypeMapContainer> gridCheck(check);
+        TypeContainerVisitor<GridRegionLinkCheck, WorldTypeMapContainer> worldCheck(check);
+        for (size_t i = _gridRegions[region]; i < _gridRegions[region + 1]; ++i)
+        {
+            Cell cell(_markedCells[i]);
+            Visit(cell, gridCheck);
+            Visit(cell, worldCheck);
+        }
+    }
+
+    // scripts started by creatures are executed in Map::Update after the regions are done
+    i_scriptLock = true;
+    _parallelUpdate = true;
+
+    for (size_t phaseBegin = 0; phaseBegin < regionCount;)
+    {
+        uint32 phase = GetGridRegionPhase(_markedCells[_gridRegions[phaseBegin]]);
+        size_t phaseEnd = phaseBegin + 1;
+        while (phaseEnd < regionCount && GetGridRegionPhase(_markedCells[_gridRegions[phaseEnd]]) == phase)
+            ++phaseEnd;
+
+        {
+            TRINITY_GUARD(ACE_Thread_Mutex, _gridRegionLock);
+            _gridRegionNext = phaseBegin;
+            _gridRegionEnd = phaseEnd;
+            _gridRegionPending = phaseEnd - phaseBegin;
+        }
+
+        // this thread takes a share of the regions too, so no helper is needed for the last one
+        for (size_t i = 1; i < phaseEnd - phaseBegin && i <= helpers; ++i)
+            sMapMgr->GetMapUpdater()->schedule_region_update(*this);
+
+        ProcessGridRegions();
+
+        {
+            TRINITY_GUARD(ACE_Thread_Mutex, _gridRegionLock);
+            while (_gridRegionPending > 0)
+                _gridRegionCondition.wait();
+        }
+
+        phaseBegin = phaseEnd;
+    }
+
+    _parallelUpdate = false;
+
+    ProcessDeferredActions();
+
+    // removal is deferred as well, so the objects are still there
+    for (std::vector<WorldObject*>::const_iterator itr = _gridRegionDeferred.begin(); itr != _gridRegionDeferred.end(); ++itr)
+    {
+        (*itr)->SetDeferredUpdate(false);
+        if ((*itr)->IsInWorld())
+            (*itr)->Update(t_diff);
+    }
+
+    i_scriptLock = false;
+
+    LoadDeferredGrids();
+}
+
+void Map::ProcessGridRegions()
+{
+    Trinity::ObjectUpdater updater(_gridRegionDiff);
+    TypeContainerVisitor<Trinity::ObjectUpdater, GridTypeMapContainer  > grid_object_update(updater);
+    TypeContainerVisitor<Trinity::ObjectUpdater, WorldTypeMapContainer > world_object_update(updater);
+
+    for (;;)
+    {
+        size_t region;
+        {
+            // helpers scheduled for an earlier phase simply join the current one
+            TRINITY_GUARD(ACE_Thread_Mutex, _gridRegionLock);
+            if (_gridRegionNext >= _gridRegionEnd)
+                return;
+
+            region = _gridRegionNext++;
+        }
+
+        for (size_t i = _gridRegions[region]; i < _gridRegions[region + 1]; ++i)
+        {
+            Cell cell(_markedCells[i]);
+            Visit(cell, grid_object_update);
+            Visit(cell, world_object_update);
+        }
+
+        TRINITY_GUARD(ACE_Thread_Mutex, _gridRegionLock);
+        if (--_gridRegionPending == 0)
+            _gridRegionCondition.broadcast();
+    }
+}
+
+void Map::UpdatePool(Creature* creature, uint32 poolId)
+{
+    if (_parallelUpdate)
+    {
+        TRINITY_GUARD(ACE_Thread_Mutex, _deferredLock);
+        _poolsToUpdate.push_back(DeferredPoolUpdate(TYPEID_UNIT, poolId, creature->GetDBTableGUIDLow()));
+        return;
+    }
+
+    sPoolMgr->UpdatePool<Creature>(poolId, creature->GetDBTableGUIDLow());
+}
+
+void Map::UpdatePool(GameObject* go, uint32 poolId)
+{
+    if (_parallelUpdate)
+    {
+        TRINITY_GUARD(ACE_Thread_Mutex, _deferredLock);
+        _poolsToUpdate.push_back(DeferredPoolUpdate(TYPEID_GAMEOBJECT, poolId, go->GetDBTableGUIDLow()));
+        return;
+    }
+
+    sPoolMgr->UpdatePool<GameObject>(poolId, go->GetDBTableGUIDLow());
+}
+
+void Map::ProcessZoneScriptEvent(ZoneScript* zoneScript, WorldObject* target, uint32 eventId)
+{
+    // zone scripts (outdoor PvP, battlefields) are shared by the whole zone, instance maps are never split into regions
+    if (_parallelUpdate)
+    {
+        TRINITY_GUARD(ACE_Thread_Mutex, _deferredLock);
+        _zoneScriptEvents.push_back(DeferredZoneScriptEvent(zoneScript, target, eventId));
+        return;
+    }
+
+    zoneScript->ProcessEvent(target, eventId);
+}
+
+// Everything the grid regions left to the serial phase, in the order it was queued. Objects removed meanwhile
+// are still there, removal waits for the end of the map update.
+void Map::ProcessDeferredActions()
+{
+    for (size_t i = 0; i < _gridsToCreate.size(); ++i)
+        EnsureGridCreated(_gridsToCreate[i]);
+    _gridsToCreate.clear();
+
+    for (size_t i = 0; i < _objectsToAdd.size(); ++i)
+    {
+        WorldObject* obj = _objectsToAdd[i];
+        switch (obj->GetTypeId())
+        {
+            case TYPEID_UNIT:
+                AddToMap(obj->ToCreature());
+                break;
+            case TYPEID_GAMEOBJECT:
+                AddToMap((GameObject*)obj);
+                break;
+            case TYPEID_DYNAMICOBJECT:
+                AddToMap((DynamicObject*)obj);
+                break;
+            case TYPEID_CORPSE:
+                AddToMap((Corpse*)obj);
+                break;
+            default:
+                break;
+        }
+    }
+    _objectsToAdd.clear();
+
+    for (size_t i = 0; i < _poolsToUpdate.size(); ++i)
+    {
+        DeferredPoolUpdate const& update = _poolsToUpdate[i];
+        if (update.typeId == TYPEID_UNIT)
+            sPoolMgr->UpdatePool<Creature>(update.poolId, update.dbGuid);
+        else
+            sPoolMgr->UpdatePool<GameObject>(update.poolId, update.dbGuid);
+    }
+    _poolsToUpdate.clear();
+
+    for (size_t i = 0; i < _zoneScriptEvents.size(); ++i)
+        _zoneScriptEvents[i].script->ProcessEvent(_zoneScriptEvents[i].target, _zoneScriptEvents[i].eventId);
+    _zoneScriptEvents.clear();
+}
+
+void Map::LoadDeferredGrids()
+{
+    while (!_gridsToLoad.empty())
+    {
+        Cell cell = _gridsToLoad.back();
+        _gridsToLoad.pop_back();
+        EnsureGridLoaded(cell);
+    }
+}
+
+void Map::PrefetchGridsAhead()
+{
+    float lookAhead = float(sWorld->getIntConfig(CONFIG_GRID_PREFETCH_LOOKAHEAD)) / IN_MILLISECONDS;
+
+    for (m_mapRefIter = m_mapRefManager.begin(); m_mapRefIter != m_mapRefManager.end(); ++m_mapRefIter)
+    {
+        Player* player = m_mapRefIter->getSource();
+        if (!player || !player->IsInWorld() || (!player->isMoving() && !player->isInFlight()))
+            continue;
+
+        float distance = player->GetSpeed(player->isInFlight() || player->IsFlying() ? MOVE_FLIGHT : MOVE_RUN) * lookAhead;
+        float angle = player->GetOrientation();
+
+        // predicted positions half way and at the end of the look ahead time
+        for (uint8 step = 1; step <= 2; ++step)
+        {
+            float x = player->GetPositionX() + distance * step / 2 * cos(angle);
+            float y = player->GetPositionY() + distance * step / 2 * sin(angle);
+            if (!Trinity::IsValidMapCoord(x, y))
+                break;
+
+            // every grid the player will see from there
+            float minX = x - GetVisibilityRange(), maxX = x + GetVisibilityRange();
+            float minY = y - GetVisibilityRange(), maxY = y + GetVisibilityRange();
+            Trinity::NormalizeMapCoord(minX);
+            Trinity::NormalizeMapCoord(maxX);
+            Trinity::NormalizeMapCoord(minY);
+            Trinity::NormalizeMapCoord(maxY);
+
+            GridCoord low = Trinity::ComputeGridCoord(minX, minY);
+            GridCoord high = Trinity::ComputeGridCoord(maxX, maxY);
+            for (uint32 gridX = low.x_coord; gridX <= high.x_coord; ++gridX)
+                for (uint32 gridY = low.y_coord; gridY <= high.y_coord; ++gridY)
+                    PrefetchGrid(GridCoord(gridX, gridY));
+        }
+    }
+}
+
+void Map::PrefetchGrid(const GridCoord& p)
+{
+    if (getNGrid(p.x_coord, p.y_coord))
+        return;
+
+    int gx = (MAX_NUMBER_OF_GRIDS - 1) - p.x_coord;
+    int gy = (MAX_NUMBER_OF_GRIDS - 1) - p.y_coord;
+
+    // create the grid from the prefetched data now, while nobody waits for it
+    if (sGridPrefetcher->IsReady(GetId(), gx, gy))
+        EnsureGridCreated(p);
+    else
+        sGridPrefetcher->Prefetch(GetId(), gx, gy);
+}
+
 void Map::Update(const uint32 t_diff)
 {
+    uint32 updateStartTime = getMSTime();
+
+    if (!Instanceable() && sGridPrefetcher->IsEnabled())
+        PrefetchGridsAhead();
+
     /// update worldsessions for existing players
     for (m_mapRefIter = m_mapRefManager.begin(); m_mapRefIter != m_mapRefManager.end(); ++m_mapRefIter)
     {
@@ -514,37 +1100,71 @@ void Map::Update(const uint32 t_diff)
     /// update active cells around players and active objects
     resetMarkedCells();
 
-    Trinity::ObjectUpdater updater(t_diff);
-    // for creature
-    TypeContainerVisitor<Trinity::ObjectUpdater, GridTypeMapContainer  > grid_object_update(updater);
-    // for pets
-    TypeContainerVisitor<Trinity::ObjectUpdater, WorldTypeMapContainer > world_object_update(updater);
-
-    // the player iterator is stored in the map object
-    // to make sure calls to Map::Remove don't invalidate it
-    for (m_mapRefIter = m_mapRefManager.begin(); m_mapRefIter != m_mapRefManager.end(); ++m_mapRefIter)
+    if (CanUpdateGridRegions())
     {
-        Player* player = m_mapRefIter->getSource();
+        // players are updated first, the cells around them are then split into grid regions
+        _markedCells.clear();
+        for (m_mapRefIter = m_mapRefManager.begin(); m_mapRefIter != m_mapRefManager.end(); ++m_mapRefIter)
+        {
+            Player* player = m_mapRefIter->getSource();
 
-        if (!player || !player->IsInWorld())
-            continue;
+            if (!player || !player->IsInWorld())
+                continue;
 
-        // update players at tick
-        player->Update(t_diff);
+            player->Update(t_diff);
 
-        VisitNearbyCellsOf(player, grid_object_update, world_object_update);
-    }
+            MarkNearbyCellsOf(player);
+        }
 
-    // non-player active objects, increasing iterator in the loop in case of object removal
-    for (m_activeNonPlayersIter = m_activeNonPlayers.begin(); m_activeNonPlayersIter != m_activeNonPlayers.end();)
+        for (m_activeNonPlayersIter = m_activeNonPlayers.begin(); m_activeNonPlayersIter != m_activeNonPlayers.end();)
+        {
+            WorldObject* obj = *m_activeNonPlayersIter;
+            ++m_activeNonPlayersIter;
+
+            if (!obj || !obj->IsInWorld())
+                continue;
+
+            MarkNearbyCellsOf(obj);
+        }
+
+        UpdateGridRegions(t_diff);
+    }
+    else
     {
-        WorldObject* obj = *m_activeNonPlayersIter;
-        ++m_activeNonPlayersIter;
+        _gridRegionCount = 0;
 
-        if (!obj || !obj->IsInWorld())
-            continue;
+        Trinity::ObjectUpdater updater(t_diff);
+        // for creature
+        TypeContainerVisitor<Trinity::ObjectUpdater, GridTypeMapContainer  > grid_object_update(updater);
+        // for pets
+        TypeContainerVisitor<Trinity::ObjectUpdater, WorldTypeMapContainer > world_object_update(updater);
+
+        // the player iterator is stored in the map object
+        // to make sure calls to Map::Remove don't invalidate it
+        for (m_mapRefIter = m_mapRefManager.begin(); m_mapRefIter != m_mapRefManager.end(); ++m_mapRefIter)
+        {
+            Player* player = m_mapRefIter->getSource();
+
+            if (!player || !player->IsInWorld())
+                continue;
+
+            // update players at tick
+            player->Update(t_diff);
+
+            VisitNearbyCellsOf(player, grid_object_update, world_object_update);
+        }
+
+        // non-player active objects, increasing iterator in the loop in case of object removal
+        for (m_activeNonPlayersIter = m_activeNonPlayers.begin(); m_activeNonPlayersIter != m_activeNonPlayers.end();)
+        {
+            WorldObject* obj = *m_activeNonPlayersIter;
+            ++m_activeNonPlayersIter;
+
+            if (!obj || !obj->IsInWorld())
+                continue;
 
-        VisitNearbyCellsOf(obj, grid_object_update, world_object_update);
+            VisitNearbyCellsOf(obj, grid_object_update, world_object_update);
+        }
     }
 
     ///- Process necessary scripts
@@ -561,19 +1181,28 @@ void Map::Update(const uint32 t_diff)
         ProcessRelocationNotifies(t_diff);
 
     sScriptMgr->OnMapUpdate(this, t_diff);
+
+    uint32 updateTime = GetMSTimeDiffToNow(updateStartTime);
+    _updateTime = long(updateTime);
+    _averageUpdateTime = long((GetAverageUpdateTime() * 7 + updateTime) / 8);
 }
 
-struct ResetNotifier
+void Map::AddUnitToNotify(Unit* unit)
 {
-    template<class T>inline void resetNotify(GridRefManager<T> &m)
-    {
-        for (typename GridRefManager<T>::iterator iter=m.begin(); iter != m.end(); ++iter)
-            iter->getSource()->ResetAllNotifies();
-    }
-    template<class T> void Visit(GridRefManager<T> &) {}
-    void Visit(CreatureMapType &m) { resetNotify<Creature>(m);}
-    void Visit(PlayerMapType &m) { resetNotify<Player>(m);}
-};
+    TRINITY_GUARD(ACE_Thread_Mutex, _deferredLock);
+    _unitsToNotify.insert(unit);
+}
+
+void Map::RemoveUnitFromNotify(Unit* unit)
+{
+    TRINITY_GUARD(ACE_Thread_Mutex, _deferredLock);
+    _unitsToNotify.erase(unit);
+
+    // a notifier callback may despawn a unit of the batch being processed
+    std::vector<Unit*>::iterator itr = std::find(_unitsNotifying.begin(), _unitsNotifying.end(), unit);
+    if (itr != _unitsNotifying.end())
+        *itr = NULL;
+}
 
 void Map::ProcessRelocationNotifies(const uint32 diff)
 {
@@ -585,38 +1214,50 @@ void Map::ProcessRelocationNotifies(const uint32 diff)
             continue;
 
         grid->getGridInfoRef()->getRelocationTimer().TUpdate(diff);
-        if (!grid->getGridInfoRef()->getRelocationTimer().TPassed())
-            continue;
-
-        uint32 gx = grid->getX(), gy = grid->getY();
+    }
 
-        CellCoord cell_min(gx*MAX_NUMBER_OF_CELLS, gy*MAX_NUMBER_OF_CELLS);
-        CellCoord cell_max(cell_min.x_coord + MAX_NUMBER_OF_CELLS, cell_min.y_coord+MAX_NUMBER_OF_CELLS);
+    ACE_Time_Value start = ACE_OS::gettimeofday();
 
-        for (uint32 x = cell_min.x_coord; x < cell_max.x_coord; ++x)
+    // only the units that moved are visited, those in grids whose relocation timer did not pass yet wait for it
+    {
+        TRINITY_GUARD(ACE_Thread_Mutex, _deferredLock);
+        for (std::set<Unit*>::iterator itr = _unitsToNotify.begin(); itr != _unitsToNotify.end();)
         {
-            for (uint32 y = cell_min.y_coord; y < cell_max.y_coord; ++y)
+            Unit* unit = *itr;
+            if (unit->IsPositionValid())
             {
-                uint32 cell_id = (y * TOTAL_NUMBER_OF_CELLS_PER_MAP) + x;
-                if (!isCellMarked(cell_id))
+                Cell cell(unit->GetPositionX(), unit->GetPositionY());
+                NGridType* grid = getNGrid(cell.GridX(), cell.GridY());
+                if (!grid || grid->GetGridState() != GRID_STATE_ACTIVE || !grid->getGridInfoRef()->getRelocationTimer().TPassed())
+                {
+                    ++itr;
                     continue;
-
-                CellCoord pair(x, y);
-                Cell cell(pair);
-                cell.SetNoCreate();
-
-                Trinity::DelayedUnitRelocation cell_relocation(cell, pair, *this, MAX_VISIBILITY_DISTANCE);
-                TypeContainerVisitor<Trinity::DelayedUnitRelocation, GridTypeMapContainer  > grid_object_relocation(cell_relocation);
-                TypeContainerVisitor<Trinity::DelayedUnitRelocation, WorldTypeMapContainer > world_object_relocation(cell_relocation);
-                Visit(cell, grid_object_relocation);
-                Visit(cell, world_object_relocation);
+                }
             }
+
+            _unitsNotifying.push_back(unit);
+            _unitsToNotify.erase(itr++);
         }
     }
 
-    ResetNotifier reset;
-    TypeContainerVisitor<ResetNotifier, GridTypeMapContainer >  grid_notifier(reset);
-    TypeContainerVisitor<ResetNotifier, WorldTypeMapContainer > world_notifier(reset);
+    // the notifiers skip units that still have to update themselves, so the flags are reset only afterwards;
+    // the AI callbacks may remove units of the batch, RemoveUnitFromNotify clears them from it
+    Trinity::DelayedUnitRelocation relocation(*this, MAX_VISIBILITY_DISTANCE);
+    for (size_t i = 0; i < _unitsNotifying.size(); ++i)
+        if (Unit* unit = _unitsNotifying[i])
+            if (unit->IsPositionValid())
+                relocation.Relocate(unit);
+
+    for (size_t i = 0; i < _unitsNotifying.size(); ++i)
+        if (Unit* unit = _unitsNotifying[i])
+            unit->ResetAllNotifies();
+
+    uint32 notified = uint32(_unitsNotifying.size());
+    {
+        TRINITY_GUARD(ACE_Thread_Mutex, _deferredLock);
+        _unitsNotifying.clear();
+    }
+
     for (GridRefManager<NGridType>::iterator i = GridRefManager<NGridType>::begin(); i != GridRefManager<NGridType>::end(); ++i)
     {
         NGridType *grid = i->getSource();
@@ -624,31 +1265,16 @@ void Map::ProcessRelocationNotifies(const uint32 diff)
         if (grid->GetGridState() != GRID_STATE_ACTIVE)
             continue;
 
-        if (!grid->getGridInfoRef()->getRelocationTimer().TPassed())
-            continue;
-
-        grid->getGridInfoRef()->getRelocationTimer().TReset(diff, m_VisibilityNotifyPeriod);
-
-        uint32 gx = grid->getX(), gy = grid->getY();
-
-        CellCoord cell_min(gx*MAX_NUMBER_OF_CELLS, gy*MAX_NUMBER_OF_CELLS);
-        CellCoord cell_max(cell_min.x_coord + MAX_NUMBER_OF_CELLS, cell_min.y_coord+MAX_NUMBER_OF_CELLS);
-
-        for (uint32 x = cell_min.x_coord; x < cell_max.x_coord; ++x)
-        {
-            for (uint32 y = cell_min.y_coord; y < cell_max.y_coord; ++y)
-            {
-                uint32 cell_id = (y * TOTAL_NUMBER_OF_CELLS_PER_MAP) + x;
-                if (!isCellMarked(cell_id))
-                    continue;
+        if (grid->getGridInfoRef()->getRelocationTimer().TPassed())
+            grid->getGridInfoRef()->getRelocationTimer().TReset(diff, m_VisibilityNotifyPeriod);
+    }
 
-                CellCoord pair(x, y);
-                Cell cell(pair);
-                cell.SetNoCreate();
-                Visit(cell, grid_notifier);
-                Visit(cell, world_notifier);
-            }
-        }
+    if (notified)
+    {
+        ACE_UINT64 usec;
+        (ACE_OS::gettimeofday() - start).to_usec(usec);
+        _relocationNotifyCount = notified;
+        _relocationNotifyTime = uint32(usec);
     }
 }
 
@@ -750,7 +1376,10 @@ void Map::AddCreatureToMoveList(Creature* c, float x, float y, float z, float an
         return;
 
     if (c->_moveState == CREATURE_CELL_MOVE_NONE)
+    {
+        TRINITY_GUARD(ACE_Thread_Mutex, _deferredLock);
         _creaturesToMove.push_back(c);
+    }
     c->SetNewCellPosition(x, y, z, ang);
 }
 
@@ -975,6 +1604,7 @@ bool Map::UnloadGrid(NGridType& ngrid, bool unloadAll)
             }
             // x and y are swapped
             VMAP::VMapFactory::createOrGetVMapManager()->unloadMap(GetId(), gx, gy);
+            MMAP::MMapFactory::createOrGetMMapManager()->unloadMap(GetId(), gx, gy);
         }
         else
             ((MapInstanced*)m_parentMap)->RemoveGridMapReference(GridCoord(gx, gy));
@@ -1018,6 +1648,14 @@ void Map::UnloadAll()
 // *****************************
 // Grid function
 // *****************************
+namespace
+{
+    ACE_Atomic_Op<ACE_Thread_Mutex, long> GridMapLoadedCount;
+    ACE_Atomic_Op<ACE_Thread_Mutex, long> GridMapMappedBytes;
+    ACE_Atomic_Op<ACE_Thread_Mutex, long> GridMapHeapBytes;
+    ACE_Atomic_Op<ACE_Thread_Mutex, long> GridMapLoadTime;
+}
+
 GridMap::GridMap()
 {
     _flags = 0;
@@ -1038,6 +1676,11 @@ GridMap::GridMap()
     _liquidLevel = INVALID_HEIGHT;
     _liquidData = NULL;
     _liquidMap  = NULL;
+    // File mapping
+    _mappedFile = NULL;
+    _mappedSize = 0;
+    _heapSize = 0;
+    _dataLoaded = false;
 }
 
 GridMap::~GridMap()
@@ -1064,29 +1707,44 @@ bool GridMap::loadData(char *filename)
 
     if (header.mapMagic == MapMagic.asUInt && header.versionMagic == MapVersionMagic.asUInt)
     {
+        ACE_Time_Value loadStartTime = ACE_OS::gettimeofday();
+        _dataLoaded = true;
+        ++GridMapLoadedCount;
+
+        if (sWorld->getBoolConfig(CONFIG_GRID_MAP_MMAP))
+        {
+            fclose(in);
+            bool result = loadMappedData(filename);
+            ACE_Time_Value loadTime = ACE_OS::gettimeofday() - loadStartTime;
+            GridMapLoadTime += long(loadTime.sec() * 1000000 + loadTime.usec());
+            return result;
+        }
+
+        bool result = true;
         // loadup area data
         if (header.areaMapOffset && !loadAreaData(in, header.areaMapOffset, header.areaMapSize))
         {
             sLog->outError("Error loading map area data\n");
-            fclose(in);
-            return false;
+            result = false;
         }
         // loadup height data
-        if (header.heightMapOffset && !loadHeihgtData(in, header.heightMapOffset, header.heightMapSize))
+        else if (header.heightMapOffset && !loadHeihgtData(in, header.heightMapOffset, header.heightMapSize))
         {
             sLog->outError("Error loading map height data\n");
-            fclose(in);
-            return false;
+            result = false;
         }
         // loadup liquid data
-        if (header.liquidMapOffset && !loadLiquidData(in, header.liquidMapOffset, header.liquidMapSize))
+        else if (header.liquidMapOffset && !loadLiquidData(in, header.liquidMapOffset, header.liquidMapSize))
         {
             sLog->outError("Error loading map liquids data\n");
-            fclose(in);
-            return false;
+            result = false;
         }
         fclose(in);
-        return true;
+        GridMapHeapBytes += _heapSize;
+
+        ACE_Time_Value loadTime = ACE_OS::gettimeofday() - loadStartTime;
+        GridMapLoadTime += long(loadTime.sec() * 1000000 + loadTime.usec());
+        return result;
     }
     sLog->outError("Map file '%s' is from an incompatible clientversion. Please recreate using the mapextractor.", filename);
     fclose(in);
@@ -1095,17 +1753,37 @@ bool GridMap::loadData(char *filename)
 
 void GridMap::unloadData()
 {
-    delete[] _areaMap;
-    delete[] m_V9;
-    delete[] m_V8;
-    delete[] _liquidData;
-    delete[] _liquidMap;
+    if (!isMappedData(_areaMap))
+        delete[] _areaMap;
+    if (!isMappedData(m_V9))
+        delete[] m_V9;
+    if (!isMappedData(m_V8))
+        delete[] m_V8;
+    if (!isMappedData(_liquidData))
+        delete[] _liquidData;
+    if (!isMappedData(_liquidMap))
+        delete[] _liquidMap;
     _areaMap = NULL;
     m_V9 = NULL;
     m_V8 = NULL;
     _liquidData = NULL;
     _liquidMap  = NULL;
     _gridGetHeight = &GridMap::getHeightFromFlat;
+
+    if (_mappedFile)
+    {
+        _mappedFile->close();
+        delete _mappedFile;
+        _mappedFile = NULL;
+    }
+
+    if (_dataLoaded)
+        --GridMapLoadedCount;
+    _dataLoaded = false;
+    GridMapMappedBytes -= _mappedSize;
+    GridMapHeapBytes -= _heapSize;
+    _mappedSize = 0;
+    _heapSize = 0;
 }
 
 bool GridMap::loadAreaData(FILE* in, uint32 offset, uint32 /*size*/)
@@ -1120,6 +1798,7 @@ bool GridMap::loadAreaData(FILE* in, uint32 offset, uint32 /*size*/)
     if (!(header.flags & MAP_AREA_NO_AREA))
     {
         _areaMap = new uint16 [16*16];
+        _heapSize += sizeof(uint16)*16*16;
         if (fread(_areaMap, sizeof(uint16), 16*16, in) != 16*16)
             return false;
     }
@@ -1141,6 +1820,7 @@ bool GridMap::loadHeihgtData(FILE* in, uint32 offset, uint32 /*size*/)
         {
             m_uint16_V9 = new uint16 [129*129];
             m_uint16_V8 = new uint16 [128*128];
+            _heapSize += sizeof(uint16)*(129*129 + 128*128);
             if (fread(m_uint16_V9, sizeof(uint16), 129*129, in) != 129*129 ||
                 fread(m_uint16_V8, sizeof(uint16), 128*128, in) != 128*128)
                 return false;
@@ -1151,6 +1831,7 @@ bool GridMap::loadHeihgtData(FILE* in, uint32 offset, uint32 /*size*/)
         {
             m_uint8_V9 = new uint8 [129*129];
             m_uint8_V8 = new uint8 [128*128];
+            _heapSize += sizeof(uint8)*(129*129 + 128*128);
             if (fread(m_uint8_V9, sizeof(uint8), 129*129, in) != 129*129 ||
                 fread(m_uint8_V8, sizeof(uint8), 128*128, in) != 128*128)
                 return false;
@@ -1161,6 +1842,7 @@ bool GridMap::loadHeihgtData(FILE* in, uint32 offset, uint32 /*size*/)
         {
             m_V9 = new float [129*129];
             m_V8 = new float [128*128];
+            _heapSize += sizeof(float)*(129*129 + 128*128);
             if (fread(m_V9, sizeof(float), 129*129, in) != 129*129 ||
                 fread(m_V8, sizeof(float), 128*128, in) != 128*128)
                 return false;
@@ -1190,18 +1872,201 @@ bool GridMap::loadLiquidData(FILE* in, uint32 offset, uint32 /*size*/)
     if (!(header.flags & MAP_LIQUID_NO_TYPE))
     {
         _liquidData = new uint8 [16*16];
+        _heapSize += sizeof(uint8)*16*16;
         if (fread(_liquidData, sizeof(uint8), 16*16, in) != 16*16)
             return false;
     }
     if (!(header.flags & MAP_LIQUID_NO_HEIGHT))
     {
         _liquidMap = new float [_liquidWidth * _liquidHeight];
+        _heapSize += sizeof(float)*_liquidWidth*_liquidHeight;
         if (fread(_liquidMap, sizeof(float), _liquidWidth*_liquidHeight, in) != _liquidWidth*_liquidHeight)
             return false;
     }
     return true;
 }
 
+// Maps the whole file read-only, the terrain pages are then shared through the page cache
+// by every map and every process using the same file and are only read in when touched.
+bool GridMap::loadMappedData(char const* filename)
+{
+    _mappedFile = new ACE_Mem_Map();
+    if (_mappedFile->map(filename, static_cast<size_t>(-1), O_RDONLY, ACE_DEFAULT_FILE_PERMS, PROT_READ, ACE_MAP_PRIVATE) == -1)
+    {
+        sLog->outError("Error mapping map file '%s' into memory", filename);
+        delete _mappedFile;
+        _mappedFile = NULL;
+        return false;
+    }
+
+    map_fileheader header;
+    if (_mappedFile->size() < sizeof(header))
+        return false;
+    memcpy(&header, _mappedFile->addr(), sizeof(header));
+
+    if (header.areaMapOffset && !mapAreaData(header.areaMapOffset))
+    {
+        sLog->outError("Error loading map area data\n");
+        return false;
+    }
+    if (header.heightMapOffset && !mapHeightData(header.heightMapOffset))
+    {
+        sLog->outError("Error loading map height data\n");
+        return false;
+    }
+    if (header.liquidMapOffset && !mapLiquidData(header.liquidMapOffset))
+    {
+        sLog->outError("Error loading map liquids data\n");
+        return false;
+    }
+    return true;
+}
+
+bool GridMap::mapAreaData(uint32 offset)
+{
+    map_areaHeader header;
+    if (offset + sizeof(header) > _mappedFile->size())
+        return false;
+    memcpy(&header, (uint8 const*)_mappedFile->addr() + offset, sizeof(header));
+
+    if (header.fourcc != MapAreaMagic.asUInt)
+        return false;
+
+    _gridArea = header.gridArea;
+    if (!(header.flags & MAP_AREA_NO_AREA))
+        if (!(_areaMap = mapArray<uint16>(offset + sizeof(header), 16*16)))
+            return false;
+    return true;
+}
+
+bool GridMap::mapHeightData(uint32 offset)
+{
+    map_heightHeader header;
+    if (offset + sizeof(header) > _mappedFile->size())
+        return false;
+    memcpy(&header, (uint8 const*)_mappedFile->addr() + offset, sizeof(header));
+
+    if (header.fourcc != MapHeightMagic.asUInt)
+        return false;
+
+    _gridHeight = header.gridHeight;
+    offset += sizeof(header);
+    if (!(header.flags & MAP_HEIGHT_NO_HEIGHT))
+    {
+        if ((header.flags & MAP_HEIGHT_AS_INT16))
+        {
+            m_uint16_V9 = mapArray<uint16>(offset, 129*129);
+            m_uint16_V8 = mapArray<uint16>(offset + sizeof(uint16)*129*129, 128*128);
+            if (!m_uint16_V9 || !m_uint16_V8)
+                return false;
+            _gridIntHeightMultiplier = (header.gridMaxHeight - header.gridHeight) / 65535;
+            _gridGetHeight = &GridMap::getHeightFromUint16;
+        }
+        else if ((header.flags & MAP_HEIGHT_AS_INT8))
+        {
+            m_uint8_V9 = mapArray<uint8>(offset, 129*129);
+            m_uint8_V8 = mapArray<uint8>(offset + sizeof(uint8)*129*129, 128*128);
+            if (!m_uint8_V9 || !m_uint8_V8)
+                return false;
+            _gridIntHeightMultiplier = (header.gridMaxHeight - header.gridHeight) / 255;
+            _gridGetHeight = &GridMap::getHeightFromUint8;
+        }
+        else
+        {
+            m_V9 = mapArray<float>(offset, 129*129);
+            m_V8 = mapArray<float>(offset + sizeof(float)*129*129, 128*128);
+            if (!m_V9 || !m_V8)
+                return false;
+            _gridGetHeight = &GridMap::getHeightFromFloat;
+        }
+    }
+    else
+        _gridGetHeight = &GridMap::getHeightFromFlat;
+    return true;
+}
+
+bool GridMap::mapLiquidData(uint32 offset)
+{
+    map_liquidHeader header;
+    if (offset + sizeof(header) > _mappedFile->size())
+        return false;
+    memcpy(&header, (uint8 const*)_mappedFile->addr() + offset, sizeof(header));
+
+    if (header.fourcc != MapLiquidMagic.asUInt)
+        return false;
+
+    _liquidType   = header.liquidType;
+    _liquidOffX  = header.offsetX;
+    _liquidOffY  = header.offsetY;
+    _liquidWidth = header.width;
+    _liquidHeight= header.height;
+    _liquidLevel  = header.liquidLevel;
+
+    offset += sizeof(header);
+    if (!(header.flags & MAP_LIQUID_NO_TYPE))
+    {
+        if (!(_liquidData = mapArray<uint8>(offset, 16*16)))
+            return false;
+        offset += sizeof(uint8)*16*16;
+    }
+    if (!(header.flags & MAP_LIQUID_NO_HEIGHT))
+        if (!(_liquidMap = mapArray<float>(offset, _liquidWidth*_liquidHeight)))
+            return false;
+    return true;
+}
+
+template<class T>
+T* GridMap::mapArray(uint32 offset, uint32 count)
+{
+    uint32 size = sizeof(T) * count;
+    if (offset + size > _mappedFile->size())
+        return NULL;
+
+    uint8* data = (uint8*)_mappedFile->addr() + offset;
+    if (reinterpret_cast<size_t>(data) % sizeof(T) == 0)
+    {
+        _mappedSize += size;
+        GridMapMappedBytes += size;
+        return reinterpret_cast<T*>(data);
+    }
+
+    // files from older extractors do not align the liquid section, copy what can't be used in place
+    T* array = new T[count];
+    memcpy(array, data, size);
+    _heapSize += size;
+    GridMapHeapBytes += size;
+    return array;
+}
+
+bool GridMap::isMappedData(void const* data) const
+{
+    if (!_mappedFile || !data)
+        return false;
+
+    uint8 const* begin = (uint8 const*)_mappedFile->addr();
+    return data >= begin && data < begin + _mappedFile->size();
+}
+
+long GridMap::GetLoadedCount()
+{
+    return GridMapLoadedCount.value();
+}
+
+long GridMap::GetMappedBytes()
+{
+    return GridMapMappedBytes.value();
+}
+
+long GridMap::GetHeapBytes()
+{
+    return GridMapHeapBytes.value();
+}
+
+long GridMap::GetLoadTime()
+{
+    return GridMapLoadTime.value();
+}
+
 uint16 GridMap::getArea(float x, float y)
 {
     if (!_areaMap)
@@ -1435,6 +2300,91 @@ float GridMap::getHeightFromUint16(float x, float y) const
     return (float)((a * x) + (b * y) + c)*_gridIntHeightMultiplier + _gridHeight;
 }
 
+namespace
+{
+    // Same triangle interpolation as GridMap::getHeightFrom*, but the triangle is selected without
+    // branches so the loop has no data dependent jumps and can be vectorized by the compiler.
+    template<class T>
+    void ComputeGridHeights(T const* V9, T const* V8, float multiplier, float base, uint32 count, float const* xs, float const* ys, float* heights)
+    {
+        for (uint32 i = 0; i < count; ++i)
+        {
+            float x = MAP_RESOLUTION * (32 - xs[i]/SIZE_OF_GRIDS);
+            float y = MAP_RESOLUTION * (32 - ys[i]/SIZE_OF_GRIDS);
+
+            int x_int = (int)x;
+            int y_int = (int)y;
+            x -= x_int;
+            y -= y_int;
+            x_int&=(MAP_RESOLUTION - 1);
+            y_int&=(MAP_RESOLUTION - 1);
+
+            T const* V9_h1_ptr = &V9[x_int*129 + y_int];
+            float h1 = float(V9_h1_ptr[  0]);
+            float h2 = float(V9_h1_ptr[129]);
+            float h3 = float(V9_h1_ptr[  1]);
+            float h4 = float(V9_h1_ptr[130]);
+            float h5 = 2 * float(V8[x_int*128 + y_int]);
+
+            bool upper = !(x+y < 1);
+            bool right = x > y;
+            float a = upper ? (right ? h2 + h4 - h5 : h4 - h3) : (right ? h2 - h1 : h5 - h1 - h3);
+            float b = upper ? (right ? h4 - h2 : h3 + h4 - h5) : (right ? h5 - h1 - h2 : h3 - h1);
+            float c = upper ? h5 - h4 : h1;
+
+            heights[i] = (a * x + b * y + c) * multiplier + base;
+        }
+    }
+}
+
+void GridMap::getHeights(uint32 count, float const* x, float const* y, float* heights)
+{
+    if (_gridGetHeight == &GridMap::getHeightFromFloat && m_V9 && m_V8)
+        ComputeGridHeights(m_V9, m_V8, 1.0f, 0.0f, count, x, y, heights);
+    else if (_gridGetHeight == &GridMap::getHeightFromUint16 && m_uint16_V9 && m_uint16_V8)
+        ComputeGridHeights(m_uint16_V9, m_uint16_V8, _gridIntHeightMultiplier, _gridHeight, count, x, y, heights);
+    else if (_gridGetHeight == &GridMap::getHeightFromUint8 && m_uint8_V9 && m_uint8_V8)
+        ComputeGridHeights(m_uint8_V9, m_uint8_V8, _gridIntHeightMultiplier, _gridHeight, count, x, y, heights);
+    else
+        std::fill(heights, heights + count, _gridHeight);
+}
+
+void GridMap::getAreas(uint32 count, float const* x, float const* y, uint16* areas)
+{
+    if (!_areaMap)
+    {
+        std::fill(areas, areas + count, _gridArea);
+        return;
+    }
+
+    for (uint32 i = 0; i < count; ++i)
+    {
+        int lx = (int)(16 * (32 - x[i]/SIZE_OF_GRIDS)) & 15;
+        int ly = (int)(16 * (32 - y[i]/SIZE_OF_GRIDS)) & 15;
+        areas[i] = _areaMap[lx*16 + ly];
+    }
+}
+
+void GridMap::getLiquidStatuses(uint32 count, float const* x, float const* y, float const* z, uint8 ReqLiquidType, ZLiquidStatus* statuses, LiquidData* data)
+{
+    if (!_liquidType && !_liquidData)
+    {
+        std::fill(statuses, statuses + count, LIQUID_MAP_NO_WATER);
+        return;
+    }
+
+    // Map::GetLiquidStatuses passes at most one batch, longer runs are split the same way
+    float groundLevels[LIQUID_STATUS_BATCH_SIZE];
+    for (uint32 chunk = 0; chunk < count; chunk += LIQUID_STATUS_BATCH_SIZE)
+    {
+        uint32 chunkSize = std::min<uint32>(count - chunk, LIQUID_STATUS_BATCH_SIZE);
+        getHeights(chunkSize, x + chunk, y + chunk, groundLevels);
+
+        for (uint32 i = 0; i < chunkSize; ++i)
+            statuses[chunk + i] = getLiquidStatus(x[chunk + i], y[chunk + i], z[chunk + i], ReqLiquidType, data ? &data[chunk + i] : NULL, &groundLevels[i]);
+    }
+}
+
 float GridMap::getLiquidLevel(float x, float y)
 {
     if (!_liquidMap)
@@ -1468,6 +2418,11 @@ uint8 GridMap::getTerrainType(float x, float y)
 
 // Get water state on map
 inline ZLiquidStatus GridMap::getLiquidStatus(float x, float y, float z, uint8 ReqLiquidType, LiquidData* data)
+{
+    return getLiquidStatus(x, y, z, ReqLiquidType, data, NULL);
+}
+
+ZLiquidStatus GridMap::getLiquidStatus(float x, float y, float z, uint8 ReqLiquidType, LiquidData* data, float const* groundLevel)
 {
     // Check water type (if no water return)
     if (!_liquidType && !_liquidData)
@@ -1501,7 +2456,7 @@ inline ZLiquidStatus GridMap::getLiquidStatus(float x, float y, float z, uint8 R
     // Get water level
     float liquid_level = _liquidMap ? _liquidMap[lx_int*_liquidWidth + ly_int] : _liquidLevel;
     // Get ground level (sub 0.2 for fix some errors)
-    float ground_level = getHeight(x, y);
+    float ground_level = groundLevel ? *groundLevel : getHeight(x, y);
 
     // Check water level and ground level
     if (liquid_level < ground_level || z < ground_level - 2)
@@ -1529,6 +2484,45 @@ inline ZLiquidStatus GridMap::getLiquidStatus(float x, float y, float z, uint8 R
     return LIQUID_MAP_ABOVE_WATER;
 }
 
+namespace
+{
+    // mapHeight set for any above raw ground Z or <= INVALID_HEIGHT
+    // vmap height set for any under Z value or <= INVALID_HEIGHT
+    inline float SelectSurfaceHeight(float z, float mapHeight, float vmapHeight)
+    {
+        if (vmapHeight > INVALID_HEIGHT)
+        {
+            if (mapHeight > INVALID_HEIGHT)
+            {
+                // we have mapheight and vmapheight and must select more appropriate
+
+                // we are already under the surface or vmap height above map heigt
+                // or if the distance of the vmap height is less the land height distance
+                if (z < mapHeight || vmapHeight > mapHeight || fabs(mapHeight-z) > fabs(vmapHeight-z))
+                    return vmapHeight;
+                else
+                    return mapHeight;                       // better use .map surface height
+            }
+            else
+                return vmapHeight;                          // we have only vmapHeight (if have)
+        }
+
+        return mapHeight;                                   // explicitly use map data
+    }
+
+    // end of the run of points starting at begin that fall into the same grid
+    inline uint32 GetGridRunEnd(uint32 begin, uint32 count, float const* x, float const* y)
+    {
+        int gx = (int)(32-x[begin]/SIZE_OF_GRIDS);
+        int gy = (int)(32-y[begin]/SIZE_OF_GRIDS);
+
+        uint32 end = begin + 1;
+        while (end < count && (int)(32-x[end]/SIZE_OF_GRIDS) == gx && (int)(32-y[end]/SIZE_OF_GRIDS) == gy)
+            ++end;
+        return end;
+    }
+}
+
 inline GridMap* Map::GetGrid(float x, float y)
 {
     // half opt method
@@ -1579,26 +2573,32 @@ float Map::GetHeight(float x, float y, float z, bool checkVMap /*= true*/, float
             vmapHeight = vmgr->getHeight(GetId(), x, y, z + 2.0f, maxSearchDist);   // look from a bit higher pos to find the floor
     }
 
-    // mapHeight set for any above raw ground Z or <= INVALID_HEIGHT
-    // vmap height set for any under Z value or <= INVALID_HEIGHT
-    if (vmapHeight > INVALID_HEIGHT)
-    {
-        if (mapHeight > INVALID_HEIGHT)
-        {
-            // we have mapheight and vmapheight and must select more appropriate
+    return SelectSurfaceHeight(z, mapHeight, vmapHeight);
+}
 
-            // we are already under the surface or vmap height above map heigt
-            // or if the distance of the vmap height is less the land height distance
-            if (z < mapHeight || vmapHeight > mapHeight || fabs(mapHeight-z) > fabs(vmapHeight-z))
-                return vmapHeight;
-            else
-                return mapHeight;                           // better use .map surface height
-        }
+void Map::GetHeights(uint32 count, float const* x, float const* y, float const* z, float* heights, bool checkVMap /*= true*/, float maxSearchDist /*= DEFAULT_HEIGHT_SEARCH*/) const
+{
+    // raw .map surface, one pass per run of points in the same grid
+    for (uint32 i = 0; i < count;)
+    {
+        uint32 end = GetGridRunEnd(i, count, x, y);
+        if (GridMap* gmap = const_cast<Map*>(this)->GetGrid(x[i], y[i]))
+            gmap->getHeights(end - i, x + i, y + i, heights + i);
         else
-            return vmapHeight;                              // we have only vmapHeight (if have)
+            std::fill(heights + i, heights + end, VMAP_INVALID_HEIGHT_VALUE);
+        i = end;
     }
 
-    return mapHeight;                               // explicitly use map data
+    VMAP::IVMapManager* vmgr = VMAP::VMapFactory::createOrGetVMapManager();
+    bool useVMap = checkVMap && vmgr->isHeightCalcEnabled();
+
+    for (uint32 i = 0; i < count; ++i)
+    {
+        // look from a bit higher pos to find the floor, ignore under surface case
+        float mapHeight = z[i] + 2.0f > heights[i] ? heights[i] : VMAP_INVALID_HEIGHT_VALUE;
+        float vmapHeight = useVMap ? vmgr->getHeight(GetId(), x[i], y[i], z[i] + 2.0f, maxSearchDist) : VMAP_INVALID_HEIGHT_VALUE;
+        heights[i] = SelectSurfaceHeight(z[i], mapHeight, vmapHeight);
+    }
 }
 
 inline bool IsOutdoorWMO(uint32 mogpFlags, int32 /*adtId*/, int32 /*rootId*/, int32 /*groupId*/, WMOAreaTableEntry const* wmoEntry, AreaTableEntry const* atEntry)
@@ -1702,6 +2702,31 @@ uint16 Map::GetAreaFlag(float x, float y, float z, bool *isOutdoors) const
     return areaflag;
  }
 
+void Map::GetAreaFlags(uint32 count, float const* x, float const* y, float const* z, uint16* areaFlags) const
+{
+    for (uint32 i = 0; i < count;)
+    {
+        uint32 end = GetGridRunEnd(i, count, x, y);
+        if (GridMap* gmap = const_cast<Map*>(this)->GetGrid(x[i], y[i]))
+            gmap->getAreas(end - i, x + i, y + i, areaFlags + i);
+        // this used while not all *.map files generated (instances)
+        else
+            std::fill(areaFlags + i, areaFlags + end, GetAreaFlagByMapId(i_mapEntry->MapID));
+        i = end;
+    }
+
+    // wmo areas override the terrain area
+    for (uint32 i = 0; i < count; ++i)
+    {
+        uint32 mogpFlags;
+        int32 adtId, rootId, groupId;
+        if (GetAreaInfo(x[i], y[i], z[i], mogpFlags, adtId, rootId, groupId))
+            if (WMOAreaTableEntry const* wmoEntry = GetWMOAreaTableEntryByTripple(rootId, adtId, groupId))
+                if (AreaTableEntry const* atEntry = GetAreaEntryByAreaID(wmoEntry->areaId))
+                    areaFlags[i] = atEntry->exploreFlag;
+    }
+}
+
 uint8 Map::GetTerrainType(float x, float y) const
 {
     if (GridMap* gmap = const_cast<Map*>(this)->GetGrid(x, y))
@@ -1711,10 +2736,69 @@ uint8 Map::GetTerrainType(float x, float y) const
 }
 
 ZLiquidStatus Map::getLiquidStatus(float x, float y, float z, uint8 ReqLiquidType, LiquidData* data) const
+{
+    float ground_level = INVALID_HEIGHT;
+    ZLiquidStatus result = getVMapLiquidStatus(x, y, z, ReqLiquidType, data, ground_level);
+    if (result != LIQUID_MAP_NO_WATER && result != LIQUID_MAP_ABOVE_WATER)
+        return result;
+
+    if (GridMap* gmap = const_cast<Map*>(this)->GetGrid(x, y))
+    {
+        LiquidData map_data;
+        ZLiquidStatus map_result = gmap->getLiquidStatus(x, y, z, ReqLiquidType, &map_data);
+        // Not override LIQUID_MAP_ABOVE_WATER with LIQUID_MAP_NO_WATER:
+        if (map_result != LIQUID_MAP_NO_WATER && (map_data.level > ground_level))
+        {
+            if (data)
+                *data = map_data;
+            return map_result;
+        }
+    }
+    return result;
+}
+
+void Map::GetLiquidStatuses(uint32 count, float const* x, float const* y, float const* z, uint8 ReqLiquidType, ZLiquidStatus* statuses, LiquidData* data) const
+{
+    // the .map results are kept on the stack, larger batches are done in chunks
+    ZLiquidStatus mapResults[LIQUID_STATUS_BATCH_SIZE];
+    LiquidData mapData[LIQUID_STATUS_BATCH_SIZE];
+
+    for (uint32 chunk = 0; chunk < count; chunk += LIQUID_STATUS_BATCH_SIZE)
+    {
+        uint32 chunkEnd = std::min<uint32>(count, chunk + LIQUID_STATUS_BATCH_SIZE);
+        for (uint32 i = chunk; i < chunkEnd;)
+        {
+            uint32 end = GetGridRunEnd(i, chunkEnd, x, y);
+            if (GridMap* gmap = const_cast<Map*>(this)->GetGrid(x[i], y[i]))
+                gmap->getLiquidStatuses(end - i, x + i, y + i, z + i, ReqLiquidType, mapResults + i - chunk, mapData + i - chunk);
+            else
+                std::fill(mapResults + i - chunk, mapResults + end - chunk, LIQUID_MAP_NO_WATER);
+            i = end;
+        }
+
+        for (uint32 i = chunk; i < chunkEnd; ++i)
+        {
+            float ground_level = INVALID_HEIGHT;
+            statuses[i] = getVMapLiquidStatus(x[i], y[i], z[i], ReqLiquidType, data ? &data[i] : NULL, ground_level);
+            if (statuses[i] != LIQUID_MAP_NO_WATER && statuses[i] != LIQUID_MAP_ABOVE_WATER)
+                continue;
+
+            // Not override LIQUID_MAP_ABOVE_WATER with LIQUID_MAP_NO_WATER:
+            if (mapResults[i - chunk] != LIQUID_MAP_NO_WATER && (mapData[i - chunk].level > ground_level))
+            {
+                if (data)
+                    data[i] = mapData[i - chunk];
+                statuses[i] = mapResults[i - chunk];
+            }
+        }
+    }
+}
+
+ZLiquidStatus Map::getVMapLiquidStatus(float x, float y, float z, uint8 ReqLiquidType, LiquidData* data, float& ground_level) const
 {
     ZLiquidStatus result = LIQUID_MAP_NO_WATER;
     VMAP::IVMapManager* vmgr = VMAP::VMapFactory::createOrGetVMapManager();
-    float liquid_level, ground_level = INVALID_HEIGHT;
+    float liquid_level;
     uint32 liquid_type;
     if (vmgr->GetLiquidLevel(GetId(), x, y, z, ReqLiquidType, liquid_level, ground_level, liquid_type))
     {
@@ -1743,19 +2827,6 @@ ZLiquidStatus Map::getLiquidStatus(float x, float y, float z, uint8 ReqLiquidTyp
             result = LIQUID_MAP_ABOVE_WATER;
         }
     }
-
-    if (GridMap* gmap = const_cast<Map*>(this)->GetGrid(x, y))
-    {
-        LiquidData map_data;
-        ZLiquidStatus map_result = gmap->getLiquidStatus(x, y, z, ReqLiquidType, &map_data);
-        // Not override LIQUID_MAP_ABOVE_WATER with LIQUID_MAP_NO_WATER:
-        if (map_result != LIQUID_MAP_NO_WATER && (map_data.level > ground_level))
-        {
-            if (data)
-                *data = map_data;
-            return map_result;
-        }
-    }
     return result;
 }
 
@@ -1973,12 +3044,53 @@ void Map::DelayedUpdate(const uint32 t_diff)
     }
 }
 
+void Map::AddUpdateObject(Object* obj)
+{
+    TRINITY_GUARD(ACE_Thread_Mutex, _updateObjectsLock);
+    _updateObjects.insert(obj);
+}
+
+void Map::RemoveUpdateObject(Object* obj)
+{
+    TRINITY_GUARD(ACE_Thread_Mutex, _updateObjectsLock);
+    _updateObjects.erase(obj);
+}
+
+void Map::SendObjectUpdates()
+{
+    std::set<Object*> objects;
+    {
+        TRINITY_GUARD(ACE_Thread_Mutex, _updateObjectsLock);
+        objects.swap(_updateObjects);
+    }
+
+    if (objects.empty())
+        return;
+
+    // players only see the objects of their own map, so no other thread builds data for them
+    UpdateDataMapType update_players;
+    for (std::set<Object*>::const_iterator itr = objects.begin(); itr != objects.end(); ++itr)
+    {
+        ASSERT((*itr)->IsInWorld());
+        (*itr)->BuildUpdate(update_players);
+    }
+
+    WorldPacket packet;                                     // here we allocate a std::vector with a size of 0x10000
+    for (UpdateDataMapType::iterator iter = update_players.begin(); iter != update_players.end(); ++iter)
+    {
+        iter->second.BuildPacket(&packet);
+        iter->first->GetSession()->SendPacket(&packet);
+        packet.clear();                                     // clean the string
+    }
+}
+
 void Map::AddObjectToRemoveList(WorldObject* obj)
 {
     ASSERT(obj->GetMapId() == GetId() && obj->GetInstanceId() == GetInstanceId());
 
     obj->CleanupsBeforeDelete(false);                            // remove or simplify at least cross referenced links
 
+    TRINITY_GUARD(ACE_Thread_Mutex, _deferredLock);
     i_objectsToRemove.insert(obj);
     //sLog->outDebug(LOG_FILTER_MAPS, "Object (GUID: %u TypeId: %u) added to removing list.", obj->GetGUIDLow(), obj->GetTypeId());
 }
@@ -1987,6 +3099,7 @@ void Map::AddObjectToSwitchList(WorldObject* obj, bool on)
 {
     ASSERT(obj->GetMapId() == GetId() && obj->GetInstanceId() == GetInstanceId());
 
+    TRINITY_GUARD(ACE_Thread_Mutex, _deferredLock);
     std::map<WorldObject*, bool>::iterator itr = i_objectsToSwitch.find(obj);
     if (itr == i_objectsToSwitch.end())
         i_objectsToSwitch.insert(itr, std::make_pair(obj, on));
@@ -23,6 +23,8 @@
 #include "Define.h"
 #include <ace/RW_Thread_Mutex.h>
 #include <ace/Thread_Mutex.h>
+#include <ace/Condition_Thread_Mutex.h>
+#include <ace/Atomic_Op.h>
 
 #include "DBCStructure.h"
 #include "GridDefines.h"
@@ -51,6 +53,8 @@ struct Position;
 class Battleground;
 class MapInstanced;
 class InstanceMap;
+class ZoneScript;
+class ACE_Mem_Map;
 namespace Trinity { struct ObjectUpdater; }
 
 struct ScriptAction
@@ -170,11 +174,24 @@ class GridMap
     uint8 _liquidOffY;
     uint8 _liquidWidth;
     uint8 _liquidHeight;
-    
+
+    // memory mapped .map file, the data arrays point into it when the sections are aligned
+    ACE_Mem_Map* _mappedFile;
+    uint32 _mappedSize;
+    uint32 _heapSize;
+    bool _dataLoaded;
+
     bool loadAreaData(FILE* in, uint32 offset, uint32 size);
     bool loadHeihgtData(FILE* in, uint32 offset, uint32 size);
     bool loadLiquidData(FILE* in, uint32 offset, uint32 size);
 
+    bool loadMappedData(char const* filename);
+    bool mapAreaData(uint32 offset);
+    bool mapHeightData(uint32 offset);
+    bool mapLiquidData(uint32 offset);
+    template<class T> T* mapArray(uint32 offset, uint32 count);
+    bool isMappedData(void const* data) const;
+
     // Get height functions and pointers
     typedef float (GridMap::*GetHeightPtr) (float x, float y) const;
     GetHeightPtr _gridGetHeight;
@@ -183,17 +200,30 @@ class GridMap
     float getHeightFromUint8(float x, float y) const;
     float getHeightFromFlat(float x, float y) const;
 
+    ZLiquidStatus getLiquidStatus(float x, float y, float z, uint8 ReqLiquidType, LiquidData* data, float const* groundLevel);
+
 public:
     GridMap();
     ~GridMap();
     bool loadData(char *filaname);
     void unloadData();
 
+    // terrain memory statistics of all loaded grid maps
+    static long GetLoadedCount();
+    static long GetMappedBytes();
+    static long GetHeapBytes();
+    static long GetLoadTime();                              // total time spent in loadData, in microseconds
+
     uint16 getArea(float x, float y);
     inline float getHeight(float x, float y) {return (this->*_gridGetHeight)(x, y);}
     float getLiquidLevel(float x, float y);
     uint8 getTerrainType(float x, float y);
     ZLiquidStatus getLiquidStatus(float x, float y, float z, uint8 ReqLiquidType, LiquidData* data = 0);
+
+    // batch versions for points inside this grid, the height encoding is only dispatched once per call
+    void getAreas(uint32 count, float const* x, float const* y, uint16* areas);
+    void getHeights(uint32 count, float const* x, float const* y, float* heights);
+    void getLiquidStatuses(uint32 count, float const* x, float const* y, float const* z, uint8 ReqLiquidType, ZLiquidStatus* statuses, LiquidData* data = 0);
 };
 
 // GCC have alternative #pragma pack(N) syntax and old gcc version not support pack(push, N), also any gcc version not support it at some platform
@@ -226,6 +256,7 @@ enum LevelRequirementVsMode
 #define MAX_FALL_DISTANCE     250000.0f                     // "unlimited fall" to find VMap ground if it is available, just larger than MAX_HEIGHT - INVALID_HEIGHT
 #define DEFAULT_HEIGHT_SEARCH     10.0f                     // default search distance to find height at nearby locations
 #define MIN_UNLOAD_DELAY      1                             // immediate unload
+#define LIQUID_STATUS_BATCH_SIZE  64                        // points per .map pass of Map::GetLiquidStatuses
 
 typedef std::map<uint32/*leaderDBGUID*/, CreatureGroup*>        CreatureGroupHolderType;
 
@@ -255,6 +286,31 @@ class Map : public GridRefManager<NGridType>
         void VisitNearbyCellsOf(WorldObject* obj, TypeContainerVisitor<Trinity::ObjectUpdater, GridTypeMapContainer> &gridVisitor, TypeContainerVisitor<Trinity::ObjectUpdater, WorldTypeMapContainer> &worldVisitor);
         virtual void Update(const uint32);
 
+        // duration of the last Map::Update call and its moving average, in milliseconds
+        uint32 GetUpdateTime() const { return uint32(_updateTime.value()); }
+        uint32 GetAverageUpdateTime() const { return uint32(_averageUpdateTime.value()); }
+        // number of grid regions updated concurrently during the last tick (0 when updated serially)
+        uint32 GetGridRegionCount() const { return _gridRegionCount; }
+        // objects left out of the grid regions of the last tick because they are linked to another grid
+        uint32 GetGridRegionDeferredCount() const { return uint32(_gridRegionDeferred.size()); }
+
+        // called by MapUpdater workers helping with the current grid region phase
+        void ProcessGridRegions();
+
+        // hand a respawned pooled object back to its pool and run a zone script event, both
+        // postponed until the grid regions are done when called from one
+        void UpdatePool(Creature* creature, uint32 poolId);
+        void UpdatePool(GameObject* go, uint32 poolId);
+        void ProcessZoneScriptEvent(ZoneScript* zoneScript, WorldObject* target, uint32 eventId);
+
+        // units whose visibility changed, visited by the next relocation notify of their grid
+        void AddUnitToNotify(Unit* unit);
+        void RemoveUnitFromNotify(Unit* unit);
+        uint32 GetPendingNotifyCount() const { return uint32(_unitsToNotify.size()); }
+        // units visited by the last relocation notify that had any and the time it took, in microseconds
+        uint32 GetRelocationNotifyCount() const { return _relocationNotifyCount; }
+        uint32 GetRelocationNotifyTime() const { return _relocationNotifyTime; }
+
         float GetVisibilityRange() const { return m_VisibleDistance; }
         //function for setting up visibility distance for maps on per-type/per-Id basis
         virtual void InitVisibilityDistance();
@@ -303,6 +359,12 @@ class Map : public GridRefManager<NGridType>
 
         ZLiquidStatus getLiquidStatus(float x, float y, float z, uint8 ReqLiquidType, LiquidData* data = 0) const;
 
+        // batch versions of GetHeight, GetAreaFlag and getLiquidStatus, the .map lookups of
+        // consecutive points in the same grid are done in one pass
+        void GetHeights(uint32 count, float const* x, float const* y, float const* z, float* heights, bool checkVMap = true, float maxSearchDist = DEFAULT_HEIGHT_SEARCH) const;
+        void GetAreaFlags(uint32 count, float const* x, float const* y, float const* z, uint16* areaFlags) const;
+        void GetLiquidStatuses(uint32 count, float const* x, float const* y, float const* z, uint8 ReqLiquidType, ZLiquidStatus* statuses, LiquidData* data = 0) const;
+
         uint16 GetAreaFlag(float x, float y, float z, bool *isOutdoors=0) const;
         bool GetAreaInfo(float x, float y, float z, uint32 &mogpflags, int32 &adtId, int32 &rootId, int32 &groupId) const;
 
@@ -373,6 +435,13 @@ class Map : public GridRefManager<NGridType>
         void AddObjectToSwitchList(WorldObject* obj, bool on);
         virtual void DelayedUpdate(const uint32 diff);
 
+        // objects of the map with changed fields, their update blocks are built by SendObjectUpdates
+        void AddUpdateObject(Object* obj);
+        void RemoveUpdateObject(Object* obj);
+        size_t GetUpdateObjectCount() const { return _updateObjects.size(); }
+        // sends the changes of the tick to the players of the map, runs after all maps were updated
+        virtual void SendObjectUpdates();
+
         void UpdateObjectVisibility(WorldObject* obj, Cell cell, CellCoord cellpair);
         void UpdateObjectsVisibilityFor(Player* player, Cell cell, CellCoord cellpair);
 
@@ -413,6 +482,9 @@ class Map : public GridRefManager<NGridType>
         template<class NOTIFIER> void VisitFirstFound(const float &x, const float &y, float radius, NOTIFIER &notifier);
         template<class NOTIFIER> void VisitWorld(const float &x, const float &y, float radius, NOTIFIER &notifier);
         template<class NOTIFIER> void VisitGrid(const float &x, const float &y, float radius, NOTIFIER &notifier);
+        // hands the notifier the objects the cell indexes place in range of the query, see CellObjectIndex
+        template<class NOTIFIER> void VisitIndexed(CellObjectIndexQuery const& query, NOTIFIER &notifier);
+        void SearchCellIndexes(CellObjectIndexQuery const& query, CellObjectIndex::ObjectList& result) const;
         CreatureGroupHolderType CreatureGroupHolder;
 
         void UpdateIteratorBack(Player* player);
@@ -432,8 +504,10 @@ class Map : public GridRefManager<NGridType>
     private:
         void LoadMapAndVMap(int gx, int gy);
         void LoadVMap(int gx, int gy);
+        void LoadMMap(int gx, int gy);
         void LoadMap(int gx, int gy, bool reload = false);
         GridMap* GetGrid(float x, float y);
+        ZLiquidStatus getVMapLiquidStatus(float x, float y, float z, uint8 ReqLiquidType, LiquidData* data, float& ground_level) const;
 
         void SetTimer(uint32 t) { i_gridExpiry = t < MIN_GRID_DELAY ? MIN_GRID_DELAY : t; }
 
@@ -445,6 +519,7 @@ class Map : public GridRefManager<NGridType>
         bool CreatureCellRelocation(Creature* creature, Cell new_cell);
 
         template<class T> void InitializeObject(T* obj);
+        template<class T> void InitializeDeferredObject(T* obj);
         void AddCreatureToMoveList(Creature* c, float x, float y, float z, float ang);
         void RemoveCreatureFromMoveList(Creature* c);
 
@@ -474,6 +549,17 @@ class Map : public GridRefManager<NGridType>
         void ScriptsProcess();
 
         void UpdateActiveCells(const float &x, const float &y, const uint32 t_diff);
+
+        // parallel grid region update, see MapUpdate.ParallelGrids
+        bool CanUpdateGridRegions() const;
+        void MarkNearbyCellsOf(WorldObject* obj);
+        void UpdateGridRegions(const uint32 t_diff);
+        void LoadDeferredGrids();
+        void ProcessDeferredActions();
+
+        // asynchronous grid loading ahead of moving players, see GridPrefetch.Enable
+        void PrefetchGridsAhead();
+        void PrefetchGrid(const GridCoord& p);
     protected:
         void SetUnloadReferenceLock(const GridCoord &p, bool on) { getNGrid(p.x_coord, p.y_coord)->setUnloadReferenceLock(on); }
 
@@ -523,6 +609,63 @@ class Map : public GridRefManager<NGridType>
         std::map<WorldObject*, bool> i_objectsToSwitch;
         std::set<WorldObject*> i_worldObjects;
 
+        // written by the updater thread of the map, read by MapUpdater when it queues the next update
+        ACE_Atomic_Op<ACE_Thread_Mutex, long> _updateTime;
+        ACE_Atomic_Op<ACE_Thread_Mutex, long> _averageUpdateTime;
+
+        std::set<Unit*> _unitsToNotify;
+        std::vector<Unit*> _unitsNotifying;                 // taken out of _unitsToNotify by ProcessRelocationNotifies, NULL once removed
+        uint32 _relocationNotifyCount;
+        uint32 _relocationNotifyTime;
+
+        // Grid regions: marked cells sorted by update phase and grid, _gridRegions holds the first
+        // cell index of every region followed by a sentinel. Regions sharing a phase have two grids
+        // between them, objects linked to another grid go to _gridRegionDeferred instead, see
+        // GridRegionLinkCheck in Map.cpp for what a region may touch.
+        std::vector<CellCoord> _markedCells;
+        std::vector<size_t> _gridRegions;
+        size_t _gridRegionNext;
+        size_t _gridRegionEnd;
+        size_t _gridRegionPending;
+        uint32 _gridRegionCount;
+        uint32 _gridRegionDiff;
+        std::vector<WorldObject*> _gridRegionDeferred;
+        ACE_Thread_Mutex _gridRegionLock;
+        ACE_Condition_Thread_Mutex _gridRegionCondition;
+
+        // set while grid regions are updated concurrently, map-wide lists are then guarded
+        // by _deferredLock, grids are neither created nor loaded and objects are neither added
+        // nor handed to their pool until all regions are done, see ProcessDeferredActions
+        bool _parallelUpdate;
+        ACE_Thread_Mutex _deferredLock;
+        std::vector<Cell> _gridsToLoad;
+        std::vector<GridCoord> _gridsToCreate;
+        std::vector<WorldObject*> _objectsToAdd;
+
+        struct DeferredPoolUpdate
+        {
+            DeferredPoolUpdate(uint8 type, uint32 pool, uint32 guid) : typeId(type), poolId(pool), dbGuid(guid) { }
+
+            uint8 typeId;                                   // TYPEID_UNIT or TYPEID_GAMEOBJECT
+            uint32 poolId;
+            uint32 dbGuid;
+        };
+        std::vector<DeferredPoolUpdate> _poolsToUpdate;
+
+        struct DeferredZoneScriptEvent
+        {
+            DeferredZoneScriptEvent(ZoneScript* zoneScript, WorldObject* eventTarget, uint32 event) : script(zoneScript), target(eventTarget), eventId(event) { }
+
+            ZoneScript* script;
+            WorldObject* target;
+            uint32 eventId;
+        };
+        std::vector<DeferredZoneScriptEvent> _zoneScriptEvents;
+
+        // fields may be changed from other threads than the one updating the map, e.g. by session handlers
+        std::set<Object*> _updateObjects;
+        ACE_Thread_Mutex _updateObjectsLock;
+
         typedef std::multimap<time_t, ScriptAction> ScriptScheduleMap;
         ScriptScheduleMap m_scriptSchedule;
 
@@ -536,12 +679,14 @@ class Map : public GridRefManager<NGridType>
         template<class T>
         void AddToActiveHelper(T* obj)
         {
+            TRINITY_GUARD(ACE_Thread_Mutex, _deferredLock);
             m_activeNonPlayers.insert(obj);
         }
 
         template<class T>
         void RemoveFromActiveHelper(T* obj)
         {
+            TRINITY_GUARD(ACE_Thread_Mutex, _deferredLock);
             // Map::Update for active object in proccess
             if (m_activeNonPlayersIter != m_activeNonPlayers.end())
             {
@@ -682,4 +827,12 @@ inline void Map::VisitGrid(const float &x, const float &y, float radius, NOTIFIE
     TypeContainerVisitor<NOTIFIER, GridTypeMapContainer >  grid_object_notifier(notifier);
     cell.Visit(p, grid_object_notifier, *this, radius, x, y);
 }
+
+template<class NOTIFIER>
+inline void Map::VisitIndexed(CellObjectIndexQuery const& query, NOTIFIER &notifier)
+{
+    CellObjectIndex::ObjectList objects;
+    SearchCellIndexes(query, objects);
+    notifier.Visit(objects);
+}
 #endif
@@ -22,6 +22,7 @@
 #include "MapManager.h"
 #include "Battleground.h"
 #include "VMapFactory.h"
+#include "MMapFactory.h"
 #include "InstanceSaveMgr.h"
 #include "World.h"
 #include "Group.h"
@@ -82,6 +83,19 @@ void MapInstanced::DelayedUpdate(const uint32 diff)
     Map::DelayedUpdate(diff); // this may be removed
 }
 
+void MapInstanced::SendObjectUpdates()
+{
+    Map::SendObjectUpdates();
+
+    for (InstancedMaps::iterator i = m_InstancedMaps.begin(); i != m_InstancedMaps.end(); ++i)
+    {
+        if (sMapMgr->GetMapUpdater()->activated())
+            sMapMgr->GetMapUpdater()->schedule_object_update(*i->second);
+        else
+            i->second->SendObjectUpdates();
+    }
+}
+
 /*
 void MapInstanced::RelocationNotify()
 {
@@ -257,6 +271,7 @@ bool MapInstanced::DestroyInstance(InstancedMaps::iterator &itr)
     if (m_InstancedMaps.size() <= 1 && sWorld->getBoolConfig(CONFIG_GRID_UNLOAD))
     {
         VMAP::VMapFactory::createOrGetVMapManager()->unloadMap(itr->second->GetId());
+        MMAP::MMapFactory::createOrGetMMapManager()->unloadMap(itr->second->GetId());
         // in that case, unload grids of the base map, too
         // so in the next map creation, (EnsureGridCreated actually) VMaps will be reloaded
         Map::UnloadAll();
@@ -36,6 +36,7 @@ class MapInstanced : public Map
         // functions overwrite Map versions
         void Update(const uint32);
         void DelayedUpdate(const uint32 diff);
+        void SendObjectUpdates();
         //void RelocationNotify();
         void UnloadAll();
         bool CanEnter(Player* player);
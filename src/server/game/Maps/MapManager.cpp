@@ -34,6 +34,7 @@
 #include "Language.h"
 #include "WorldPacket.h"
 #include "Group.h"
+#include "GridPrefetcher.h"
 
 extern GridState* si_GridStates[];                          // debugging code, should be deleted some day
 
@@ -62,6 +63,8 @@ void MapManager::Initialize()
     // Start mtmaps if needed.
     if (num_threads > 0 && m_updater.activate(num_threads) == -1)
         abort();
+
+    sGridPrefetcher->Initialize();
 }
 
 void MapManager::InitializeVisibilityDistanceInfo()
@@ -286,6 +289,17 @@ void MapManager::Update(uint32 diff)
     for (iter = i_maps.begin(); iter != i_maps.end(); ++iter)
         iter->second->DelayedUpdate(uint32(i_timer.GetCurrent()));
 
+    // the update blocks of every map are built by its own worker
+    for (iter = i_maps.begin(); iter != i_maps.end(); ++iter)
+    {
+        if (m_updater.activated())
+            m_updater.schedule_object_update(*iter->second);
+        else
+            iter->second->SendObjectUpdates();
+    }
+    if (m_updater.activated())
+        m_updater.wait();
+
     sObjectAccessor->Update(uint32(i_timer.GetCurrent()));
     for (TransportSet::iterator itr = m_Transports.begin(); itr != m_Transports.end(); ++itr)
         (*itr)->Update(uint32(i_timer.GetCurrent()));
@@ -321,6 +335,8 @@ bool MapManager::IsValidMAP(uint32 mapid, bool startUp)
 
 void MapManager::UnloadAll()
 {
+    sGridPrefetcher->Unload();
+
     for (TransportSet::iterator i = m_Transports.begin(); i != m_Transports.end(); ++i)
     {
         (*i)->RemoveFromWorld();
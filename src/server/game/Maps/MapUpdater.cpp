@@ -18,84 +18,168 @@
  */
 
 #include "MapUpdater.h"
-#include "DelayExecutor.h"
 #include "Map.h"
 #include "DatabaseEnv.h"
+#include "WorldSession.h"
 
 #include <ace/Guard_T.h>
-#include <ace/Method_Request.h>
 
-class WDBThreadStartReq1 : public ACE_Method_Request
+class MapUpdaterRequest
 {
     public:
 
-        WDBThreadStartReq1()
+        // the cost is never 0, so the queued cost also reflects the number of queued requests
+        explicit MapUpdaterRequest(uint32 cost) : m_cost(cost ? cost : 1) { }
+        virtual ~MapUpdaterRequest() { }
+
+        virtual void call() = 0;
+
+        uint32 cost() const { return m_cost; }
+
+    private:
+
+        uint32 m_cost;
+};
+
+class MapUpdateRequest : public MapUpdaterRequest
+{
+    private:
+
+        Map& m_map;
+        MapUpdater& m_updater;
+        ACE_UINT32 m_diff;
+
+    public:
+
+        MapUpdateRequest(Map& m, MapUpdater& u, ACE_UINT32 d)
+            : MapUpdaterRequest(m.GetUpdateTime()), m_map(m), m_updater(u), m_diff(d)
         {
         }
 
-        virtual int call()
+        virtual void call()
         {
-            return 0;
+            m_map.Update (m_diff);
+            m_updater.update_finished ();
         }
 };
 
-class WDBThreadEndReq1 : public ACE_Method_Request
+class GridRegionUpdateRequest : public MapUpdaterRequest
 {
+    private:
+
+        Map& m_map;
+        MapUpdater& m_updater;
+
     public:
 
-        WDBThreadEndReq1()
+        GridRegionUpdateRequest(Map& m, MapUpdater& u)
+            : MapUpdaterRequest(0), m_map(m), m_updater(u)
         {
         }
 
-        virtual int call()
+        virtual void call()
         {
-            return 0;
+            m_map.ProcessGridRegions();
+            m_updater.update_finished();
         }
 };
 
-class MapUpdateRequest : public ACE_Method_Request
+class SessionDomainUpdateRequest : public MapUpdaterRequest
+{
+    private:
+
+        std::vector<WorldSession*> const& m_sessions;
+        size_t m_begin;
+        size_t m_end;
+        MapUpdater& m_updater;
+
+    public:
+
+        SessionDomainUpdateRequest(std::vector<WorldSession*> const& sessions, size_t begin, size_t end, MapUpdater& u)
+            : MapUpdaterRequest(uint32(end - begin)), m_sessions(sessions), m_begin(begin), m_end(end), m_updater(u)
+        {
+        }
+
+        virtual void call()
+        {
+            for (size_t i = m_begin; i < m_end; ++i)
+            {
+                DomainSessionFilter filter(m_sessions[i]);
+                m_sessions[i]->Update(0, filter);
+            }
+
+            m_updater.update_finished();
+        }
+};
+
+class ObjectUpdateRequest : public MapUpdaterRequest
 {
     private:
 
         Map& m_map;
         MapUpdater& m_updater;
-        ACE_UINT32 m_diff;
 
     public:
 
-        MapUpdateRequest(Map& m, MapUpdater& u, ACE_UINT32 d)
-            : m_map(m), m_updater(u), m_diff(d)
+        ObjectUpdateRequest(Map& m, MapUpdater& u)
+            : MapUpdaterRequest(uint32(m.GetUpdateObjectCount())), m_map(m), m_updater(u)
         {
         }
 
-        virtual int call()
+        virtual void call()
         {
-            m_map.Update (m_diff);
-            m_updater.update_finished ();
-            return 0;
+            m_map.SendObjectUpdates();
+            m_updater.update_finished();
         }
 };
 
 MapUpdater::MapUpdater():
-m_executor(), m_mutex(), m_condition(m_mutex), pending_requests(0)
+m_next_worker(0), m_steals(0), m_executed(0), m_mutex(), m_condition(m_mutex), m_work_condition(m_mutex),
+pending_requests(0), m_queued(0), m_max_queued(0), m_enqueued(0), m_activated(0)
 {
 }
 
 MapUpdater::~MapUpdater()
 {
     deactivate();
+
+    for (size_t i = 0; i < m_queues.size(); ++i)
+        delete m_queues[i];
 }
 
 int MapUpdater::activate(size_t num_threads)
 {
-    return m_executor.activate((int)num_threads, new WDBThreadStartReq1, new WDBThreadEndReq1);
+    if (activated() || num_threads < 1)
+        return -1;
+
+    for (size_t i = 0; i < num_threads; ++i)
+        m_queues.push_back(new WorkerQueue());
+
+    m_activated = 1;
+
+    if (ACE_Task_Base::activate(THR_NEW_LWP | THR_JOINABLE | THR_INHERIT_SCHED, (int)num_threads) == -1)
+    {
+        m_activated = 0;
+        return -1;
+    }
+
+    return 0;
 }
 
 int MapUpdater::deactivate()
 {
+    if (!activated())
+        return -1;
+
     wait();
 
-    return m_executor.deactivate();
+    {
+        TRINITY_GUARD(ACE_Thread_Mutex, m_mutex);
+        m_activated = 0;
+        m_work_condition.broadcast();
+    }
+
+    return ACE_Task_Base::wait();
 }
 
 int MapUpdater::wait()
@@ -110,24 +194,194 @@ int MapUpdater::wait()
 
 int MapUpdater::schedule_update(Map& map, ACE_UINT32 diff)
 {
-    TRINITY_GUARD(ACE_Thread_Mutex, m_mutex);
+    return enqueue(new MapUpdateRequest(map, *this, diff), false);
+}
+
+int MapUpdater::schedule_region_update(Map& map)
+{
+    // helpers join a map update that is already running, don't let them wait behind whole maps
+    return enqueue(new GridRegionUpdateRequest(map, *this), true);
+}
+
+int MapUpdater::schedule_session_update(std::vector<WorldSession*> const& sessions, size_t begin, size_t end)
+{
+    return enqueue(new SessionDomainUpdateRequest(sessions, begin, end, *this), false);
+}
 
-    ++pending_requests;
+int MapUpdater::schedule_object_update(Map& map)
+{
+    return enqueue(new ObjectUpdateRequest(map, *this), false);
+}
 
-    if (m_executor.execute(new MapUpdateRequest(map, *this, diff)) == -1)
+int MapUpdater::enqueue(MapUpdaterRequest* request, bool front)
+{
+    if (!activated() || m_queues.empty())
     {
+        delete request;
         ACE_DEBUG((LM_ERROR, ACE_TEXT("(%t) \n"), ACE_TEXT("Failed to schedule Map Update")));
-
-        --pending_requests;
         return -1;
     }
 
+    {
+        // counted before the push, so a worker never sees less queued requests than exist
+        TRINITY_GUARD(ACE_Thread_Mutex, m_mutex);
+        ++pending_requests;
+        if (++m_queued > m_max_queued)
+            m_max_queued = m_queued;
+    }
+
+    // the queue with the least expected work gets the request, the shorter one on a tie as costs
+    // are whole milliseconds, longest requests are kept first
+    WorkerQueue* target = m_queues[0];
+    for (size_t i = 1; i < m_queues.size(); ++i)
+    {
+        long cost = m_queues[i]->cost.value();
+        long targetCost = target->cost.value();
+        if (cost < targetCost || (cost == targetCost && m_queues[i]->count.value() < target->count.value()))
+            target = m_queues[i];
+    }
+
+    {
+        TRINITY_GUARD(ACE_Thread_Mutex, target->lock);
+        std::deque<MapUpdaterRequest*>::iterator itr = target->requests.begin();
+        if (!front)
+            while (itr != target->requests.end() && (*itr)->cost() >= request->cost())
+                ++itr;
+
+        target->requests.insert(itr, request);
+        target->cost += long(request->cost());
+        ++target->count;
+    }
+
+    TRINITY_GUARD(ACE_Thread_Mutex, m_mutex);
+    ++m_enqueued;
+    m_work_condition.signal();
     return 0;
 }
 
+MapUpdaterRequest* MapUpdater::take(size_t worker)
+{
+    WorkerQueue* queue = m_queues[worker];
+
+    TRINITY_GUARD(ACE_Thread_Mutex, queue->lock);
+    if (queue->requests.empty())
+        return NULL;
+
+    MapUpdaterRequest* request = queue->requests.front();
+    queue->requests.pop_front();
+    queue->cost -= long(request->cost());
+    --queue->count;
+    return request;
+}
+
+MapUpdaterRequest* MapUpdater::steal(size_t worker)
+{
+    // the costs are read without the queue locks, a stale victim only costs a look at another queue
+    size_t victim = worker;
+    long victimCost = 0;
+    for (size_t i = 0; i < m_queues.size(); ++i)
+    {
+        if (i == worker)
+            continue;
+
+        long cost = m_queues[i]->cost.value();
+        if (victim == worker || cost > victimCost)
+        {
+            victim = i;
+            victimCost = cost;
+        }
+    }
+
+    if (victim == worker)
+        return NULL;
+
+    if (MapUpdaterRequest* request = steal_from(victim))
+        return request;
+
+    // the most loaded queue was emptied meanwhile, any other request is still better than sleeping
+    for (size_t i = 1; i < m_queues.size(); ++i)
+    {
+        size_t other = (worker + i) % m_queues.size();
+        if (other == victim)
+            continue;
+
+        if (MapUpdaterRequest* request = steal_from(other))
+            return request;
+    }
+
+    return NULL;
+}
+
+MapUpdaterRequest* MapUpdater::steal_from(size_t victim)
+{
+    WorkerQueue* queue = m_queues[victim];
+
+    TRINITY_GUARD(ACE_Thread_Mutex, queue->lock);
+    if (queue->requests.empty())
+        return NULL;
+
+    // the owner works from the front, take the cheapest request from the back
+    MapUpdaterRequest* request = queue->requests.back();
+    queue->requests.pop_back();
+    queue->cost -= long(request->cost());
+    --queue->count;
+    ++m_steals;
+    return request;
+}
+
+int MapUpdater::svc()
+{
+    size_t worker = size_t(m_next_worker++) % m_queues.size();
+
+    for (;;)
+    {
+        // requests pushed after this point wake the worker up, earlier ones are found by the search
+        size_t enqueued;
+        {
+            TRINITY_GUARD(ACE_Thread_Mutex, m_mutex);
+            enqueued = m_enqueued;
+        }
+
+        MapUpdaterRequest* request = take(worker);
+        if (!request)
+            request = steal(worker);
+
+        if (!request)
+        {
+            // m_queued also counts requests taken by other workers but not yet started,
+            // wait for a new push instead of searching the queues again and again
+            TRINITY_GUARD(ACE_Thread_Mutex, m_mutex);
+            while (m_enqueued == enqueued && m_activated.value())
+                m_work_condition.wait();
+
+            if (m_enqueued == enqueued && !m_activated.value())
+                break;
+
+            continue;
+        }
+
+        {
+            TRINITY_GUARD(ACE_Thread_Mutex, m_mutex);
+            --m_queued;
+        }
+
+        request->call();
+        delete request;
+        ++m_executed;
+    }
+
+    return 0;
+}
+
+size_t MapUpdater::queue_depth()
+{
+    TRINITY_GUARD(ACE_Thread_Mutex, m_mutex);
+    return m_queued;
+}
+
 bool MapUpdater::activated()
 {
-    return m_executor.activated();
+    return m_activated.value() != 0;
 }
 
 void MapUpdater::update_finished()
@@ -20,14 +20,25 @@
 #ifndef _MAP_UPDATER_H_INCLUDED
 #define _MAP_UPDATER_H_INCLUDED
 
+#include <ace/Task.h>
 #include <ace/Thread_Mutex.h>
 #include <ace/Condition_Thread_Mutex.h>
+#include <ace/Atomic_Op.h>
 
-#include "DelayExecutor.h"
+#include <deque>
+#include <vector>
 
-class Map;
+#include "Define.h"
 
-class MapUpdater
+class Map;
+class MapUpdaterRequest;
+class WorldSession;
+
+// Every worker owns a queue of requests ordered by their expected cost (the previous
+// update time of the map), new requests go to the queue with the least queued cost.
+// A worker that runs out of work steals from the back of the most loaded queue, or of any
+// other queue that still has requests, and sleeps until the next request is queued otherwise.
+class MapUpdater : protected ACE_Task_Base
 {
     public:
 
@@ -35,9 +46,21 @@ class MapUpdater
         virtual ~MapUpdater();
 
         friend class MapUpdateRequest;
+        friend class GridRegionUpdateRequest;
+        friend class SessionDomainUpdateRequest;
+        friend class ObjectUpdateRequest;
 
         int schedule_update(Map& map, ACE_UINT32 diff);
 
+        // queues a helper for the grid regions of a map that is being updated in parallel
+        int schedule_region_update(Map& map);
+
+        // processes the opcode domain packets of sessions[begin, end) between the map updates
+        int schedule_session_update(std::vector<WorldSession*> const& sessions, size_t begin, size_t end);
+
+        // builds and sends the object updates of a map once all maps were updated
+        int schedule_object_update(Map& map);
+
         int wait();
 
         int activate(size_t num_threads);
@@ -46,12 +69,47 @@ class MapUpdater
 
         bool activated();
 
+        // statistics
+        size_t queue_depth();
+        size_t max_queue_depth() const { return m_max_queued; }
+        long steal_count() const { return m_steals.value(); }
+        long executed_count() const { return m_executed.value(); }
+
+    protected:
+
+        virtual int svc();
+
     private:
 
-        DelayExecutor m_executor;
+        struct WorkerQueue
+        {
+            WorkerQueue() : cost(0), count(0) { }
+
+            ACE_Thread_Mutex lock;
+            std::deque<MapUpdaterRequest*> requests;
+            // changed under lock, read without it when picking a queue to push to or steal from
+            ACE_Atomic_Op<ACE_Thread_Mutex, long> cost;     // sum of expected cost of queued requests
+            ACE_Atomic_Op<ACE_Thread_Mutex, long> count;    // number of queued requests
+        };
+
+        int enqueue(MapUpdaterRequest* request, bool front);
+        MapUpdaterRequest* take(size_t worker);
+        MapUpdaterRequest* steal(size_t worker);
+        MapUpdaterRequest* steal_from(size_t victim);
+
+        std::vector<WorkerQueue*> m_queues;
+        ACE_Atomic_Op<ACE_Thread_Mutex, long> m_next_worker;
+        ACE_Atomic_Op<ACE_Thread_Mutex, long> m_steals;
+        ACE_Atomic_Op<ACE_Thread_Mutex, long> m_executed;
+
         ACE_Thread_Mutex m_mutex;
-        ACE_Condition_Thread_Mutex m_condition;
-        size_t pending_requests;
+        ACE_Condition_Thread_Mutex m_condition;             // signaled when a request finishes
+        ACE_Condition_Thread_Mutex m_work_condition;        // signaled when a request is queued
+        size_t pending_requests;                            // queued or running
+        size_t m_queued;                                    // queued only
+        size_t m_max_queued;
+        size_t m_enqueued;                                  // requests pushed so far, wakes up idle workers
+        ACE_Atomic_Op<ACE_Thread_Mutex, long> m_activated;  // read without m_mutex by activated()
 
         void update_finished();
 };
@@ -24,6 +24,7 @@
 #include "ObjectAccessor.h"
 #include "MoveSplineInit.h"
 #include "MoveSpline.h"
+#include "PathGenerator.h"
 
 #define MIN_QUIET_DISTANCE 28.0f
 #define MAX_QUIET_DISTANCE 43.0f
@@ -47,8 +48,11 @@ FleeingMovementGenerator<T>::_setTargetLocation(T &owner)
 
     owner.AddUnitState(UNIT_STATE_FLEEING_MOVE);
 
+    PathGenerator path(&owner);
+    path.CalculatePath(x, y, z);
+
     Movement::MoveSplineInit init(owner);
-    init.MoveTo(x, y, z);
+    init.MovebyPath(path.GetPath());
     init.SetWalk(false);
     init.Launch();
 }
@@ -170,9 +174,13 @@ FleeingMovementGenerator<T>::_getPoint(T &owner, float &x, float &y, float &z)
 
             if (!(new_z - z) || distance / fabs(new_z - z) > 1.0f)
             {
-                float new_z_left = _map->GetHeight(temp_x + 1.0f*cos(angle+static_cast<float>(M_PI/2)),temp_y + 1.0f*sin(angle+static_cast<float>(M_PI/2)),z, true);
-                float new_z_right = _map->GetHeight(temp_x + 1.0f*cos(angle-static_cast<float>(M_PI/2)),temp_y + 1.0f*sin(angle-static_cast<float>(M_PI/2)),z, true);
-                if (fabs(new_z_left - new_z) < 1.2f && fabs(new_z_right - new_z) < 1.2f)
+                // left and right of the destination
+                float side_x[2] = { temp_x + 1.0f*cos(angle+static_cast<float>(M_PI/2)), temp_x + 1.0f*cos(angle-static_cast<float>(M_PI/2)) };
+                float side_y[2] = { temp_y + 1.0f*sin(angle+static_cast<float>(M_PI/2)), temp_y + 1.0f*sin(angle-static_cast<float>(M_PI/2)) };
+                float side_z[2] = { z, z };
+                float side_heights[2];
+                _map->GetHeights(2, side_x, side_y, side_z, side_heights, true);
+                if (fabs(side_heights[0] - new_z) < 1.2f && fabs(side_heights[1] - new_z) < 1.2f)
                 {
                     x = temp_x;
                     y = temp_y;
@@ -23,6 +23,7 @@
 #include "WorldPacket.h"
 #include "MoveSplineInit.h"
 #include "MoveSpline.h"
+#include "PathGenerator.h"
 
 void HomeMovementGenerator<Creature>::Initialize(Creature & owner)
 {
@@ -50,7 +51,11 @@ void HomeMovementGenerator<Creature>::_setTargetLocation(Creature & owner)
     owner.GetHomePosition(x, y, z, o);
     init.SetFacing(o);
     //}
-    init.MoveTo(x, y, z);
+
+    // evading creatures must reach home even when the navmesh does not
+    PathGenerator path(&owner);
+    path.CalculatePath(x, y, z, true);
+    init.MovebyPath(path.GetPath());
     init.SetWalk(false);
     init.Launch();
 
@@ -25,6 +25,7 @@
 #include "MoveSplineInit.h"
 #include "MoveSpline.h"
 #include "Player.h"
+#include "PathGenerator.h"
 
 //----- Point Movement Generator
 template<class T>
@@ -34,8 +35,11 @@ void PointMovementGenerator<T>::Initialize(T &unit)
         unit.StopMoving();
 
     unit.AddUnitState(UNIT_STATE_ROAMING|UNIT_STATE_ROAMING_MOVE);
+    PathGenerator path(&unit);
+    path.CalculatePath(i_x, i_y, i_z, true);
+
     Movement::MoveSplineInit init(unit);
-    init.MoveTo(i_x, i_y, i_z);
+    init.MovebyPath(path.GetPath());
     if (speed > 0.0f)
         init.SetVelocity(speed);
     init.Launch();
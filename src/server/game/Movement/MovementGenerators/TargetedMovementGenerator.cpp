@@ -26,6 +26,7 @@
 #include "MoveSplineInit.h"
 #include "MoveSpline.h"
 #include "Player.h"
+#include "PathGenerator.h"
 
 #include <cmath>
 
@@ -77,8 +78,11 @@ void TargetedMovementGeneratorMedium<T, D>::_setTargetLocation(T &owner)
     i_targetReached = false;
     i_recalculateTravel = false;
 
+    PathGenerator path(&owner);
+    path.CalculatePath(x, y, z);
+
     Movement::MoveSplineInit init(owner);
-    init.MoveTo(x, y, z);
+    init.MovebyPath(path.GetPath());
     init.SetWalk(((D*)this)->EnableWalking());
     init.Launch();
 }
@@ -0,0 +1,313 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ * Copyright (C) 2008-2012 TrinityCore <http://www.trinitycore.org/>
+ * Copyright (C) 2005-2012 MaNGOS <http://getmangos.com/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PathGenerator.h"
+#include "Map.h"
+#include "Creature.h"
+#include "MMapFactory.h"
+#include "MMapDefines.h"
+#include "Log.h"
+
+#include "DetourCommon.h"
+
+////////////////// PathGenerator //////////////////
+PathGenerator::PathGenerator(Unit const* owner) :
+    _polyLength(0), _type(PATHFIND_BLANK), _forceDestination(false),
+    _sourceUnit(owner), _navMeshQuery(NULL)
+{
+    memset(_pathPolyRefs, 0, sizeof(_pathPolyRefs));
+}
+
+bool PathGenerator::CalculatePath(float destX, float destY, float destZ, bool forceDest)
+{
+    Movement::Vector3 dest(destX, destY, destZ);
+    SetEndPosition(dest);
+
+    Movement::Vector3 start(_sourceUnit->GetPositionX(), _sourceUnit->GetPositionY(), _sourceUnit->GetPositionZ());
+    SetStartPosition(start);
+
+    _forceDestination = forceDest;
+
+    // callers launch the path whatever the result, never leave them an empty one
+    if (!Trinity::IsValidMapCoord(destX, destY, destZ) ||
+        !Trinity::IsValidMapCoord(start.x, start.y, start.z))
+    {
+        BuildShortcut();
+        return false;
+    }
+
+    sLog->outDebug(LOG_FILTER_MAPS, "++ PathGenerator::CalculatePath() for " UI64FMTD, _sourceUnit->GetGUID());
+
+    // make sure the navMesh works - we can run on map w/o mmap
+    // check if the start and end point have a .mmtile loaded (can we pass via not loaded tile on the way?)
+    if (!CanUseNavMesh())
+    {
+        BuildShortcut();
+        _type = PathType(PATHFIND_NORMAL | PATHFIND_NOT_USING_PATH);
+        return true;
+    }
+
+    MMAP::MMapManager* mmap = MMAP::MMapFactory::createOrGetMMapManager();
+    _navMeshQuery = mmap->acquireNavMeshQuery(_sourceUnit->GetMapId());
+    if (!_navMeshQuery)
+    {
+        BuildShortcut();
+        _type = PathType(PATHFIND_NORMAL | PATHFIND_NOT_USING_PATH);
+        return true;
+    }
+
+    CreateFilter();
+    BuildPolyPath(start, dest);
+
+    mmap->releaseNavMeshQuery(_sourceUnit->GetMapId(), _navMeshQuery);
+    _navMeshQuery = NULL;
+    return true;
+}
+
+bool PathGenerator::CanUseNavMesh() const
+{
+    if (!MMAP::MMapFactory::isPathfindingEnabled())
+        return false;
+
+    // flying and passengers do not follow the ground
+    if (_sourceUnit->IsFlying() || _sourceUnit->GetTransport() || _sourceUnit->GetVehicle())
+        return false;
+
+    if (Creature const* creature = _sourceUnit->ToCreature())
+        if (!creature->canWalk() && !creature->canSwim())
+            return false;
+
+    return true;
+}
+
+dtPolyRef PathGenerator::GetPolyByLocation(float const* point, float* distance) const
+{
+    // first we check the current path
+    // if the current path doesn't contain the current poly,
+    // we need to use the expensive navMesh.findNearestPoly
+    dtPolyRef polyRef = INVALID_POLYREF;
+    float closestPoint[VERTEX_SIZE] = {0.0f, 0.0f, 0.0f};
+
+    // we don't have it in our old path
+    // try to get it by findNearestPoly()
+    // first try with low search box
+    float extents[VERTEX_SIZE] = {3.0f, 5.0f, 3.0f};    // bounds of poly search area
+    if (_navMeshQuery->findNearestPoly(point, extents, &_filter, &polyRef, closestPoint) == DT_SUCCESS && polyRef != INVALID_POLYREF)
+    {
+        *distance = dtVdist(closestPoint, point);
+        return polyRef;
+    }
+
+    // still nothing ..
+    // try with bigger search box
+    extents[1] = 200.0f;
+    if (_navMeshQuery->findNearestPoly(point, extents, &_filter, &polyRef, closestPoint) == DT_SUCCESS && polyRef != INVALID_POLYREF)
+    {
+        *distance = dtVdist(closestPoint, point);
+        return polyRef;
+    }
+
+    return INVALID_POLYREF;
+}
+
+void PathGenerator::BuildPolyPath(Movement::Vector3 const& startPos, Movement::Vector3 const& endPos)
+{
+    // *** getting start/end poly logic ***
+
+    float distToStartPoly, distToEndPoly;
+    float startPoint[VERTEX_SIZE] = {startPos.y, startPos.z, startPos.x};
+    float endPoint[VERTEX_SIZE] = {endPos.y, endPos.z, endPos.x};
+
+    dtPolyRef startPoly = GetPolyByLocation(startPoint, &distToStartPoly);
+    dtPolyRef endPoly = GetPolyByLocation(endPoint, &distToEndPoly);
+
+    // we have a hole in our mesh
+    // make shortcut path and mark it as NOPATH ( with flying exception )
+    // its up to caller how he will use this info
+    if (startPoly == INVALID_POLYREF || endPoly == INVALID_POLYREF)
+    {
+        sLog->outDebug(LOG_FILTER_MAPS, "++ BuildPolyPath :: (startPoly == 0 || endPoly == 0)\n");
+        BuildShortcut();
+        _type = PATHFIND_NOPATH;
+        return;
+    }
+
+    // we may need a better number here
+    bool farFromPoly = (distToStartPoly > 7.0f || distToEndPoly > 7.0f);
+    if (farFromPoly)
+    {
+        sLog->outDebug(LOG_FILTER_MAPS, "++ BuildPolyPath :: farFromPoly distToStartPoly=%.3f distToEndPoly=%.3f\n", distToStartPoly, distToEndPoly);
+
+        // swimming creatures leave the mesh below the water surface, let them go straight
+        if (Creature const* creature = _sourceUnit->ToCreature())
+        {
+            if (creature->canSwim() && _sourceUnit->GetBaseMap()->IsInWater(startPos.x, startPos.y, startPos.z))
+            {
+                BuildShortcut();
+                _type = PathType(PATHFIND_NORMAL | PATHFIND_NOT_USING_PATH);
+                return;
+            }
+        }
+
+        // the start is off the mesh, we cannot reach the polygons from here
+        if (distToStartPoly > 7.0f)
+        {
+            BuildShortcut();
+            _type = PATHFIND_NOPATH;
+            return;
+        }
+    }
+
+    // both on the same polygon, straight line is the path
+    if (startPoly == endPoly)
+    {
+        sLog->outDebug(LOG_FILTER_MAPS, "++ BuildPolyPath :: (startPoly == endPoly)\n");
+
+        _pathPolyRefs[0] = startPoly;
+        _polyLength = 1;
+
+        BuildShortcut();
+        _type = farFromPoly ? PATHFIND_INCOMPLETE : PATHFIND_NORMAL;
+        if (_type == PATHFIND_INCOMPLETE && _forceDestination)
+            _type = PathType(PATHFIND_NORMAL | PATHFIND_NOT_USING_PATH);
+        return;
+    }
+
+    int pathCount = 0;
+    dtStatus dtResult = _navMeshQuery->findPath(
+            startPoly,          // start polygon
+            endPoly,            // end polygon
+            startPoint,         // start position
+            endPoint,           // end position
+            &_filter,           // polygon search filter
+            _pathPolyRefs,      // [out] path
+            &pathCount,
+            MAX_PATH_LENGTH);   // max number of polygons in output path
+
+    if (pathCount <= 0 || dtResult != DT_SUCCESS)
+    {
+        // only happens if we passed bad data to findPath(), or navmesh is messed up
+        sLog->outError("%u's Path Build failed: 0 length path", _sourceUnit->GetGUIDLow());
+        BuildShortcut();
+        _type = PATHFIND_NOPATH;
+        return;
+    }
+
+    _polyLength = uint32(pathCount);
+
+    // the search ran out of nodes or polygons before reaching the end polygon
+    if (_pathPolyRefs[_polyLength - 1] != endPoly || farFromPoly)
+        _type = PATHFIND_INCOMPLETE;
+    else
+        _type = PATHFIND_NORMAL;
+
+    // generate the point-path out of our up-to-date poly-path
+    BuildPointPath(startPoint, endPoint);
+}
+
+void PathGenerator::BuildPointPath(float const* startPoint, float const* endPoint)
+{
+    float pathPoints[MAX_POINT_PATH_LENGTH * VERTEX_SIZE];
+    int pointCount = 0;
+
+    dtStatus dtResult = _navMeshQuery->findStraightPath(
+            startPoint,         // start position
+            endPoint,           // end position
+            _pathPolyRefs,      // current path
+            int(_polyLength),   // lenth of current path
+            pathPoints,         // [out] path corner points
+            NULL,               // [out] flags
+            NULL,               // [out] shortened path
+            &pointCount,
+            MAX_POINT_PATH_LENGTH);   // maximum number of points/polygons to use
+
+    if (pointCount < 2 || dtResult != DT_SUCCESS)
+    {
+        // only happens if pass bad data to findStraightPath or navmesh is broken
+        // single point paths can be generated here
+        /// @todo check the exact cases
+        sLog->outDebug(LOG_FILTER_MAPS, "++ PathGenerator::BuildPointPath FAILED! path sized %d returned\n", pointCount);
+        BuildShortcut();
+        _type = PATHFIND_NOPATH;
+        return;
+    }
+
+    // recast coordinates are (y, z, x)
+    _pathPoints.resize(pointCount);
+    for (int i = 0; i < pointCount; ++i)
+        _pathPoints[i] = Movement::Vector3(pathPoints[i * VERTEX_SIZE + 2], pathPoints[i * VERTEX_SIZE], pathPoints[i * VERTEX_SIZE + 1]);
+
+    // the last point is as close to the destination as the path gets
+    SetActualEndPosition(_pathPoints[pointCount - 1]);
+
+    // force the given destination, if needed
+    if (_forceDestination &&
+        (!(_type & PATHFIND_NORMAL) || !_actualEndPosition.fuzzyEq(_endPosition)))
+    {
+        // we may want to keep partial subpath
+        if ((_actualEndPosition - _endPosition).squaredLength() < 0.09f * (_startPosition - _endPosition).squaredLength())
+        {
+            SetActualEndPosition(_endPosition);
+            _pathPoints[_pathPoints.size() - 1] = _endPosition;
+        }
+        else
+        {
+            SetActualEndPosition(_endPosition);
+            BuildShortcut();
+        }
+
+        _type = PathType(PATHFIND_NORMAL | PATHFIND_NOT_USING_PATH);
+    }
+
+    sLog->outDebug(LOG_FILTER_MAPS, "++ PathGenerator::BuildPointPath path type %d size %d poly-size %d\n", _type, pointCount, _polyLength);
+}
+
+void PathGenerator::BuildShortcut()
+{
+    Clear();
+
+    // make two point path, our curr pos is the start, and dest is the end
+    _pathPoints.resize(2);
+
+    // set start and a default next position
+    _pathPoints[0] = _startPosition;
+    _pathPoints[1] = _actualEndPosition;
+
+    _type = PATHFIND_SHORTCUT;
+}
+
+void PathGenerator::CreateFilter()
+{
+    uint16 includeFlags = 0;
+    uint16 excludeFlags = NAV_MAGMA | NAV_SLIME;
+
+    if (Creature const* creature = _sourceUnit->ToCreature())
+    {
+        if (creature->canWalk())
+            includeFlags |= NAV_GROUND;
+
+        if (creature->canSwim())
+            includeFlags |= NAV_WATER;
+    }
+    else
+        includeFlags = NAV_GROUND | NAV_WATER;
+
+    _filter.setIncludeFlags(includeFlags);
+    _filter.setExcludeFlags(excludeFlags);
+}
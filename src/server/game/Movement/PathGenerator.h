@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ * Copyright (C) 2008-2012 TrinityCore <http://www.trinitycore.org/>
+ * Copyright (C) 2005-2012 MaNGOS <http://getmangos.com/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_PATHGENERATOR_H
+#define TRINITY_PATHGENERATOR_H
+
+#include "SharedDefines.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+#include "MoveSplineInitArgs.h"
+
+class Unit;
+
+// 74*4.0f=296y  number_of_points*interval = max_path_len
+// this is way more than actual evade range
+// I think we can safely cut those down even more
+#define MAX_PATH_LENGTH         74
+#define MAX_POINT_PATH_LENGTH   74
+
+#define VERTEX_SIZE       3
+#define INVALID_POLYREF   0
+
+enum PathType
+{
+    PATHFIND_BLANK          = 0x00,   // path not built yet
+    PATHFIND_NORMAL         = 0x01,   // normal path
+    PATHFIND_SHORTCUT       = 0x02,   // travel through obstacles, terrain, air, etc (old behavior)
+    PATHFIND_INCOMPLETE     = 0x04,   // we have partial path to follow - getting closer to target
+    PATHFIND_NOPATH         = 0x08,   // no valid path at all or error in generating one
+    PATHFIND_NOT_USING_PATH = 0x10    // used when we are either flying/swiming or on map w/o mmaps
+};
+
+// builds the movement path of a unit on the navmesh of its map
+// when no navmesh is usable the path is the straight line to the destination
+class PathGenerator
+{
+    public:
+        explicit PathGenerator(Unit const* owner);
+        ~PathGenerator() { }
+
+        // calculate the path from the owner position to the given destination
+        // return: true if a new path was calculated, false otherwise (no change needed)
+        bool CalculatePath(float destX, float destY, float destZ, bool forceDest = false);
+
+        Movement::Vector3 const& GetStartPosition() const { return _startPosition; }
+        Movement::Vector3 const& GetEndPosition() const { return _endPosition; }
+        Movement::Vector3 const& GetActualEndPosition() const { return _actualEndPosition; }
+
+        Movement::PointsArray const& GetPath() const { return _pathPoints; }
+        PathType GetPathType() const { return _type; }
+
+    private:
+        dtPolyRef _pathPolyRefs[MAX_PATH_LENGTH];   // array of Detour polygon references
+        uint32 _polyLength;                         // number of polygons in the path
+
+        Movement::PointsArray _pathPoints;          // our actual (x,y,z) path to the target
+        PathType _type;                             // tells what kind of path this is
+
+        bool _forceDestination;                     // when set, we will always arrive at given point
+
+        Movement::Vector3 _startPosition;           // {x, y, z} of current location
+        Movement::Vector3 _endPosition;             // {x, y, z} of the destination
+        Movement::Vector3 _actualEndPosition;       // {x, y, z} of the closest possible point to given destination
+
+        Unit const* const _sourceUnit;              // the unit that is moving
+        dtNavMeshQuery const* _navMeshQuery;        // the nav mesh query used to find the path, only set while calculating
+        dtQueryFilter _filter;                      // use single filter for all movements, update it when needed
+
+        void SetStartPosition(Movement::Vector3 const& point) { _startPosition = point; }
+        void SetEndPosition(Movement::Vector3 const& point) { _actualEndPosition = point; _endPosition = point; }
+        void SetActualEndPosition(Movement::Vector3 const& point) { _actualEndPosition = point; }
+
+        void Clear()
+        {
+            _polyLength = 0;
+            _pathPoints.clear();
+        }
+
+        dtPolyRef GetPolyByLocation(float const* point, float* distance) const;
+
+        void BuildPolyPath(Movement::Vector3 const& startPos, Movement::Vector3 const& endPos);
+        void BuildPointPath(float const* startPoint, float const* endPoint);
+        void BuildShortcut();
+
+        void CreateFilter();
+        bool CanUseNavMesh() const;
+};
+
+#endif
@@ -55,7 +55,11 @@ void Map::ScriptsStart(ScriptMapMap const& scripts, uint32 id, Object* source, O
         sa.ownerGUID  = ownerGUID;
 
         sa.script = &iter->second;
-        m_scriptSchedule.insert(ScriptScheduleMap::value_type(time_t(sWorld->GetGameTime() + iter->first), sa));
+        {
+            // creatures may start scripts while grid regions are updated in parallel
+            TRINITY_GUARD(ACE_Thread_Mutex, _deferredLock);
+            m_scriptSchedule.insert(ScriptScheduleMap::value_type(time_t(sWorld->GetGameTime() + iter->first), sa));
+        }
         if (iter->first == 0)
             immedScript = true;
 
@@ -85,7 +89,10 @@ void Map::ScriptCommandStart(ScriptInfo const& script, uint32 delay, Object* sou
     sa.ownerGUID  = ownerGUID;
 
     sa.script = &script;
-    m_scriptSchedule.insert(ScriptScheduleMap::value_type(time_t(sWorld->GetGameTime() + delay), sa));
+    {
+        TRINITY_GUARD(ACE_Thread_Mutex, _deferredLock);
+        m_scriptSchedule.insert(ScriptScheduleMap::value_type(time_t(sWorld->GetGameTime() + delay), sa));
+    }
 
     sScriptMgr->IncreaseScheduledScriptsCount();
 
@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ * Copyright (C) 2008-2012 TrinityCore <http://www.trinitycore.org/>
+ * Copyright (C) 2005-2012 MaNGOS <http://getmangos.com/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** \file
+    \ingroup u2w
+*/
+
+#include "OpcodeStats.h"
+#include "Config.h"
+#include "Log.h"
+
+#include <ace/TSS_T.h>
+#include <ace/OS_NS_unistd.h>
+
+uint32 OpcodeCounters::GetLatencyPercentile(float share) const
+{
+    uint64 limit = uint64(handled * share);
+    uint64 calls = 0;
+    for (uint8 i = 0; i < OPCODE_LATENCY_BUCKETS - 1; ++i)
+    {
+        calls += latency[i];
+        if (calls >= limit)
+            return 1 << i;
+    }
+
+    return uint32(maxHandlerTime);
+}
+
+/// Counters of the current thread, owned by OpcodeStats so they outlive the thread.
+struct OpcodeStatsThreadPtr
+{
+    OpcodeStatsThreadPtr() : counters(NULL) { }
+
+    void* counters;
+};
+
+typedef ACE_TSS<OpcodeStatsThreadPtr> OpcodeStatsThreadPtrTSS;
+static OpcodeStatsThreadPtrTSS threadCounters;
+
+OpcodeStats::OpcodeStats() : _enabled(false), _ticksPerUsec(0), _generation(0)
+{
+}
+
+OpcodeStats::~OpcodeStats()
+{
+    for (std::vector<ThreadCounters*>::const_iterator itr = _threads.begin(); itr != _threads.end(); ++itr)
+    {
+        for (uint32 i = 0; i < NUM_MSG_TYPES; ++i)
+            delete (*itr)->counters[i];
+        delete *itr;
+    }
+}
+
+void OpcodeStats::Initialize(bool enabled)
+{
+    // once at startup, before the handlers may see _enabled; a config reload keeps the rate
+    if (!_ticksPerUsec)
+        Calibrate();
+
+    std::string logsDir = ConfigMgr::GetStringDefault("LogsDir", "");
+    if (!logsDir.empty())
+    {
+        if ((logsDir.at(logsDir.length()-1) != '/') && (logsDir.at(logsDir.length()-1) != '\\'))
+            logsDir.push_back('/');
+    }
+
+    std::string dumpFile = ConfigMgr::GetStringDefault("OpcodeStats.DumpFile", "");
+    _dumpFile = dumpFile.empty() ? dumpFile : logsDir + dumpFile;
+
+    _enabled = enabled;
+}
+
+void OpcodeStats::Calibrate()
+{
+    ACE_Time_Value startTime = ACE_OS::gettimeofday();
+    uint64 startTicks = GetOpcodeStatsTicks();
+    ACE_OS::sleep(ACE_Time_Value(0, 20000));
+    uint64 ticks = GetOpcodeStatsTicks() - startTicks;
+
+    ACE_UINT64 usec;
+    (ACE_OS::gettimeofday() - startTime).to_usec(usec);
+    _ticksPerUsec = std::max<uint64>(usec ? ticks / usec : 1, 1);
+
+    // ticks of 1000 reads / ticks per usec = nsec per read
+    const uint32 reads = 1000;
+    startTicks = GetOpcodeStatsTicks();
+    for (uint32 i = 1; i < reads; ++i)
+        GetOpcodeStatsTicks();
+    ticks = GetOpcodeStatsTicks() - startTicks;
+
+    sLog->outString("OpcodeStats: " UI64FMTD " clock ticks per usec, a handler call costs two clock reads of " UI64FMTD " nsec.",
+        _ticksPerUsec, ticks / _ticksPerUsec);
+}
+
+OpcodeCounters* OpcodeStats::GetCounters(uint32 opcode)
+{
+    if (opcode >= NUM_MSG_TYPES)
+        return NULL;
+
+    ThreadCounters* thread = static_cast<ThreadCounters*>(threadCounters->counters);
+    if (!thread)
+    {
+        thread = new ThreadCounters();
+        thread->generation = _generation.value();
+        memset(thread->counters, 0, sizeof(thread->counters));
+
+        TRINITY_GUARD(ACE_Thread_Mutex, _lock);
+        _threads.push_back(thread);
+        threadCounters->counters = thread;
+    }
+    else if (thread->generation != _generation.value())
+    {
+        for (uint32 i = 0; i < NUM_MSG_TYPES; ++i)
+            if (thread->counters[i])
+                memset(thread->counters[i], 0, sizeof(OpcodeCounters));
+        thread->generation = _generation.value();
+    }
+
+    OpcodeCounters*& counters = thread->counters[opcode];
+    if (!counters)
+    {
+        OpcodeCounters* newCounters = new OpcodeCounters();
+        memset(newCounters, 0, sizeof(OpcodeCounters));
+        counters = newCounters;
+    }
+
+    return counters;
+}
+
+void OpcodeStats::RecordReceived(uint32 opcode, size_t size)
+{
+    if (!_enabled)
+        return;
+
+    if (OpcodeCounters* counters = GetCounters(opcode))
+    {
+        ++counters->received;
+        counters->bytesIn += size;
+    }
+}
+
+void OpcodeStats::RecordHandled(uint32 opcode, uint64 ticks)
+{
+    OpcodeCounters* counters = GetCounters(opcode);
+    if (!counters)
+        return;
+
+    uint32 usec = _ticksPerUsec ? uint32(ticks / _ticksPerUsec) : 0;
+    ++counters->handled;
+    counters->handlerTime += usec;
+    if (usec > counters->maxHandlerTime)
+        counters->maxHandlerTime = usec;
+
+    uint8 bucket = 0;
+    while (usec && bucket < OPCODE_LATENCY_BUCKETS - 1)
+    {
+        usec >>= 1;
+        ++bucket;
+    }
+    ++counters->latency[bucket];
+}
+
+void OpcodeStats::RecordSent(uint32 opcode, size_t size)
+{
+    if (!_enabled)
+        return;
+
+    if (OpcodeCounters* counters = GetCounters(opcode))
+    {
+        ++counters->sent;
+        counters->bytesOut += size;
+    }
+}
+
+void OpcodeStats::Collect(OpcodeStatsEntries& entries)
+{
+    entries.clear();
+
+    TRINITY_GUARD(ACE_Thread_Mutex, _lock);
+    long generation = _generation.value();
+
+    // counters are written by their thread without any lock, the sums may be off by the packets in flight
+    for (uint32 opcode = 0; opcode < NUM_MSG_TYPES; ++opcode)
+    {
+        OpcodeStatsEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.opcode = opcode;
+        bool found = false;
+
+        for (std::vector<ThreadCounters*>::const_iterator itr = _threads.begin(); itr != _threads.end(); ++itr)
+        {
+            // the thread has not seen the last reset yet
+            if ((*itr)->generation != generation)
+                continue;
+
+            OpcodeCounters const* counters = (*itr)->counters[opcode];
+            if (!counters)
+                continue;
+
+            found = true;
+            entry.received += counters->received;
+            entry.bytesIn += counters->bytesIn;
+            entry.handled += counters->handled;
+            entry.handlerTime += counters->handlerTime;
+            entry.maxHandlerTime = std::max(entry.maxHandlerTime, counters->maxHandlerTime);
+            for (uint8 i = 0; i < OPCODE_LATENCY_BUCKETS; ++i)
+                entry.latency[i] += counters->latency[i];
+            entry.sent += counters->sent;
+            entry.bytesOut += counters->bytesOut;
+        }
+
+        if (found && (entry.received || entry.handled || entry.sent))
+            entries.push_back(entry);
+    }
+}
+
+void OpcodeStats::Reset()
+{
+    ++_generation;
+}
+
+bool OpcodeStats::Dump()
+{
+    if (_dumpFile.empty())
+        return false;
+
+    OpcodeStatsEntries entries;
+    Collect(entries);
+
+    FILE* file = fopen(_dumpFile.c_str(), "w");
+    if (!file)
+    {
+        sLog->outError("OpcodeStats: can't open %s for writing.", _dumpFile.c_str());
+        return false;
+    }
+
+    fprintf(file, "opcode,name,processing,received,bytes_in,handled,total_us,avg_us,p50_us,p99_us,max_us,sent,bytes_out\n");
+    for (OpcodeStatsEntries::const_iterator itr = entries.begin(); itr != entries.end(); ++itr)
+    {
+        static char const* processing[] = { "inplace", "threadunsafe", "threadsafe" };
+
+        fprintf(file, "0x%.4X,%s,%s," UI64FMTD "," UI64FMTD "," UI64FMTD "," UI64FMTD "," UI64FMTD ",%u,%u," UI64FMTD "," UI64FMTD "," UI64FMTD "\n",
+            itr->opcode, LookupOpcodeName(itr->opcode), processing[opcodeTable[itr->opcode].packetProcessing],
+            itr->received, itr->bytesIn, itr->handled, itr->handlerTime, itr->handled ? itr->handlerTime / itr->handled : UI64LIT(0),
+            itr->GetLatencyPercentile(0.5f), itr->GetLatencyPercentile(0.99f), itr->maxHandlerTime, itr->sent, itr->bytesOut);
+    }
+
+    fclose(file);
+    return true;
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ * Copyright (C) 2008-2012 TrinityCore <http://www.trinitycore.org/>
+ * Copyright (C) 2005-2012 MaNGOS <http://getmangos.com/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/// \addtogroup u2w
+/// @{
+/// \file
+
+#ifndef TRINITY_OPCODESTATS_H
+#define TRINITY_OPCODESTATS_H
+
+#include "Common.h"
+#include "Opcodes.h"
+
+#include <ace/Singleton.h>
+#include <ace/Atomic_Op.h>
+#include <ace/Thread_Mutex.h>
+#include <ace/OS_NS_sys_time.h>
+
+#include <vector>
+
+#if COMPILER == COMPILER_MICROSOFT
+#  include <intrin.h>
+#endif
+
+/// Handler time histogram, bucket i counts the calls that took less than 2^i usec, the last one all slower calls.
+#define OPCODE_LATENCY_BUCKETS 16
+
+/// Time stamp counter of the core, OpcodeStats converts its ticks to usec. Falls back to gettimeofday in usec.
+inline uint64 GetOpcodeStatsTicks()
+{
+#if COMPILER == COMPILER_MICROSOFT
+    return __rdtsc();
+#elif defined(__i386__) || defined(__x86_64__)
+    uint32 lo, hi;
+    __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+    return (uint64(hi) << 32) | lo;
+#else
+    ACE_UINT64 usec;
+    ACE_OS::gettimeofday().to_usec(usec);
+    return usec;
+#endif
+}
+
+struct OpcodeCounters
+{
+    uint64 received;                                        // packets read from the sockets
+    uint64 bytesIn;                                         // their payload
+    uint64 handled;                                         // handler calls
+    uint64 handlerTime;                                     // usec spent in the handler
+    uint64 maxHandlerTime;
+    uint64 latency[OPCODE_LATENCY_BUCKETS];
+    uint64 sent;                                            // packets queued to the sockets
+    uint64 bytesOut;                                        // their payload
+
+    /// Upper bound in usec of the handler time of the given share (0..1) of the calls.
+    uint32 GetLatencyPercentile(float share) const;
+};
+
+struct OpcodeStatsEntry : public OpcodeCounters
+{
+    uint32 opcode;
+};
+
+typedef std::vector<OpcodeStatsEntry> OpcodeStatsEntries;
+
+/**
+ * Per opcode packet, byte and handler time counters.
+ *
+ * Every thread counts into its own block, so recording takes no lock and
+ * shares no cache line with other threads; readers sum the blocks. Each
+ * handler call reads the time stamp counter twice, the first Initialize
+ * calibrates it against gettimeofday and logs what a read costs on the host.
+ */
+class OpcodeStats
+{
+    friend class ACE_Singleton<OpcodeStats, ACE_Thread_Mutex>;
+
+    public:
+        void Initialize(bool enabled);
+        bool IsEnabled() const { return _enabled; }
+
+        void RecordReceived(uint32 opcode, size_t size);
+        void RecordHandled(uint32 opcode, uint64 ticks);
+        void RecordSent(uint32 opcode, size_t size);
+
+        /// Counters of all opcodes seen since the last reset.
+        void Collect(OpcodeStatsEntries& entries);
+        void Reset();
+
+        /// Writes the counters as csv to OpcodeStats.DumpFile, false if no file is configured or it can't be written.
+        bool Dump();
+        std::string const& GetDumpFile() const { return _dumpFile; }
+
+    private:
+        OpcodeStats();
+        ~OpcodeStats();
+
+        struct ThreadCounters
+        {
+            long generation;
+            OpcodeCounters* counters[NUM_MSG_TYPES];
+        };
+
+        OpcodeCounters* GetCounters(uint32 opcode);
+        /// Measures the clock ticks per usec and logs the cost of a clock read.
+        void Calibrate();
+
+        bool _enabled;
+        std::string _dumpFile;
+        uint64 _ticksPerUsec;                               // 0 until calibrated
+
+        ACE_Thread_Mutex _lock;                             // guards _threads
+        std::vector<ThreadCounters*> _threads;
+        ACE_Atomic_Op<ACE_Thread_Mutex, long> _generation;  // bumped by Reset, stale thread counters are zeroed by their owner
+};
+
+#define sOpcodeStats ACE_Singleton<OpcodeStats, ACE_Thread_Mutex>::instance()
+
+/// Times the handler call of its scope.
+class OpcodeStatsTimer
+{
+    public:
+        explicit OpcodeStatsTimer(uint32 opcode) : _opcode(opcode), _enabled(sOpcodeStats->IsEnabled())
+        {
+            if (_enabled)
+                _start = GetOpcodeStatsTicks();
+        }
+
+        ~OpcodeStatsTimer()
+        {
+            if (!_enabled)
+                return;
+
+            // the counters of two cores may be slightly apart when the thread moved
+            uint64 end = GetOpcodeStatsTicks();
+            sOpcodeStats->RecordHandled(_opcode, end > _start ? end - _start : 0);
+        }
+
+    private:
+        uint32 _opcode;
+        bool _enabled;
+        uint64 _start;
+};
+
+#endif
+/// @}
@@ -33,9 +33,29 @@ static void DefineOpcode(uint32 opcode, const char* name, SessionStatus status,
     opcodeTable[opcode].status = status;
     opcodeTable[opcode].packetProcessing = packetProcessing;
     opcodeTable[opcode].handler = handler;
+    opcodeTable[opcode].domain = OPCODE_DOMAIN_WORLD;
+}
+
+static void DefineOpcodeDomain(uint32 opcode, OpcodeDomain domain)
+{
+    // only handlers kept out of the map updates need a domain
+    ASSERT(opcodeTable[opcode].packetProcessing == PROCESS_THREADUNSAFE);
+    opcodeTable[opcode].domain = domain;
 }
 
 #define OPCODE( name, status, packetProcessing, handler ) DefineOpcode( name, #name, status, packetProcessing, handler )
+#define OPCODE_DOMAIN( name, domain ) DefineOpcodeDomain( name, domain )
+
+static ACE_Thread_Mutex opcodeDomainLocks[MAX_OPCODE_DOMAINS];
+
+ACE_Thread_Mutex* GetOpcodeDomainLock(OpcodeDomain domain)
+{
+    // query handlers only read, the world domain is never processed concurrently
+    if (domain == OPCODE_DOMAIN_QUERY || domain == OPCODE_DOMAIN_WORLD)
+        return NULL;
+
+    return &opcodeDomainLocks[domain];
+}
 
 void InitOpcodeTable()
 {
@@ -1229,15 +1249,15 @@ void InitOpcodeTable()
     OPCODE( CMSG_CHAR_FACTION_CHANGE,                     STATUS_AUTHED,   PROCESS_THREADUNSAFE, &WorldSession::HandleCharFactionOrRaceChange    );
     OPCODE( SMSG_CHAR_FACTION_CHANGE,                     STATUS_NEVER,    PROCESS_INPLACE,       &WorldSession::Handle_ServerSide               );
     OPCODE( SMSG_BATTLEFIELD_MGR_ENTRY_INVITE,            STATUS_NEVER,    PROCESS_INPLACE,       &WorldSession::Handle_ServerSide               );
-    OPCODE( CMSG_BATTLEFIELD_MGR_ENTRY_INVITE_RESPONSE,   STATUS_LOGGEDIN, PROCESS_INPLACE,       &WorldSession::HandleBfEntryInviteResponse     );
+    OPCODE( CMSG_BATTLEFIELD_MGR_ENTRY_INVITE_RESPONSE,   STATUS_LOGGEDIN, PROCESS_THREADUNSAFE,  &WorldSession::HandleBfEntryInviteResponse     );
     OPCODE( SMSG_BATTLEFIELD_MGR_ENTERED,                 STATUS_NEVER,    PROCESS_INPLACE,       &WorldSession::Handle_ServerSide               );
     OPCODE( SMSG_BATTLEFIELD_MGR_QUEUE_INVITE,            STATUS_NEVER,    PROCESS_INPLACE,       &WorldSession::Handle_ServerSide               );
-    OPCODE( CMSG_BATTLEFIELD_MGR_QUEUE_INVITE_RESPONSE,   STATUS_LOGGEDIN, PROCESS_INPLACE,       &WorldSession::HandleBfQueueInviteResponse     );
+    OPCODE( CMSG_BATTLEFIELD_MGR_QUEUE_INVITE_RESPONSE,   STATUS_LOGGEDIN, PROCESS_THREADUNSAFE,  &WorldSession::HandleBfQueueInviteResponse     );
     OPCODE( CMSG_BATTLEFIELD_MGR_QUEUE_REQUEST,           STATUS_NEVER,    PROCESS_INPLACE,       &WorldSession::Handle_NULL                     );
     OPCODE( SMSG_BATTLEFIELD_MGR_QUEUE_REQUEST_RESPONSE,  STATUS_NEVER,    PROCESS_INPLACE,       &WorldSession::Handle_ServerSide               );
     OPCODE( SMSG_BATTLEFIELD_MGR_EJECT_PENDING,           STATUS_NEVER,    PROCESS_INPLACE,       &WorldSession::Handle_ServerSide               );
     OPCODE( SMSG_BATTLEFIELD_MGR_EJECTED,                 STATUS_NEVER,    PROCESS_INPLACE,       &WorldSession::Handle_ServerSide               );
-    OPCODE( CMSG_BATTLEFIELD_MGR_EXIT_REQUEST,            STATUS_LOGGEDIN, PROCESS_INPLACE,       &WorldSession::HandleBfExitRequest             );
+    OPCODE( CMSG_BATTLEFIELD_MGR_EXIT_REQUEST,            STATUS_LOGGEDIN, PROCESS_THREADUNSAFE,  &WorldSession::HandleBfExitRequest             );
     OPCODE( SMSG_BATTLEFIELD_MGR_STATE_CHANGE,            STATUS_NEVER,    PROCESS_INPLACE,       &WorldSession::Handle_ServerSide               );
     OPCODE( MSG_SET_RAID_DIFFICULTY,                      STATUS_LOGGEDIN, PROCESS_THREADUNSAFE,  &WorldSession::HandleSetRaidDifficultyOpcode   );
     OPCODE( SMSG_TOGGLE_XP_GAIN,                          STATUS_NEVER,    PROCESS_INPLACE,       &WorldSession::Handle_ServerSide               );
@@ -1274,10 +1294,106 @@ void InitOpcodeTable()
     OPCODE( CMSG_REDIRECT_AUTH_PROOF,                     STATUS_NEVER,    PROCESS_INPLACE,       &WorldSession::Handle_NULL                     );
     OPCODE( CMSG_AUTO_DECLINE_GUILD_INVITES,              STATUS_NEVER,    PROCESS_INPLACE,       &WorldSession::Handle_NULL                     );
     OPCODE( CMSG_SET_PRIMARY_TALENT_TREE,                 STATUS_NEVER,    PROCESS_INPLACE,       &WorldSession::Handle_NULL                     );
-    OPCODE( CMSG_GROUP_SET_ROLES,                         STATUS_LOGGEDIN, PROCESS_INPLACE,       &WorldSession::HandleGroupSetRoles             );
+    OPCODE( CMSG_GROUP_SET_ROLES,                         STATUS_LOGGEDIN, PROCESS_THREADUNSAFE,  &WorldSession::HandleGroupSetRoles             );
     OPCODE( CMSG_GUILD_UPDATE_PARTY_STATE,                STATUS_LOGGEDIN, PROCESS_INPLACE,       &WorldSession::HandleGuildPartyStateUpdate     );
     OPCODE( CMSG_GUILD_QUERY_NEWS,                        STATUS_LOGGEDIN, PROCESS_INPLACE,       &WorldSession::HandleGuildQueryNews            );
     OPCODE( SMSG_UNKNOWN_1310,                            STATUS_NEVER,    PROCESS_INPLACE,       &WorldSession::Handle_ServerSide               );
     OPCODE( CMSG_RETURN_TO_GRAVEYARD,                     STATUS_LOGGEDIN, PROCESS_THREADUNSAFE,  &WorldSession::HandleMoveToGraveyard           );
-    OPCODE( CMSG_REFORGE_ITEM,                            STATUS_LOGGEDIN, PROCESS_INPLACE,       &WorldSession::HandleReforgeItem               );
+    OPCODE( CMSG_REFORGE_ITEM,                            STATUS_LOGGEDIN, PROCESS_THREADUNSAFE,  &WorldSession::HandleReforgeItem               );
+
+    ///- Thread-unsafe handlers that only change their own player and the state of their domain, the domains
+    ///- run concurrently (OPCODE_DOMAIN_QUERY even without a lock). Handlers that read or change other players
+    ///- (invites, inspects, mail and auction deliveries) or may earn achievements, whose SendAchievementEarned
+    ///- broadcasts to the guild, stay in OPCODE_DOMAIN_WORLD with every other PROCESS_THREADUNSAFE opcode
+
+    // read static data and the names of other players
+    OPCODE_DOMAIN( CMSG_NAME_QUERY,                               OPCODE_DOMAIN_QUERY );
+    OPCODE_DOMAIN( CMSG_PET_NAME_QUERY,                           OPCODE_DOMAIN_QUERY );
+    OPCODE_DOMAIN( CMSG_PAGE_TEXT_QUERY,                          OPCODE_DOMAIN_QUERY );
+    OPCODE_DOMAIN( CMSG_GAMEOBJECT_QUERY,                         OPCODE_DOMAIN_QUERY );
+    OPCODE_DOMAIN( CMSG_CREATURE_QUERY,                           OPCODE_DOMAIN_QUERY );
+    OPCODE_DOMAIN( CMSG_NPC_TEXT_QUERY,                           OPCODE_DOMAIN_QUERY );
+    OPCODE_DOMAIN( CMSG_ITEM_NAME_QUERY,                          OPCODE_DOMAIN_QUERY );
+    OPCODE_DOMAIN( CMSG_QUEST_POI_QUERY,                          OPCODE_DOMAIN_QUERY );
+    OPCODE_DOMAIN( CMSG_QUERY_TIME,                               OPCODE_DOMAIN_QUERY );
+    OPCODE_DOMAIN( CMSG_QUERY_QUESTS_COMPLETED,                   OPCODE_DOMAIN_QUERY );
+
+    // only change their own player and guild, so the achievements they earn only broadcast under this domain's lock;
+    // invite, leave (may pass the leadership on), remove, promote, ... change other members and stay in OPCODE_DOMAIN_WORLD
+    OPCODE_DOMAIN( CMSG_GUILD_QUERY,                              OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( CMSG_GUILD_ACCEPT,                             OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( CMSG_GUILD_DECLINE,                            OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( CMSG_GUILD_INFO,                               OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( CMSG_GUILD_ROSTER,                             OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( CMSG_GUILD_MOTD,                               OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( CMSG_QUERY_GUILD_REWARDS,                      OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( CMSG_QUERY_GUILD_XP,                           OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( CMSG_QUERY_GUILD_MAX_XP,                       OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( CMSG_GUILD_RANK,                               OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( CMSG_GUILD_RANKS,                              OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( CMSG_GUILD_ADD_RANK,                           OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( CMSG_GUILD_DEL_RANK,                           OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( CMSG_GUILD_SET_NOTE,                           OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( CMSG_GUILD_QUERY_TRADESKILL,                   OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( CMSG_GUILD_INFO_TEXT,                          OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( MSG_SAVE_GUILD_EMBLEM,                         OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( MSG_GUILD_PERMISSIONS,                         OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( MSG_GUILD_EVENT_LOG_QUERY,                     OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( CMSG_GUILD_BANKER_ACTIVATE,                    OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( CMSG_GUILD_BANK_QUERY_TAB,                     OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( CMSG_GUILD_BANK_SWAP_ITEMS,                    OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( CMSG_GUILD_BANK_BUY_TAB,                       OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( CMSG_GUILD_BANK_UPDATE_TAB,                    OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( CMSG_GUILD_BANK_DEPOSIT_MONEY,                 OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( CMSG_GUILD_BANK_WITHDRAW_MONEY,                OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( MSG_GUILD_BANK_LOG_QUERY,                      OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( MSG_GUILD_BANK_MONEY_WITHDRAWN,                OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( MSG_QUERY_GUILD_BANK_TEXT,                     OPCODE_DOMAIN_GUILD );
+    OPCODE_DOMAIN( CMSG_SET_GUILD_BANK_TEXT,                      OPCODE_DOMAIN_GUILD );
+
+    // only read and delete the own mails and list the auctions, sending, taking money or items and bidding stay in OPCODE_DOMAIN_WORLD
+    OPCODE_DOMAIN( CMSG_GET_MAIL_LIST,                            OPCODE_DOMAIN_MAIL );
+    OPCODE_DOMAIN( CMSG_ITEM_TEXT_QUERY,                          OPCODE_DOMAIN_MAIL );
+    OPCODE_DOMAIN( CMSG_MAIL_MARK_AS_READ,                        OPCODE_DOMAIN_MAIL );
+    OPCODE_DOMAIN( CMSG_MAIL_DELETE,                              OPCODE_DOMAIN_MAIL );
+    OPCODE_DOMAIN( MSG_QUERY_NEXT_MAIL_TIME,                      OPCODE_DOMAIN_MAIL );
+    OPCODE_DOMAIN( MSG_AUCTION_HELLO,                             OPCODE_DOMAIN_MAIL );
+    OPCODE_DOMAIN( CMSG_AUCTION_LIST_ITEMS,                       OPCODE_DOMAIN_MAIL );
+    OPCODE_DOMAIN( CMSG_AUCTION_LIST_OWNER_ITEMS,                 OPCODE_DOMAIN_MAIL );
+    OPCODE_DOMAIN( CMSG_AUCTION_LIST_BIDDER_ITEMS,                OPCODE_DOMAIN_MAIL );
+    OPCODE_DOMAIN( CMSG_AUCTION_LIST_PENDING_SALES,               OPCODE_DOMAIN_MAIL );
+
+    // chat messages may be commands and stay in OPCODE_DOMAIN_WORLD, as the invite that reads the ignore list of the invitee
+    OPCODE_DOMAIN( CMSG_JOIN_CHANNEL,                             OPCODE_DOMAIN_CHANNEL );
+    OPCODE_DOMAIN( CMSG_LEAVE_CHANNEL,                            OPCODE_DOMAIN_CHANNEL );
+    OPCODE_DOMAIN( CMSG_CHANNEL_LIST,                             OPCODE_DOMAIN_CHANNEL );
+    OPCODE_DOMAIN( CMSG_CHANNEL_PASSWORD,                         OPCODE_DOMAIN_CHANNEL );
+    OPCODE_DOMAIN( CMSG_CHANNEL_SET_OWNER,                        OPCODE_DOMAIN_CHANNEL );
+    OPCODE_DOMAIN( CMSG_CHANNEL_OWNER,                            OPCODE_DOMAIN_CHANNEL );
+    OPCODE_DOMAIN( CMSG_CHANNEL_MODERATOR,                        OPCODE_DOMAIN_CHANNEL );
+    OPCODE_DOMAIN( CMSG_CHANNEL_UNMODERATOR,                      OPCODE_DOMAIN_CHANNEL );
+    OPCODE_DOMAIN( CMSG_CHANNEL_MUTE,                             OPCODE_DOMAIN_CHANNEL );
+    OPCODE_DOMAIN( CMSG_CHANNEL_UNMUTE,                           OPCODE_DOMAIN_CHANNEL );
+    OPCODE_DOMAIN( CMSG_CHANNEL_KICK,                             OPCODE_DOMAIN_CHANNEL );
+    OPCODE_DOMAIN( CMSG_CHANNEL_BAN,                              OPCODE_DOMAIN_CHANNEL );
+    OPCODE_DOMAIN( CMSG_CHANNEL_UNBAN,                            OPCODE_DOMAIN_CHANNEL );
+    OPCODE_DOMAIN( CMSG_CHANNEL_ANNOUNCEMENTS,                    OPCODE_DOMAIN_CHANNEL );
+    OPCODE_DOMAIN( CMSG_CHANNEL_DISPLAY_LIST,                     OPCODE_DOMAIN_CHANNEL );
+    OPCODE_DOMAIN( CMSG_GET_CHANNEL_MEMBER_COUNT,                 OPCODE_DOMAIN_CHANNEL );
+    OPCODE_DOMAIN( CMSG_CHANNEL_VOICE_ON,                         OPCODE_DOMAIN_CHANNEL );
+    OPCODE_DOMAIN( CMSG_SET_CHANNEL_WATCH,                        OPCODE_DOMAIN_CHANNEL );
+    OPCODE_DOMAIN( CMSG_DECLINE_CHANNEL_INVITE,                   OPCODE_DOMAIN_CHANNEL );
+
+    OPCODE_DOMAIN( CMSG_CONTACT_LIST,                             OPCODE_DOMAIN_SOCIAL );
+    OPCODE_DOMAIN( CMSG_ADD_FRIEND,                               OPCODE_DOMAIN_SOCIAL );
+    OPCODE_DOMAIN( CMSG_DEL_FRIEND,                               OPCODE_DOMAIN_SOCIAL );
+    OPCODE_DOMAIN( CMSG_SET_CONTACT_NOTES,                        OPCODE_DOMAIN_SOCIAL );
+
+    // only change their own player and team, invite/remove/disband/leader change other players and stay in OPCODE_DOMAIN_WORLD
+    OPCODE_DOMAIN( CMSG_ARENA_TEAM_QUERY,                         OPCODE_DOMAIN_ARENA_TEAM );
+    OPCODE_DOMAIN( CMSG_ARENA_TEAM_ROSTER,                        OPCODE_DOMAIN_ARENA_TEAM );
+    OPCODE_DOMAIN( CMSG_ARENA_TEAM_ACCEPT,                        OPCODE_DOMAIN_ARENA_TEAM );
+    OPCODE_DOMAIN( CMSG_ARENA_TEAM_DECLINE,                       OPCODE_DOMAIN_ARENA_TEAM );
+    OPCODE_DOMAIN( CMSG_ARENA_TEAM_LEAVE,                         OPCODE_DOMAIN_ARENA_TEAM );
+    OPCODE_DOMAIN( MSG_INSPECT_ARENA_TEAMS,                       OPCODE_DOMAIN_ARENA_TEAM );
 };
@@ -1372,16 +1372,34 @@ enum PacketProcessing
 
 class WorldPacket;
 
+///- Shared state touched by a PROCESS_THREADUNSAFE handler besides the player of its session,
+///- handlers of different domains may run concurrently in World::UpdateSessions()
+enum OpcodeDomain
+{
+    OPCODE_DOMAIN_WORLD = 0,                                //anything - processed by World::UpdateSessions() itself
+    OPCODE_DOMAIN_QUERY,                                    //static data only - processed without lock
+    OPCODE_DOMAIN_GUILD,                                    //sGuildMgr and the guilds
+    OPCODE_DOMAIN_MAIL,                                     //the own mails and the sAuctionMgr lists
+    OPCODE_DOMAIN_CHANNEL,                                  //ChannelMgr and the channels
+    OPCODE_DOMAIN_SOCIAL,                                   //sSocialMgr
+    OPCODE_DOMAIN_ARENA_TEAM,                               //sArenaTeamMgr and the arena teams
+    MAX_OPCODE_DOMAINS
+};
+
 struct OpcodeHandler
 {
     char const* name;
     SessionStatus status;
     PacketProcessing packetProcessing;
     void (WorldSession::*handler)(WorldPacket& recvPacket);
+    OpcodeDomain domain;
 };
 
 extern OpcodeHandler opcodeTable[NUM_MSG_TYPES];
 
+/// Lock serializing the handlers of a domain, NULL if they need none
+extern ACE_Thread_Mutex* GetOpcodeDomainLock(OpcodeDomain domain);
+
 /// Lookup opcode name for human understandable logging
 inline const char* LookupOpcodeName(uint32 id)
 {
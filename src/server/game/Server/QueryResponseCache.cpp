@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ * Copyright (C) 2008-2012 TrinityCore <http://www.trinitycore.org/>
+ * Copyright (C) 2005-2012 MaNGOS <http://getmangos.com/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "QueryResponseCache.h"
+
+SharedPacket QueryResponseCache::Find(QueryResponseType type, uint32 entry, int locale) const
+{
+    ResponseStore const& store = _stores[type];
+
+    TRINITY_READ_GUARD(ACE_RW_Thread_Mutex, store.lock);
+    ResponseMap::const_iterator itr = store.responses.find(MakeKey(entry, locale));
+    if (itr == store.responses.end())
+        return SharedPacket();
+
+    return itr->second;
+}
+
+SharedPacket QueryResponseCache::Store(QueryResponseType type, uint32 entry, int locale, WorldPacket const& packet)
+{
+    ResponseStore& store = _stores[type];
+    uint64 key = MakeKey(entry, locale);
+
+    TRINITY_WRITE_GUARD(ACE_RW_Thread_Mutex, store.lock);
+    ResponseMap::const_iterator itr = store.responses.find(key);
+    if (itr != store.responses.end())
+        return itr->second;
+
+    SharedPacket response(packet);
+    store.responses[key] = response;
+    return response;
+}
+
+void QueryResponseCache::Invalidate(QueryResponseType type, uint32 entry)
+{
+    ResponseStore& store = _stores[type];
+
+    TRINITY_WRITE_GUARD(ACE_RW_Thread_Mutex, store.lock);
+    for (int locale = -1; locale < TOTAL_LOCALES; ++locale)
+        store.responses.erase(MakeKey(entry, locale));
+}
+
+void QueryResponseCache::Invalidate(QueryResponseType type)
+{
+    ResponseStore& store = _stores[type];
+
+    // packets still queued on sockets keep their own reference
+    TRINITY_WRITE_GUARD(ACE_RW_Thread_Mutex, store.lock);
+    store.responses.clear();
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ * Copyright (C) 2008-2012 TrinityCore <http://www.trinitycore.org/>
+ * Copyright (C) 2005-2012 MaNGOS <http://getmangos.com/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _QUERYRESPONSECACHE_H
+#define _QUERYRESPONSECACHE_H
+
+#include "Common.h"
+#include "SharedPacket.h"
+#include "UnorderedMap.h"
+
+#include <ace/Singleton.h>
+#include <ace/RW_Thread_Mutex.h>
+
+enum QueryResponseType
+{
+    QUERY_RESPONSE_CREATURE     = 0,                        // SMSG_CREATURE_QUERY_RESPONSE, by creature entry
+    QUERY_RESPONSE_GAMEOBJECT   = 1,                        // SMSG_GAMEOBJECT_QUERY_RESPONSE, by gameobject entry
+    QUERY_RESPONSE_NPC_TEXT     = 2,                        // SMSG_NPC_TEXT_UPDATE, by text id
+    QUERY_RESPONSE_PAGE_TEXT    = 3,                        // SMSG_PAGE_TEXT_QUERY_RESPONSE, by page id
+    QUERY_RESPONSE_QUEST_POI    = 4,                        // per quest block of SMSG_QUEST_POI_QUERY_RESPONSE, not locale dependent
+    MAX_QUERY_RESPONSE_TYPES
+};
+
+/**
+ * Pre-serialized responses to the static data queries, one per entry and
+ * db locale index. Responses are built by the query handlers on the first
+ * request and then only referenced, the query opcodes run concurrently so
+ * the cache is safe to use from any thread. The reload commands of the
+ * tables the responses are built from invalidate them.
+ */
+class QueryResponseCache
+{
+    friend class ACE_Singleton<QueryResponseCache, ACE_Thread_Mutex>;
+
+    public:
+        /// Cached response, a null packet if it was not built yet.
+        SharedPacket Find(QueryResponseType type, uint32 entry, int locale) const;
+        /// Caches the response and returns the cached one, another thread may have stored it first.
+        SharedPacket Store(QueryResponseType type, uint32 entry, int locale, WorldPacket const& packet);
+
+        /// Drops the responses for all locales of the entry.
+        void Invalidate(QueryResponseType type, uint32 entry);
+        void Invalidate(QueryResponseType type);
+
+    private:
+        QueryResponseCache() { }
+
+        typedef UNORDERED_MAP<uint64, SharedPacket> ResponseMap;
+
+        // db locale index is -1 for the default locale
+        static uint64 MakeKey(uint32 entry, int locale) { return (uint64(entry) << 8) | uint8(locale + 1); }
+
+        struct ResponseStore
+        {
+            mutable ACE_RW_Thread_Mutex lock;
+            ResponseMap responses;
+        };
+
+        ResponseStore _stores[MAX_QUERY_RESPONSE_TYPES];
+};
+
+#define sQueryResponseCache ACE_Singleton<QueryResponseCache, ACE_Thread_Mutex>::instance()
+
+#endif
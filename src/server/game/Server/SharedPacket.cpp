@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ * Copyright (C) 2008-2012 TrinityCore <http://www.trinitycore.org/>
+ * Copyright (C) 2005-2012 MaNGOS <http://getmangos.com/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SharedPacket.h"
+
+#include <ace/Message_Block.h>
+
+/// Message block of a socket's out queue pointing at a shared payload instead of owning a copy.
+class SharedPacketBlock : public ACE_Message_Block
+{
+    public:
+        explicit SharedPacketBlock(SharedPacket::Data* data) :
+            ACE_Message_Block((char const*)data->packet.contents(), data->packet.size()), m_data(data)
+        {
+            SharedPacket::AddReference(m_data);
+            wr_ptr(m_data->packet.size());
+        }
+
+        // release() deletes the blocks of a chain, so this also runs for queued packets
+        ~SharedPacketBlock()
+        {
+            SharedPacket::RemoveReference(m_data);
+        }
+
+    private:
+        SharedPacket::Data* m_data;
+};
+
+SharedPacket::SharedPacket(WorldPacket const& packet) : m_data(new Data(packet))
+{
+}
+
+SharedPacket::SharedPacket(SharedPacket const& other) : m_data(other.m_data)
+{
+    if (m_data)
+        AddReference(m_data);
+}
+
+SharedPacket::~SharedPacket()
+{
+    if (m_data)
+        RemoveReference(m_data);
+}
+
+SharedPacket& SharedPacket::operator=(SharedPacket const& other)
+{
+    if (other.m_data)
+        AddReference(other.m_data);
+    if (m_data)
+        RemoveReference(m_data);
+    m_data = other.m_data;
+    return *this;
+}
+
+ACE_Message_Block* SharedPacket::CreateMessageBlock() const
+{
+    return new SharedPacketBlock(m_data);
+}
+
+void SharedPacket::AddReference(Data* data)
+{
+    ++data->refs;
+}
+
+void SharedPacket::RemoveReference(Data* data)
+{
+    if (--data->refs == 0)
+        delete data;
+}
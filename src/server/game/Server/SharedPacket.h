@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ * Copyright (C) 2008-2012 TrinityCore <http://www.trinitycore.org/>
+ * Copyright (C) 2005-2012 MaNGOS <http://getmangos.com/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SHAREDPACKET_H
+#define _SHAREDPACKET_H
+
+#include "Common.h"
+#include "WorldPacket.h"
+
+#include <ace/Atomic_Op.h>
+#include <ace/Thread_Mutex.h>
+
+class ACE_Message_Block;
+
+/// Payloads smaller than this are cheaper to copy into each socket's output buffer than to reference.
+#define SHARED_PACKET_MIN_SIZE 256
+
+/**
+ * Immutable, reference counted copy of a server packet.
+ *
+ * The packet is copied once, from then on the out queues of any number of
+ * sockets and the vectored sends handing it to the kernel only reference
+ * its payload. The encrypted header is the only data a socket keeps for
+ * itself.
+ */
+class SharedPacket
+{
+    public:
+        /// Null packet, only good for being assigned to.
+        SharedPacket() : m_data(NULL) { }
+        explicit SharedPacket(WorldPacket const& packet);
+        SharedPacket(SharedPacket const& other);
+        ~SharedPacket();
+        SharedPacket& operator=(SharedPacket const& other);
+
+        bool IsNull() const { return m_data == NULL; }
+
+        WorldPacket const& GetPacket() const { return m_data->packet; }
+        uint32 GetOpcode() const { return m_data->packet.GetOpcode(); }
+        size_t size() const { return m_data->packet.size(); }
+        bool empty() const { return m_data->packet.empty(); }
+
+        /// Message block referencing the payload, it keeps the payload alive until it is released.
+        ACE_Message_Block* CreateMessageBlock() const;
+
+    private:
+        struct Data
+        {
+            explicit Data(WorldPacket const& pct) : refs(1), packet(pct) { }
+
+            ACE_Atomic_Op<ACE_Thread_Mutex, long> refs;
+            WorldPacket const packet;
+        };
+
+        static void AddReference(Data* data);
+        static void RemoveReference(Data* data);
+
+        friend class SharedPacketBlock;
+
+        Data* m_data;
+};
+
+#endif
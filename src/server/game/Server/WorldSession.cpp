@@ -28,6 +28,8 @@
 #include "Opcodes.h"
 #include "WorldPacket.h"
 #include "WorldSession.h"
+#include "SharedPacket.h"
+#include "OpcodeStats.h"
 #include "Player.h"
 #include "Vehicle.h"
 #include "ObjectMgr.h"
@@ -86,6 +88,19 @@ bool WorldSessionFilter::Process(WorldPacket* packet)
     return (player->IsInWorld() == false);
 }
 
+//only thread-unsafe packets of a domain other than OPCODE_DOMAIN_WORLD, the first other
+//packet stops the processing so the packets of a session keep their order, InitOpcodeTable()
+//only puts handlers in a domain that change nothing but their own player and the domain state
+bool DomainSessionFilter::Process(WorldPacket* packet)
+{
+    OpcodeHandler const &opHandle = opcodeTable[packet->GetOpcode()];
+    if (opHandle.packetProcessing != PROCESS_THREADUNSAFE || opHandle.domain == OPCODE_DOMAIN_WORLD)
+        return false;
+
+    Player* player = m_pSession->GetPlayer();
+    return player && player->IsInWorld();
+}
+
 /// WorldSession constructor
 WorldSession::WorldSession(uint32 id, WorldSocket* sock, AccountTypes sec, uint8 expansion, time_t mute_time, LocaleConstant locale, uint32 recruiter, bool isARecruiter):
 m_muteTime(mute_time), m_timeOutTime(0), _player(NULL), m_Socket(sock),
@@ -123,10 +138,11 @@ WorldSession::~WorldSession()
         m_Socket = NULL;
     }
 
-    ///- empty incoming packet queue
+    ///- empty incoming packet queues
     WorldPacket* packet = NULL;
-    while (_recvQueue.next(packet))
-        delete packet;
+    for (uint8 lane = 0; lane < MAX_PACKET_LANES; ++lane)
+        while (_recvQueue[lane].next(packet))
+            delete packet;
 
     LoginDatabase.PExecute("UPDATE account SET online = 0 WHERE id = %u;", GetAccountId());     // One-time query
 }
@@ -143,14 +159,10 @@ char const* WorldSession::GetPlayerName() const
     return GetPlayer() ? GetPlayer()->GetName() : "<none>";
 }
 
-/// Send a packet to the client
-void WorldSession::SendPacket(WorldPacket const* packet)
-{
-    if (!m_Socket)
-        return;
-
 #ifdef TRINITY_DEBUG
-    // Code for network use statistic
+/// Network use statistic, shared by both SendPacket overloads
+static void CountSentPacket(size_t size)
+{
     static uint64 sendPacketCount = 0;
     static uint64 sendPacketBytes = 0;
 
@@ -165,10 +177,10 @@ void WorldSession::SendPacket(WorldPacket const* packet)
     if ((cur_time - lastTime) < 60)
     {
         sendPacketCount+=1;
-        sendPacketBytes+=packet->size();
+        sendPacketBytes+=size;
 
         sendLastPacketCount+=1;
-        sendLastPacketBytes+=packet->size();
+        sendLastPacketBytes+=size;
     }
     else
     {
@@ -179,18 +191,76 @@ void WorldSession::SendPacket(WorldPacket const* packet)
 
         lastTime = cur_time;
         sendLastPacketCount = 1;
-        sendLastPacketBytes = packet->wpos();               // wpos is real written size
+        sendLastPacketBytes = size;
     }
+}
 #endif                                                      // !TRINITY_DEBUG
 
+/// Send a packet to the client
+void WorldSession::SendPacket(WorldPacket const* packet)
+{
+    if (!m_Socket)
+        return;
+
+#ifdef TRINITY_DEBUG
+    CountSentPacket(packet->size());
+#endif
+
     if (m_Socket->SendPacket (*packet) == -1)
         m_Socket->CloseSocket ();
 }
 
-/// Add an incoming packet to the queue
+/// Send a packet shared with other sessions to the client
+void WorldSession::SendPacket(SharedPacket const& packet)
+{
+    if (!m_Socket)
+        return;
+
+#ifdef TRINITY_DEBUG
+    CountSentPacket(packet.size());
+#endif
+
+    if (m_Socket->SendPacket (packet) == -1)
+        m_Socket->CloseSocket ();
+}
+
+void WorldSession::GetOutputStats(uint64& copied, uint64& shared) const
+{
+    copied = shared = 0;
+    if (m_Socket)
+        m_Socket->GetOutputStats(copied, shared);
+}
+
+void WorldSession::GetFlushStats(uint64& frames, uint64& sends) const
+{
+    frames = sends = 0;
+    if (m_Socket)
+        m_Socket->GetFlushStats(frames, sends);
+}
+
+/// Add an incoming packet to the queue of its processing class, called from the network threads without any lock
 void WorldSession::QueuePacket(WorldPacket* new_packet)
 {
-    _recvQueue.add(new_packet);
+    if (opcodeTable[new_packet->GetOpcode()].packetProcessing == PROCESS_THREADUNSAFE)
+        _recvQueue[PACKET_LANE_THREADUNSAFE].add(new_packet);
+    else
+        _recvQueue[PACKET_LANE_THREADSAFE].add(new_packet);
+}
+
+/// Call the handler of a packet, holding the lock of its opcode domain if the filter asks for it
+void WorldSession::ExecuteOpcode(OpcodeHandler const& opHandle, WorldPacket& packet, PacketFilter& updater)
+{
+    ACE_Thread_Mutex* lock = updater.LockDomains() ? GetOpcodeDomainLock(opHandle.domain) : NULL;
+    if (!lock)
+    {
+        OpcodeStatsTimer timer(packet.GetOpcode());
+        (this->*opHandle.handler)(packet);
+        return;
+    }
+
+    TRINITY_GUARD(ACE_Thread_Mutex, *lock);
+    OpcodeStatsTimer timer(packet.GetOpcode());
+    (this->*opHandle.handler)(packet);
 }
 
 /// Logging helper for unexpected opcodes
@@ -212,140 +282,152 @@ void WorldSession::LogUnprocessedTail(WorldPacket* packet)
 /// Update the WorldSession (triggered by World update)
 bool WorldSession::Update(uint32 diff, PacketFilter& updater)
 {
-    /// Update Timeout timer.
-    UpdateTimeOutTime(diff);
+    if (updater.ProcessTimeOut())
+    {
+        /// Update Timeout timer.
+        UpdateTimeOutTime(diff);
 
-    ///- Before we process anything:
-    /// If necessary, kick the player from the character select screen
-    if (IsConnectionIdle())
-        m_Socket->CloseSocket();
+        ///- Before we process anything:
+        /// If necessary, kick the player from the character select screen
+        if (IsConnectionIdle())
+            m_Socket->CloseSocket();
+    }
 
-    ///- Retrieve packets from the receive queue and call the appropriate handlers
+    ///- Retrieve packets from the receive queues and call the appropriate handlers
     /// not process packets if socket already closed
     WorldPacket* packet = NULL;
-    //! Delete packet after processing by default
-    bool deletePacket = true;
-    //! To prevent infinite loop
-    WorldPacket* firstDelayedPacket = NULL;
-    //! If _recvQueue.peek() == firstDelayedPacket it means that in this Update call, we've processed all
-    //! *properly timed* packets, and we're now at the part of the queue where we find
-    //! delayed packets that were re-enqueued due to improper timing. To prevent an infinite
-    //! loop caused by re-enqueueing the same packets over and over again, we stop updating this session
-    //! and continue updating others. The re-enqueued packets will be handled in the next Update call for this session.
-    while (m_Socket && !m_Socket->IsClosed() &&
-            !_recvQueue.empty() && _recvQueue.peek(true) != firstDelayedPacket &&
-            _recvQueue.next(packet, updater))
+    for (uint8 lane = 0; lane < MAX_PACKET_LANES; ++lane)
     {
-        OpcodeHandler const &opHandle = opcodeTable[packet->GetOpcode()];
-
-        // Opcode display while only while debugging.
-        sLog->outDebug(LOG_FILTER_OPCODES, "SESSION: Received opcode 0x%.4X (%s)", packet->GetOpcode(), packet->GetOpcode()>OPCODE_NOT_FOUND?"nf":LookupOpcodeName(packet->GetOpcode()));
+        //! A filter only takes the packets of its lanes, so a packet another thread has to handle never blocks the others
+        if (!updater.ProcessLane(PacketQueueLane(lane)))
+            continue;
 
-        // !=NULL checked in WorldSocket
-        try
+        ACE_Based::MPSCQueue<WorldPacket*>& recvQueue = _recvQueue[lane];
+        //! To prevent infinite loop
+        WorldPacket* firstDelayedPacket = NULL;
+        //! If recvQueue.peek() == firstDelayedPacket it means that in this Update call, we've processed all
+        //! *properly timed* packets, and we're now at the part of the queue where we find
+        //! delayed packets that were re-enqueued due to improper timing. To prevent an infinite
+        //! loop caused by re-enqueueing the same packets over and over again, we stop updating this lane
+        //! and continue with the next one. The re-enqueued packets will be handled in the next Update call for this session.
+        while (m_Socket && !m_Socket->IsClosed() &&
+                recvQueue.peek(packet) && packet != firstDelayedPacket &&
+                recvQueue.next(packet, updater))
         {
-            switch (opHandle.status)
+            //! Delete packet after processing by default
+            bool deletePacket = true;
+            OpcodeHandler const &opHandle = opcodeTable[packet->GetOpcode()];
+
+            // Opcode display while only while debugging.
+            sLog->outDebug(LOG_FILTER_OPCODES, "SESSION: Received opcode 0x%.4X (%s)", packet->GetOpcode(), packet->GetOpcode()>OPCODE_NOT_FOUND?"nf":LookupOpcodeName(packet->GetOpcode()));
+
+            // !=NULL checked in WorldSocket
+            try
             {
-                case STATUS_LOGGEDIN:
-                    if (!_player)
-                    {
-                        // skip STATUS_LOGGEDIN opcode unexpected errors if player logout sometime ago - this can be network lag delayed packets
-                        //! If player didn't log out a while ago, it means packets are being sent while the server does not recognize
-                        //! the client to be in world yet. We will re-add the packets to the bottom of the queue and process them later.
-                        if (!m_playerRecentlyLogout)
+                switch (opHandle.status)
+                {
+                    case STATUS_LOGGEDIN:
+                        if (!_player)
                         {
-                            //! Prevent infinite loop
-                            if (!firstDelayedPacket)
-                                firstDelayedPacket = packet;
-                            //! Because checking a bool is faster than reallocating memory
-                            deletePacket = false;
-                            QueuePacket(packet);
-                            //! Log
-                            sLog->outDebug(LOG_FILTER_NETWORKIO, "Re-enqueueing packet with opcode %s (0x%.4X) with with status STATUS_LOGGEDIN. "
-                                "Player is currently not in world yet.", opHandle.name, packet->GetOpcode());
+                            // skip STATUS_LOGGEDIN opcode unexpected errors if player logout sometime ago - this can be network lag delayed packets
+                            //! If player didn't log out a while ago, it means packets are being sent while the server does not recognize
+                            //! the client to be in world yet. We will re-add the packets to the bottom of the queue and process them later.
+                            if (!m_playerRecentlyLogout)
+                            {
+                                //! Prevent infinite loop
+                                if (!firstDelayedPacket)
+                                    firstDelayedPacket = packet;
+                                //! Because checking a bool is faster than reallocating memory
+                                deletePacket = false;
+                                QueuePacket(packet);
+                                //! Log
+                                sLog->outDebug(LOG_FILTER_NETWORKIO, "Re-enqueueing packet with opcode %s (0x%.4X) with with status STATUS_LOGGEDIN. "
+                                    "Player is currently not in world yet.", opHandle.name, packet->GetOpcode());
+                            }
                         }
-                    }
-                    else if (_player->IsInWorld())
-                    {
-                        sScriptMgr->OnPacketReceive(m_Socket, WorldPacket(*packet));
-                        (this->*opHandle.handler)(*packet);
-                        if (sLog->IsOutDebug() && packet->rpos() < packet->wpos())
-                            LogUnprocessedTail(packet);
-                    }
-                    // lag can cause STATUS_LOGGEDIN opcodes to arrive after the player started a transfer
-                    break;
-                case STATUS_LOGGEDIN_OR_RECENTLY_LOGGOUT:
-                    if (!_player && !m_playerRecentlyLogout)
-                        LogUnexpectedOpcode(packet, "STATUS_LOGGEDIN_OR_RECENTLY_LOGGOUT",
-                            "the player has not logged in yet and not recently logout");
-                    else
-                    {
-                        // not expected _player or must checked in packet hanlder
-                        sScriptMgr->OnPacketReceive(m_Socket, WorldPacket(*packet));
-                        (this->*opHandle.handler)(*packet);
-                        if (sLog->IsOutDebug() && packet->rpos() < packet->wpos())
-                            LogUnprocessedTail(packet);
-                    }
-                    break;
-                case STATUS_TRANSFER:
-                    if (!_player)
-                        LogUnexpectedOpcode(packet, "STATUS_TRANSFER", "the player has not logged in yet");
-                    else if (_player->IsInWorld())
-                        LogUnexpectedOpcode(packet, "STATUS_TRANSFER", "the player is still in world");
-                    else
-                    {
-                        sScriptMgr->OnPacketReceive(m_Socket, WorldPacket(*packet));
-                        (this->*opHandle.handler)(*packet);
+                        else if (_player->IsInWorld())
+                        {
+                            sScriptMgr->OnPacketReceive(m_Socket, *packet);
+                            ExecuteOpcode(opHandle, *packet, updater);
+                            if (sLog->IsOutDebug() && packet->rpos() < packet->wpos())
+                                LogUnprocessedTail(packet);
+                        }
+                        // lag can cause STATUS_LOGGEDIN opcodes to arrive after the player started a transfer
+                        break;
+                    case STATUS_LOGGEDIN_OR_RECENTLY_LOGGOUT:
+                        if (!_player && !m_playerRecentlyLogout)
+                            LogUnexpectedOpcode(packet, "STATUS_LOGGEDIN_OR_RECENTLY_LOGGOUT",
+                                "the player has not logged in yet and not recently logout");
+                        else
+                        {
+                            // not expected _player or must checked in packet hanlder
+                            sScriptMgr->OnPacketReceive(m_Socket, *packet);
+                            ExecuteOpcode(opHandle, *packet, updater);
+                            if (sLog->IsOutDebug() && packet->rpos() < packet->wpos())
+                                LogUnprocessedTail(packet);
+                        }
+                        break;
+                    case STATUS_TRANSFER:
+                        if (!_player)
+                            LogUnexpectedOpcode(packet, "STATUS_TRANSFER", "the player has not logged in yet");
+                        else if (_player->IsInWorld())
+                            LogUnexpectedOpcode(packet, "STATUS_TRANSFER", "the player is still in world");
+                        else
+                        {
+                            sScriptMgr->OnPacketReceive(m_Socket, *packet);
+                            ExecuteOpcode(opHandle, *packet, updater);
+                            if (sLog->IsOutDebug() && packet->rpos() < packet->wpos())
+                                LogUnprocessedTail(packet);
+                        }
+                        break;
+                    case STATUS_AUTHED:
+                        // prevent cheating with skip queue wait
+                        if (m_inQueue)
+                        {
+                            LogUnexpectedOpcode(packet, "STATUS_AUTHED", "the player not pass queue yet");
+                            break;
+                        }
+
+                        // single from authed time opcodes send in to after logout time
+                        // and before other STATUS_LOGGEDIN_OR_RECENTLY_LOGGOUT opcodes.
+                        if (packet->GetOpcode() != CMSG_SET_ACTIVE_VOICE_CHANNEL)
+                            m_playerRecentlyLogout = false;
+
+                        sScriptMgr->OnPacketReceive(m_Socket, *packet);
+                        ExecuteOpcode(opHandle, *packet, updater);
                         if (sLog->IsOutDebug() && packet->rpos() < packet->wpos())
                             LogUnprocessedTail(packet);
-                    }
-                    break;
-                case STATUS_AUTHED:
-                    // prevent cheating with skip queue wait
-                    if (m_inQueue)
-                    {
-                        LogUnexpectedOpcode(packet, "STATUS_AUTHED", "the player not pass queue yet");
                         break;
-                    }
-
-                    // single from authed time opcodes send in to after logout time
-                    // and before other STATUS_LOGGEDIN_OR_RECENTLY_LOGGOUT opcodes.
-                    if (packet->GetOpcode() != CMSG_SET_ACTIVE_VOICE_CHANNEL)
-                        m_playerRecentlyLogout = false;
-
-                    sScriptMgr->OnPacketReceive(m_Socket, WorldPacket(*packet));
-                    (this->*opHandle.handler)(*packet);
-                    if (sLog->IsOutDebug() && packet->rpos() < packet->wpos())
-                        LogUnprocessedTail(packet);
-                    break;
-                case STATUS_NEVER:
-                    sLog->outError("SESSION (account: %u, guidlow: %u, char: %s): received not allowed opcode %s (0x%.4X)",
-                        GetAccountId(), m_GUIDLow, _player ? _player->GetName() : "<none>",
-                        LookupOpcodeName(packet->GetOpcode()), packet->GetOpcode());
-                    break;
-                case STATUS_UNHANDLED:
-                    sLog->outDebug(LOG_FILTER_NETWORKIO, "SESSION (account: %u, guidlow: %u, char: %s): received not handled opcode %s (0x%.4X)",
-                        GetAccountId(), m_GUIDLow, _player ? _player->GetName() : "<none>",
-                        LookupOpcodeName(packet->GetOpcode()), packet->GetOpcode());
-                    break;
+                    case STATUS_NEVER:
+                        sLog->outError("SESSION (account: %u, guidlow: %u, char: %s): received not allowed opcode %s (0x%.4X)",
+                            GetAccountId(), m_GUIDLow, _player ? _player->GetName() : "<none>",
+                            LookupOpcodeName(packet->GetOpcode()), packet->GetOpcode());
+                        break;
+                    case STATUS_UNHANDLED:
+                        sLog->outDebug(LOG_FILTER_NETWORKIO, "SESSION (account: %u, guidlow: %u, char: %s): received not handled opcode %s (0x%.4X)",
+                            GetAccountId(), m_GUIDLow, _player ? _player->GetName() : "<none>",
+                            LookupOpcodeName(packet->GetOpcode()), packet->GetOpcode());
+                        break;
+                }
             }
-        }
-        catch (ByteBufferException &)
-        {
-            sLog->outError("WorldSession::Update ByteBufferException occured while parsing a packet (opcode: %u) from client %s, accountid=%i. Skipped packet.",
-                    packet->GetOpcode(), GetRemoteAddress().c_str(), GetAccountId());
-            if (sLog->IsOutDebug())
+            catch (ByteBufferException &)
             {
-                sLog->outDebug(LOG_FILTER_NETWORKIO, "Dumping error causing packet:");
-                packet->hexlike();
+                sLog->outError("WorldSession::Update ByteBufferException occured while parsing a packet (opcode: %u) from client %s, accountid=%i. Skipped packet.",
+                        packet->GetOpcode(), GetRemoteAddress().c_str(), GetAccountId());
+                if (sLog->IsOutDebug())
+                {
+                    sLog->outDebug(LOG_FILTER_NETWORKIO, "Dumping error causing packet:");
+                    packet->hexlike();
+                }
             }
-        }
 
-        if (deletePacket)
-            delete packet;
+            if (deletePacket)
+                delete packet;
+        }
     }
 
-    ProcessQueryCallbacks();
+    if (updater.ProcessQueryCallbacks())
+        ProcessQueryCallbacks();
 
     //check if we are safe to proceed with logout
     //logout procedure should happen only in World::UpdateSessions() method!!!
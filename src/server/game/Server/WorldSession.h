@@ -29,12 +29,14 @@
 #include "AddonMgr.h"
 #include "DatabaseEnv.h"
 #include "World.h"
+#include "MPSCQueue.h"
 //#include "WorldPacket.h"
 
 struct ItemTemplate;
 struct AuctionEntry;
 struct DeclinedName;
 struct MovementInfo;
+struct OpcodeHandler;
 
 class Creature;
 class Item;
@@ -43,6 +45,7 @@ class Player;
 class Unit;
 class GameObject;
 class Quest;
+class SharedPacket;
 class WorldPacket;
 class WorldSocket;
 class LoginQueryHolder;
@@ -139,6 +142,15 @@ enum CharterTypes
     ARENA_TEAM_CHARTER_5v5_TYPE                   = 5
 };
 
+//receive queues of a session, packets keep their order only within their lane, so
+//handlers that change the player, its items or its group must be PROCESS_THREADUNSAFE
+enum PacketQueueLane
+{
+    PACKET_LANE_THREADSAFE      = 0,                        //PROCESS_INPLACE and PROCESS_THREADSAFE packets
+    PACKET_LANE_THREADUNSAFE    = 1,                        //PROCESS_THREADUNSAFE packets
+    MAX_PACKET_LANES
+};
+
 //class to deal with packet processing
 //allows to determine if next packet is safe to be processed
 class PacketFilter
@@ -148,7 +160,13 @@ public:
     virtual ~PacketFilter() {}
 
     virtual bool Process(WorldPacket* /*packet*/) { return true; }
+    //whether the packets of a lane may be processed at all, the other lanes are left untouched
+    virtual bool ProcessLane(PacketQueueLane /*lane*/) const { return true; }
     virtual bool ProcessLogout() const { return true; }
+    virtual bool ProcessTimeOut() const { return true; }
+    virtual bool ProcessQueryCallbacks() const { return true; }
+    //whether handlers have to hold the lock of their opcode domain
+    virtual bool LockDomains() const { return false; }
 
 protected:
     WorldSession* const m_pSession;
@@ -161,6 +179,7 @@ public:
     ~MapSessionFilter() {}
 
     virtual bool Process(WorldPacket* packet);
+    virtual bool ProcessLane(PacketQueueLane lane) const { return lane == PACKET_LANE_THREADSAFE; }
     //in Map::Update() we do not process player logout!
     virtual bool ProcessLogout() const { return false; }
 };
@@ -176,6 +195,24 @@ public:
     virtual bool Process(WorldPacket* packet);
 };
 
+//class used to process the thread-unsafe packets of the opcode domains concurrently
+//in World::UpdateSessions() before the remaining ones are processed by WorldSessionFilter
+class DomainSessionFilter : public PacketFilter
+{
+public:
+    explicit DomainSessionFilter(WorldSession* pSession) : PacketFilter(pSession) {}
+    ~DomainSessionFilter() {}
+
+    virtual bool Process(WorldPacket* packet);
+    virtual bool ProcessLane(PacketQueueLane lane) const { return lane == PACKET_LANE_THREADUNSAFE; }
+    virtual bool ProcessLogout() const { return false; }
+    //the time out and idle kick close the socket, leave them to World::UpdateSessions()
+    virtual bool ProcessTimeOut() const { return false; }
+    //callbacks may log in players, leave them to World::UpdateSessions()
+    virtual bool ProcessQueryCallbacks() const { return false; }
+    virtual bool LockDomains() const { return true; }
+};
+
 // Proxy structure to contain data passed to callback function,
 // only to prevent bloating the parameter list
 class CharacterCreateInfo
@@ -233,6 +270,10 @@ class WorldSession
         void WriteMovementInfo(WorldPacket* data, MovementInfo* mi);
 
         void SendPacket(WorldPacket const* packet);
+        //! same packet for many receivers, its payload is only referenced
+        void SendPacket(SharedPacket const& packet);
+        void GetOutputStats(uint64& copied, uint64& shared) const;
+        void GetFlushStats(uint64& frames, uint64& sends) const;
         void SendNotification(const char *format, ...) ATTR_PRINTF(2, 3);
         void SendNotification(uint32 string_id, ...);
         void SendPetNameInvalid(uint32 error, const std::string& name, DeclinedName *declinedName);
@@ -945,6 +986,7 @@ class WorldSession
         // logging helper
         void LogUnexpectedOpcode(WorldPacket* packet, const char* status, const char *reason);
         void LogUnprocessedTail(WorldPacket* packet);
+        void ExecuteOpcode(OpcodeHandler const& opHandle, WorldPacket& packet, PacketFilter& updater);
 
         // EnumData helpers
         bool CharCanLogin(uint32 lowGUID)
@@ -982,7 +1024,7 @@ class WorldSession
         AddonsList m_addonsList;
         uint32 recruiterId;
         bool isRecruiter;
-        ACE_Based::LockedQueue<WorldPacket*, ACE_Thread_Mutex> _recvQueue;
+        ACE_Based::MPSCQueue<WorldPacket*> _recvQueue[MAX_PACKET_LANES];
         time_t timeLastWhoCommand;
 };
 #endif
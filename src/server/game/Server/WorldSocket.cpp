@@ -32,18 +32,24 @@
 #include "WorldSocketMgr.h"
 #include "Log.h"
 #include "WorldLog.h"
+#include "OpcodeStats.h"
 #include "ScriptMgr.h"
+#include "SharedPacket.h"
+#include "UpdateData.h"
 
 #include <ace/Message_Block.h>
 #include <ace/OS_NS_string.h>
 #include <ace/OS_NS_unistd.h>
+#include <ace/OS_NS_sys_socket.h>
 #include <ace/os_include/arpa/os_inet.h>
 #include <ace/os_include/netinet/os_tcp.h>
 #include <ace/os_include/sys/os_types.h>
 #include <ace/os_include/sys/os_socket.h>
+#include <ace/os_include/sys/os_uio.h>
 #include <ace/OS_NS_string.h>
 #include <ace/Reactor.h>
 #include <ace/Auto_Ptr.h>
+#include <ace/TSS_T.h>
 
 #if defined(__GNUC__)
 #pragma pack(1)
@@ -98,11 +104,31 @@ struct ClientPktHeader
 #pragma pack(pop)
 #endif
 
+/// Buffers handed to the kernel by a single vectored send in handle_output().
+#define WORLDSOCKET_SEND_IOV_MAX 64
+
+/// Size of the blocks small packets are coalesced in once the output had to be queued.
+#define WORLDSOCKET_OUT_BLOCK_SIZE 4096
+
+/// Size of the buffer of each network thread the sockets are read into.
+#define WORLDSOCKET_RECV_BUFFER_SIZE 65536
+
+/// Received data is read into a buffer owned by the network thread, large enough that
+/// a single recv() usually takes everything the socket has.
+struct WorldSocketRecvBuffer
+{
+    char data[WORLDSOCKET_RECV_BUFFER_SIZE];
+};
+
+typedef ACE_TSS<WorldSocketRecvBuffer> WorldSocketRecvBufferTSS;
+static WorldSocketRecvBufferTSS recvBuffer;
+
 WorldSocket::WorldSocket (void): WorldHandler(),
 m_LastPingTime(ACE_Time_Value::zero), m_OverSpeedPings(0), m_Session(0),
 m_RecvWPct(0), m_RecvPct(), m_Header(sizeof (ClientPktHeader)),
-m_OutBuffer(0), m_OutBufferSize(65536), m_OutActive(false),
-m_Seed(static_cast<uint32> (rand32()))
+m_OutBuffer(0), m_OutBufferSize(65536), m_OutTail(0), m_OutActive(false),
+m_Seed(static_cast<uint32> (rand32())), m_OutBytesCopied(0), m_OutBytesShared(0),
+m_OutFrames(0), m_OutSends(0), m_FlushedTick(0), m_FlushNow(false), m_Closing(0)
 {
     reference_counting_policy().value (ACE_Event_Handler::Reference_Counting_Policy::ENABLED);
 
@@ -118,24 +144,26 @@ WorldSocket::~WorldSocket (void)
         m_OutBuffer->release();
 
     closing_ = true;
+    m_Closing = 1;
 
     peer().close();
 }
 
 bool WorldSocket::IsClosed (void) const
 {
-    return closing_;
+    return m_Closing.value() != 0;
 }
 
 void WorldSocket::CloseSocket (void)
 {
     {
-        ACE_GUARD (LockType, Guard, m_OutBufferLock);
+        ACE_GUARD (LockType, Guard, m_CloseLock);
 
-        if (closing_)
+        if (IsClosed())
             return;
 
         closing_ = true;
+        m_Closing = 1;
         peer().close_writer();
     }
 
@@ -153,11 +181,136 @@ const std::string& WorldSocket::GetRemoteAddress (void) const
 
 int WorldSocket::SendPacket (const WorldPacket& pct)
 {
-    ACE_GUARD_RETURN (LockType, Guard, m_OutBufferLock, -1);
+    if (IsClosed())
+        return -1;
+
+    // Small packets are copied straight into the output unless the network thread is writing
+    // right now, the packets queued before are written first so the order is kept.
+    if (pct.size() < SHARED_PACKET_MIN_SIZE)
+    {
+        GuardType Guard (m_OutBufferLock, false);
+
+        if (Guard.locked() && m_OutBuffer)
+        {
+            if (WriteQueuedPackets() == -1)
+                return -1;
+
+            int ret = WriteCompressedUpdate(pct);
+            if (ret == 0)
+                ret = WritePacket(pct);
+
+            return ret == -1 ? -1 : 0;
+        }
+    }
+
+    m_SendQueue.add(QueuedPacket(SharedPacket(pct), true));
+    return 0;
+}
+
+int WorldSocket::SendPacket (const SharedPacket& shared)
+{
+    if (IsClosed())
+        return -1;
+
+    m_SendQueue.add(QueuedPacket(shared, false));
+    return 0;
+}
+
+int WorldSocket::WriteQueuedPackets (void)
+{
+    QueuedPacket queued;
+
+    while (m_SendQueue.next(queued))
+    {
+        if (IsClosed())
+            return -1;
+
+        int ret = WriteCompressedUpdate(queued.packet.GetPacket());
+        if (ret == 0)
+            ret = WriteSharedPacket(queued.packet, queued.copied);
+
+        if (ret == -1)
+            return -1;
+    }
+
+    return 0;
+}
+
+int WorldSocket::WriteCompressedUpdate (const WorldPacket& pct)
+{
+    if (pct.GetOpcode() != SMSG_UPDATE_OBJECT || !sWorld->getBoolConfig(CONFIG_COMPRESSION_ASYNC))
+        return 0;
+
+    int level = UpdateData::GetCompressionLevel(pct.size());
+    if (!level)
+        return 0;
+
+    // the payload may be shared with other sockets, compress a copy of it
+    WorldPacket compressed(pct);
+    compressed.compress(SMSG_COMPRESSED_UPDATE_OBJECT, level);
+    return WritePacket(compressed) == -1 ? -1 : 1;
+}
 
-    if (closing_)
+int WorldSocket::WritePacket (const WorldPacket& pct)
+{
+    if (!OnSendPacket(pct))
+        return 0;
+
+    ServerPktHeader header(pct.size()+2, pct.GetOpcode());
+    m_Crypt.EncryptSend ((uint8*)header.header, header.getHeaderLength());
+
+    if (AppendOutput((const char*) header.header, header.getHeaderLength()) == -1)
+        return -1;
+
+    if (pct.empty())
+        return 0;
+
+    m_OutBytesCopied += pct.size();
+    return AppendOutput((const char*) pct.contents(), pct.size());
+}
+
+int WorldSocket::WriteSharedPacket (const SharedPacket& shared, bool copied)
+{
+    const WorldPacket& pct = shared.GetPacket();
+    if (!OnSendPacket(pct))
+        return 0;
+
+    // Only the header is encrypted, it's the only part that differs between the receivers.
+    ServerPktHeader header(pct.size()+2, pct.GetOpcode());
+    m_Crypt.EncryptSend ((uint8*)header.header, header.getHeaderLength());
+
+    if (AppendOutput((const char*) header.header, header.getHeaderLength()) == -1)
+        return -1;
+
+    if (pct.empty())
+        return 0;
+
+    if (pct.size() < SHARED_PACKET_MIN_SIZE)
+    {
+        m_OutBytesCopied += pct.size();
+        return AppendOutput((const char*) pct.contents(), pct.size());
+    }
+
+    ACE_Message_Block* mb = shared.CreateMessageBlock();
+
+    if (msg_queue()->enqueue_tail(mb, (ACE_Time_Value*)&ACE_Time_Value::zero) == -1)
+    {
+        sLog->outError("WorldSocket::WriteSharedPacket enqueue_tail failed");
+        mb->release();
         return -1;
+    }
+
+    // whatever comes next has to be queued behind the reference
+    m_OutTail = NULL;
+    if (copied)
+        m_OutBytesCopied += pct.size();
+    else
+        m_OutBytesShared += pct.size();
+    return 0;
+}
 
+bool WorldSocket::OnSendPacket (const WorldPacket& pct)
+{
     // Dump outgoing packet.
     if (sWorldLog->LogWorld())
     {
@@ -186,48 +339,85 @@ int WorldSocket::SendPacket (const WorldPacket& pct)
     if (pct.GetOpcode() > OPCODE_NOT_FOUND)
     {
         sLog->outDebug(LOG_FILTER_NETWORKIO, "Packet %s (%X) not send.\n", LookupOpcodeName (pct.GetOpcode()), pct.GetOpcode());
-        return 0;
+        return false;
     }
 
-    // Create a copy of the original packet; this is to avoid issues if a hook modifies it.
-    sScriptMgr->OnPacketSend(this, WorldPacket(pct));
+    // Hooks only get to look at the packet, so there is nothing to copy for them.
+    sScriptMgr->OnPacketSend(this, pct);
 
-    ServerPktHeader header(pct.size()+2, pct.GetOpcode());
-    m_Crypt.EncryptSend ((uint8*)header.header, header.getHeaderLength());
+    ++m_OutFrames;
+    sOpcodeStats->RecordSent(pct.GetOpcode(), pct.size());
+    if (sWorldSocketMgr->IsImmediateOpcode(pct.GetOpcode()))
+        m_FlushNow = true;
+
+    return true;
+}
 
-    if (m_OutBuffer->space() >= pct.size() + header.getHeaderLength() && msg_queue()->is_empty())
+int WorldSocket::AppendOutput (const char* data, size_t len)
+{
+    // Nothing is queued, the output buffer is the end of the output.
+    if (msg_queue()->is_empty() && m_OutBuffer->space() >= len)
     {
-        // Put the packet on the buffer.
-        if (m_OutBuffer->copy((char*) header.header, header.getHeaderLength()) == -1)
+        if (m_OutBuffer->copy(data, len) == -1)
             ACE_ASSERT(false);
 
-        if (!pct.empty())
-            if (m_OutBuffer->copy((char*) pct.contents(), pct.size()) == -1)
-                ACE_ASSERT(false);
+        return 0;
     }
-    else
+
+    // Otherwise keep filling the last queued block, requeued so the queue accounts for it.
+    if (m_OutTail && m_OutTail->space() >= len)
     {
-        // Enqueue the packet.
         ACE_Message_Block* mb;
 
-        ACE_NEW_RETURN(mb, ACE_Message_Block(pct.size() + header.getHeaderLength()), -1);
-
-        mb->copy((char*) header.header, header.getHeaderLength());
+        if (msg_queue()->dequeue_tail(mb, (ACE_Time_Value*)&ACE_Time_Value::zero) == -1)
+        {
+            sLog->outError("WorldSocket::AppendOutput dequeue_tail failed");
+            return -1;
+        }
 
-        if (!pct.empty())
-            mb->copy((const char*)pct.contents(), pct.size());
+        ACE_ASSERT(mb == m_OutTail);
+        mb->copy(data, len);
 
         if (msg_queue()->enqueue_tail(mb, (ACE_Time_Value*)&ACE_Time_Value::zero) == -1)
         {
-            sLog->outError("WorldSocket::SendPacket enqueue_tail failed");
+            sLog->outError("WorldSocket::AppendOutput enqueue_tail failed");
             mb->release();
+            m_OutTail = NULL;
             return -1;
         }
+
+        return 0;
+    }
+
+    ACE_Message_Block* mb;
+
+    ACE_NEW_RETURN(mb, ACE_Message_Block(std::max(len, size_t(WORLDSOCKET_OUT_BLOCK_SIZE))), -1);
+
+    mb->copy(data, len);
+
+    if (msg_queue()->enqueue_tail(mb, (ACE_Time_Value*)&ACE_Time_Value::zero) == -1)
+    {
+        sLog->outError("WorldSocket::AppendOutput enqueue_tail failed");
+        mb->release();
+        return -1;
     }
 
+    m_OutTail = mb;
     return 0;
 }
 
+void WorldSocket::GetOutputStats (uint64& copied, uint64& shared)
+{
+    copied = m_OutBytesCopied;
+    shared = m_OutBytesShared;
+}
+
+void WorldSocket::GetFlushStats (uint64& frames, uint64& sends)
+{
+    frames = m_OutFrames;
+    sends = m_OutSends;
+}
+
 long WorldSocket::AddReference (void)
 {
     return static_cast<long> (add_reference());
@@ -303,6 +493,7 @@ int WorldSocket::close (int)
     shutdown();
 
     closing_ = true;
+    m_Closing = 1;
 
     remove_reference();
 
@@ -311,7 +502,7 @@ int WorldSocket::close (int)
 
 int WorldSocket::handle_input (ACE_HANDLE)
 {
-    if (closing_)
+    if (IsClosed())
         return -1;
 
     switch (handle_input_missing_data())
@@ -349,18 +540,60 @@ int WorldSocket::handle_output (ACE_HANDLE)
 {
     ACE_GUARD_RETURN (LockType, Guard, m_OutBufferLock, -1);
 
-    if (closing_)
+    return HandleOutput();
+}
+
+int WorldSocket::HandleOutput (void)
+{
+    if (IsClosed())
         return -1;
 
-    size_t send_len = m_OutBuffer->length();
+    if (WriteQueuedPackets() == -1)
+        return -1;
+
+    // Gather the output buffer and the queued packets, whose payloads may be shared
+    // with other sockets, into a single vectored send.
+    iovec iov[WORLDSOCKET_SEND_IOV_MAX];
+    int iovcnt = 0;
+    size_t send_len = 0;
+
+    if (m_OutBuffer->length() > 0)
+    {
+        iov[iovcnt].iov_base = m_OutBuffer->rd_ptr();
+        iov[iovcnt].iov_len = m_OutBuffer->length();
+        send_len += iov[iovcnt++].iov_len;
+    }
+
+    ACE_Message_Block* queued = NULL;
+    if (!msg_queue()->is_empty())
+        msg_queue()->peek_dequeue_head(queued, (ACE_Time_Value*)&ACE_Time_Value::zero);
+
+    for (; queued && iovcnt < WORLDSOCKET_SEND_IOV_MAX; queued = queued->next())
+    {
+        for (ACE_Message_Block* mb = queued; mb && iovcnt < WORLDSOCKET_SEND_IOV_MAX; mb = mb->cont())
+        {
+            if (mb->length() == 0)
+                continue;
+
+            iov[iovcnt].iov_base = mb->rd_ptr();
+            iov[iovcnt].iov_len = mb->length();
+            send_len += iov[iovcnt++].iov_len;
+        }
+    }
 
     if (send_len == 0)
-        return handle_output_queue(Guard);
+        return cancel_wakeup_output();
+
+    m_FlushNow = false;
 
 #ifdef MSG_NOSIGNAL
-    ssize_t n = peer().send (m_OutBuffer->rd_ptr(), send_len, MSG_NOSIGNAL);
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovcnt;
+    ssize_t n = ACE_OS::sendmsg (get_handle(), &msg, MSG_NOSIGNAL);
 #else
-    ssize_t n = peer().send (m_OutBuffer->rd_ptr(), send_len);
+    ssize_t n = peer().sendv (iov, iovcnt);
 #endif // MSG_NOSIGNAL
 
     if (n == 0)
@@ -368,97 +601,86 @@ int WorldSocket::handle_output (ACE_HANDLE)
     else if (n == -1)
     {
         if (errno == EWOULDBLOCK || errno == EAGAIN)
-            return schedule_wakeup_output (Guard);
+            return schedule_wakeup_output();
 
         return -1;
     }
-    else if (n < (ssize_t)send_len) //now n > 0
-    {
-        m_OutBuffer->rd_ptr (static_cast<size_t> (n));
 
-        // move the data to the base of the buffer
-        m_OutBuffer->crunch();
+    ++m_OutSends;
 
-        return schedule_wakeup_output (Guard);
-    }
-    else //now n == send_len
+    // Consume what was sent, in the order it was gathered.
+    size_t sent = static_cast<size_t> (n);
+
+    if (m_OutBuffer->length() > 0)
     {
-        m_OutBuffer->reset();
+        const size_t len = std::min(sent, m_OutBuffer->length());
+        m_OutBuffer->rd_ptr (len);
+        sent -= len;
 
-        return handle_output_queue (Guard);
+        if (m_OutBuffer->length() == 0)
+            m_OutBuffer->reset();
+        else
+            // move the data to the base of the buffer
+            m_OutBuffer->crunch();
     }
 
-    ACE_NOTREACHED (return 0);
-}
-
-int WorldSocket::handle_output_queue (GuardType& g)
-{
-    if (msg_queue()->is_empty())
-        return cancel_wakeup_output(g);
-
-    ACE_Message_Block *mblk;
-
-    if (msg_queue()->dequeue_head(mblk, (ACE_Time_Value*)&ACE_Time_Value::zero) == -1)
+    while (sent > 0)
     {
-        sLog->outError("WorldSocket::handle_output_queue dequeue_head");
-        return -1;
-    }
+        ACE_Message_Block* mblk;
 
-    const size_t send_len = mblk->length();
+        if (msg_queue()->dequeue_head(mblk, (ACE_Time_Value*)&ACE_Time_Value::zero) == -1)
+        {
+            sLog->outError("WorldSocket::handle_output dequeue_head");
+            return -1;
+        }
 
-#ifdef MSG_NOSIGNAL
-    ssize_t n = peer().send (mblk->rd_ptr(), send_len, MSG_NOSIGNAL);
-#else
-    ssize_t n = peer().send (mblk->rd_ptr(), send_len);
-#endif // MSG_NOSIGNAL
+        const size_t len = mblk->total_length();
+        if (sent >= len)
+        {
+            if (mblk == m_OutTail)
+                m_OutTail = NULL;
 
-    if (n == 0)
-    {
-        mblk->release();
+            mblk->release();
+            sent -= len;
+            continue;
+        }
 
-        return -1;
-    }
-    else if (n == -1)
-    {
-        if (errno == EWOULDBLOCK || errno == EAGAIN)
+        for (ACE_Message_Block* mb = mblk; sent > 0; mb = mb->cont())
         {
-            msg_queue()->enqueue_head(mblk, (ACE_Time_Value*) &ACE_Time_Value::zero);
-            return schedule_wakeup_output (g);
+            const size_t part = std::min(sent, mb->length());
+            mb->rd_ptr (part);
+            sent -= part;
         }
 
-        mblk->release();
-        return -1;
-    }
-    else if (n < (ssize_t)send_len) //now n > 0
-    {
-        mblk->rd_ptr(static_cast<size_t> (n));
-
+        // requeue it so the queue accounts for the partly sent packet correctly
         if (msg_queue()->enqueue_head(mblk, (ACE_Time_Value*) &ACE_Time_Value::zero) == -1)
         {
-            sLog->outError("WorldSocket::handle_output_queue enqueue_head");
+            sLog->outError("WorldSocket::handle_output enqueue_head");
+            if (mblk == m_OutTail)
+                m_OutTail = NULL;
             mblk->release();
             return -1;
         }
-
-        return schedule_wakeup_output (g);
     }
-    else //now n == send_len
-    {
-        mblk->release();
 
-        return msg_queue()->is_empty() ? cancel_wakeup_output(g) : ACE_Event_Handler::WRITE_MASK;
-    }
+    if (static_cast<size_t> (n) < send_len)
+        return schedule_wakeup_output();
 
-    ACE_NOTREACHED(return -1);
+    // everything gathered went out, but more than one send worth may have been queued
+    if (m_OutBuffer->length() == 0 && msg_queue()->is_empty())
+        return cancel_wakeup_output();
+
+    return ACE_Event_Handler::WRITE_MASK;
 }
 
 int WorldSocket::handle_close (ACE_HANDLE h, ACE_Reactor_Mask)
 {
     // Critical section
     {
-        ACE_GUARD_RETURN (LockType, Guard, m_OutBufferLock, -1);
+        ACE_GUARD_RETURN (LockType, Guard, m_CloseLock, -1);
 
         closing_ = true;
+        m_Closing = 1;
 
         if (h == ACE_INVALID_HANDLE)
             peer().close_writer();
@@ -477,15 +699,31 @@ int WorldSocket::handle_close (ACE_HANDLE h, ACE_Reactor_Mask)
 
 int WorldSocket::Update (void)
 {
-    if (closing_)
+    if (IsClosed())
+        return -1;
+
+    ACE_GUARD_RETURN (LockType, Guard, m_OutBufferLock, -1);
+
+    if (WriteQueuedPackets() == -1)
         return -1;
 
     if (m_OutActive || (m_OutBuffer->length() == 0 && msg_queue()->is_empty()))
         return 0;
 
+    // Batched output waits for the end of the world update, unless a latency critical
+    // packet is in it or it no longer fits the output buffer.
+    if (sWorldSocketMgr->IsBatchingOutput())
+    {
+        const long tick = sWorldSocketMgr->GetOutputTick();
+        if (tick == m_FlushedTick && !m_FlushNow && msg_queue()->is_empty())
+            return 0;
+
+        m_FlushedTick = tick;
+    }
+
     int ret;
     do
-        ret = handle_output (get_handle());
+        ret = HandleOutput();
     while (ret > 0);
 
     return ret;
@@ -559,11 +797,9 @@ int WorldSocket::handle_input_payload (void)
 
 int WorldSocket::handle_input_missing_data (void)
 {
-    char buf [4096];
-
-    ACE_Data_Block db (sizeof (buf),
+    ACE_Data_Block db (WORLDSOCKET_RECV_BUFFER_SIZE,
                         ACE_Message_Block::MB_DATA,
-                        buf,
+                        recvBuffer->data,
                         0,
                         0,
                         ACE_Message_Block::DONT_DELETE,
@@ -646,15 +882,13 @@ int WorldSocket::handle_input_missing_data (void)
     return (size_t)n == recv_size ? 1 : 2;
 }
 
-int WorldSocket::cancel_wakeup_output (GuardType& g)
+int WorldSocket::cancel_wakeup_output (void)
 {
     if (!m_OutActive)
         return 0;
 
     m_OutActive = false;
 
-    g.release();
-
     if (reactor()->cancel_wakeup
         (this, ACE_Event_Handler::WRITE_MASK) == -1)
     {
@@ -666,15 +900,13 @@ int WorldSocket::cancel_wakeup_output (GuardType& g)
     return 0;
 }
 
-int WorldSocket::schedule_wakeup_output (GuardType& g)
+int WorldSocket::schedule_wakeup_output (void)
 {
     if (m_OutActive)
         return 0;
 
     m_OutActive = true;
 
-    g.release();
-
     if (reactor()->schedule_wakeup
         (this, ACE_Event_Handler::WRITE_MASK) == -1)
     {
@@ -694,9 +926,11 @@ int WorldSocket::ProcessIncoming (WorldPacket* new_pct)
 
     const ACE_UINT32 opcode = new_pct->GetOpcode();
 
-    if (closing_)
+    if (IsClosed())
         return -1;
 
+    sOpcodeStats->RecordReceived(opcode, new_pct->size());
+
     // Dump received packet.
     if (sWorldLog->LogWorld())
     {
@@ -722,19 +956,25 @@ int WorldSocket::ProcessIncoming (WorldPacket* new_pct)
         switch (opcode)
         {
             case CMSG_PING:
+            {
+                OpcodeStatsTimer timer(opcode);
                 return HandlePing (*new_pct);
+            }
             case CMSG_AUTH_SESSION:
+            {
                 if (m_Session)
                 {
                     sLog->outError ("WorldSocket::ProcessIncoming: Player send CMSG_AUTH_SESSION again");
                     return -1;
                 }
 
-                sScriptMgr->OnPacketReceive(this, WorldPacket(*new_pct));
+                OpcodeStatsTimer timer(opcode);
+                sScriptMgr->OnPacketReceive(this, *new_pct);
                 return HandleAuthSession (*new_pct);
+            }
             case CMSG_KEEP_ALIVE:
                 sLog->outStaticDebug ("CMSG_KEEP_ALIVE , size: " UI64FMTD, uint64(new_pct->size()));
-                sScriptMgr->OnPacketReceive(this, WorldPacket(*new_pct));
+                sScriptMgr->OnPacketReceive(this, *new_pct);
                 return 0;
             default:
             {
@@ -1007,7 +1247,15 @@ int WorldSocket::HandleAuthSession(WorldPacket& recvPacket)
     // NOTE ATM the socket is single-threaded, have this in mind ...
     ACE_NEW_RETURN (m_Session, WorldSession (id, this, AccountTypes(security), expansion, mutetime, locale, recruiter, isRecruiter), -1);
 
-    m_Crypt.Init(&K);
+    // packets queued before are sent without encryption
+    {
+        ACE_GUARD_RETURN (LockType, Guard, m_OutBufferLock, -1);
+
+        if (WriteQueuedPackets() == -1)
+            return -1;
+
+        m_Crypt.Init(&K);
+    }
 
     m_Session->LoadGlobalAccountData();
     m_Session->LoadTutorialsData();
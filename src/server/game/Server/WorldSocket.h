@@ -36,6 +36,7 @@
 #include <ace/Guard_T.h>
 #include <ace/Unbounded_Queue.h>
 #include <ace/Message_Block.h>
+#include <ace/Atomic_Op.h>
 
 #if !defined (ACE_LACKS_PRAGMA_ONCE)
 #pragma once
@@ -43,6 +44,8 @@
 
 #include "Common.h"
 #include "AuthCrypt.h"
+#include "MPSCQueue.h"
+#include "SharedPacket.h"
 
 class ACE_Message_Block;
 class WorldPacket;
@@ -59,9 +62,22 @@ typedef ACE_Svc_Handler<ACE_SOCK_STREAM, ACE_NULL_SYNCH> WorldHandler;
  * Most methods return -1 on failure.
  * The class uses reference counting.
  *
+ * SendPacket() copies a small packet straight into the output
+ * buffer if it gets the output lock without waiting, anything
+ * else goes to a lock free queue. The network thread running
+ * the reactor of the socket takes the packets off that queue
+ * in Update() and handle_output(), encrypts their headers and
+ * writes them out, so no sender ever waits for the lock.
+ *
  * For output the class uses one buffer (64K usually) and
  * a queue where it stores packet if there is no place on
- * the queue. The reason this is done, is because the server
+ * the buffer. Once something is queued, small packets are
+ * coalesced in blocks at the end of the queue, while the
+ * payloads of shared (broadcast) packets are queued by
+ * reference instead of being copied for every receiver.
+ * handle_output() sends the buffer and the queue with one
+ * vectored write. The reason the buffer is used at all,
+ * is because the server
  * does really a lot of small-size writes to it, and it doesn't
  * scale well to allocate memory for every. When something is
  * written to the output buffer the socket is not immediately
@@ -75,10 +91,12 @@ typedef ACE_Svc_Handler<ACE_SOCK_STREAM, ACE_NULL_SYNCH> WorldHandler;
  * The calls to Update() method are managed by WorldSocketMgr
  * and ReactorRunnable.
  *
- * For input , the class uses one 1024 bytes buffer on stack
- * to which it does recv() calls. And then received data is
- * distributed where its needed. 1024 matches pretty well the
- * traffic generated by client for now.
+ * For input , the class does recv() calls into one 64K buffer
+ * owned by the network thread, so a single call usually drains
+ * the kernel buffer even when the client sends a burst of
+ * packets. And then received data is distributed where its
+ * needed. A full buffer makes handle_input() ask the reactor
+ * to call it again, so other sockets get their turn in between.
  *
  * The input/output do speculative reads/writes (AKA it tryes
  * to read all data available in the kernel buffer or tryes to
@@ -111,11 +129,22 @@ class WorldSocket : protected WorldHandler
         /// Get address of connected peer.
         const std::string& GetRemoteAddress (void) const;
 
-        /// Send A packet on the socket, this function is reentrant.
-        /// @param pct packet to send
+        /// Send A packet on the socket, this function is reentrant and never waits for a lock.
+        /// @param pct packet to send, copied once, small ones straight into the output if the network thread isn't writing
         /// @return -1 of failure
         int SendPacket (const WorldPacket& pct);
 
+        /// Send a packet shared with other sockets, only its header is encrypted and copied.
+        /// @param shared packet to send, large payloads are referenced
+        /// @return -1 of failure
+        int SendPacket (const SharedPacket& shared);
+
+        /// Payload bytes copied into the output so far and payload bytes only referenced.
+        void GetOutputStats (uint64& copied, uint64& shared);
+
+        /// Packets written to the output so far and send calls it took to send them.
+        void GetFlushStats (uint64& frames, uint64& sends);
+
         /// Add reference to this object.
         long AddReference (void);
 
@@ -152,13 +181,34 @@ class WorldSocket : protected WorldHandler
         int handle_input_payload (void);
         int handle_input_missing_data (void);
 
+        /// Send the output, m_OutBufferLock must be held.
+        int HandleOutput (void);
+
         /// Help functions to mark/unmark the socket for output.
-        /// @param g the guard is for m_OutBufferLock, the function will release it
-        int cancel_wakeup_output (GuardType& g);
-        int schedule_wakeup_output (GuardType& g);
+        int cancel_wakeup_output (void);
+        int schedule_wakeup_output (void);
+
+        /// Write the packets added by SendPacket() to the output, in order, compressing
+        /// update packets left uncompressed by Compression.Async. m_OutBufferLock must be held.
+        int WriteQueuedPackets (void);
+
+        /// Compress an update packet left uncompressed by Compression.Async and write it.
+        /// @return 1 if it was written, 0 if it needs no compression, -1 on failure
+        int WriteCompressedUpdate (const WorldPacket& pct);
+
+        /// Write the header and a copy of the payload of a packet to the output.
+        int WritePacket (const WorldPacket& pct);
+
+        /// Write the header of a packet to the output and queue its payload by reference.
+        /// @param copied the payload was copied for this socket alone
+        int WriteSharedPacket (const SharedPacket& shared, bool copied);
+
+        /// Dump an outgoing packet and pass it to the hooks.
+        /// @return false if the packet must not be sent
+        bool OnSendPacket (const WorldPacket& pct);
 
-        /// Drain the queue if its not empty.
-        int handle_output_queue (GuardType& g);
+        /// Copy data to the end of the output.
+        int AppendOutput (const char* data, size_t len);
 
         /// process one incoming packet.
         /// @param new_pct received packet , note that you need to delete it.
@@ -200,7 +250,24 @@ class WorldSocket : protected WorldHandler
         /// Fragment of the received header.
         ACE_Message_Block m_Header;
 
-        /// Mutex for protecting output related data.
+        /// A packet added by SendPacket(), waiting for the network thread.
+        struct QueuedPacket
+        {
+            QueuedPacket() : copied(false) { }
+            QueuedPacket(const SharedPacket& pct, bool copy) : packet(pct), copied(copy) { }
+
+            SharedPacket packet;
+            bool copied;                                    // the payload is a copy made for this socket
+        };
+
+        /// Packets sent by any thread, taken out under m_OutBufferLock.
+        ACE_Based::MPSCQueue<QueuedPacket> m_SendQueue;
+
+        /// Serializes closing the socket.
+        LockType m_CloseLock;
+
+        /// Guards the output below and the header encryption. The network thread waits for it,
+        /// SendPacket only tries it to write small packets directly and queues them otherwise.
         LockType m_OutBufferLock;
 
         /// Buffer used for writing output.
@@ -209,10 +276,31 @@ class WorldSocket : protected WorldHandler
         /// Size of the m_OutBuffer.
         size_t m_OutBufferSize;
 
+        /// Last block of the queue if small packets can still be appended to it.
+        ACE_Message_Block* m_OutTail;
+
         /// True if the socket is registered with the reactor for output
         bool m_OutActive;
 
         uint32 m_Seed;
+
+        /// Payload bytes copied for the output and payload bytes queued by reference.
+        /// The statistics are read by other threads without a lock.
+        uint64 m_OutBytesCopied;
+        uint64 m_OutBytesShared;
+
+        /// Packets written to the output and send calls that went through.
+        uint64 m_OutFrames;
+        uint64 m_OutSends;
+
+        /// WorldSocketMgr output tick of the last flush of batched output.
+        long m_FlushedTick;
+
+        /// A packet that must not wait for the end of the world update was written.
+        bool m_FlushNow;
+
+        /// closing_ of ACE_Svc_Handler as seen by the threads that send packets.
+        ACE_Atomic_Op<ACE_Thread_Mutex, long> m_Closing;
 };
 
 #endif  /* _WORLDSOCKET_H */
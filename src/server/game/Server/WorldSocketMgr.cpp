@@ -46,6 +46,8 @@
 #include "WorldSocket.h"
 #include "WorldSocketAcceptor.h"
 #include "ScriptMgr.h"
+#include "Opcodes.h"
+#include "Util.h"
 
 /**
 * This is a helper class to WorldSocketMgr , that manages
@@ -218,6 +220,8 @@ WorldSocketMgr::WorldSocketMgr() :
     m_SockOutKBuff(-1),
     m_SockOutUBuff(65536),
     m_UseNoDelay(true),
+    m_BatchOutput(false),
+    m_OutputTick(0),
     m_Acceptor (0)
 {
     InitOpcodeTable();
@@ -259,6 +263,12 @@ WorldSocketMgr::StartReactiveIO (ACE_UINT16 port, const char* address)
         return -1;
     }
 
+    m_BatchOutput = ConfigMgr::GetBoolDefault ("Network.BatchOutput", false);
+
+    if (m_BatchOutput)
+        LoadImmediateOpcodes(ConfigMgr::GetStringDefault ("Network.BatchOutput.ImmediateOpcodes",
+            "SMSG_PONG SMSG_AUTH_RESPONSE MSG_MOVE_* SMSG_MONSTER_MOVE* SMSG_SPELL_START SMSG_SPELL_GO SMSG_ATTACKERSTATEUPDATE"));
+
     m_Acceptor = new WorldSocketAcceptor;
 
     ACE_INET_Addr listen_addr (port, address);
@@ -275,6 +285,36 @@ WorldSocketMgr::StartReactiveIO (ACE_UINT16 port, const char* address)
     return 0;
 }
 
+void
+WorldSocketMgr::LoadImmediateOpcodes (std::string const& names)
+{
+    m_ImmediateOpcodes.assign(NUM_MSG_TYPES, false);
+
+    // names ending with '*' match every opcode starting with the rest of the name
+    Tokens tokens(names, ' ');
+    for (Tokens::const_iterator itr = tokens.begin(); itr != tokens.end(); ++itr)
+    {
+        std::string name = *itr;
+        bool prefix = !name.empty() && name[name.size() - 1] == '*';
+        if (prefix)
+            name.erase(name.size() - 1);
+
+        uint32 matches = 0;
+        for (uint32 opcode = 0; opcode < NUM_MSG_TYPES; ++opcode)
+        {
+            const char* opcodeName = opcodeTable[opcode].name;
+            if (!opcodeName || (prefix ? strncmp(opcodeName, name.c_str(), name.size()) : strcmp(opcodeName, name.c_str())))
+                continue;
+
+            m_ImmediateOpcodes[opcode] = true;
+            ++matches;
+        }
+
+        if (!matches)
+            sLog->outError ("Network.BatchOutput.ImmediateOpcodes: unknown opcode %s", *itr);
+    }
+}
+
 int
 WorldSocketMgr::StartNetwork (ACE_UINT16 port, const char* address)
 {
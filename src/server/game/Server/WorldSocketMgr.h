@@ -29,6 +29,10 @@
 #include <ace/Basic_Types.h>
 #include <ace/Singleton.h>
 #include <ace/Thread_Mutex.h>
+#include <ace/Atomic_Op.h>
+
+#include <string>
+#include <vector>
 
 class WorldSocket;
 class ReactorRunnable;
@@ -50,9 +54,21 @@ public:
     /// Wait untill all network threads have "joined" .
     void Wait();
 
+    /// Let the sockets send the output batched during the world update that just ended.
+    void FlushOutput() { ++m_OutputTick; }
+
+    /// Sockets hold their output until FlushOutput() with Network.BatchOutput.
+    bool IsBatchingOutput() const { return m_BatchOutput; }
+
 private:
     int OnSocketOpen(WorldSocket* sock);
 
+    long GetOutputTick() const { return m_OutputTick.value(); }
+
+    /// Opcodes sent as soon as possible even while the output is batched.
+    bool IsImmediateOpcode(ACE_UINT32 opcode) const { return opcode < m_ImmediateOpcodes.size() && m_ImmediateOpcodes[opcode]; }
+    void LoadImmediateOpcodes(std::string const& names);
+
     int StartReactiveIO(ACE_UINT16 port, const char* address);
 
 private:
@@ -66,6 +82,10 @@ private:
     int m_SockOutUBuff;
     bool m_UseNoDelay;
 
+    bool m_BatchOutput;
+    std::vector<bool> m_ImmediateOpcodes;
+    ACE_Atomic_Op<ACE_Thread_Mutex, long> m_OutputTick;
+
     class WorldSocketAcceptor* m_Acceptor;
 };
 
@@ -1908,10 +1908,15 @@ void Spell::SearchAreaTarget(std::list<Unit*> &TagUnitMap, float radius, SpellNo
     }
 
     Trinity::SpellNotifierCreatureAndPlayer notifier(m_caster, TagUnitMap, radius, type, TargetType, pos, entry, m_spellInfo);
-    if ((m_spellInfo->AttributesEx3 & SPELL_ATTR3_ONLY_TARGET_PLAYERS) || (TargetType == SPELL_TARGETS_ENTRY && !entry))
+    if (TargetType == SPELL_TARGETS_ENTRY && !entry)
         m_caster->GetMap()->VisitWorld(pos->m_positionX, pos->m_positionY, radius, notifier);
     else
-        m_caster->GetMap()->VisitAll(pos->m_positionX, pos->m_positionY, radius, notifier);
+    {
+        // every push type measures from pos, from the caster when it adds its own size
+        uint32 typeMask = (m_spellInfo->AttributesEx3 & SPELL_ATTR3_ONLY_TARGET_PLAYERS) ? TYPEMASK_PLAYER : TYPEMASK_UNIT;
+        CellObjectIndexQuery query(pos->m_positionX, pos->m_positionY, pos->m_positionZ, radius + m_caster->GetObjectSize(), PHASEMASK_ANYWHERE, typeMask);
+        m_caster->GetMap()->VisitIndexed(query, notifier);
+    }
 }
 
 void Spell::SearchGOAreaTarget(std::list<GameObject*> &TagGOMap, float radius, SpellNotifyPushType type, SpellTargets TargetType, uint32 entry)
@@ -2024,7 +2029,7 @@ WorldObject* Spell::SearchNearbyTarget(float range, SpellTargets TargetType, Spe
             Unit* target = NULL;
             Trinity::AnyUnfriendlyUnitInObjectRangeCheck u_check(m_caster, m_caster, range);
             Trinity::UnitLastSearcher<Trinity::AnyUnfriendlyUnitInObjectRangeCheck> searcher(m_caster, target, u_check);
-            m_caster->VisitNearbyObject(range, searcher);
+            m_caster->VisitNearbyIndexedObject(range, TYPEMASK_UNIT, searcher, true);
             return target;
         }
         case SPELL_TARGETS_ALLY:
@@ -2032,7 +2037,7 @@ WorldObject* Spell::SearchNearbyTarget(float range, SpellTargets TargetType, Spe
             Unit* target = NULL;
             Trinity::AnyFriendlyUnitInObjectRangeCheck u_check(m_caster, m_caster, range);
             Trinity::UnitLastSearcher<Trinity::AnyFriendlyUnitInObjectRangeCheck> searcher(m_caster, target, u_check);
-            m_caster->VisitNearbyObject(range, searcher);
+            m_caster->VisitNearbyIndexedObject(range, TYPEMASK_UNIT, searcher);
             return target;
         }
     }
@@ -2835,11 +2840,12 @@ uint32 Spell::SelectEffectTargets(uint32 i, SpellImplicitTargetInfo const& cur)
                         // Remove targets not in LoS or in stealth
                         for (std::list<Unit*>::iterator itr = unitList.begin() ; itr != unitList.end();)
                         {
-                            if ((*itr)->HasStealthAura() || (*itr)->HasInvisibilityAura() || !(*itr)->IsWithinLOSInMap(m_caster))
+                            if ((*itr)->HasStealthAura() || (*itr)->HasInvisibilityAura())
                                 itr = unitList.erase(itr);
                             else
                                 ++itr;
                         }
+                        m_caster->SelectWithinLOSInMap(unitList);
                         break;
                     }
                     else
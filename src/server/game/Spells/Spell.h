@@ -713,61 +713,69 @@ namespace Trinity
         template<class T> inline void Visit(GridRefManager<T>& m)
         {
             for (typename GridRefManager<T>::iterator itr = m.begin(); itr != m.end(); ++itr)
+                Push((Unit*)itr->getSource());
+        }
+
+        // units found by Map::VisitIndexed
+        inline void Visit(CellObjectIndex::ObjectList const& units)
+        {
+            for (CellObjectIndex::ObjectList::const_iterator itr = units.begin(); itr != units.end(); ++itr)
+                Push((Unit*)*itr);
+        }
+
+        inline void Push(Unit* target)
+        {
+            if (i_spellProto->CheckTarget(i_source, target, true) != SPELL_CAST_OK)
+                return;
+
+            switch (i_TargetType)
+            {
+                case SPELL_TARGETS_ENEMY:
+                    if (target->isTotem())
+                        return;
+                    if (!i_source->_IsValidAttackTarget(target, i_spellProto))
+                        return;
+                    break;
+                case SPELL_TARGETS_ALLY:
+                    if (target->isTotem())
+                        return;
+                    if (!i_source->_IsValidAssistTarget(target, i_spellProto))
+                        return;
+                    break;
+                case SPELL_TARGETS_ENTRY:
+                    if (target->GetEntry()!= i_entry)
+                        return;
+                    break;
+                case SPELL_TARGETS_ANY:
+                default:
+                    break;
+            }
+
+            switch (i_push_type)
             {
-                Unit* target = (Unit*)itr->getSource();
-
-                if (i_spellProto->CheckTarget(i_source, target, true) != SPELL_CAST_OK)
-                    continue;
-
-                switch (i_TargetType)
-                {
-                    case SPELL_TARGETS_ENEMY:
-                        if (target->isTotem())
-                            continue;
-                        if (!i_source->_IsValidAttackTarget(target, i_spellProto))
-                            continue;
-                        break;
-                    case SPELL_TARGETS_ALLY:
-                        if (target->isTotem())
-                            continue;
-                        if (!i_source->_IsValidAssistTarget(target, i_spellProto))
-                            continue;
-                        break;
-                    case SPELL_TARGETS_ENTRY:
-                        if (target->GetEntry()!= i_entry)
-                            continue;
-                        break;
-                    case SPELL_TARGETS_ANY:
-                    default:
-                        break;
-                }
-
-                switch (i_push_type)
-                {
-                    case PUSH_SRC_CENTER:
-                    case PUSH_DST_CENTER:
-                    case PUSH_CHAIN:
-                    default:
-                        if (target->IsWithinDist3d(i_pos, i_radius))
-                            i_data->push_back(target);
-                        break;
-                    case PUSH_IN_FRONT:
-                        if (i_source->isInFront(target, i_radius, static_cast<float>(M_PI/2)))
-                            i_data->push_back(target);
-                        break;
-                    case PUSH_IN_BACK:
-                        if (i_source->isInBack(target, i_radius, static_cast<float>(M_PI/2)))
-                            i_data->push_back(target);
-                        break;
-                    case PUSH_IN_LINE:
-                        if (i_source->HasInLine(target, i_radius, i_source->GetObjectSize()))
-                            i_data->push_back(target);
-                        break;
-                    case PUSH_IN_THIN_LINE: // only traj
-                        if (i_pos->HasInLine(target, i_radius, 0))
-                            i_data->push_back(target);
-                        break;
-                }
+                case PUSH_SRC_CENTER:
+                case PUSH_DST_CENTER:
+                case PUSH_CHAIN:
+                default:
+                    if (target->IsWithinDist3d(i_pos, i_radius))
+                        i_data->push_back(target);
+                    break;
+                case PUSH_IN_FRONT:
+                    if (i_source->isInFront(target, i_radius, static_cast<float>(M_PI/2)))
+                        i_data->push_back(target);
+                    break;
+                case PUSH_IN_BACK:
+                    if (i_source->isInBack(target, i_radius, static_cast<float>(M_PI/2)))
+                        i_data->push_back(target);
+                    break;
+                case PUSH_IN_LINE:
+                    if (i_source->HasInLine(target, i_radius, i_source->GetObjectSize()))
+                        i_data->push_back(target);
+                    break;
+                case PUSH_IN_THIN_LINE: // only traj
+                    if (i_pos->HasInLine(target, i_radius, 0))
+                        i_data->push_back(target);
+                    break;
             }
         }
 
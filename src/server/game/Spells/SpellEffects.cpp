@@ -1581,7 +1581,7 @@ void Spell::EffectDummy(SpellEffIndex effIndex)
                         std::list<Unit*> targets;
                         Trinity::AnyUnfriendlyUnitInObjectRangeCheck u_check((*itr), (*itr), 6.0f);
                         Trinity::UnitListSearcher<Trinity::AnyUnfriendlyUnitInObjectRangeCheck> searcher((*itr), targets, u_check);
-                        (*itr)->VisitNearbyObject(6.0f, searcher);
+                        (*itr)->VisitNearbyIndexedObject(6.0f, TYPEMASK_UNIT, searcher, true);
                         for (std::list<Unit*>::const_iterator iter = targets.begin(); iter != targets.end(); ++iter)
                         {
                             //Damage spell
@@ -2532,7 +2532,7 @@ void Spell::EffectSendEvent(SpellEffIndex effIndex)
     sLog->outDebug(LOG_FILTER_SPELLS_AURAS, "Spell ScriptStart %u for spellid %u in EffectSendEvent ", m_spellInfo->Effects[effIndex].MiscValue, m_spellInfo->Id);
 
     if (ZoneScript* zoneScript = m_caster->GetZoneScript())
-        zoneScript->ProcessEvent(target, m_spellInfo->Effects[effIndex].MiscValue);
+        m_caster->GetMap()->ProcessZoneScriptEvent(zoneScript, target, m_spellInfo->Effects[effIndex].MiscValue);
     else if (InstanceScript* instanceScript = m_caster->GetInstanceScript())    // needed in case Player is the caster
         instanceScript->ProcessEvent(target, m_spellInfo->Effects[effIndex].MiscValue);
 
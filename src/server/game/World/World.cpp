@@ -28,6 +28,7 @@
 #include "Log.h"
 #include "Opcodes.h"
 #include "WorldSession.h"
+#include "WorldSocketMgr.h"
 #include "WorldPacket.h"
 #include "Player.h"
 #include "Vehicle.h"
@@ -56,6 +57,7 @@
 #include "TemporarySummon.h"
 #include "WaypointMovementGenerator.h"
 #include "VMapFactory.h"
+#include "MMapFactory.h"
 #include "GameEventMgr.h"
 #include "PoolMgr.h"
 #include "GridNotifiersImpl.h"
@@ -77,6 +79,7 @@
 #include "SmartAI.h"
 #include "Channel.h"
 #include "DB2Stores.h"
+#include "OpcodeStats.h"
 
 volatile bool World::m_stopEvent = false;
 uint8 World::m_ExitCode = SHUTDOWN_EXIT_CODE;
@@ -134,6 +137,7 @@ World::~World()
         delete command;
 
     VMAP::VMapFactory::clear();
+    MMAP::MMapFactory::clear();
 
     //TODO free addSessQueue
 }
@@ -575,6 +579,16 @@ void World::LoadConfigSettings(bool reload)
         sLog->outError("Compression level (%i) must be in range 1..9. Using default compression level (1).", m_int_configs[CONFIG_COMPRESSION]);
         m_int_configs[CONFIG_COMPRESSION] = 1;
     }
+    m_int_configs[CONFIG_COMPRESSION_THRESHOLD] = ConfigMgr::GetIntDefault("Compression.Threshold", 100);
+    m_int_configs[CONFIG_COMPRESSION_ADAPTIVE_BUDGET] = ConfigMgr::GetIntDefault("Compression.Adaptive.UpdateTime", 0);
+    m_int_configs[CONFIG_COMPRESSION_ADAPTIVE_THRESHOLD] = ConfigMgr::GetIntDefault("Compression.Adaptive.Threshold", 1024);
+    if (m_int_configs[CONFIG_COMPRESSION_ADAPTIVE_THRESHOLD] < m_int_configs[CONFIG_COMPRESSION_THRESHOLD])
+    {
+        sLog->outError("Compression.Adaptive.Threshold (%u) must be >= Compression.Threshold (%u). Using %u instead.",
+            m_int_configs[CONFIG_COMPRESSION_ADAPTIVE_THRESHOLD], m_int_configs[CONFIG_COMPRESSION_THRESHOLD], m_int_configs[CONFIG_COMPRESSION_THRESHOLD]);
+        m_int_configs[CONFIG_COMPRESSION_ADAPTIVE_THRESHOLD] = m_int_configs[CONFIG_COMPRESSION_THRESHOLD];
+    }
+    m_bool_configs[CONFIG_COMPRESSION_ASYNC] = ConfigMgr::GetBoolDefault("Compression.Async", false);
     m_bool_configs[CONFIG_ADDON_CHANNEL] = ConfigMgr::GetBoolDefault("AddonChannel", true);
     m_bool_configs[CONFIG_CLEAN_CHARACTER_DB] = ConfigMgr::GetBoolDefault("CleanCharacterDB", false);
     m_int_configs[CONFIG_PERSISTENT_CHARACTER_CLEAN_FLAGS] = ConfigMgr::GetIntDefault("PersistentCharacterCleanFlags", 0);
@@ -589,6 +603,7 @@ void World::LoadConfigSettings(bool reload)
     m_bool_configs[CONFIG_PRESERVE_CUSTOM_CHANNELS] = ConfigMgr::GetBoolDefault("PreserveCustomChannels", false);
     m_int_configs[CONFIG_PRESERVE_CUSTOM_CHANNEL_DURATION] = ConfigMgr::GetIntDefault("PreserveCustomChannelDuration", 14);
     m_bool_configs[CONFIG_GRID_UNLOAD] = ConfigMgr::GetBoolDefault("GridUnload", true);
+    m_bool_configs[CONFIG_GRID_MAP_MMAP] = ConfigMgr::GetBoolDefault("MapFiles.MemoryMapped", true);
     m_int_configs[CONFIG_INTERVAL_SAVE] = ConfigMgr::GetIntDefault("PlayerSaveInterval", 15 * MINUTE * IN_MILLISECONDS);
     m_int_configs[CONFIG_INTERVAL_DISCONNECT_TOLERANCE] = ConfigMgr::GetIntDefault("DisconnectToleranceInterval", 0);
     m_bool_configs[CONFIG_STATS_SAVE_ONLY_ON_LOGOUT] = ConfigMgr::GetBoolDefault("PlayerSave.Stats.SaveOnlyOnLogout", true);
@@ -1146,6 +1161,7 @@ void World::LoadConfigSettings(bool reload)
     bool enableLOS = ConfigMgr::GetBoolDefault("vmap.enableLOS", true);
     bool enableHeight = ConfigMgr::GetBoolDefault("vmap.enableHeight", true);
     bool enablePetLOS = ConfigMgr::GetBoolDefault("vmap.petLOS", true);
+    int32 losCacheSize = ConfigMgr::GetIntDefault("vmap.lineOfSightCacheSize", 8192);
     std::string ignoreSpellIds = ConfigMgr::GetStringDefault("vmap.ignoreSpellIds", "");
 
     if (!enableHeight)
@@ -1153,10 +1169,15 @@ void World::LoadConfigSettings(bool reload)
 
     VMAP::VMapFactory::createOrGetVMapManager()->setEnableLineOfSightCalc(enableLOS);
     VMAP::VMapFactory::createOrGetVMapManager()->setEnableHeightCalc(enableHeight);
+    VMAP::VMapFactory::createOrGetVMapManager()->setLineOfSightCacheSize(losCacheSize > 0 ? uint32(losCacheSize) : 0);
     VMAP::VMapFactory::preventSpellsFromBeingTestedForLoS(ignoreSpellIds.c_str());
-    sLog->outString("WORLD: VMap support included. LineOfSight:%i, getHeight:%i, indoorCheck:%i PetLOS:%i", enableLOS, enableHeight, enableIndoor, enablePetLOS);
+    sLog->outString("WORLD: VMap support included. LineOfSight:%i, getHeight:%i, indoorCheck:%i PetLOS:%i LineOfSightCache:%i", enableLOS, enableHeight, enableIndoor, enablePetLOS, losCacheSize);
     sLog->outString("WORLD: VMap data directory is: %svmaps", m_dataPath.c_str());
 
+    m_bool_configs[CONFIG_ENABLE_MMAPS] = ConfigMgr::GetBoolDefault("mmap.enablePathFinding", false);
+    MMAP::MMapFactory::setPathfindingEnabled(m_bool_configs[CONFIG_ENABLE_MMAPS]);
+    sLog->outString("WORLD: MMap pathfinding %sabled, data directory is: %smmaps", m_bool_configs[CONFIG_ENABLE_MMAPS] ? "en" : "dis", m_dataPath.c_str());
+
     m_int_configs[CONFIG_MAX_WHO] = ConfigMgr::GetIntDefault("MaxWhoListReturns", 49);
     m_bool_configs[CONFIG_PET_LOS] = ConfigMgr::GetBoolDefault("vmap.petLOS", true);
     m_bool_configs[CONFIG_START_ALL_SPELLS] = ConfigMgr::GetBoolDefault("PlayerStart.AllSpells", false);
@@ -1178,8 +1199,22 @@ void World::LoadConfigSettings(bool reload)
     m_int_configs[CONFIG_INTERVAL_LOG_UPDATE] = ConfigMgr::GetIntDefault("RecordUpdateTimeDiffInterval", 60000);
     m_int_configs[CONFIG_MIN_LOG_UPDATE] = ConfigMgr::GetIntDefault("MinRecordUpdateTimeDiff", 100);
     m_int_configs[CONFIG_NUMTHREADS] = ConfigMgr::GetIntDefault("MapUpdate.Threads", 1);
+    m_bool_configs[CONFIG_MAP_PARALLEL_GRID_UPDATE] = ConfigMgr::GetBoolDefault("MapUpdate.ParallelGrids", false);
+    m_bool_configs[CONFIG_MAP_PARALLEL_SESSION_UPDATE] = ConfigMgr::GetBoolDefault("MapUpdate.ParallelSessions", false);
+    m_bool_configs[CONFIG_GRID_PREFETCH] = ConfigMgr::GetBoolDefault("GridPrefetch.Enable", false);
+    m_int_configs[CONFIG_GRID_PREFETCH_LOOKAHEAD] = ConfigMgr::GetIntDefault("GridPrefetch.LookAhead", 10000);
     m_int_configs[CONFIG_MAX_RESULTS_LOOKUP_COMMANDS] = ConfigMgr::GetIntDefault("Command.LookupMaxResults", 0);
 
+    // opcode statistics
+    m_bool_configs[CONFIG_OPCODE_STATS] = ConfigMgr::GetBoolDefault("OpcodeStats.Enable", false);
+    m_int_configs[CONFIG_OPCODE_STATS_DUMP_INTERVAL] = ConfigMgr::GetIntDefault("OpcodeStats.DumpInterval", 0);
+    if (reload)
+    {
+        m_timers[WUPDATE_OPCODESTATS].SetInterval(m_int_configs[CONFIG_OPCODE_STATS_DUMP_INTERVAL] * IN_MILLISECONDS);
+        m_timers[WUPDATE_OPCODESTATS].Reset();
+    }
+    sOpcodeStats->Initialize(m_bool_configs[CONFIG_OPCODE_STATS]);
+
     // chat logging
     m_bool_configs[CONFIG_CHATLOG_CHANNEL] = ConfigMgr::GetBoolDefault("ChatLogs.Channel", false);
     m_bool_configs[CONFIG_CHATLOG_WHISPER] = ConfigMgr::GetBoolDefault("ChatLogs.Whisper", false);
@@ -1722,6 +1757,8 @@ void World::SetInitialWorldSettings()
 
     m_timers[WUPDATE_PINGDB].SetInterval(getIntConfig(CONFIG_DB_PING_INTERVAL)*MINUTE*IN_MILLISECONDS);    // Mysql ping time in minutes
 
+    m_timers[WUPDATE_OPCODESTATS].SetInterval(getIntConfig(CONFIG_OPCODE_STATS_DUMP_INTERVAL)*IN_MILLISECONDS);
+
     //to set mailtimer to return mails every day between 4 and 5 am
     //mailtimer is increased when updating auctions
     //one second is 1000 -(tested on win system)
@@ -2018,6 +2055,16 @@ void World::Update(uint32 diff)
         }
     }
 
+    /// <li> Dump opcode statistics
+    if (getBoolConfig(CONFIG_OPCODE_STATS) && getIntConfig(CONFIG_OPCODE_STATS_DUMP_INTERVAL) > 0)
+    {
+        if (m_timers[WUPDATE_OPCODESTATS].Passed())
+        {
+            m_timers[WUPDATE_OPCODESTATS].Reset();
+            sOpcodeStats->Dump();
+        }
+    }
+
     /// <li> Handle all other objects
     ///- Update objects when the timer has passed (maps, transport, creatures, ...)
     RecordTimeDiff(NULL);
@@ -2089,6 +2136,9 @@ void World::Update(uint32 diff)
     ProcessCliCommands();
 
     sScriptMgr->OnWorldUpdate(diff);
+
+    // everything sent during this update can go out now
+    sWorldSocketMgr->FlushOutput();
 }
 
 void World::ForceGameEventUpdate()
@@ -2594,6 +2644,10 @@ void World::UpdateSessions(uint32 diff)
     while (addSessQueue.next(sess))
         AddSession_ (sess);
 
+    ///- Let the map update threads process the packets of the opcode domains first
+    if (getBoolConfig(CONFIG_MAP_PARALLEL_SESSION_UPDATE))
+        UpdateSessionDomains();
+
     ///- Then send an update signal to remaining ones
     for (SessionMap::iterator itr = m_sessions.begin(), next; itr != m_sessions.end(); itr = next)
     {
@@ -2615,6 +2669,28 @@ void World::UpdateSessions(uint32 diff)
     }
 }
 
+/// Process the thread-unsafe packets with an opcode domain (see Opcodes.cpp) in the map update threads,
+/// handlers of one domain are serialized by its lock
+void World::UpdateSessionDomains()
+{
+    MapUpdater* updater = sMapMgr->GetMapUpdater();
+    if (!updater->activated())
+        return;
+
+    std::vector<WorldSession*> sessions;
+    sessions.reserve(m_sessions.size());
+    for (SessionMap::const_iterator itr = m_sessions.begin(); itr != m_sessions.end(); ++itr)
+        if (itr->second->GetPlayer() && itr->second->GetPlayer()->IsInWorld())
+            sessions.push_back(itr->second);
+
+    // a session is always processed by a single request, so its packets keep their order
+    const size_t sessionsPerRequest = 32;
+    for (size_t begin = 0; begin < sessions.size(); begin += sessionsPerRequest)
+        updater->schedule_session_update(sessions, begin, std::min(begin + sessionsPerRequest, sessions.size()));
+
+    updater->wait();
+}
+
 // This handles the issued and queued CLI commands
 void World::ProcessCliCommands()
 {
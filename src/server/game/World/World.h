@@ -78,6 +78,7 @@ enum WorldTimers
     WUPDATE_MAILBOXQUEUE,
     WUPDATE_DELETECHARS,
     WUPDATE_PINGDB,
+    WUPDATE_OPCODESTATS,
     WUPDATE_COUNT
 };
 
@@ -167,6 +168,13 @@ enum WorldBoolConfigs
     CONFIG_QUEST_IGNORE_AUTO_COMPLETE,
     CONFIG_WINTERGRASP_ENABLE,
     CONFIG_TOL_BARAD_ENABLE,
+    CONFIG_MAP_PARALLEL_GRID_UPDATE,
+    CONFIG_GRID_PREFETCH,
+    CONFIG_GRID_MAP_MMAP,
+    CONFIG_ENABLE_MMAPS,
+    CONFIG_COMPRESSION_ASYNC,
+    CONFIG_MAP_PARALLEL_SESSION_UPDATE,
+    CONFIG_OPCODE_STATS,
     BOOL_CONFIG_VALUE_COUNT
 };
 
@@ -328,6 +336,11 @@ enum WorldIntConfigs
     CONFIG_TOL_BARAD_BATTLETIME,
     CONFIG_TOL_BARAD_NOBATTLETIME,
     CONFIG_IGNORING_MAPS_VERSION,
+    CONFIG_GRID_PREFETCH_LOOKAHEAD,
+    CONFIG_COMPRESSION_THRESHOLD,
+    CONFIG_COMPRESSION_ADAPTIVE_BUDGET,
+    CONFIG_COMPRESSION_ADAPTIVE_THRESHOLD,
+    CONFIG_OPCODE_STATS_DUMP_INTERVAL,
     INT_CONFIG_VALUE_COUNT
 };
 
@@ -670,6 +683,7 @@ class World
         void Update(uint32 diff);
 
         void UpdateSessions(uint32 diff);
+        void UpdateSessionDomains();
         /// Set a server rate (see #Rates)
         void setRate(Rates rate, float value) { rate_values[rate]=value; }
         /// Get a server rate (see #Rates)
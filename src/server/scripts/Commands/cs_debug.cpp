@@ -32,8 +32,38 @@ EndScriptData */
 #include "GridNotifiers.h"
 #include "GridNotifiersImpl.h"
 #include "GossipDef.h"
+#include "MapManager.h"
+#include "GridPrefetcher.h"
+#include "MMapFactory.h"
+#include "VMapFactory.h"
+#include "PathGenerator.h"
+#include "SharedPacket.h"
+#include "WorldSocketMgr.h"
+#include "OpcodeStats.h"
+#include "LockedQueue.h"
+#include "MPSCQueue.h"
 
 #include <fstream>
+#include <ace/Task.h>
+
+/// Threads adding to a receive queue for .debug recvqueue, as the network threads do
+template<class Queue>
+class RecvQueueProducers : public ACE_Task_Base
+{
+public:
+    RecvQueueProducers(Queue& queue, uint32 count) : _queue(queue), _count(count) { }
+
+    int svc()
+    {
+        for (uint32 i = 1; i <= _count; ++i)
+            _queue.add(i);
+        return 0;
+    }
+
+private:
+    Queue& _queue;
+    uint32 const _count;
+};
 
 class debug_commandscript : public CommandScript
 {
@@ -89,6 +119,16 @@ public:
             { "update",        SEC_ADMINISTRATOR,  false, &HandleDebugUpdateCommand,          "", NULL },
             { "itemexpire",    SEC_ADMINISTRATOR,  false, &HandleDebugItemExpireCommand,      "", NULL },
             { "areatriggers",  SEC_ADMINISTRATOR,  false, &HandleDebugAreaTriggersCommand,    "", NULL },
+            { "mapupdate",     SEC_ADMINISTRATOR,  false, &HandleDebugMapUpdateCommand,       "", NULL },
+            { "terrain",       SEC_ADMINISTRATOR,  false, &HandleDebugTerrainCommand,         "", NULL },
+            { "mmap",          SEC_ADMINISTRATOR,  false, &HandleDebugMMapCommand,            "", NULL },
+            { "los",           SEC_ADMINISTRATOR,  false, &HandleDebugLosCommand,             "", NULL },
+            { "broadcast",     SEC_ADMINISTRATOR,  false, &HandleDebugBroadcastCommand,       "", NULL },
+            { "netstats",      SEC_ADMINISTRATOR,  true,  &HandleDebugNetStatsCommand,        "", NULL },
+            { "opcodestats",   SEC_ADMINISTRATOR,  true,  &HandleDebugOpcodeStatsCommand,     "", NULL },
+            { "recvqueue",     SEC_ADMINISTRATOR,  true,  &HandleDebugRecvQueueCommand,       "", NULL },
+            { "valuesupdate",  SEC_ADMINISTRATOR,  false, &HandleDebugValuesUpdateCommand,    "", NULL },
+            { "areasearch",    SEC_ADMINISTRATOR,  false, &HandleDebugAreaSearchCommand,      "", NULL },
             { NULL,             0,                  false, NULL,                               "", NULL }
         };
         static ChatCommand commandTable[] =
@@ -782,6 +822,523 @@ public:
         return true;
     }
 
+    static bool HandleDebugMapUpdateCommand(ChatHandler* handler, char const* /*args*/)
+    {
+        Map* map = handler->GetSession()->GetPlayer()->GetMap();
+
+        handler->PSendSysMessage("Map %u (%s) instance %u: last update %u ms, average %u ms, %u grid regions, %u objects updated after them",
+            map->GetId(), map->GetMapName(), map->GetInstanceId(), map->GetUpdateTime(), map->GetAverageUpdateTime(), map->GetGridRegionCount(), map->GetGridRegionDeferredCount());
+        handler->PSendSysMessage("Visibility: %u players, last relocation notify visited %u moved units in %u us, %u units waiting",
+            map->GetPlayersCountExceptGMs(), map->GetRelocationNotifyCount(), map->GetRelocationNotifyTime(), map->GetPendingNotifyCount());
+
+        MapUpdater* updater = sMapMgr->GetMapUpdater();
+        if (updater->activated())
+            handler->PSendSysMessage("Map updater: %u queued (max %u), %li executed, %li stolen",
+                uint32(updater->queue_depth()), uint32(updater->max_queue_depth()), updater->executed_count(), updater->steal_count());
+
+        if (sGridPrefetcher->IsEnabled())
+            handler->PSendSysMessage("Grid prefetch: %u hits, %u misses, %u expired, %u ms spent loading grids synchronously",
+                sGridPrefetcher->GetHits(), sGridPrefetcher->GetMisses(), sGridPrefetcher->GetExpired(), sGridPrefetcher->GetStallTime());
+
+        handler->PSendSysMessage("Terrain: %li grid maps, %li KB memory mapped, %li KB on heap, %li ms spent loading",
+            GridMap::GetLoadedCount(), GridMap::GetMappedBytes() / 1024, GridMap::GetHeapBytes() / 1024, GridMap::GetLoadTime() / 1000);
+        return true;
+    }
+
+    // compares single point and batch .map terrain queries on random points around the player
+    static bool HandleDebugTerrainCommand(ChatHandler* handler, char const* args)
+    {
+        uint32 count = *args ? uint32(atoi(args)) : 10000;
+        if (!count)
+            return false;
+
+        Player* player = handler->GetSession()->GetPlayer();
+        Map* map = player->GetMap();
+
+        std::vector<float> x(count), y(count), z(count), heights(count);
+        std::vector<ZLiquidStatus> statuses(count);
+        for (uint32 i = 0; i < count; ++i)
+        {
+            x[i] = player->GetPositionX() + frand(-100.0f, 100.0f);
+            y[i] = player->GetPositionY() + frand(-100.0f, 100.0f);
+            z[i] = player->GetPositionZ();
+            Trinity::NormalizeMapCoord(x[i]);
+            Trinity::NormalizeMapCoord(y[i]);
+        }
+
+        ACE_Time_Value start = ACE_OS::gettimeofday();
+        for (uint32 i = 0; i < count; ++i)
+            heights[i] = map->GetHeight(x[i], y[i], z[i], false);
+        ACE_Time_Value singleTime = ACE_OS::gettimeofday() - start;
+
+        std::vector<float> batchHeights(count);
+        start = ACE_OS::gettimeofday();
+        map->GetHeights(count, &x[0], &y[0], &z[0], &batchHeights[0], false);
+        ACE_Time_Value batchTime = ACE_OS::gettimeofday() - start;
+
+        uint32 mismatches = 0;
+        for (uint32 i = 0; i < count; ++i)
+            if (fabs(heights[i] - batchHeights[i]) > 0.001f)
+                ++mismatches;
+
+        handler->PSendSysMessage("Heights of %u points: %li us single, %li us batch, %u mismatches",
+            count, long(singleTime.sec() * 1000000 + singleTime.usec()), long(batchTime.sec() * 1000000 + batchTime.usec()), mismatches);
+
+        start = ACE_OS::gettimeofday();
+        for (uint32 i = 0; i < count; ++i)
+            statuses[i] = map->getLiquidStatus(x[i], y[i], z[i], MAP_ALL_LIQUIDS);
+        singleTime = ACE_OS::gettimeofday() - start;
+
+        std::vector<ZLiquidStatus> batchStatuses(count);
+        start = ACE_OS::gettimeofday();
+        map->GetLiquidStatuses(count, &x[0], &y[0], &z[0], MAP_ALL_LIQUIDS, &batchStatuses[0]);
+        batchTime = ACE_OS::gettimeofday() - start;
+
+        mismatches = 0;
+        for (uint32 i = 0; i < count; ++i)
+            if (statuses[i] != batchStatuses[i])
+                ++mismatches;
+
+        handler->PSendSysMessage("Liquid status of %u points: %li us single, %li us batch, %u mismatches",
+            count, long(singleTime.sec() * 1000000 + singleTime.usec()), long(batchTime.sec() * 1000000 + batchTime.usec()), mismatches);
+        return true;
+    }
+
+    // navmesh state and time of #count paths from the player to random points around him
+    static bool HandleDebugMMapCommand(ChatHandler* handler, char const* args)
+    {
+        uint32 count = *args ? uint32(atoi(args)) : 1000;
+        if (!count)
+            return false;
+
+        MMAP::MMapManager* manager = MMAP::MMapFactory::createOrGetMMapManager();
+        handler->PSendSysMessage("Pathfinding %s, %u maps and %u tiles loaded, %u queries allocated",
+            MMAP::MMapFactory::isPathfindingEnabled() ? "enabled" : "disabled",
+            manager->getLoadedMapsCount(), manager->getLoadedTilesCount(), manager->getQueryCount());
+
+        Player* player = handler->GetSession()->GetPlayer();
+        uint32 normal = 0, incomplete = 0, noPath = 0, notUsing = 0, points = 0;
+
+        ACE_Time_Value start = ACE_OS::gettimeofday();
+        for (uint32 i = 0; i < count; ++i)
+        {
+            float x = player->GetPositionX() + frand(-40.0f, 40.0f);
+            float y = player->GetPositionY() + frand(-40.0f, 40.0f);
+            float z = player->GetPositionZ();
+
+            PathGenerator path(player);
+            path.CalculatePath(x, y, z);
+            points += uint32(path.GetPath().size());
+
+            PathType type = path.GetPathType();
+            if (type & PATHFIND_NOT_USING_PATH)
+                ++notUsing;
+            else if (type & PATHFIND_NOPATH)
+                ++noPath;
+            else if (type & PATHFIND_INCOMPLETE)
+                ++incomplete;
+            else
+                ++normal;
+        }
+        ACE_Time_Value elapsed = ACE_OS::gettimeofday() - start;
+        long usec = long(elapsed.sec() * 1000000 + elapsed.usec());
+
+        handler->PSendSysMessage("%u paths in %li us (%.0f/s), %u points: %u normal, %u incomplete, %u no path, %u straight",
+            count, usec, usec ? count * 1000000.0 / usec : 0.0, points, normal, incomplete, noPath, notUsing);
+        return true;
+    }
+
+    // line of sight cache counters, time of #count single and batched checks to random points around the player
+    // without the cache, then with the cache twice
+    static bool HandleDebugLosCommand(ChatHandler* handler, char const* args)
+    {
+        uint32 count = *args ? uint32(atoi(args)) : 1000;
+        if (!count)
+            return false;
+
+        VMAP::IVMapManager* manager = VMAP::VMapFactory::createOrGetVMapManager();
+        uint32 maps;
+        uint64 hits, misses;
+        manager->getLineOfSightCacheStats(maps, hits, misses);
+        handler->PSendSysMessage("Line of sight cache: %u entries per map, %u maps, " UI64FMTD " hits, " UI64FMTD " misses (%.1f%%)",
+            manager->getLineOfSightCacheSize(), maps, hits, misses, hits + misses ? hits * 100.0 / (hits + misses) : 0.0);
+
+        Player* player = handler->GetSession()->GetPlayer();
+        float srcX = player->GetPositionX();
+        float srcY = player->GetPositionY();
+        float srcZ = player->GetPositionZ() + 2.0f;
+
+        std::vector<float> x(count), y(count), z(count);
+        for (uint32 i = 0; i < count; ++i)
+        {
+            x[i] = srcX + frand(-40.0f, 40.0f);
+            y[i] = srcY + frand(-40.0f, 40.0f);
+            z[i] = srcZ + frand(-5.0f, 5.0f);
+        }
+
+        // raw collision first, single rays against packets of rays without the cache
+        std::vector<bool> single(count);
+        uint32 visible = 0;
+        ACE_Time_Value start = ACE_OS::gettimeofday();
+        for (uint32 i = 0; i < count; ++i)
+        {
+            single[i] = manager->isInLineOfSight(player->GetMapId(), srcX, srcY, srcZ, x[i], y[i], z[i], false);
+            if (single[i])
+                ++visible;
+        }
+        ACE_Time_Value singleTime = ACE_OS::gettimeofday() - start;
+
+        bool* batch = new bool[count];
+        start = ACE_OS::gettimeofday();
+        manager->isInLineOfSight(player->GetMapId(), srcX, srcY, srcZ, count, &x[0], &y[0], &z[0], batch, false);
+        ACE_Time_Value batchTime = ACE_OS::gettimeofday() - start;
+
+        uint32 mismatches = 0;
+        for (uint32 i = 0; i < count; ++i)
+            if (batch[i] != single[i])
+                ++mismatches;
+        delete[] batch;
+
+        handler->PSendSysMessage("%u checks, %u in line of sight: %li us single, %li us batch, %u mismatches",
+            count, visible, long(singleTime.sec() * 1000000 + singleTime.usec()), long(batchTime.sec() * 1000000 + batchTime.usec()), mismatches);
+
+        if (!manager->getLineOfSightCacheSize())
+            return true;
+
+        // the second pass repeats the rays of the first one
+        for (uint32 pass = 0; pass < 2; ++pass)
+        {
+            start = ACE_OS::gettimeofday();
+            for (uint32 i = 0; i < count; ++i)
+                manager->isInLineOfSight(player->GetMapId(), srcX, srcY, srcZ, x[i], y[i], z[i]);
+            ACE_Time_Value elapsed = ACE_OS::gettimeofday() - start;
+
+            handler->PSendSysMessage("Cached pass %u: %u checks in %li us", pass + 1, count, long(elapsed.sec() * 1000000 + elapsed.usec()));
+        }
+
+        return true;
+    }
+
+    static bool HandleDebugBroadcastCommand(ChatHandler* handler, char const* args)
+    {
+        char* sizeStr = strtok((char*)args, " ");
+        char* countStr = strtok(NULL, " ");
+        char* receiversStr = strtok(NULL, " ");
+
+        uint32 size = sizeStr ? uint32(atoi(sizeStr)) : 512;
+        uint32 count = countStr ? uint32(atoi(countStr)) : 10;
+        if (!count || size > 0x7FFF)
+            return false;
+
+        // by default as many copies as players a broadcast of ours reaches, all of them go to our own client
+        WorldSession* session = handler->GetSession();
+        Player* player = session->GetPlayer();
+        uint32 receivers = receiversStr ? uint32(atoi(receiversStr)) : 0;
+        if (!receiversStr)
+        {
+            std::list<Player*> players;
+            Trinity::AnyPlayerInObjectRangeCheck check(player, player->GetVisibilityRange(), false);
+            Trinity::PlayerListSearcher<Trinity::AnyPlayerInObjectRangeCheck> searcher(player, players, check);
+            player->VisitNearbyWorldObject(player->GetVisibilityRange(), searcher);
+            receivers = uint32(players.size());
+        }
+
+        if (!receivers || receivers > 1000)
+            return false;
+
+        // an addon message with an unregistered prefix, clients drop it
+        std::string message = "SFBENCH\t";
+        message.resize(std::max<size_t>(size, message.size()), 'x');
+        WorldPacket data;
+        ChatHandler::FillMessageData(&data, session, CHAT_MSG_WHISPER, LANG_ADDON, NULL, player->GetGUID(), message.c_str(), NULL);
+
+        uint64 copiedBefore, sharedBefore, copiedAfter, sharedAfter;
+
+        // every send copies the packet, as a loop over SendPacket(WorldPacket const*) does
+        session->GetOutputStats(copiedBefore, sharedBefore);
+        ACE_Time_Value start = ACE_OS::gettimeofday();
+        for (uint32 i = 0; i < count; ++i)
+            for (uint32 j = 0; j < receivers; ++j)
+                session->SendPacket(&data);
+        ACE_Time_Value copyTime = ACE_OS::gettimeofday() - start;
+        session->GetOutputStats(copiedAfter, sharedAfter);
+        uint64 copyCopied = copiedAfter - copiedBefore;
+
+        // the payload is copied once per broadcast and referenced by the sends, as MessageDistDeliverer does
+        session->GetOutputStats(copiedBefore, sharedBefore);
+        start = ACE_OS::gettimeofday();
+        for (uint32 i = 0; i < count; ++i)
+        {
+            SharedPacket shared(data);
+            for (uint32 j = 0; j < receivers; ++j)
+                session->SendPacket(shared);
+        }
+        ACE_Time_Value sharedTime = ACE_OS::gettimeofday() - start;
+        session->GetOutputStats(copiedAfter, sharedAfter);
+        uint64 sharedCopied = copiedAfter - copiedBefore + uint64(data.size()) * count;
+        uint64 sharedReferenced = sharedAfter - sharedBefore;
+
+        handler->PSendSysMessage("%u broadcasts of %u bytes to %u receivers (payloads below %u bytes are always copied)",
+            count, uint32(data.size()), receivers, uint32(SHARED_PACKET_MIN_SIZE));
+        handler->PSendSysMessage("Copied: %li us and " UI64FMTD " bytes copied per broadcast",
+            long(copyTime.sec() * 1000000 + copyTime.usec()) / long(count), copyCopied / count);
+        handler->PSendSysMessage("Shared: %li us and " UI64FMTD " bytes copied, " UI64FMTD " bytes referenced per broadcast",
+            long(sharedTime.sec() * 1000000 + sharedTime.usec()) / long(count), sharedCopied / count, sharedReferenced / count);
+        return true;
+    }
+
+    static bool HandleDebugNetStatsCommand(ChatHandler* handler, char const* /*args*/)
+    {
+        uint64 frames = 0, sends = 0, copied = 0, shared = 0;
+        uint32 sessions = 0;
+
+        {
+            TRINITY_READ_GUARD(HashMapHolder<Player>::LockType, *HashMapHolder<Player>::GetLock());
+            HashMapHolder<Player>::MapType const& players = sObjectAccessor->GetPlayers();
+            for (HashMapHolder<Player>::MapType::const_iterator itr = players.begin(); itr != players.end(); ++itr)
+            {
+                uint64 sessionFrames, sessionSends, sessionCopied, sessionShared;
+                itr->second->GetSession()->GetFlushStats(sessionFrames, sessionSends);
+                itr->second->GetSession()->GetOutputStats(sessionCopied, sessionShared);
+                frames += sessionFrames;
+                sends += sessionSends;
+                copied += sessionCopied;
+                shared += sessionShared;
+                ++sessions;
+            }
+        }
+
+        handler->PSendSysMessage("Output of %u player sessions (batched: %s)", sessions, sWorldSocketMgr->IsBatchingOutput() ? "yes" : "no");
+        handler->PSendSysMessage("Packets: " UI64FMTD ", send calls: " UI64FMTD ", packets per send call: %.2f",
+            frames, sends, sends ? double(frames) / double(sends) : 0.0);
+        handler->PSendSysMessage("Payload bytes copied: " UI64FMTD ", referenced: " UI64FMTD, copied, shared);
+        return true;
+    }
+
+    static bool OpcodeStatsByHandlerTime(OpcodeStatsEntry const& left, OpcodeStatsEntry const& right)
+    {
+        return left.handlerTime > right.handlerTime;
+    }
+
+    static bool HandleDebugOpcodeStatsCommand(ChatHandler* handler, char const* args)
+    {
+        if (!sOpcodeStats->IsEnabled())
+        {
+            handler->SendSysMessage("Opcode statistics are disabled, see OpcodeStats.Enable.");
+            return true;
+        }
+
+        uint32 count = 10;
+        if (*args)
+        {
+            if (!strcmp(args, "reset"))
+            {
+                sOpcodeStats->Reset();
+                handler->SendSysMessage("Opcode statistics reset.");
+                return true;
+            }
+
+            if (!strcmp(args, "dump"))
+            {
+                if (sOpcodeStats->Dump())
+                    handler->PSendSysMessage("Opcode statistics written to %s.", sOpcodeStats->GetDumpFile().c_str());
+                else
+                    handler->SendSysMessage("Opcode statistics not written, check OpcodeStats.DumpFile.");
+                return true;
+            }
+
+            count = uint32(atoi(args));
+            if (!count)
+                return false;
+        }
+
+        OpcodeStatsEntries entries;
+        sOpcodeStats->Collect(entries);
+
+        uint64 calls[PROCESS_THREADSAFE + 1] = { 0, 0, 0 };
+        uint64 time[PROCESS_THREADSAFE + 1] = { 0, 0, 0 };
+        uint64 bytesIn = 0, bytesOut = 0;
+        for (OpcodeStatsEntries::const_iterator itr = entries.begin(); itr != entries.end(); ++itr)
+        {
+            PacketProcessing processing = opcodeTable[itr->opcode].packetProcessing;
+            calls[processing] += itr->handled;
+            time[processing] += itr->handlerTime;
+            bytesIn += itr->bytesIn;
+            bytesOut += itr->bytesOut;
+        }
+
+        handler->PSendSysMessage("Handler calls: in place " UI64FMTD " (" UI64FMTD " ms), thread-unsafe " UI64FMTD " (" UI64FMTD " ms), thread-safe " UI64FMTD " (" UI64FMTD " ms)",
+            calls[PROCESS_INPLACE], time[PROCESS_INPLACE] / IN_MILLISECONDS, calls[PROCESS_THREADUNSAFE], time[PROCESS_THREADUNSAFE] / IN_MILLISECONDS,
+            calls[PROCESS_THREADSAFE], time[PROCESS_THREADSAFE] / IN_MILLISECONDS);
+        handler->PSendSysMessage("Payload bytes received: " UI64FMTD ", sent: " UI64FMTD, bytesIn, bytesOut);
+
+        std::sort(entries.begin(), entries.end(), OpcodeStatsByHandlerTime);
+        for (OpcodeStatsEntries::const_iterator itr = entries.begin(); itr != entries.end() && count && itr->handled; ++itr, --count)
+            handler->PSendSysMessage("%s (0x%.4X): " UI64FMTD " calls, " UI64FMTD " ms, avg " UI64FMTD " us, p99 < %u us, max " UI64FMTD " us, " UI64FMTD " bytes in",
+                LookupOpcodeName(itr->opcode), itr->opcode, itr->handled, itr->handlerTime / IN_MILLISECONDS, itr->handlerTime / itr->handled,
+                itr->GetLatencyPercentile(0.99f), itr->maxHandlerTime, itr->bytesIn);
+
+        return true;
+    }
+
+    /// Time the producers need to hand their items to the consumer of a receive queue
+    template<class Queue>
+    static ACE_Time_Value RunRecvQueueProducers(uint32 producers, uint32 count)
+    {
+        Queue queue;
+        RecvQueueProducers<Queue> task(queue, count);
+
+        ACE_Time_Value start = ACE_OS::gettimeofday();
+        if (task.activate(THR_NEW_LWP | THR_JOINABLE, int(producers)) == -1)
+            return ACE_Time_Value::zero;
+
+        // the consumer takes the items while they are added, as the world and map threads do
+        uint32 item;
+        for (uint64 left = uint64(producers) * count; left;)
+            if (queue.next(item))
+                --left;
+
+        ACE_Time_Value elapsed = ACE_OS::gettimeofday() - start;
+        task.wait();
+        return elapsed;
+    }
+
+    static bool HandleDebugRecvQueueCommand(ChatHandler* handler, char const* args)
+    {
+        char* producersStr = strtok((char*)args, " ");
+        char* countStr = strtok(NULL, " ");
+
+        uint32 producers = producersStr ? uint32(atoi(producersStr)) : 4;
+        uint32 count = countStr ? uint32(atoi(countStr)) : 1000000;
+        if (!producers || producers > 64 || !count)
+            return false;
+
+        ACE_Time_Value locked = RunRecvQueueProducers<ACE_Based::LockedQueue<uint32, ACE_Thread_Mutex> >(producers, count);
+        ACE_Time_Value lockFree = RunRecvQueueProducers<ACE_Based::MPSCQueue<uint32> >(producers, count);
+        if (locked == ACE_Time_Value::zero || lockFree == ACE_Time_Value::zero)
+        {
+            handler->SendSysMessage("Could not start the producer threads.");
+            handler->SetSentErrorMessage(true);
+            return false;
+        }
+
+        uint64 items = uint64(producers) * count;
+        handler->PSendSysMessage("%u producers adding %u items each, one consumer", producers, count);
+        handler->PSendSysMessage("Locked queue: %u ms, " UI64FMTD " ns per item",
+            uint32(locked.msec()), uint64(locked.sec() * 1000000 + locked.usec()) * 1000 / items);
+        handler->PSendSysMessage("Lock-free queue: %u ms, " UI64FMTD " ns per item",
+            uint32(lockFree.msec()), uint64(lockFree.sec() * 1000000 + lockFree.usec()) * 1000 / items);
+        return true;
+    }
+
+    static bool HandleDebugValuesUpdateCommand(ChatHandler* handler, char const* args)
+    {
+        uint32 count = *args ? uint32(atoi(args)) : 100;
+        if (!count)
+            return false;
+
+        Unit* unit = handler->getSelectedUnit();
+        if (!unit)
+            unit = handler->GetSession()->GetPlayer();
+
+        // the players the changes of the unit are sent to
+        std::list<Player*> receivers;
+        Trinity::AnyPlayerInObjectRangeCheck check(unit, unit->GetVisibilityRange(), false);
+        Trinity::PlayerListSearcher<Trinity::AnyPlayerInObjectRangeCheck> searcher(unit, receivers, check);
+        unit->VisitNearbyWorldObject(unit->GetVisibilityRange(), searcher);
+
+        // fields changing all the time in combat, the unit sends them once more with the next update
+        static uint16 const fields[] = { UNIT_FIELD_HEALTH, UNIT_FIELD_POWER1, UNIT_FIELD_FLAGS, UNIT_FIELD_AURASTATE,
+            UNIT_FIELD_BYTES_2, UNIT_FIELD_FACTIONTEMPLATE, UNIT_DYNAMIC_FLAGS, UNIT_FIELD_TARGET };
+        for (uint8 i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i)
+            unit->ForceValuesUpdateAtIndex(fields[i]);
+
+        UpdateData uncached(unit->GetMapId());
+        UpdateData cached(unit->GetMapId());
+
+        ACE_Time_Value start = ACE_OS::gettimeofday();
+        for (uint32 i = 0; i < count; ++i)
+        {
+            uncached.Clear();
+            for (std::list<Player*>::const_iterator itr = receivers.begin(); itr != receivers.end(); ++itr)
+                unit->BuildValuesUpdateBlockForPlayer(&uncached, *itr);
+        }
+        ACE_Time_Value uncachedTime = ACE_OS::gettimeofday() - start;
+
+        start = ACE_OS::gettimeofday();
+        for (uint32 i = 0; i < count; ++i)
+        {
+            cached.Clear();
+            ValuesUpdateCache cache;
+            for (std::list<Player*>::const_iterator itr = receivers.begin(); itr != receivers.end(); ++itr)
+                unit->BuildValuesUpdateBlockForPlayer(&cached, *itr, cache);
+        }
+        ACE_Time_Value cachedTime = ACE_OS::gettimeofday() - start;
+
+        // both ways have to give the same data
+        WorldPacket uncachedPacket, cachedPacket;
+        uncached.BuildPacket(&uncachedPacket);
+        cached.BuildPacket(&cachedPacket);
+        bool same = uncachedPacket.size() == cachedPacket.size() &&
+            (!cachedPacket.size() || !memcmp(uncachedPacket.contents(), cachedPacket.contents(), cachedPacket.size()));
+
+        handler->PSendSysMessage("%u value updates of %s for %u players, %u bytes per update, data %s",
+            count, unit->GetName(), uint32(receivers.size()), uint32(cachedPacket.size()), same ? "identical" : "DIFFERENT");
+        handler->PSendSysMessage("Per player: %li us per update", long(uncachedTime.sec() * 1000000 + uncachedTime.usec()) / long(count));
+        handler->PSendSysMessage("Per observer class: %li us per update", long(cachedTime.sec() * 1000000 + cachedTime.usec()) / long(count));
+        return true;
+    }
+
+    static bool HandleDebugAreaSearchCommand(ChatHandler* handler, char const* args)
+    {
+        char* countStr = strtok((char*)args, " ");
+        char* radiusStr = strtok(NULL, " ");
+
+        uint32 count = countStr ? uint32(atoi(countStr)) : 1000;
+        float radius = radiusStr ? float(atof(radiusStr)) : 30.0f;
+        if (!count || radius <= 0.0f)
+            return false;
+
+        Player* player = handler->GetSession()->GetPlayer();
+        Trinity::AnyUnitInObjectRangeCheck check(player, radius);
+
+        // the cell lists of both containers, as the searchers walked them so far
+        std::list<Unit*> walked;
+        ACE_Time_Value start = ACE_OS::gettimeofday();
+        for (uint32 i = 0; i < count; ++i)
+        {
+            walked.clear();
+            Trinity::UnitListSearcher<Trinity::AnyUnitInObjectRangeCheck> searcher(player, walked, check);
+            player->VisitNearbyObject(radius + player->GetObjectSize(), searcher);
+        }
+        ACE_Time_Value walkTime = ACE_OS::gettimeofday() - start;
+
+        std::list<Unit*> indexed;
+        start = ACE_OS::gettimeofday();
+        for (uint32 i = 0; i < count; ++i)
+        {
+            indexed.clear();
+            Trinity::UnitListSearcher<Trinity::AnyUnitInObjectRangeCheck> searcher(player, indexed, check);
+            player->VisitNearbyIndexedObject(radius, TYPEMASK_UNIT, searcher, true);
+        }
+        ACE_Time_Value indexTime = ACE_OS::gettimeofday() - start;
+
+        // every object of the searched cells, to relate the times to the crowd
+        CellObjectIndex::ObjectList candidates;
+        CellObjectIndexQuery everything(player->GetPositionX(), player->GetPositionY(), player->GetPositionZ(), radius + player->GetObjectSize(), PHASEMASK_ANYWHERE, TYPEMASK_UNIT);
+        player->GetMap()->SearchCellIndexes(everything, candidates);
+
+        // the cell index search leaves the player out
+        walked.remove(player);
+        walked.sort();
+        indexed.sort();
+        handler->PSendSysMessage("%u area searches of %.1f yards, %u units in range, %u alive units found, results %s",
+            count, radius, uint32(candidates.size()), uint32(indexed.size()), walked == indexed ? "identical" : "DIFFERENT");
+        handler->PSendSysMessage("Cell lists: %li us per search", long(walkTime.sec() * 1000000 + walkTime.usec()) / long(count));
+        handler->PSendSysMessage("Cell indexes: %li us per search", long(indexTime.sec() * 1000000 + indexTime.usec()) / long(count));
+        return true;
+    }
+
     static bool HandleDebugArenaCommand(ChatHandler* /*handler*/, char const* /*args*/)
     {
         sBattlegroundMgr->ToggleArenaTesting();
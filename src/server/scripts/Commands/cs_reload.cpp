@@ -38,6 +38,7 @@ EndScriptData */
 #include "SkillExtraItems.h"
 #include "Chat.h"
 #include "WaypointManager.h"
+#include "QueryResponseCache.h"
 
 class reload_commandscript : public CommandScript
 {
@@ -512,6 +513,7 @@ public:
             const_cast<CreatureTemplate*>(cInfo)->ScriptID = sObjectMgr->GetScriptId(fields[82].GetCString());
 
             sObjectMgr->CheckCreatureTemplate(cInfo);
+            sQueryResponseCache->Invalidate(QUERY_RESPONSE_CREATURE, entry);
         }
 
         handler->SendGlobalGMSysMessage("Creature template reloaded.");
@@ -752,6 +754,7 @@ public:
     {
         sLog->outString( "Re-Loading Quest POI ..." );
         sObjectMgr->LoadQuestPOI();
+        sQueryResponseCache->Invalidate(QUERY_RESPONSE_QUEST_POI);
         handler->SendGlobalGMSysMessage("DB Table `quest_poi` and `quest_poi_points` reloaded.");
         return true;
     }
@@ -912,6 +915,7 @@ public:
     {
         sLog->outString("Re-Loading Page Texts...");
         sObjectMgr->LoadPageTexts();
+        sQueryResponseCache->Invalidate(QUERY_RESPONSE_PAGE_TEXT);
         handler->SendGlobalGMSysMessage("DB table `page_texts` reloaded.");
         return true;
     }
@@ -1149,6 +1153,7 @@ public:
     {
         sLog->outString("Re-Loading Locales Creature ...");
         sObjectMgr->LoadCreatureLocales();
+        sQueryResponseCache->Invalidate(QUERY_RESPONSE_CREATURE);
         handler->SendGlobalGMSysMessage("DB table `locales_creature` reloaded.");
         return true;
     }
@@ -1157,6 +1162,7 @@ public:
     {
         sLog->outString("Re-Loading Locales Gameobject ... ");
         sObjectMgr->LoadGameObjectLocales();
+        sQueryResponseCache->Invalidate(QUERY_RESPONSE_GAMEOBJECT);
         handler->SendGlobalGMSysMessage("DB table `locales_gameobject` reloaded.");
         return true;
     }
@@ -1189,6 +1195,7 @@ public:
     {
         sLog->outString("Re-Loading Locales NPC Text ... ");
         sObjectMgr->LoadNpcTextLocales();
+        sQueryResponseCache->Invalidate(QUERY_RESPONSE_NPC_TEXT);
         handler->SendGlobalGMSysMessage("DB table `locales_npc_text` reloaded.");
         return true;
     }
@@ -1197,6 +1204,7 @@ public:
     {
         sLog->outString("Re-Loading Locales Page Text ... ");
         sObjectMgr->LoadPageTextLocales();
+        sQueryResponseCache->Invalidate(QUERY_RESPONSE_PAGE_TEXT);
         handler->SendGlobalGMSysMessage("DB table `locales_page_text` reloaded.");
         return true;
     }
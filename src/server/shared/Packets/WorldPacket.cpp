@@ -18,12 +18,69 @@
  */
 
 #include "WorldPacket.h"
-#include "World.h"
+#include "Log.h"
 #include "Opcodes.h"
 
+#include <ace/TSS_T.h>
 #include <zlib.h>
 
-void WorldPacket::compress(uint32 opcode)
+/// Deflate stream kept by each thread that compresses packets, reset between packets
+/// instead of allocating and initializing the zlib state for every one of them.
+class PacketDeflateStream
+{
+    public:
+        PacketDeflateStream() : _level(-1)
+        {
+            memset(&_stream, 0, sizeof(_stream));
+        }
+
+        ~PacketDeflateStream()
+        {
+            if (_level != -1)
+                deflateEnd(&_stream);
+        }
+
+        z_stream* Get(int level)
+        {
+            int z_res;
+            if (_level == -1)
+            {
+                z_res = deflateInit(&_stream, level);
+                if (z_res != Z_OK)
+                {
+                    sLog->outError("Can't compress update packet (zlib: deflateInit) Error code: %i (%s)", z_res, zError(z_res));
+                    return NULL;
+                }
+
+                _level = level;
+                return &_stream;
+            }
+
+            z_res = deflateReset(&_stream);
+            if (z_res == Z_OK && level != _level)
+                z_res = deflateParams(&_stream, level, Z_DEFAULT_STRATEGY);
+
+            if (z_res != Z_OK)
+            {
+                sLog->outError("Can't compress update packet (zlib: deflateReset) Error code: %i (%s)", z_res, zError(z_res));
+                deflateEnd(&_stream);
+                _level = -1;
+                return NULL;
+            }
+
+            _level = level;
+            return &_stream;
+        }
+
+    private:
+        z_stream _stream;
+        int _level;
+};
+
+typedef ACE_TSS<PacketDeflateStream> PacketDeflateStreamTSS;
+static PacketDeflateStreamTSS deflateStream;
+
+void WorldPacket::compress(uint32 opcode, int level)
 {
     if (opcode == OPCODE_NOT_FOUND)  // this just doesn't look right, atm not using that define opcode way.
         return;
@@ -34,7 +91,7 @@ void WorldPacket::compress(uint32 opcode)
 
     std::vector<uint8> storage(destsize);
 
-    _compress(static_cast<void*>(&storage[0]), &destsize, static_cast<const void*>(contents()), size);
+    _compress(static_cast<void*>(&storage[0]), &destsize, static_cast<const void*>(contents()), size, level);
     if (destsize == 0)
         return;
 
@@ -48,44 +105,22 @@ void WorldPacket::compress(uint32 opcode)
         uncompressedOpcode, size, opcode, destsize);
 }
 
-void WorldPacket::_compress(void* dst, uint32 *dst_size, const void* src, int src_size)
+void WorldPacket::_compress(void* dst, uint32 *dst_size, const void* src, int src_size, int level)
 {
-    z_stream c_stream;
-
-    c_stream.zalloc = (alloc_func)0;
-    c_stream.zfree = (free_func)0;
-    c_stream.opaque = (voidpf)0;
-
-    // default Z_BEST_SPEED (1)
-    int z_res = deflateInit(&c_stream, sWorld->getIntConfig(CONFIG_COMPRESSION));
-    if (z_res != Z_OK)
-    {
-        sLog->outError("Can't compress update packet (zlib: deflateInit) Error code: %i (%s)", z_res, zError(z_res));
-        *dst_size = 0;
-        return;
-    }
-
-    c_stream.next_out = (Bytef*)dst;
-    c_stream.avail_out = *dst_size;
-    c_stream.next_in = (Bytef*)src;
-    c_stream.avail_in = (uInt)src_size;
-
-    z_res = deflate(&c_stream, Z_NO_FLUSH);
-    if (z_res != Z_OK)
+    z_stream* c_stream = deflateStream->Get(level);
+    if (!c_stream)
     {
-        sLog->outError("Can't compress update packet (zlib: deflate) Error code: %i (%s)", z_res, zError(z_res));
         *dst_size = 0;
         return;
     }
 
-    if (c_stream.avail_in != 0)
-    {
-        sLog->outError("Can't compress update packet (zlib: deflate not greedy)");
-        *dst_size = 0;
-        return;
-    }
+    c_stream->next_out = (Bytef*)dst;
+    c_stream->avail_out = *dst_size;
+    c_stream->next_in = (Bytef*)src;
+    c_stream->avail_in = (uInt)src_size;
 
-    z_res = deflate(&c_stream, Z_FINISH);
+    // the output buffer holds compressBound() bytes, a single call has to finish the stream
+    int z_res = deflate(c_stream, Z_FINISH);
     if (z_res != Z_STREAM_END)
     {
         sLog->outError("Can't compress update packet (zlib: deflate should report Z_STREAM_END instead %i (%s)", z_res, zError(z_res));
@@ -93,13 +128,5 @@ void WorldPacket::_compress(void* dst, uint32 *dst_size, const void* src, int sr
         return;
     }
 
-    z_res = deflateEnd(&c_stream);
-    if (z_res != Z_OK)
-    {
-        sLog->outError("Can't compress update packet (zlib: deflateEnd) Error code: %i (%s)", z_res, zError(z_res));
-        *dst_size = 0;
-        return;
-    }
-
-    *dst_size = c_stream.total_out;
+    *dst_size = c_stream->total_out;
 }
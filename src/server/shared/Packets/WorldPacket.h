@@ -46,9 +46,10 @@ class WorldPacket : public ByteBuffer
         uint32 GetOpcode() const { return m_opcode; }
         void SetOpcode(uint32 opcode) { m_opcode = opcode; }
 
-        void compress(uint32 opcode);
+        /// Replaces the contents with their zlib stream at the given level (1..9), under the given opcode
+        void compress(uint32 opcode, int level);
     protected:
         uint32 m_opcode;
-        void _compress(void* dst, uint32 *dst_size, const void* src, int src_size);
+        void _compress(void* dst, uint32 *dst_size, const void* src, int src_size, int level);
 };
 #endif
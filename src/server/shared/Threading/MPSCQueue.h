@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ * Copyright (C) 2008-2012 TrinityCore <http://www.trinitycore.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include "Define.h"
+
+#include <ace/TSS_T.h>
+
+#if COMPILER == COMPILER_MICROSOFT
+#  include <windows.h>
+#endif
+
+namespace ACE_Based
+{
+    /**
+     * Unbounded queue any number of threads add to without a lock, while a
+     * single consumer at a time takes the items out (D. Vyukov's node based
+     * MPSC queue). Producers exchange the head and then link the previous
+     * node, so adding never waits on another thread; the consumer owns the
+     * tail. Consumers may change between calls as long as the hand over is
+     * synchronized, as it is between the world and the map update threads.
+     *
+     * An item added while the consumer reads the queue may show up only on
+     * its next call, after the producer linked it.
+     *
+     * Nodes are recycled: consumers push the nodes they are done with on a
+     * free list shared by all queues of the type, a producer that runs out
+     * of cached nodes takes the whole list into its thread's cache with one
+     * exchange. Taking everything at once keeps the list free of ABA.
+     */
+    template <class T>
+    class MPSCQueue
+    {
+        struct Node
+        {
+            Node() : next(NULL), item() { }
+            explicit Node(T const& value) : next(NULL), item(value) { }
+
+            Node* volatile next;
+            T item;
+        };
+
+        //! Nodes a thread took from the free list, only used by that thread.
+        struct NodeCache
+        {
+            NodeCache() : first(NULL) { }
+            ~NodeCache()
+            {
+                while (Node* node = first)
+                {
+                    first = node->next;
+                    delete node;
+                }
+            }
+
+            Node* first;
+        };
+
+        //! Nodes freed by the consumers of all queues of the type.
+        static Node* volatile _freeNodes;
+        static ACE_TSS<NodeCache> _nodeCache;
+
+        //! Last added node, exchanged by the producers.
+        Node* volatile _head;
+
+        //! Node before the first item, owned by the consumer.
+        Node* _tail;
+
+        static Node* Exchange(Node* volatile* target, Node* value)
+        {
+#if COMPILER == COMPILER_MICROSOFT
+            return static_cast<Node*>(InterlockedExchangePointer((PVOID volatile*)target, value));
+#else
+            // __sync_lock_test_and_set is only an acquire barrier, the node must be written before it is published
+            __sync_synchronize();
+            return __sync_lock_test_and_set(target, value);
+#endif
+        }
+
+        static bool CompareExchange(Node* volatile* target, Node* value, Node* comparand)
+        {
+#if COMPILER == COMPILER_MICROSOFT
+            return InterlockedCompareExchangePointer((PVOID volatile*)target, value, comparand) == comparand;
+#else
+            return __sync_bool_compare_and_swap(target, comparand, value);
+#endif
+        }
+
+        static Node* AllocateNode(T const& item)
+        {
+            Node*& cached = _nodeCache->first;
+            if (!cached)
+                cached = Exchange(&_freeNodes, NULL);
+
+            Node* node = cached;
+            if (!node)
+                return new Node(item);
+
+            cached = node->next;
+            node->next = NULL;
+            node->item = item;
+            return node;
+        }
+
+        //! The item of the node must be reset already.
+        static void FreeNode(Node* node)
+        {
+            // only the head is compared, pushing is safe against nodes being taken and pushed again meanwhile
+            Node* first;
+            do
+            {
+                first = _freeNodes;
+                node->next = first;
+            }
+            while (!CompareExchange(&_freeNodes, node, first));
+        }
+
+        static void StoreRelease(Node* volatile* target, Node* value)
+        {
+#if COMPILER == COMPILER_MICROSOFT
+            MemoryBarrier();
+#else
+            __sync_synchronize();
+#endif
+            *target = value;
+        }
+
+        static Node* LoadAcquire(Node* volatile const* target)
+        {
+            Node* value = *target;
+#if COMPILER == COMPILER_MICROSOFT
+            MemoryBarrier();
+#else
+            __sync_synchronize();
+#endif
+            return value;
+        }
+
+        MPSCQueue(MPSCQueue const&);
+        MPSCQueue& operator=(MPSCQueue const&);
+
+        public:
+
+            MPSCQueue() : _head(new Node()), _tail(_head)
+            {
+            }
+
+            //! Items still queued are dropped, delete owned pointers first.
+            ~MPSCQueue()
+            {
+                T item;
+                while (next(item))
+                    ;
+
+                delete _tail;
+            }
+
+            //! Adds an item to the queue, from any thread.
+            void add(T const& item)
+            {
+                Node* node = AllocateNode(item);
+                Node* prev = Exchange(&_head, node);
+                // until this store the consumer sees the queue end at prev
+                StoreRelease(&prev->next, node);
+            }
+
+            //! Gets the next item, if any. Consumer only.
+            bool next(T& result)
+            {
+                Node* tail = _tail;
+                Node* first = LoadAcquire(&tail->next);
+                if (!first)
+                    return false;
+
+                // first becomes the new stub, its item is handed out
+                result = first->item;
+                first->item = T();
+                _tail = first;
+                FreeNode(tail);
+                return true;
+            }
+
+            //! Gets the next item if the checker accepts it, an item it rejects stays first. Consumer only.
+            template<class Checker>
+            bool next(T& result, Checker& check)
+            {
+                Node* first = LoadAcquire(&_tail->next);
+                if (!first || !check.Process(first->item))
+                    return false;
+
+                return next(result);
+            }
+
+            //! Looks at the next item without taking it. Consumer only.
+            bool peek(T& result) const
+            {
+                Node* first = LoadAcquire(&_tail->next);
+                if (!first)
+                    return false;
+
+                result = first->item;
+                return true;
+            }
+
+            //! Consumer only, producers may add items right after.
+            bool empty() const
+            {
+                return LoadAcquire(&_tail->next) == NULL;
+            }
+    };
+
+    template <class T>
+    typename MPSCQueue<T>::Node* volatile MPSCQueue<T>::_freeNodes = NULL;
+
+    template <class T>
+    ACE_TSS<typename MPSCQueue<T>::NodeCache> MPSCQueue<T>::_nodeCache;
+}
+#endif
@@ -647,7 +647,8 @@ bool ConvertADT(char *filename, char *filename2, int cell_y, int cell_x, uint32
                     liquid_height[y][x] = CONF_use_minHeight;
             }
         }
-        map.liquidMapOffset = map.heightMapOffset + map.heightMapSize;
+        // keep the liquid heights 4 byte aligned, the server maps the files into memory
+        map.liquidMapOffset = (map.heightMapOffset + map.heightMapSize + 3) & ~3;
         map.liquidMapSize = sizeof(map_liquidHeader);
         liquidHeader.fourcc = *(uint32 const*)MAP_LIQUID_MAGIC;
         liquidHeader.flags = 0;
@@ -714,6 +715,8 @@ bool ConvertADT(char *filename, char *filename2, int cell_y, int cell_x, uint32
     // Store liquid data if need
     if (map.liquidMapOffset)
     {
+        uint32 padding = 0;
+        fwrite(&padding, map.liquidMapOffset - (map.heightMapOffset + map.heightMapSize), 1, output);
         fwrite(&liquidHeader, sizeof(liquidHeader), 1, output);
         if (!(liquidHeader.flags&MAP_LIQUID_NO_TYPE))
             fwrite(liquid_type, sizeof(liquid_type), 1, output);
@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AuthClient.h"
+#include "ByteBuffer.h"
+#include "SHA1.h"
+
+#include <ace/SOCK_Connector.h>
+
+#include <algorithm>
+#include <cctype>
+
+enum AuthCommand
+{
+    AUTH_LOGON_CHALLENGE    = 0x00,
+    AUTH_LOGON_PROOF        = 0x01
+};
+
+#define AUTH_TIMEOUT        10                              // seconds
+#define AUTH_SALT_SIZE      32
+
+AuthClient::AuthClient(ACE_INET_Addr const& address) : _address(address)
+{
+}
+
+AuthClient::~AuthClient()
+{
+    _peer.close();
+}
+
+bool AuthClient::Fail(char const* error)
+{
+    _error = error;
+    _peer.close();
+    return false;
+}
+
+bool AuthClient::Receive(void* data, size_t size)
+{
+    ACE_Time_Value timeout(AUTH_TIMEOUT);
+    return _peer.recv_n(data, size, &timeout) == ssize_t(size);
+}
+
+bool AuthClient::Send(void const* data, size_t size)
+{
+    ACE_Time_Value timeout(AUTH_TIMEOUT);
+    return _peer.send_n(data, size, &timeout) == ssize_t(size);
+}
+
+bool AuthClient::Logon(std::string const& account, std::string const& password, BigNumber& K)
+{
+    ACE_SOCK_Connector connector;
+    ACE_Time_Value timeout(AUTH_TIMEOUT);
+    if (connector.connect(_peer, _address, &timeout) == -1)
+        return Fail("can't connect to the auth server");
+
+    std::string login = account;
+    std::string pass = password;
+    std::transform(login.begin(), login.end(), login.begin(), ::toupper);
+    std::transform(pass.begin(), pass.end(), pass.begin(), ::toupper);
+
+    // sAuthLogonChallenge_C, the four character codes are sent reversed
+    ByteBuffer challenge;
+    challenge << uint8(AUTH_LOGON_CHALLENGE);
+    challenge << uint8(8);                                  // protocol version
+    challenge << uint16(30 + login.length());               // size of the rest
+    challenge.append("WoW", 4);
+    challenge << uint8(4) << uint8(0) << uint8(6);          // 4.0.6
+    challenge << uint16(LOADGEN_CLIENT_BUILD);
+    challenge.append("68x", 4);                             // x86
+    challenge.append("niW", 4);                             // Win
+    challenge.append("SUne", 4);                            // enUS
+    challenge << uint32(0);                                 // timezone bias
+    challenge << uint32(0x0100007F);                        // 127.0.0.1
+    challenge << uint8(login.length());
+    challenge.append(login.c_str(), login.length());
+
+    if (!Send(challenge.contents(), challenge.size()))
+        return Fail("can't send the logon challenge");
+
+    uint8 header[3];
+    if (!Receive(header, sizeof(header)) || header[0] != AUTH_LOGON_CHALLENGE)
+        return Fail("no logon challenge answer");
+
+    if (header[2] != 0)
+        return Fail("logon challenge refused, check that the account exists and is not banned");
+
+    // B[32], g_len, g, N_len, N, s[32], unk[16], security flags
+    uint8 B_raw[32];
+    uint8 g_len, N_len;
+    uint8 g_raw[32], N_raw[32];
+    uint8 s_raw[AUTH_SALT_SIZE];
+    uint8 unk[16];
+    uint8 securityFlags;
+
+    if (!Receive(B_raw, 32) || !Receive(&g_len, 1) || g_len > 32 || !Receive(g_raw, g_len) ||
+        !Receive(&N_len, 1) || N_len > 32 || !Receive(N_raw, N_len) ||
+        !Receive(s_raw, AUTH_SALT_SIZE) || !Receive(unk, 16) || !Receive(&securityFlags, 1))
+        return Fail("truncated logon challenge answer");
+
+    if (securityFlags)
+        return Fail("account requires a pin, matrix or token");
+
+    BigNumber N, g, B, s;
+    N.SetBinary(N_raw, N_len);
+    g.SetBinary(g_raw, g_len);
+    B.SetBinary(B_raw, 32);
+    s.SetBinary(s_raw, AUTH_SALT_SIZE);
+
+    BigNumber a;
+    a.SetRand(19 * 8);
+    BigNumber A = g.ModExp(a, N);
+
+    SHA1Hash sha;
+    sha.UpdateBigNumbers(&A, &B, NULL);
+    sha.Finalize();
+    BigNumber u;
+    u.SetBinary(sha.GetDigest(), 20);
+
+    // x = H(s | H(I:P)), the password hash stored in account.sha_pass_hash
+    sha.Initialize();
+    sha.UpdateData(login + ":" + pass);
+    sha.Finalize();
+    uint8 passHash[SHA_DIGEST_LENGTH];
+    memcpy(passHash, sha.GetDigest(), SHA_DIGEST_LENGTH);
+
+    sha.Initialize();
+    sha.UpdateData(s_raw, AUTH_SALT_SIZE);
+    sha.UpdateData(passHash, SHA_DIGEST_LENGTH);
+    sha.Finalize();
+    BigNumber x;
+    x.SetBinary(sha.GetDigest(), 20);
+
+    // S = (B - 3 * g^x) ^ (a + u * x), kept positive by adding 3 * N
+    BigNumber gx = g.ModExp(x, N);
+    BigNumber base = (B + N * 3 - gx * 3) % N;
+    BigNumber S = base.ModExp(a + u * x, N);
+
+    // same interleaved hash of S as AuthSocket::_HandleLogonProof
+    uint8 t[32];
+    uint8 t1[16];
+    uint8 vK[40];
+    memcpy(t, S.AsByteArray(32), 32);
+
+    for (int i = 0; i < 16; ++i)
+        t1[i] = t[i * 2];
+
+    sha.Initialize();
+    sha.UpdateData(t1, 16);
+    sha.Finalize();
+
+    for (int i = 0; i < 20; ++i)
+        vK[i * 2] = sha.GetDigest()[i];
+
+    for (int i = 0; i < 16; ++i)
+        t1[i] = t[i * 2 + 1];
+
+    sha.Initialize();
+    sha.UpdateData(t1, 16);
+    sha.Finalize();
+
+    for (int i = 0; i < 20; ++i)
+        vK[i * 2 + 1] = sha.GetDigest()[i];
+
+    K.SetBinary(vK, 40);
+
+    uint8 hash[20];
+
+    sha.Initialize();
+    sha.UpdateBigNumbers(&N, NULL);
+    sha.Finalize();
+    memcpy(hash, sha.GetDigest(), 20);
+    sha.Initialize();
+    sha.UpdateBigNumbers(&g, NULL);
+    sha.Finalize();
+
+    for (int i = 0; i < 20; ++i)
+        hash[i] ^= sha.GetDigest()[i];
+
+    BigNumber t3;
+    t3.SetBinary(hash, 20);
+
+    sha.Initialize();
+    sha.UpdateData(login);
+    sha.Finalize();
+    uint8 t4[SHA_DIGEST_LENGTH];
+    memcpy(t4, sha.GetDigest(), SHA_DIGEST_LENGTH);
+
+    sha.Initialize();
+    sha.UpdateBigNumbers(&t3, NULL);
+    sha.UpdateData(t4, SHA_DIGEST_LENGTH);
+    sha.UpdateBigNumbers(&s, &A, &B, &K, NULL);
+    sha.Finalize();
+
+    // sAuthLogonProof_C
+    ByteBuffer proof;
+    proof << uint8(AUTH_LOGON_PROOF);
+    proof.append(A.AsByteArray(32), 32);
+    proof.append(sha.GetDigest(), 20);                      // M1
+    for (int i = 0; i < 20; ++i)
+        proof << uint8(0);                                  // crc hash, not checked
+    proof << uint8(0);                                      // number of keys
+    proof << uint8(0);                                      // security flags
+
+    if (!Send(proof.contents(), proof.size()))
+        return Fail("can't send the logon proof");
+
+    uint8 result[2];
+    if (!Receive(result, sizeof(result)) || result[0] != AUTH_LOGON_PROOF)
+        return Fail("no logon proof answer");
+
+    if (result[1] != 0)
+        return Fail("wrong password");
+
+    // M2[20], unk1, unk2, unk3 of sAuthLogonProof_S, the server is trusted
+    uint8 rest[30];
+    if (!Receive(rest, sizeof(rest)))
+        return Fail("truncated logon proof answer");
+
+    _peer.close();
+    return true;
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LOADGEN_AUTHCLIENT_H
+#define _LOADGEN_AUTHCLIENT_H
+
+#include "Common.h"
+#include "BigNumber.h"
+
+#include <ace/INET_Addr.h>
+#include <ace/SOCK_Stream.h>
+
+#define LOADGEN_CLIENT_BUILD 13623
+
+/**
+ * Client side of the SRP6 logon of AuthSocket. The exchange is short and
+ * blocking, the load generator runs it on its login thread and hands the
+ * session key to the world connection of the bot.
+ */
+class AuthClient
+{
+    public:
+        explicit AuthClient(ACE_INET_Addr const& address);
+        ~AuthClient();
+
+        /// Logs the account in and fills K with the session key, false with the reason in GetError() otherwise.
+        bool Logon(std::string const& account, std::string const& password, BigNumber& K);
+        std::string const& GetError() const { return _error; }
+
+    private:
+        bool Receive(void* data, size_t size);
+        bool Send(void const* data, size_t size);
+        bool Fail(char const* error);
+
+        ACE_INET_Addr _address;
+        ACE_SOCK_Stream _peer;
+        std::string _error;
+};
+
+#endif
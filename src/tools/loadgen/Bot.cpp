@@ -0,0 +1,772 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Bot.h"
+#include "AuthClient.h"
+#include "LoadGenOpcodes.h"
+#include "SHA1.h"
+#include "Timer.h"
+#include "Util.h"
+
+#include <ace/SOCK_Connector.h>
+#include <ace/OS_NS_errno.h>
+#include <ace/OS_NS_sys_time.h>
+#include <ace/OS_NS_string.h>
+#include <ace/Reactor.h>
+#include <ace/os_include/netinet/os_tcp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+// values of the server enums the bots look at
+enum
+{
+    AUTH_OK                     = 0x0C,
+    AUTH_WAIT_QUEUE             = 0x1B,
+    CHAR_CREATE_SUCCESS         = 0x2F,
+    CHAT_MSG_SYSTEM             = 0x00,
+    CHAT_MSG_SAY                = 0x01,
+    LANG_UNIVERSAL              = 0,
+    MOVEMENTFLAG_NONE           = 0x00000000,
+    MOVEMENTFLAG_FORWARD        = 0x00000001
+};
+
+#define BOT_CONNECT_TIMEOUT     10                          // seconds
+#define BOT_READ_SIZE           4096
+#define BOT_OUTPUT_LIMIT        (256 * 1024)                // a bot that can't get rid of this much is stuck
+#define BOT_RUN_SPEED           7.0f
+#define BOT_HEARTBEAT_INTERVAL  500
+#define BOT_WANDER_RADIUS       30.0f
+#define BOT_PING_INTERVAL       30000                       // WorldSocket kicks clients that ping faster than every 27 seconds
+#define BOT_SERVER_INFO_INTERVAL 5000
+
+static uint64 GetUSecTime()
+{
+    ACE_UINT64 usec;
+    ACE_OS::gettimeofday().to_usec(usec);
+    return usec;
+}
+
+Bot::Bot(uint32 id, std::string const& account, LoadGenConfig const& config) :
+    _id(id), _account(account), _config(config), _stats(NULL), _state(BOT_STATE_AUTH_CHALLENGE), _broken(false),
+    _input(BOT_READ_SIZE), _inputSize(0), _headerDecrypted(0),
+    _guid(0), _homeX(0.0f), _homeY(0.0f), _x(0.0f), _y(0.0f), _z(0.0f), _o(0.0f), _moving(false),
+    _moveTimer(0), _heartbeatTimer(0), _chatTimer(0), _castTimer(0), _queryTimer(0), _pingTimer(0), _infoTimer(0),
+    _timeoutTimer(IN_MILLISECONDS), _castCount(0), _pingSequence(0), _queryCount(0)
+{
+    std::transform(_account.begin(), _account.end(), _account.begin(), ::toupper);
+    memset(_requestStart, 0, sizeof(_requestStart));
+}
+
+Bot::~Bot()
+{
+    _peer.close();
+}
+
+bool Bot::Connect(BigNumber const& K)
+{
+    _K = K;
+
+    ACE_SOCK_Connector connector;
+    ACE_Time_Value timeout(BOT_CONNECT_TIMEOUT);
+    if (connector.connect(_peer, _config.worldAddress, &timeout) == -1)
+        return false;
+
+    int nodelay = 1;
+    _peer.set_option(ACE_IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    _peer.enable(ACE_NONBLOCK);
+    return true;
+}
+
+bool Bot::Open(ACE_Reactor* botReactor, BotStats* stats)
+{
+    _stats = stats;
+    reactor(botReactor);
+
+    if (reactor()->register_handler(this, ACE_Event_Handler::READ_MASK) == -1)
+        return false;
+
+    ++_stats->connected;
+    return true;
+}
+
+void Bot::Close()
+{
+    Shutdown(true);
+}
+
+void Bot::Shutdown(bool unregister)
+{
+    if (_state == BOT_STATE_CLOSED)
+        return;
+
+    if (unregister && reactor())
+        reactor()->remove_handler(this, ACE_Event_Handler::ALL_EVENTS_MASK | ACE_Event_Handler::DONT_CALL);
+
+    _peer.close();
+
+    if (_state == BOT_STATE_IN_WORLD)
+        --_stats->inWorld;
+    --_stats->connected;
+
+    _state = BOT_STATE_CLOSED;
+}
+
+ACE_HANDLE Bot::get_handle() const
+{
+    return _peer.get_handle();
+}
+
+int Bot::handle_input(ACE_HANDLE)
+{
+    if (_input.size() - _inputSize < BOT_READ_SIZE)
+        _input.resize(_inputSize + BOT_READ_SIZE);
+
+    ssize_t n = _peer.recv(&_input[_inputSize], _input.size() - _inputSize);
+    if (n == 0)
+        return -1;
+
+    if (n < 0)
+        return (errno == EWOULDBLOCK || errno == EAGAIN) ? 0 : -1;
+
+    _inputSize += n;
+    _stats->bytesIn += n;
+
+    return ProcessInput() ? 0 : -1;
+}
+
+int Bot::handle_close(ACE_HANDLE, ACE_Reactor_Mask)
+{
+    // the server closed the connection or it broke, the worker deletes the bot on its next update
+    if (_state != BOT_STATE_CLOSED)
+    {
+        ++_stats->disconnected;
+        Shutdown(false);
+    }
+
+    return 0;
+}
+
+bool Bot::ProcessInput()
+{
+    size_t pos = 0;
+
+    while (!_broken && pos < _inputSize)
+    {
+        uint8* header = &_input[pos];
+        size_t available = _inputSize - pos;
+
+        // the first byte tells if the size takes two or three bytes, decrypt it alone
+        if (!_headerDecrypted)
+        {
+            _crypt.EncryptSend(header, 1);
+            _headerDecrypted = 1;
+        }
+
+        size_t headerSize = (header[0] & 0x80) ? 5 : 4;
+        size_t decrypt = std::min(available, headerSize);
+        if (decrypt > _headerDecrypted)
+        {
+            _crypt.EncryptSend(header + _headerDecrypted, decrypt - _headerDecrypted);
+            _headerDecrypted = decrypt;
+        }
+
+        if (available < headerSize)
+            break;
+
+        // size is big endian and counts the opcode
+        uint32 size = headerSize == 5 ? ((header[0] & 0x7F) << 16) | (header[1] << 8) | header[2] : (header[0] << 8) | header[1];
+        uint32 opcode = header[headerSize - 2] | (header[headerSize - 1] << 8);
+
+        if (size < 2)
+        {
+            printf("Bot %u: malformed packet header, closing.\n", _id);
+            return false;
+        }
+
+        size_t packetSize = headerSize + size - 2;
+        if (available < packetSize)
+            break;
+
+        ++_stats->packetsIn;
+
+        try
+        {
+            HandlePacket(opcode, header + headerSize, size - 2);
+        }
+        catch (ByteBufferException const&)
+        {
+            printf("Bot %u: malformed packet 0x%.4X, closing.\n", _id, opcode);
+            return false;
+        }
+
+        pos += packetSize;
+        _headerDecrypted = 0;
+    }
+
+    if (pos)
+    {
+        _inputSize -= pos;
+        memmove(&_input[0], &_input[pos], _inputSize);
+    }
+
+    return !_broken;
+}
+
+void Bot::HandlePacket(uint32 opcode, uint8 const* data, size_t size)
+{
+    switch (opcode)
+    {
+        case SMSG_AUTH_CHALLENGE:
+        case SMSG_AUTH_RESPONSE:
+        case SMSG_CHAR_ENUM:
+        case SMSG_CHAR_CREATE:
+        case SMSG_LOGIN_VERIFY_WORLD:
+        case SMSG_MESSAGECHAT:
+        case SMSG_SPELL_START:
+        case SMSG_TIME_SYNC_REQ:
+            break;
+        case SMSG_PONG:
+            EndRequest(REQUEST_PING);
+            return;
+        case SMSG_NAME_QUERY_RESPONSE:
+            EndRequest(REQUEST_NAME_QUERY);
+            return;
+        case SMSG_CREATURE_QUERY_RESPONSE:
+            EndRequest(REQUEST_CREATURE_QUERY);
+            return;
+        case SMSG_CAST_FAILED:
+            EndRequest(REQUEST_CAST_SPELL);
+            return;
+        default:
+            // world state the bots don't look at
+            return;
+    }
+
+    ByteBuffer packet(size);
+    if (size)
+        packet.append(data, size);
+
+    switch (opcode)
+    {
+        case SMSG_AUTH_CHALLENGE:       HandleAuthChallenge(packet); break;
+        case SMSG_AUTH_RESPONSE:        HandleAuthResponse(packet); break;
+        case SMSG_CHAR_ENUM:            HandleCharEnum(packet); break;
+        case SMSG_CHAR_CREATE:          HandleCharCreate(packet); break;
+        case SMSG_LOGIN_VERIFY_WORLD:   HandleLoginVerifyWorld(packet); break;
+        case SMSG_MESSAGECHAT:          HandleMessageChat(packet); break;
+        case SMSG_SPELL_START:          HandleSpellStart(packet); break;
+        case SMSG_TIME_SYNC_REQ:        HandleTimeSyncRequest(packet); break;
+        default: break;
+    }
+}
+
+void Bot::HandleAuthChallenge(ByteBuffer& packet)
+{
+    if (_state != BOT_STATE_AUTH_CHALLENGE)
+        return;
+
+    uint32 serverSeed;
+    packet.read_skip(16);                                   // encryption seeds
+    packet.read_skip<uint8>();
+    packet >> serverSeed;
+
+    uint32 clientSeed = urand(0, 0xFFFFFFFF);
+    uint32 t = 0;
+
+    SHA1Hash sha;
+    sha.UpdateData(_account);
+    sha.UpdateData((uint8*)&t, 4);
+    sha.UpdateData((uint8*)&clientSeed, 4);
+    sha.UpdateData((uint8*)&serverSeed, 4);
+    sha.UpdateBigNumbers(&_K, NULL);
+    sha.Finalize();
+    uint8 const* digest = sha.GetDigest();
+
+    // same field order as WorldSocket::HandleAuthSession reads them, the digest is spread over the packet
+    ByteBuffer data(100);
+    data.append(digest, 7);
+    data << uint32(0);
+    data.append(digest + 7, 1);
+    data << uint64(0);
+    data << uint32(0);
+    data.append(digest + 8, 1);
+    data << uint8(0);
+    data.append(digest + 9, 2);
+    data << uint32(clientSeed);
+    data << uint32(0);
+    data.append(digest + 11, 6);
+    data << uint16(LOADGEN_CLIENT_BUILD);
+    data.append(digest + 17, 1);
+    data << uint8(0);
+    data << uint32(0);
+    data.append(digest + 18, 2);
+    data << uint32(0);                                      // addon info size
+    data << _account;
+
+    StartRequest(REQUEST_AUTH_SESSION);
+    SendPacket(CMSG_AUTH_SESSION, data);
+
+    // every header after this one is encrypted, in both directions
+    _crypt.Init(&_K);
+    _state = BOT_STATE_AUTH_RESPONSE;
+}
+
+void Bot::HandleAuthResponse(ByteBuffer& packet)
+{
+    if (_state != BOT_STATE_AUTH_RESPONSE)
+        return;
+
+    uint8 code;
+    packet >> code;
+
+    // a queued session gets a second response when it leaves the queue
+    if (code == AUTH_WAIT_QUEUE)
+        return;
+
+    EndRequest(REQUEST_AUTH_SESSION);
+
+    if (code != AUTH_OK)
+    {
+        printf("Bot %u: world server refused account %s (auth response %u).\n", _id, _account.c_str(), code);
+        _broken = true;
+        return;
+    }
+
+    StartRequest(REQUEST_CHAR_ENUM);
+    SendPacket(CMSG_CHAR_ENUM, ByteBuffer());
+    _state = BOT_STATE_CHAR_ENUM;
+}
+
+void Bot::HandleCharEnum(ByteBuffer& packet)
+{
+    if (_state != BOT_STATE_CHAR_ENUM)
+        return;
+
+    EndRequest(REQUEST_CHAR_ENUM);
+
+    uint8 count;
+    packet >> count;
+
+    if (!count)
+    {
+        SendCharCreate();
+        return;
+    }
+
+    packet >> _guid;
+
+    ByteBuffer data(8);
+    data << uint64(_guid);
+
+    StartRequest(REQUEST_PLAYER_LOGIN);
+    SendPacket(CMSG_PLAYER_LOGIN, data);
+    _state = BOT_STATE_LOGIN;
+}
+
+void Bot::SendCharCreate()
+{
+    // names may only hold letters and no letter three times in a row, alternate consonants and vowels
+    static char const consonants[] = "bcdfghjklmnprstvwxyz";
+    std::string name = "Lg";
+    uint32 id = _id;
+    do
+    {
+        name += consonants[id % 20];
+        name += 'a';
+        id /= 20;
+    }
+    while (id);
+
+    ByteBuffer data(32);
+    data << name;
+    data << uint8(_config.race);
+    data << uint8(_config.class_);
+    data << uint8(_id % 2);                                 // gender
+    data << uint8(0) << uint8(0) << uint8(0) << uint8(0) << uint8(0);   // skin, face, hair style, hair color, facial hair
+    data << uint8(0);                                       // outfit
+
+    StartRequest(REQUEST_CHAR_CREATE);
+    SendPacket(CMSG_CHAR_CREATE, data);
+    _state = BOT_STATE_CHAR_CREATE;
+}
+
+void Bot::HandleCharCreate(ByteBuffer& packet)
+{
+    if (_state != BOT_STATE_CHAR_CREATE)
+        return;
+
+    EndRequest(REQUEST_CHAR_CREATE);
+
+    uint8 code;
+    packet >> code;
+
+    if (code != CHAR_CREATE_SUCCESS)
+    {
+        printf("Bot %u: character creation failed (result %u).\n", _id, code);
+        _broken = true;
+        return;
+    }
+
+    StartRequest(REQUEST_CHAR_ENUM);
+    SendPacket(CMSG_CHAR_ENUM, ByteBuffer());
+    _state = BOT_STATE_CHAR_ENUM;
+}
+
+void Bot::HandleLoginVerifyWorld(ByteBuffer& packet)
+{
+    if (_state != BOT_STATE_LOGIN)
+        return;
+
+    EndRequest(REQUEST_PLAYER_LOGIN);
+
+    packet.read_skip<uint32>();                             // map
+    packet >> _x >> _y >> _z >> _o;
+    _homeX = _x;
+    _homeY = _y;
+
+    // spread the periodic packets of the bots over time
+    _moveTimer = urand(0, 5000);
+    _chatTimer = urand(0, 30000);
+    _castTimer = urand(0, 15000);
+    _queryTimer = urand(0, 8000);
+    _pingTimer = BOT_PING_INTERVAL;
+    _infoTimer = 0;
+
+    ++_stats->inWorld;
+    _state = BOT_STATE_IN_WORLD;
+}
+
+void Bot::HandleMessageChat(ByteBuffer& packet)
+{
+    if (_state != BOT_STATE_IN_WORLD)
+        return;
+
+    uint8 type;
+    uint64 sender;
+    std::string message;
+
+    packet >> type;
+    packet.read_skip<uint32>();                             // language
+    packet >> sender;
+    packet.read_skip<uint32>();
+    packet.read_skip<uint64>();                             // target
+    packet.read_skip<uint32>();                             // message length
+    packet >> message;
+
+    if (type == CHAT_MSG_SAY && sender == _guid)
+        EndRequest(REQUEST_CHAT);
+    else if (type == CHAT_MSG_SYSTEM && _requestStart[REQUEST_SERVER_INFO])
+    {
+        uint32 diff;
+        if (sscanf(message.c_str(), "Update time diff: %u", &diff) != 1)
+            return;
+
+        EndRequest(REQUEST_SERVER_INFO);
+
+        ++_stats->tickSamples;
+        _stats->tickSum += diff;
+        _stats->tickMax = std::max(_stats->tickMax, diff);
+        _stats->tickLast = diff;
+    }
+}
+
+void Bot::HandleSpellStart(ByteBuffer& packet)
+{
+    uint64 casterItem, caster;
+    packet.readPackGUID(casterItem);
+    packet.readPackGUID(caster);
+
+    // spell starts of nearby players are broadcast too
+    if (caster == _guid)
+        EndRequest(REQUEST_CAST_SPELL);
+}
+
+void Bot::HandleTimeSyncRequest(ByteBuffer& packet)
+{
+    uint32 counter;
+    packet >> counter;
+
+    ByteBuffer data(8);
+    data << uint32(counter);
+    data << uint32(getMSTime());
+    SendPacket(CMSG_TIME_SYNC_RESP, data);
+}
+
+void Bot::SendPacket(uint32 opcode, ByteBuffer const& payload)
+{
+    // ClientPktHeader, size is big endian and counts the opcode
+    uint8 header[6];
+    uint16 size = uint16(payload.size() + 4);
+    header[0] = uint8(size >> 8);
+    header[1] = uint8(size);
+    header[2] = uint8(opcode);
+    header[3] = uint8(opcode >> 8);
+    header[4] = uint8(opcode >> 16);
+    header[5] = uint8(opcode >> 24);
+
+    // AuthCrypt is written for the server, the client encrypts with the stream the server decrypts with
+    _crypt.DecryptRecv(header, sizeof(header));
+
+    _output.insert(_output.end(), header, header + sizeof(header));
+    if (payload.size())
+        _output.insert(_output.end(), payload.contents(), payload.contents() + payload.size());
+
+    ++_stats->packetsOut;
+    _stats->bytesOut += sizeof(header) + payload.size();
+
+    Flush();
+}
+
+bool Bot::Flush()
+{
+    if (_output.empty() || _broken)
+        return !_broken;
+
+    ssize_t n = _peer.send(&_output[0], _output.size());
+    if (n < 0)
+    {
+        if (errno != EWOULDBLOCK && errno != EAGAIN)
+            _broken = true;
+    }
+    else
+        _output.erase(_output.begin(), _output.begin() + n);
+
+    if (_output.size() > BOT_OUTPUT_LIMIT)
+    {
+        printf("Bot %u: server stopped reading, closing.\n", _id);
+        _broken = true;
+    }
+
+    return !_broken;
+}
+
+void Bot::SendMovement(uint32 opcode, uint32 flags)
+{
+    ByteBuffer data(40);
+    data.appendPackGUID(_guid);
+    data << uint32(flags);
+    data << uint16(0);                                      // extra flags
+    data << uint32(getMSTime());
+    data << _x << _y << _z << _o;
+    SendPacket(opcode, data);
+}
+
+void Bot::SendChat(char const* message)
+{
+    ByteBuffer data(64);
+    data << uint32(LANG_UNIVERSAL);
+    data << message;
+    SendPacket(CMSG_MESSAGECHAT_SAY, data);
+}
+
+void Bot::SendCastSpell()
+{
+    ByteBuffer data(16);
+    data << uint8(++_castCount);
+    data << uint32(_config.spellId);
+    data << uint32(0);                                      // glyph index
+    data << uint8(0);                                       // cast flags
+    data << uint32(0);                                      // target mask, self
+
+    StartRequest(REQUEST_CAST_SPELL);
+    SendPacket(CMSG_CAST_SPELL, data);
+}
+
+void Bot::SendQuery()
+{
+    // alternate between player names and creature templates
+    if (_config.creatureEntries.empty() || (_queryCount++ % 2) == 0)
+    {
+        if (_requestStart[REQUEST_NAME_QUERY])
+            return;
+
+        ByteBuffer data(8);
+        data << uint64(_guid);
+
+        StartRequest(REQUEST_NAME_QUERY);
+        SendPacket(CMSG_NAME_QUERY, data);
+    }
+    else
+    {
+        if (_requestStart[REQUEST_CREATURE_QUERY])
+            return;
+
+        ByteBuffer data(12);
+        data << uint32(_config.creatureEntries[urand(0, _config.creatureEntries.size() - 1)]);
+        data << uint64(0);
+
+        StartRequest(REQUEST_CREATURE_QUERY);
+        SendPacket(CMSG_CREATURE_QUERY, data);
+    }
+}
+
+void Bot::SendPing()
+{
+    ByteBuffer data(8);
+    data << uint32(0);                                      // latency
+    data << uint32(++_pingSequence);
+
+    StartRequest(REQUEST_PING);
+    SendPacket(CMSG_PING, data);
+}
+
+void Bot::UpdateMovement(uint32 diff)
+{
+    if (_moving)
+    {
+        float distance = BOT_RUN_SPEED * diff / IN_MILLISECONDS;
+        _x += cos(_o) * distance;
+        _y += sin(_o) * distance;
+
+        _heartbeatTimer -= diff;
+        if (_heartbeatTimer <= 0)
+        {
+            SendMovement(MSG_MOVE_HEARTBEAT, MOVEMENTFLAG_FORWARD);
+            _heartbeatTimer = BOT_HEARTBEAT_INTERVAL;
+        }
+    }
+
+    _moveTimer -= diff;
+    if (_moveTimer > 0)
+        return;
+
+    if (_moving)
+    {
+        SendMovement(MSG_MOVE_STOP, MOVEMENTFLAG_NONE);
+        _moving = false;
+        _moveTimer = urand(1000, 4000);
+        return;
+    }
+
+    // wander around the login position, the ground height is not known so z stays
+    float dx = _homeX - _x;
+    float dy = _homeY - _y;
+    if (dx * dx + dy * dy > BOT_WANDER_RADIUS * BOT_WANDER_RADIUS)
+        _o = atan2(dy, dx);
+    else
+        _o = frand(0.0f, 2 * M_PI);
+
+    if (_o < 0.0f)
+        _o += 2 * M_PI;
+
+    SendMovement(MSG_MOVE_START_FORWARD, MOVEMENTFLAG_FORWARD);
+    _moving = true;
+    _moveTimer = urand(2000, 5000);
+    _heartbeatTimer = BOT_HEARTBEAT_INTERVAL;
+}
+
+bool Bot::Update(uint32 diff)
+{
+    if (_state == BOT_STATE_CLOSED || _broken)
+        return false;
+
+    _timeoutTimer -= diff;
+    if (_timeoutTimer <= 0)
+    {
+        CheckRequestTimeouts();
+        _timeoutTimer = IN_MILLISECONDS;
+    }
+
+    if (_state == BOT_STATE_IN_WORLD)
+    {
+        UpdateMovement(diff);
+
+        _chatTimer -= diff;
+        if (_chatTimer <= 0)
+        {
+            if (!_requestStart[REQUEST_CHAT])
+            {
+                char message[64];
+                snprintf(message, sizeof(message), "load test bot %u reporting", _id);
+                StartRequest(REQUEST_CHAT);
+                SendChat(message);
+            }
+            _chatTimer = urand(10000, 30000);
+        }
+
+        _castTimer -= diff;
+        if (_castTimer <= 0)
+        {
+            if (_config.spellId && !_requestStart[REQUEST_CAST_SPELL])
+                SendCastSpell();
+            _castTimer = urand(8000, 15000);
+        }
+
+        _queryTimer -= diff;
+        if (_queryTimer <= 0)
+        {
+            SendQuery();
+            _queryTimer = urand(3000, 8000);
+        }
+
+        _pingTimer -= diff;
+        if (_pingTimer <= 0)
+        {
+            if (!_requestStart[REQUEST_PING])
+                SendPing();
+            _pingTimer = BOT_PING_INTERVAL;
+        }
+
+        // the first bot samples the world update time for the report
+        if (_id == _config.firstBot)
+        {
+            _infoTimer -= diff;
+            if (_infoTimer <= 0)
+            {
+                if (!_requestStart[REQUEST_SERVER_INFO])
+                {
+                    StartRequest(REQUEST_SERVER_INFO);
+                    SendChat(".server info");
+                }
+                _infoTimer = BOT_SERVER_INFO_INTERVAL;
+            }
+        }
+    }
+
+    return Flush();
+}
+
+void Bot::StartRequest(BotRequest request)
+{
+    ++_stats->requests[request].sent;
+    _requestStart[request] = GetUSecTime();
+}
+
+void Bot::EndRequest(BotRequest request)
+{
+    // answers to timed out requests are not counted
+    if (!_requestStart[request])
+        return;
+
+    _stats->requests[request].AddAnswer(GetUSecTime() - _requestStart[request]);
+    _requestStart[request] = 0;
+}
+
+void Bot::CheckRequestTimeouts()
+{
+    uint64 now = GetUSecTime();
+    for (uint8 i = 0; i < MAX_BOT_REQUESTS; ++i)
+    {
+        if (_requestStart[i] && now - _requestStart[i] > uint64(BOT_REQUEST_TIMEOUT) * IN_MILLISECONDS * IN_MILLISECONDS)
+        {
+            ++_stats->requests[i].timedOut;
+            _requestStart[i] = 0;
+        }
+    }
+}
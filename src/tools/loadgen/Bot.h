@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LOADGEN_BOT_H
+#define _LOADGEN_BOT_H
+
+#include "Common.h"
+#include "AuthCrypt.h"
+#include "BigNumber.h"
+#include "BotStats.h"
+#include "ByteBuffer.h"
+
+#include <ace/Event_Handler.h>
+#include <ace/INET_Addr.h>
+#include <ace/SOCK_Stream.h>
+
+#include <vector>
+
+/// Seconds after which an unanswered request counts as timed out.
+#define BOT_REQUEST_TIMEOUT 30
+
+struct LoadGenConfig
+{
+    ACE_INET_Addr authAddress;
+    ACE_INET_Addr worldAddress;
+    uint32 bots;
+    uint32 threads;
+    uint32 loginRate;                                       // logins per second
+    uint32 duration;                                        // seconds, 0 runs until interrupted
+    uint32 reportInterval;                                  // seconds
+    uint32 firstBot;                                        // number of the first account, several load boxes use distinct ranges
+    std::string accountPrefix;
+    std::string password;
+    uint8 race;
+    uint8 class_;
+    uint32 spellId;
+    std::vector<uint32> creatureEntries;
+};
+
+enum BotState
+{
+    BOT_STATE_AUTH_CHALLENGE,                               // waiting for SMSG_AUTH_CHALLENGE
+    BOT_STATE_AUTH_RESPONSE,                                // waiting for SMSG_AUTH_RESPONSE, also while queued
+    BOT_STATE_CHAR_ENUM,
+    BOT_STATE_CHAR_CREATE,
+    BOT_STATE_LOGIN,                                        // waiting for SMSG_LOGIN_VERIFY_WORLD
+    BOT_STATE_IN_WORLD,
+    BOT_STATE_CLOSED
+};
+
+/**
+ * One scripted client on a world connection.
+ *
+ * The bot is connected by the login thread and then owned by one
+ * BotRunnable, which dispatches its socket events and updates its timers;
+ * from then on it is only touched by that thread. Like the real client it
+ * only encrypts the packet headers.
+ */
+class Bot : public ACE_Event_Handler
+{
+    public:
+        Bot(uint32 id, std::string const& account, LoadGenConfig const& config);
+        ~Bot();
+
+        /// Opens the world connection with the session key of the logon, called by the login thread.
+        bool Connect(BigNumber const& K);
+        /// Registers the socket with the reactor of the worker that owns the bot from now on.
+        bool Open(ACE_Reactor* reactor, BotStats* stats);
+        void Close();
+
+        /// Runs the scripted behaviour, false once the connection is gone.
+        bool Update(uint32 diff);
+
+        uint32 GetId() const { return _id; }
+        BotState GetState() const { return _state; }
+
+        // ACE_Event_Handler
+        ACE_HANDLE get_handle() const;
+        int handle_input(ACE_HANDLE = ACE_INVALID_HANDLE);
+        int handle_close(ACE_HANDLE = ACE_INVALID_HANDLE, ACE_Reactor_Mask = ACE_Event_Handler::ALL_EVENTS_MASK);
+
+    private:
+        void Shutdown(bool unregister);
+        bool ProcessInput();
+        void HandlePacket(uint32 opcode, uint8 const* data, size_t size);
+
+        void HandleAuthChallenge(ByteBuffer& packet);
+        void HandleAuthResponse(ByteBuffer& packet);
+        void HandleCharEnum(ByteBuffer& packet);
+        void HandleCharCreate(ByteBuffer& packet);
+        void HandleLoginVerifyWorld(ByteBuffer& packet);
+        void HandleMessageChat(ByteBuffer& packet);
+        void HandleSpellStart(ByteBuffer& packet);
+        void HandleTimeSyncRequest(ByteBuffer& packet);
+
+        void SendPacket(uint32 opcode, ByteBuffer const& payload);
+        bool Flush();
+
+        void SendCharCreate();
+        void SendMovement(uint32 opcode, uint32 flags);
+        void SendChat(char const* message);
+        void SendCastSpell();
+        void SendQuery();
+        void SendPing();
+
+        void UpdateMovement(uint32 diff);
+
+        void StartRequest(BotRequest request);
+        void EndRequest(BotRequest request);
+        void CheckRequestTimeouts();
+
+        uint32 _id;
+        std::string _account;
+        LoadGenConfig const& _config;
+        BotStats* _stats;
+        BotState _state;
+        bool _broken;                                       // protocol or send error, the worker closes the bot
+
+        ACE_SOCK_Stream _peer;
+        AuthCrypt _crypt;                                   // server side crypt with swapped roles, see SendPacket
+        BigNumber _K;
+
+        std::vector<uint8> _input;
+        size_t _inputSize;
+        size_t _headerDecrypted;                            // header bytes of the next packet already decrypted
+        std::vector<uint8> _output;
+
+        uint64 _guid;
+        float _homeX, _homeY;
+        float _x, _y, _z, _o;
+        bool _moving;
+        int32 _moveTimer;
+        int32 _heartbeatTimer;
+        int32 _chatTimer;
+        int32 _castTimer;
+        int32 _queryTimer;
+        int32 _pingTimer;
+        int32 _infoTimer;
+        int32 _timeoutTimer;
+        uint8 _castCount;
+        uint32 _pingSequence;
+        uint32 _queryCount;
+
+        uint64 _requestStart[MAX_BOT_REQUESTS];             // usec, 0 when nothing is pending
+};
+
+#endif
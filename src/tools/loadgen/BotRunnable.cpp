@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "BotRunnable.h"
+#include "Bot.h"
+#include "Timer.h"
+
+#include <ace/Dev_Poll_Reactor.h>
+#include <ace/TP_Reactor.h>
+
+BotRunnable::BotRunnable() : _reactor(NULL), _threadId(-1)
+{
+    _stats.Clear();
+
+    ACE_Reactor_Impl* imp = 0;
+
+    #if defined (ACE_HAS_EVENT_POLL) || defined (ACE_HAS_DEV_POLL)
+
+    imp = new ACE_Dev_Poll_Reactor();
+
+    imp->max_notify_iterations (128);
+    imp->restart (1);
+
+    #else
+
+    imp = new ACE_TP_Reactor();
+    imp->max_notify_iterations (128);
+
+    #endif
+
+    _reactor = new ACE_Reactor(imp, 1);
+}
+
+BotRunnable::~BotRunnable()
+{
+    Stop();
+    Wait();
+
+    for (BotList::const_iterator itr = _bots.begin(); itr != _bots.end(); ++itr)
+        delete *itr;
+
+    for (std::vector<Bot*>::const_iterator itr = _newBots.begin(); itr != _newBots.end(); ++itr)
+        delete *itr;
+
+    delete _reactor;
+}
+
+int BotRunnable::Start()
+{
+    if (_threadId != -1)
+        return -1;
+
+    return (_threadId = activate());
+}
+
+void BotRunnable::Stop()
+{
+    _reactor->end_reactor_event_loop();
+}
+
+void BotRunnable::AddBot(Bot* bot)
+{
+    TRINITY_GUARD(ACE_Thread_Mutex, _newBotsLock);
+    _newBots.push_back(bot);
+}
+
+void BotRunnable::AddNewBots()
+{
+    TRINITY_GUARD(ACE_Thread_Mutex, _newBotsLock);
+
+    for (std::vector<Bot*>::const_iterator itr = _newBots.begin(); itr != _newBots.end(); ++itr)
+    {
+        Bot* bot = *itr;
+        if (bot->Open(_reactor, &_stats))
+            _bots.push_back(bot);
+        else
+        {
+            ++_stats.disconnected;
+            delete bot;
+        }
+    }
+
+    _newBots.clear();
+}
+
+int BotRunnable::svc()
+{
+    uint32 lastUpdate = getMSTime();
+
+    while (!_reactor->reactor_event_loop_done())
+    {
+        // run_reactor_event_loop modifies the interval
+        ACE_Time_Value interval(0, 10000);
+
+        if (_reactor->run_reactor_event_loop(interval) == -1)
+            break;
+
+        AddNewBots();
+
+        uint32 now = getMSTime();
+        uint32 diff = getMSTimeDiff(lastUpdate, now);
+        lastUpdate = now;
+
+        for (BotList::iterator itr = _bots.begin(); itr != _bots.end();)
+        {
+            if ((*itr)->Update(diff))
+                ++itr;
+            else
+            {
+                // closed by the bot itself after a protocol or send error
+                if ((*itr)->GetState() != BOT_STATE_CLOSED)
+                    ++_stats.disconnected;
+
+                (*itr)->Close();
+                delete *itr;
+                itr = _bots.erase(itr);
+            }
+        }
+    }
+
+    for (BotList::const_iterator itr = _bots.begin(); itr != _bots.end(); ++itr)
+        (*itr)->Close();
+
+    return 0;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LOADGEN_BOTRUNNABLE_H
+#define _LOADGEN_BOTRUNNABLE_H
+
+#include "Common.h"
+#include "BotStats.h"
+
+#include <ace/Task.h>
+#include <ace/Reactor.h>
+#include <ace/Thread_Mutex.h>
+
+#include <list>
+#include <vector>
+
+class Bot;
+
+/**
+ * Network thread of the load generator, the client side twin of the
+ * ReactorRunnable of WorldSocketMgr: one reactor dispatches the sockets of
+ * the bots it owns and the loop updates their timers between two polls.
+ */
+class BotRunnable : protected ACE_Task_Base
+{
+    public:
+        BotRunnable();
+        virtual ~BotRunnable();
+
+        int Start();
+        void Stop();
+        void Wait() { ACE_Task_Base::wait(); }
+
+        /// Hands a connected bot to this thread, which deletes it once it is closed.
+        void AddBot(Bot* bot);
+
+        BotStats const& GetStats() const { return _stats; }
+
+    protected:
+        virtual int svc();
+
+    private:
+        void AddNewBots();
+
+        typedef std::list<Bot*> BotList;
+
+        ACE_Reactor* _reactor;
+        int _threadId;
+        BotStats _stats;                                    // written by this thread only
+
+        BotList _bots;
+        ACE_Thread_Mutex _newBotsLock;                      // guards _newBots
+        std::vector<Bot*> _newBots;
+};
+
+#endif
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "BotStats.h"
+
+#include <string.h>
+#include <algorithm>
+
+char const* GetBotRequestName(BotRequest request)
+{
+    static char const* names[MAX_BOT_REQUESTS] =
+    {
+        "AUTH_SESSION", "CHAR_ENUM", "CHAR_CREATE", "PLAYER_LOGIN", "PING",
+        "NAME_QUERY", "CREATURE_QUERY", "MESSAGECHAT_SAY", "CAST_SPELL", "SERVER_INFO"
+    };
+
+    return request < MAX_BOT_REQUESTS ? names[request] : "UNKNOWN";
+}
+
+void RequestCounters::AddAnswer(uint64 usec)
+{
+    ++answered;
+    rttSum += usec;
+    if (usec > rttMax)
+        rttMax = usec;
+
+    uint8 bucket = 0;
+    while (usec && bucket < RTT_BUCKETS - 1)
+    {
+        usec >>= 1;
+        ++bucket;
+    }
+    ++rtt[bucket];
+}
+
+uint64 RequestCounters::GetPercentile(float share) const
+{
+    uint64 limit = uint64(answered * share);
+    uint64 answers = 0;
+    for (uint8 i = 0; i < RTT_BUCKETS - 1; ++i)
+    {
+        answers += rtt[i];
+        if (answers >= limit)
+            return UI64LIT(1) << i;
+    }
+
+    return rttMax;
+}
+
+void BotStats::Clear()
+{
+    memset(this, 0, sizeof(BotStats));
+}
+
+void BotStats::Merge(BotStats const& other)
+{
+    connected += other.connected;
+    inWorld += other.inWorld;
+    disconnected += other.disconnected;
+    packetsIn += other.packetsIn;
+    bytesIn += other.bytesIn;
+    packetsOut += other.packetsOut;
+    bytesOut += other.bytesOut;
+
+    for (uint8 i = 0; i < MAX_BOT_REQUESTS; ++i)
+    {
+        RequestCounters& counters = requests[i];
+        RequestCounters const& otherCounters = other.requests[i];
+
+        counters.sent += otherCounters.sent;
+        counters.answered += otherCounters.answered;
+        counters.timedOut += otherCounters.timedOut;
+        counters.rttSum += otherCounters.rttSum;
+        counters.rttMax = std::max(counters.rttMax, otherCounters.rttMax);
+        for (uint8 j = 0; j < RTT_BUCKETS; ++j)
+            counters.rtt[j] += otherCounters.rtt[j];
+    }
+
+    tickSamples += other.tickSamples;
+    tickSum += other.tickSum;
+    tickMax = std::max(tickMax, other.tickMax);
+    if (other.tickSamples)
+        tickLast = other.tickLast;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LOADGEN_BOTSTATS_H
+#define _LOADGEN_BOTSTATS_H
+
+#include "Common.h"
+
+/// Requests the bots time from sending to the matching server answer.
+enum BotRequest
+{
+    REQUEST_AUTH_SESSION    = 0,                            // CMSG_AUTH_SESSION -> SMSG_AUTH_RESPONSE
+    REQUEST_CHAR_ENUM       = 1,                            // CMSG_CHAR_ENUM -> SMSG_CHAR_ENUM
+    REQUEST_CHAR_CREATE     = 2,                            // CMSG_CHAR_CREATE -> SMSG_CHAR_CREATE
+    REQUEST_PLAYER_LOGIN    = 3,                            // CMSG_PLAYER_LOGIN -> SMSG_LOGIN_VERIFY_WORLD
+    REQUEST_PING            = 4,                            // CMSG_PING -> SMSG_PONG
+    REQUEST_NAME_QUERY      = 5,                            // CMSG_NAME_QUERY -> SMSG_NAME_QUERY_RESPONSE
+    REQUEST_CREATURE_QUERY  = 6,                            // CMSG_CREATURE_QUERY -> SMSG_CREATURE_QUERY_RESPONSE
+    REQUEST_CHAT            = 7,                            // CMSG_MESSAGECHAT_SAY -> own SMSG_MESSAGECHAT
+    REQUEST_CAST_SPELL      = 8,                            // CMSG_CAST_SPELL -> SMSG_SPELL_START or SMSG_CAST_FAILED
+    REQUEST_SERVER_INFO     = 9,                            // ".server info" -> its update time diff line
+    MAX_BOT_REQUESTS
+};
+
+char const* GetBotRequestName(BotRequest request);
+
+/// Round trip histogram, bucket i counts the answers that took less than 2^i usec, the last one all slower answers.
+#define RTT_BUCKETS 24
+
+struct RequestCounters
+{
+    uint64 sent;
+    uint64 answered;
+    uint64 timedOut;                                        // no answer within BOT_REQUEST_TIMEOUT
+    uint64 rttSum;                                          // usec
+    uint64 rttMax;
+    uint64 rtt[RTT_BUCKETS];
+
+    void AddAnswer(uint64 usec);
+    /// Upper bound in usec of the round trip of the given share (0..1) of the answers.
+    uint64 GetPercentile(float share) const;
+};
+
+/**
+ * Counters of the bots of one worker thread. Only the worker writes them,
+ * the reporting thread reads them without a lock so a report may be off
+ * by the packets in flight.
+ */
+struct BotStats
+{
+    uint32 connected;                                       // open world connections
+    uint32 inWorld;                                         // characters logged in
+    uint32 disconnected;                                    // connections the server closed or refused
+    uint64 packetsIn;
+    uint64 bytesIn;
+    uint64 packetsOut;
+    uint64 bytesOut;
+    RequestCounters requests[MAX_BOT_REQUESTS];
+
+    // update time diff of the world, as reported by ".server info"
+    uint64 tickSamples;
+    uint64 tickSum;
+    uint32 tickMax;
+    uint32 tickLast;
+
+    void Clear();
+    void Merge(BotStats const& other);
+};
+
+#endif
@@ -0,0 +1,412 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/// \addtogroup loadgen Load generator
+/// @{
+/// \file
+
+#include "AuthClient.h"
+#include "Bot.h"
+#include "BotRunnable.h"
+#include "SHA1.h"
+#include "SignalHandler.h"
+#include "Timer.h"
+
+#include <ace/Sig_Handler.h>
+#include <ace/OS_NS_unistd.h>
+#include <ace/OS_NS_signal.h>
+
+#include <algorithm>
+#include <cctype>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_PRINTED_LOGON_FAILURES 10
+
+static volatile bool stopEvent = false;
+
+/// Stops the run on SIGINT and SIGTERM.
+class LoadGenSignalHandler : public Trinity::SignalHandler
+{
+    public:
+        virtual void HandleSignal(int SigNum)
+        {
+            switch (SigNum)
+            {
+                case SIGINT:
+                case SIGTERM:
+                    stopEvent = true;
+                    break;
+            }
+        }
+};
+
+void printUsage(char const* name)
+{
+    printf("\nusage: %s [options]\n", name);
+    printf("Logs bots in through the auth and world servers and makes them move, chat, cast and query.\n");
+    printf("Reports the round trip time of the requests and the world update time of the server.\n\n");
+    printf("  --auth <host[:port]>    auth server, defaults to 127.0.0.1:3724\n");
+    printf("  --world <host[:port]>   world server, the realm list is not read, defaults to 127.0.0.1:8085\n");
+    printf("  --bots <count>          number of bots, defaults to 100\n");
+    printf("  --first <number>        number of the first bot account, defaults to 1\n");
+    printf("  --account <prefix>      accounts are <prefix><number>, defaults to loadgen\n");
+    printf("  --password <password>   password of all bot accounts, defaults to loadgen\n");
+    printf("  --threads <count>       network threads, defaults to the number of processors\n");
+    printf("  --rate <count>          logins per second, defaults to 50\n");
+    printf("  --duration <seconds>    length of the run, defaults to 0 to run until interrupted\n");
+    printf("  --interval <seconds>    report interval, defaults to 10\n");
+    printf("  --race <id>             race of created characters, defaults to 1 (human)\n");
+    printf("  --class <id>            class of created characters, defaults to 1 (warrior)\n");
+    printf("  --spell <id>            spell the bots cast, 0 to disable, defaults to 2457 (Battle Stance)\n");
+    printf("  --creature <id,...>     creature entries the bots query, defaults to 197,823,299,68\n");
+    printf("  --sql                   print the SQL creating the bot accounts and exit\n");
+    printf("  --help                  show this text\n\n");
+    printf("Characters are created on the first login of an account. Each bot keeps a socket open,\n");
+    printf("raise the open file limit (ulimit -n) above the number of bots.\n");
+}
+
+bool parseAddress(char const* param, uint16 defaultPort, ACE_INET_Addr& address)
+{
+    if (strchr(param, ':'))
+        return address.set(param) == 0;
+
+    return address.set(defaultPort, param) == 0;
+}
+
+void parseEntries(char const* param, std::vector<uint32>& entries)
+{
+    entries.clear();
+
+    std::string list = param;
+    size_t pos = 0;
+    while (pos < list.length())
+    {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos)
+            end = list.length();
+
+        if (uint32 entry = atoi(list.substr(pos, end - pos).c_str()))
+            entries.push_back(entry);
+
+        pos = end + 1;
+    }
+}
+
+std::string getAccountName(LoadGenConfig const& config, uint32 number)
+{
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u", number);
+    return config.accountPrefix + buf;
+}
+
+/// Prints the accounts in the format the auth server computes the SRP6 verifier from.
+void printAccountSql(LoadGenConfig const& config)
+{
+    std::string password = config.password;
+    std::transform(password.begin(), password.end(), password.begin(), ::toupper);
+
+    for (uint32 i = 0; i < config.bots; ++i)
+    {
+        if (i % 500 == 0)
+            printf("%sINSERT IGNORE INTO `account` (`username`, `sha_pass_hash`, `expansion`) VALUES\n", i ? ";\n" : "");
+        else
+            printf(",\n");
+
+        std::string account = getAccountName(config, config.firstBot + i);
+        std::transform(account.begin(), account.end(), account.begin(), ::toupper);
+
+        SHA1Hash sha;
+        sha.UpdateData(account + ":" + password);
+        sha.Finalize();
+
+        printf("('%s', '", account.c_str());
+        for (int j = 0; j < SHA_DIGEST_LENGTH; ++j)
+            printf("%02X", sha.GetDigest()[j]);
+        printf("', 3)");
+    }
+
+    if (config.bots)
+        printf(";\n");
+}
+
+void printReport(std::vector<BotRunnable*> const& workers, uint32 elapsed, uint32 started, uint32 logonFailures)
+{
+    BotStats total;
+    total.Clear();
+    for (std::vector<BotRunnable*>::const_iterator itr = workers.begin(); itr != workers.end(); ++itr)
+        total.Merge((*itr)->GetStats());
+
+    printf("\n[%6us] %u bots started, %u connected, %u in world, %u logon failures, %u disconnects\n",
+        elapsed / IN_MILLISECONDS, started, total.connected, total.inWorld, logonFailures, total.disconnected);
+    printf("          packets in " UI64FMTD " (" UI64FMTD " KB), out " UI64FMTD " (" UI64FMTD " KB)\n",
+        total.packetsIn, total.bytesIn / 1024, total.packetsOut, total.bytesOut / 1024);
+
+    if (total.tickSamples)
+        printf("          world update diff: last %u ms, avg " UI64FMTD " ms, max %u ms over " UI64FMTD " samples\n",
+            total.tickLast, total.tickSum / total.tickSamples, total.tickMax, total.tickSamples);
+
+    printf("          %-16s %10s %10s %8s %9s %9s %9s %9s\n", "request", "sent", "answered", "timeout", "avg_ms", "p50_ms", "p99_ms", "max_ms");
+    for (uint8 i = 0; i < MAX_BOT_REQUESTS; ++i)
+    {
+        RequestCounters const& counters = total.requests[i];
+        if (!counters.sent)
+            continue;
+
+        printf("          %-16s %10u %10u %8u %9.2f %9.2f %9.2f %9.2f\n",
+            GetBotRequestName(BotRequest(i)), uint32(counters.sent), uint32(counters.answered), uint32(counters.timedOut),
+            counters.answered ? double(counters.rttSum) / counters.answered / 1000.0 : 0.0,
+            counters.GetPercentile(0.5f) / 1000.0, counters.GetPercentile(0.99f) / 1000.0, counters.rttMax / 1000.0);
+    }
+
+    fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+    LoadGenConfig config;
+    config.authAddress.set(3724, "127.0.0.1");
+    config.worldAddress.set(8085, "127.0.0.1");
+    config.bots = 100;
+    config.threads = ACE_OS::num_processors_online();
+    config.loginRate = 50;
+    config.duration = 0;
+    config.reportInterval = 10;
+    config.firstBot = 1;
+    config.accountPrefix = "loadgen";
+    config.password = "loadgen";
+    config.race = 1;
+    config.class_ = 1;
+    config.spellId = 2457;
+    parseEntries("197,823,299,68", config.creatureEntries);
+    bool printSql = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        char const* arg = argv[i];
+        char const* param = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "--auth") == 0 && param)
+        {
+            if (!parseAddress(param, 3724, config.authAddress))
+            {
+                printf("Invalid auth server address '%s'\n", param);
+                return 1;
+            }
+            ++i;
+        }
+        else if (strcmp(arg, "--world") == 0 && param)
+        {
+            if (!parseAddress(param, 8085, config.worldAddress))
+            {
+                printf("Invalid world server address '%s'\n", param);
+                return 1;
+            }
+            ++i;
+        }
+        else if (strcmp(arg, "--bots") == 0 && param)
+        {
+            config.bots = atoi(param);
+            ++i;
+        }
+        else if (strcmp(arg, "--first") == 0 && param)
+        {
+            config.firstBot = atoi(param);
+            ++i;
+        }
+        else if (strcmp(arg, "--account") == 0 && param)
+        {
+            config.accountPrefix = param;
+            ++i;
+        }
+        else if (strcmp(arg, "--password") == 0 && param)
+        {
+            config.password = param;
+            ++i;
+        }
+        else if (strcmp(arg, "--threads") == 0 && param)
+        {
+            config.threads = atoi(param);
+            ++i;
+        }
+        else if (strcmp(arg, "--rate") == 0 && param)
+        {
+            config.loginRate = atoi(param);
+            ++i;
+        }
+        else if (strcmp(arg, "--duration") == 0 && param)
+        {
+            config.duration = atoi(param);
+            ++i;
+        }
+        else if (strcmp(arg, "--interval") == 0 && param)
+        {
+            config.reportInterval = atoi(param);
+            ++i;
+        }
+        else if (strcmp(arg, "--race") == 0 && param)
+        {
+            config.race = atoi(param);
+            ++i;
+        }
+        else if (strcmp(arg, "--class") == 0 && param)
+        {
+            config.class_ = atoi(param);
+            ++i;
+        }
+        else if (strcmp(arg, "--spell") == 0 && param)
+        {
+            config.spellId = atoi(param);
+            ++i;
+        }
+        else if (strcmp(arg, "--creature") == 0 && param)
+        {
+            parseEntries(param, config.creatureEntries);
+            ++i;
+        }
+        else if (strcmp(arg, "--sql") == 0)
+            printSql = true;
+        else if (strcmp(arg, "--help") == 0 || strcmp(arg, "-?") == 0)
+        {
+            printUsage(argv[0]);
+            return 0;
+        }
+        else
+        {
+            printf("Unknown argument '%s'\n", arg);
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    // a prefix that long would not leave room for the number in account.username
+    if (config.accountPrefix.empty() || config.accountPrefix.length() > 20)
+    {
+        printf("The account prefix must be 1 to 20 characters long\n");
+        return 1;
+    }
+
+    if (printSql)
+    {
+        printAccountSql(config);
+        return 0;
+    }
+
+    if (!config.threads)
+        config.threads = 1;
+    if (!config.loginRate)
+        config.loginRate = 1;
+    if (!config.reportInterval)
+        config.reportInterval = 10;
+
+    LoadGenSignalHandler SignalINT, SignalTERM;
+    ACE_Sig_Handler Handler;
+    Handler.register_handler(SIGINT, &SignalINT);
+    Handler.register_handler(SIGTERM, &SignalTERM);
+
+#if PLATFORM != PLATFORM_WINDOWS
+    // a server that goes away must not kill the generator on the next send
+    ACE_OS::signal(SIGPIPE, SIG_IGN);
+#endif
+
+    std::vector<BotRunnable*> workers;
+    for (uint32 i = 0; i < config.threads; ++i)
+    {
+        BotRunnable* worker = new BotRunnable();
+        if (worker->Start() == -1)
+        {
+            printf("Can't start network thread %u\n", i);
+            delete worker;
+            break;
+        }
+        workers.push_back(worker);
+    }
+
+    if (workers.empty())
+        return 1;
+
+    printf("Starting %u bots on %u threads, %u logins per second.\n", config.bots, uint32(workers.size()), config.loginRate);
+
+    uint32 startTime = getMSTime();
+    uint32 nextReport = config.reportInterval * IN_MILLISECONDS;
+    uint32 started = 0;
+    uint32 logonFailures = 0;
+
+    // logons are blocking and run on this thread, paced to the login rate
+    while (!stopEvent)
+    {
+        uint32 elapsed = GetMSTimeDiffToNow(startTime);
+        if (config.duration && elapsed >= config.duration * IN_MILLISECONDS)
+            break;
+
+        if (started < config.bots && uint64(started) * IN_MILLISECONDS / config.loginRate <= elapsed)
+        {
+            uint32 number = config.firstBot + started;
+            std::string account = getAccountName(config, number);
+
+            AuthClient auth(config.authAddress);
+            BigNumber K;
+            Bot* bot = NULL;
+
+            if (!auth.Logon(account, config.password, K))
+            {
+                if (logonFailures < MAX_PRINTED_LOGON_FAILURES)
+                    printf("Bot %u: logon of %s failed, %s.\n", number, account.c_str(), auth.GetError().c_str());
+                ++logonFailures;
+            }
+            else
+            {
+                bot = new Bot(number, account, config);
+                if (!bot->Connect(K))
+                {
+                    if (logonFailures < MAX_PRINTED_LOGON_FAILURES)
+                        printf("Bot %u: can't connect to the world server.\n", number);
+                    ++logonFailures;
+                    delete bot;
+                }
+                else
+                    workers[started % workers.size()]->AddBot(bot);
+            }
+
+            ++started;
+        }
+        else
+            ACE_OS::sleep(ACE_Time_Value(0, 10000));
+
+        if (elapsed >= nextReport)
+        {
+            printReport(workers, elapsed, started, logonFailures);
+            nextReport += config.reportInterval * IN_MILLISECONDS;
+        }
+    }
+
+    for (std::vector<BotRunnable*>::const_iterator itr = workers.begin(); itr != workers.end(); ++itr)
+        (*itr)->Stop();
+
+    for (std::vector<BotRunnable*>::const_iterator itr = workers.begin(); itr != workers.end(); ++itr)
+        (*itr)->Wait();
+
+    printReport(workers, GetMSTimeDiffToNow(startTime), started, logonFailures);
+
+    for (std::vector<BotRunnable*>::const_iterator itr = workers.begin(); itr != workers.end(); ++itr)
+        delete *itr;
+
+    return 0;
+}
+
+/// @}
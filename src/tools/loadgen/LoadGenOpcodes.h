@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LOADGEN_OPCODES_H
+#define _LOADGEN_OPCODES_H
+
+#include "Define.h"
+
+/// Opcodes of client build 13623 the bots use, keep in sync with game/Server/Protocol/Opcodes.h.
+enum LoadGenOpcodes
+{
+    CMSG_AUTH_SESSION                   = 0x00E0E,
+    CMSG_CAST_SPELL                     = 0x065C4,
+    CMSG_CHAR_CREATE                    = 0x07EEC,
+    CMSG_CHAR_ENUM                      = 0x06AA4,
+    CMSG_CREATURE_QUERY                 = 0x0268C,
+    CMSG_LOGOUT_REQUEST                 = 0x0A7A8,
+    CMSG_MESSAGECHAT_SAY                = 0x0002A,
+    CMSG_NAME_QUERY                     = 0x07AAC,
+    CMSG_PING                           = 0x0064E,
+    CMSG_PLAYER_LOGIN                   = 0x08180,
+    CMSG_TIME_SYNC_RESP                 = 0x0A8AC,
+    MSG_MOVE_HEARTBEAT                  = 0x022EC,
+    MSG_MOVE_START_FORWARD              = 0x0EBAC,
+    MSG_MOVE_STOP                       = 0x034E0,
+    SMSG_AUTH_CHALLENGE                 = 0x06019,
+    SMSG_AUTH_RESPONSE                  = 0x0B28C,
+    SMSG_CAST_FAILED                    = 0x02A8C,
+    SMSG_CHAR_CREATE                    = 0x0F7EC,
+    SMSG_CHAR_ENUM                      = 0x0ECCC,
+    SMSG_CREATURE_QUERY_RESPONSE        = 0x0E6AC,
+    SMSG_LOGIN_VERIFY_WORLD             = 0x028C0,
+    SMSG_MESSAGECHAT                    = 0x061E4,
+    SMSG_NAME_QUERY_RESPONSE            = 0x07BC8,
+    SMSG_PONG                           = 0x0A01B,
+    SMSG_SPELL_START                    = 0x06BA8,
+    SMSG_TIME_SYNC_REQ                  = 0x0AA80
+};
+
+#endif
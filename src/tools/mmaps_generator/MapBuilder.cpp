@@ -0,0 +1,505 @@
+/*
+ * Copyright (C) 2005-2011 MaNGOS <http://www.getmangos.com/>
+ * Copyright (C) 2008-2011 Trinity <http://www.trinitycore.org/>
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "MapBuilder.h"
+#include "TerrainBuilder.h"
+#include "MMapDefines.h"
+
+#include "Recast.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshBuilder.h"
+#include "DetourCommon.h"
+
+#include <ace/Guard_T.h>
+#include <ace/OS_NS_stdio.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+    // agent dimensions in voxels, a voxel is BASE_UNIT_DIM yards in every direction
+    const int WALKABLE_HEIGHT = 6;
+    const int WALKABLE_CLIMB = 4;
+    const int WALKABLE_RADIUS = 2;
+
+    uint32 PackTile(uint32 gx, uint32 gy)
+    {
+        return (gx << 16) | gy;
+    }
+
+    struct SubTileMeshes
+    {
+        ~SubTileMeshes()
+        {
+            for (size_t i = 0; i < polyMeshes.size(); ++i)
+                rcFreePolyMesh(polyMeshes[i]);
+            for (size_t i = 0; i < detailMeshes.size(); ++i)
+                rcFreePolyMeshDetail(detailMeshes[i]);
+        }
+
+        std::vector<rcPolyMesh*> polyMeshes;
+        std::vector<rcPolyMeshDetail*> detailMeshes;
+    };
+
+    // rasterizes one sub tile of the grid, returns false if it has no walkable polygon
+    bool BuildSubTile(rcContext& context, rcConfig const& config, MMAP::MeshData const& meshData, SubTileMeshes& meshes)
+    {
+        rcHeightfield* solid = rcAllocHeightfield();
+        if (!solid || !rcCreateHeightfield(&context, *solid, config.width, config.height, config.bmin, config.bmax, config.cs, config.ch))
+        {
+            rcFreeHeightField(solid);
+            return false;
+        }
+
+        rcRasterizeTriangles(&context, &meshData.verts[0], meshData.vertexCount(), &meshData.tris[0], &meshData.areas[0],
+            meshData.triangleCount(), *solid, config.walkableClimb);
+
+        rcFilterLowHangingWalkableObstacles(&context, config.walkableClimb, *solid);
+        rcFilterLedgeSpans(&context, config.walkableHeight, config.walkableClimb, *solid);
+        rcFilterWalkableLowHeightSpans(&context, config.walkableHeight, *solid);
+
+        rcCompactHeightfield* compact = rcAllocCompactHeightfield();
+        bool success = compact && rcBuildCompactHeightfield(&context, config.walkableHeight, config.walkableClimb, *solid, *compact);
+        rcFreeHeightField(solid);
+
+        success = success && rcErodeWalkableArea(&context, config.walkableRadius, *compact) &&
+            rcBuildDistanceField(&context, *compact) &&
+            rcBuildRegions(&context, *compact, config.borderSize, config.minRegionArea, config.mergeRegionArea);
+
+        rcContourSet* contours = success ? rcAllocContourSet() : NULL;
+        success = contours && rcBuildContours(&context, *compact, config.maxSimplificationError, config.maxEdgeLen, *contours);
+
+        rcPolyMesh* polyMesh = success ? rcAllocPolyMesh() : NULL;
+        success = polyMesh && rcBuildPolyMesh(&context, *contours, config.maxVertsPerPoly, *polyMesh);
+
+        rcPolyMeshDetail* detailMesh = success ? rcAllocPolyMeshDetail() : NULL;
+        success = detailMesh && rcBuildPolyMeshDetail(&context, *polyMesh, *compact, config.detailSampleDist, config.detailSampleMaxError, *detailMesh);
+
+        rcFreeCompactHeightfield(compact);
+        rcFreeContourSet(contours);
+
+        if (!success || !polyMesh->npolys)
+        {
+            rcFreePolyMesh(polyMesh);
+            rcFreePolyMeshDetail(detailMesh);
+            return false;
+        }
+
+        // drop the border, Detour finds the links to the neighbour tiles on the tile edges
+        for (int i = 0; i < polyMesh->nverts; ++i)
+        {
+            unsigned short* v = &polyMesh->verts[i * 3];
+            v[0] -= (unsigned short)config.borderSize;
+            v[2] -= (unsigned short)config.borderSize;
+        }
+        polyMesh->bmin[0] += config.borderSize * config.cs;
+        polyMesh->bmin[2] += config.borderSize * config.cs;
+
+        meshes.polyMeshes.push_back(polyMesh);
+        meshes.detailMeshes.push_back(detailMesh);
+        return true;
+    }
+}
+
+namespace MMAP
+{
+    MapBuilder::MapBuilder(std::string const& dataPath, bool rebuild, bool skipLiquid, float maxWalkableAngle) :
+        _dataPath(dataPath), _rebuild(rebuild), _skipLiquid(skipLiquid), _maxWalkableAngle(maxWalkableAngle),
+        _totalTasks(0), _built(0), _skipped(0), _failed(0)
+    {
+    }
+
+    void MapBuilder::discoverTiles()
+    {
+        std::vector<std::string> files;
+
+        printf("Discovering maps... ");
+        getDirContents(files, _dataPath + "maps", "*.map");
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            // MMMXXYY.map
+            uint32 mapId = uint32(atoi(files[i].substr(0, 3).c_str()));
+            uint32 gx = uint32(atoi(files[i].substr(3, 2).c_str()));
+            uint32 gy = uint32(atoi(files[i].substr(5, 2).c_str()));
+            _tiles[mapId].insert(PackTile(gx, gy));
+        }
+
+        files.clear();
+        getDirContents(files, _dataPath + "vmaps", "*.vmtree");
+        for (size_t i = 0; i < files.size(); ++i)
+            _tiles[uint32(atoi(files[i].substr(0, 3).c_str()))];
+
+        printf("found %u.\n", uint32(_tiles.size()));
+
+        printf("Discovering tiles... ");
+        uint32 count = 0;
+        TerrainBuilder terrain(_dataPath, _skipLiquid);
+        for (TileList::iterator itr = _tiles.begin(); itr != _tiles.end(); ++itr)
+        {
+            char filter[16];
+            snprintf(filter, sizeof(filter), "%03u_*.vmtile", itr->first);
+
+            files.clear();
+            getDirContents(files, _dataPath + "vmaps", filter);
+            for (size_t i = 0; i < files.size(); ++i)
+            {
+                // MMM_YY_XX.vmtile
+                uint32 gy = uint32(atoi(files[i].substr(4, 2).c_str()));
+                uint32 gx = uint32(atoi(files[i].substr(7, 2).c_str()));
+                itr->second.insert(PackTile(gx, gy));
+            }
+
+            // maps without terrain consist of one global model, cover its bounds
+            uint32 minX, minY, maxX, maxY;
+            if (itr->second.empty() && terrain.getGlobalModelBounds(itr->first, minX, minY, maxX, maxY))
+                for (uint32 gx = minX; gx <= maxX; ++gx)
+                    for (uint32 gy = minY; gy <= maxY; ++gy)
+                        itr->second.insert(PackTile(gx, gy));
+
+            count += uint32(itr->second.size());
+        }
+        printf("found %u.\n\n", count);
+    }
+
+    bool MapBuilder::buildNavMeshParams(uint32 mapId)
+    {
+        TileList::const_iterator itr = _tiles.find(mapId);
+        if (itr == _tiles.end() || itr->second.empty())
+            return false;
+
+        // Recast x is the world y, Recast z the world x, the tile of grid [gx, gy] is [63 - gy, 63 - gx]
+        dtNavMeshParams params;
+        memset(&params, 0, sizeof(params));
+        params.orig[0] = -32.0f * GRID_SIZE;
+        params.orig[1] = 0.0f;
+        params.orig[2] = -32.0f * GRID_SIZE;
+        params.tileWidth = GRID_SIZE;
+        params.tileHeight = GRID_SIZE;
+        params.maxTiles = int(itr->second.size());
+        params.maxPolys = 1 << STATIC_POLY_BITS;
+
+        char fileName[32];
+        snprintf(fileName, sizeof(fileName), "mmaps/%03u.mmap", mapId);
+
+        FILE* file = fopen((_dataPath + fileName).c_str(), "wb");
+        if (!file)
+        {
+            printf("Failed to open %s for writing\n", fileName);
+            return false;
+        }
+
+        bool success = fwrite(&params, sizeof(params), 1, file) == 1;
+        fclose(file);
+        return success;
+    }
+
+    void MapBuilder::buildMaps(int mapId, uint32 threads)
+    {
+        discoverTiles();
+
+        for (TileList::const_iterator itr = _tiles.begin(); itr != _tiles.end(); ++itr)
+        {
+            if (mapId >= 0 && itr->first != uint32(mapId))
+                continue;
+
+            if (!buildNavMeshParams(itr->first))
+                continue;
+
+            for (std::set<uint32>::const_iterator tile = itr->second.begin(); tile != itr->second.end(); ++tile)
+                _tasks.push_back(TileTask(itr->first, *tile >> 16, *tile & 0xFFFF));
+        }
+
+        runTasks(threads);
+    }
+
+    void MapBuilder::buildSingleTile(uint32 mapId, uint32 gx, uint32 gy)
+    {
+        discoverTiles();
+
+        // the tile may still hold models or liquid of a neighbour grid
+        _tiles[mapId].insert(PackTile(gx, gy));
+        if (!buildNavMeshParams(mapId))
+            return;
+
+        // a single tile is always rebuilt
+        _rebuild = true;
+        _tasks.push_back(TileTask(mapId, gx, gy));
+        runTasks(1);
+    }
+
+    void MapBuilder::runTasks(uint32 threads)
+    {
+        _totalTasks = uint32(_tasks.size());
+        if (!_totalTasks)
+        {
+            printf("Nothing to build.\n");
+            return;
+        }
+
+        printf("Building %u tiles using %u threads...\n", _totalTasks, threads);
+        if (activate(THR_NEW_LWP | THR_JOINABLE, int(threads)) == -1)
+        {
+            printf("Could not start the worker threads, building in the main thread\n");
+            svc();
+        }
+        else
+            wait();
+
+        printf("\nDone: %u built, %u already up to date, %u failed.\n", _built, _skipped, _failed);
+    }
+
+    int MapBuilder::svc()
+    {
+        rcContext context(false);
+        TerrainBuilder terrain(_dataPath, _skipLiquid);
+
+        while (true)
+        {
+            TileTask task(0, 0, 0);
+            {
+                ACE_Guard<ACE_Thread_Mutex> guard(_lock);
+                if (_tasks.empty())
+                    break;
+
+                task = _tasks.front();
+                _tasks.pop_front();
+            }
+
+            char const* result;
+            if (!_rebuild && isTileDone(task.mapId, task.gx, task.gy))
+                result = "up to date";
+            else if (buildTile(task.mapId, task.gx, task.gy, terrain, context))
+                result = "built";
+            else
+                result = "FAILED";
+
+            ACE_Guard<ACE_Thread_Mutex> guard(_lock);
+            if (result[0] == 'u')
+                ++_skipped;
+            else if (result[0] == 'b')
+                ++_built;
+            else
+                ++_failed;
+
+            printf("[%u/%u] Map %03u [%02u,%02u] %s\n", _built + _skipped + _failed, _totalTasks, task.mapId, task.gx, task.gy, result);
+        }
+
+        return 0;
+    }
+
+    bool MapBuilder::isTileDone(uint32 mapId, uint32 gx, uint32 gy) const
+    {
+        char fileName[32];
+        snprintf(fileName, sizeof(fileName), "mmaps/%03u%02u%02u.mmtile", mapId, gx, gy);
+
+        FILE* file = fopen((_dataPath + fileName).c_str(), "rb");
+        if (!file)
+            return false;
+
+        MmapTileHeader header;
+        bool done = fread(&header, sizeof(header), 1, file) == 1 &&
+            header.mmapMagic == MMAP_MAGIC && header.mmapVersion == MMAP_VERSION && header.dtVersion == uint32(DT_NAVMESH_VERSION) &&
+            header.usesLiquids == uint8(!_skipLiquid);
+
+        // an interrupted run may have left a truncated tile
+        if (done)
+        {
+            fseek(file, 0, SEEK_END);
+            done = ftell(file) == long(sizeof(header) + header.size);
+        }
+
+        fclose(file);
+        return done;
+    }
+
+    bool MapBuilder::buildTile(uint32 mapId, uint32 gx, uint32 gy, TerrainBuilder& terrain, rcContext& context)
+    {
+        MeshData meshData;
+        terrain.loadTerrain(mapId, gx, gy, meshData);
+        terrain.loadModels(mapId, gx, gy, meshData);
+
+        // nothing to walk on, record the tile as empty
+        if (!meshData.triangleCount())
+            return writeTile(mapId, gx, gy, NULL, 0);
+
+        // grid bounds in Recast coordinates
+        float bmin[3], bmax[3];
+        rcCalcBounds(&meshData.verts[0], meshData.vertexCount(), bmin, bmax);
+        bmin[0] = (31.0f - gy) * GRID_SIZE;
+        bmin[2] = (31.0f - gx) * GRID_SIZE;
+        bmax[0] = bmin[0] + GRID_SIZE;
+        bmax[2] = bmin[2] + GRID_SIZE;
+
+        rcClearUnwalkableTriangles(&context, _maxWalkableAngle, &meshData.verts[0], meshData.vertexCount(),
+            &meshData.tris[0], meshData.triangleCount(), &meshData.areas[0]);
+
+        rcConfig config;
+        memset(&config, 0, sizeof(config));
+        config.cs = BASE_UNIT_DIM;
+        config.ch = BASE_UNIT_DIM;
+        config.walkableSlopeAngle = _maxWalkableAngle;
+        config.walkableHeight = WALKABLE_HEIGHT;
+        config.walkableClimb = WALKABLE_CLIMB;
+        config.walkableRadius = WALKABLE_RADIUS;
+        config.tileSize = VERTEX_PER_TILE;
+        config.borderSize = config.walkableRadius + 3;
+        config.width = config.tileSize + config.borderSize * 2;
+        config.height = config.tileSize + config.borderSize * 2;
+        config.maxEdgeLen = VERTEX_PER_TILE + 1;
+        config.maxSimplificationError = 1.8f;
+        config.minRegionArea = rcSqr(60);
+        config.mergeRegionArea = rcSqr(50);
+        config.maxVertsPerPoly = DT_VERTS_PER_POLYGON;
+        config.detailSampleDist = config.cs * 64;
+        config.detailSampleMaxError = config.ch * 2;
+
+        // rasterizing the whole grid at once would need a 2000x2000 heightfield per thread
+        SubTileMeshes meshes;
+        for (int x = 0; x < TILES_PER_GRID; ++x)
+        {
+            for (int z = 0; z < TILES_PER_GRID; ++z)
+            {
+                rcConfig tileConfig = config;
+                tileConfig.bmin[0] = bmin[0] + float(x * config.tileSize - config.borderSize) * config.cs;
+                tileConfig.bmin[1] = bmin[1];
+                tileConfig.bmin[2] = bmin[2] + float(z * config.tileSize - config.borderSize) * config.cs;
+                tileConfig.bmax[0] = bmin[0] + float((x + 1) * config.tileSize + config.borderSize) * config.cs;
+                tileConfig.bmax[1] = bmax[1];
+                tileConfig.bmax[2] = bmin[2] + float((z + 1) * config.tileSize + config.borderSize) * config.cs;
+
+                BuildSubTile(context, tileConfig, meshData, meshes);
+            }
+        }
+
+        if (meshes.polyMeshes.empty())
+            return writeTile(mapId, gx, gy, NULL, 0);
+
+        rcPolyMesh* polyMesh = rcAllocPolyMesh();
+        rcPolyMeshDetail* detailMesh = rcAllocPolyMeshDetail();
+        if (!polyMesh || !detailMesh ||
+            !rcMergePolyMeshes(&context, &meshes.polyMeshes[0], int(meshes.polyMeshes.size()), *polyMesh) ||
+            !rcMergePolyMeshDetails(&context, &meshes.detailMeshes[0], int(meshes.detailMeshes.size()), *detailMesh))
+        {
+            printf("Map %03u [%02u,%02u]: failed to merge the sub tile meshes\n", mapId, gx, gy);
+            rcFreePolyMesh(polyMesh);
+            rcFreePolyMeshDetail(detailMesh);
+            return false;
+        }
+
+        // vertices are relative to the lowest sub tile with polygons, move them to the grid origin
+        unsigned short offX = (unsigned short)floorf((polyMesh->bmin[0] - bmin[0]) / config.cs + 0.5f);
+        unsigned short offZ = (unsigned short)floorf((polyMesh->bmin[2] - bmin[2]) / config.cs + 0.5f);
+        for (int i = 0; i < polyMesh->nverts; ++i)
+        {
+            polyMesh->verts[i * 3] += offX;
+            polyMesh->verts[i * 3 + 2] += offZ;
+        }
+        polyMesh->bmin[0] = bmin[0];
+        polyMesh->bmin[2] = bmin[2];
+
+        // the pathfinder filters on the terrain type of the polygons
+        for (int i = 0; i < polyMesh->npolys; ++i)
+            polyMesh->flags[i] = polyMesh->areas[i];
+
+        dtNavMeshCreateParams params;
+        memset(&params, 0, sizeof(params));
+        params.verts = polyMesh->verts;
+        params.vertCount = polyMesh->nverts;
+        params.polys = polyMesh->polys;
+        params.polyAreas = polyMesh->areas;
+        params.polyFlags = polyMesh->flags;
+        params.polyCount = polyMesh->npolys;
+        params.nvp = polyMesh->nvp;
+        params.detailMeshes = detailMesh->meshes;
+        params.detailVerts = detailMesh->verts;
+        params.detailVertsCount = detailMesh->nverts;
+        params.detailTris = detailMesh->tris;
+        params.detailTriCount = detailMesh->ntris;
+        params.walkableHeight = BASE_UNIT_DIM * config.walkableHeight;
+        params.walkableRadius = BASE_UNIT_DIM * config.walkableRadius;
+        params.walkableClimb = BASE_UNIT_DIM * config.walkableClimb;
+        params.tileX = 63 - int(gy);
+        params.tileY = 63 - int(gx);
+        rcVcopy(params.bmin, polyMesh->bmin);
+        params.bmax[0] = bmax[0];
+        params.bmax[1] = polyMesh->bmax[1];
+        params.bmax[2] = bmax[2];
+        params.cs = config.cs;
+        params.ch = config.ch;
+        params.tileSize = VERTEX_PER_GRID;
+
+        unsigned char* navData = NULL;
+        int navDataSize = 0;
+        bool success = dtCreateNavMeshData(&params, &navData, &navDataSize);
+        if (!success)
+            printf("Map %03u [%02u,%02u]: failed to create the Detour tile (%d polygons, %d vertices)\n", mapId, gx, gy, params.polyCount, params.vertCount);
+
+        rcFreePolyMesh(polyMesh);
+        rcFreePolyMeshDetail(detailMesh);
+
+        if (!success)
+            return false;
+
+        success = writeTile(mapId, gx, gy, navData, uint32(navDataSize));
+        dtFree(navData);
+        return success;
+    }
+
+    bool MapBuilder::writeTile(uint32 mapId, uint32 gx, uint32 gy, unsigned char const* data, uint32 size) const
+    {
+        char fileName[32];
+        snprintf(fileName, sizeof(fileName), "mmaps/%03u%02u%02u.mmtile", mapId, gx, gy);
+        std::string path = _dataPath + fileName;
+        std::string tempPath = path + ".tmp";
+
+        FILE* file = fopen(tempPath.c_str(), "wb");
+        if (!file)
+        {
+            printf("Failed to open %s for writing\n", tempPath.c_str());
+            return false;
+        }
+
+        MmapTileHeader header;
+        header.size = size;
+        header.usesLiquids = uint8(!_skipLiquid);
+
+        bool success = fwrite(&header, sizeof(header), 1, file) == 1 && (!size || fwrite(data, size, 1, file) == 1);
+        fclose(file);
+
+        // the finished tile replaces the old one at once, so an aborted run never leaves a partial tile behind
+        if (success)
+        {
+            remove(path.c_str());
+            success = rename(tempPath.c_str(), path.c_str()) == 0;
+        }
+
+        if (!success)
+        {
+            printf("Failed to write %s\n", path.c_str());
+            remove(tempPath.c_str());
+        }
+
+        return success;
+    }
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2005-2011 MaNGOS <http://www.getmangos.com/>
+ * Copyright (C) 2008-2011 Trinity <http://www.trinitycore.org/>
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef _MAP_BUILDER_H
+#define _MAP_BUILDER_H
+
+#include "PathCommon.h"
+
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+
+#include <ace/Task.h>
+#include <ace/Thread_Mutex.h>
+
+class rcContext;
+
+namespace MMAP
+{
+    class TerrainBuilder;
+
+    // grid tiles per map id, packed as (gx << 16) | gy
+    typedef std::map<uint32, std::set<uint32> > TileList;
+
+    struct TileTask
+    {
+        TileTask(uint32 map, uint32 x, uint32 y) : mapId(map), gx(x), gy(y) { }
+
+        uint32 mapId;
+        uint32 gx;
+        uint32 gy;
+    };
+
+    // bakes one Detour tile per grid, the tiles are built by a pool of threads
+    class MapBuilder : public ACE_Task_Base
+    {
+        public:
+            MapBuilder(std::string const& dataPath, bool rebuild, bool skipLiquid, float maxWalkableAngle);
+
+            // builds every tile found for the map, all maps when mapId is negative
+            void buildMaps(int mapId, uint32 threads);
+            // builds a single tile of a map
+            void buildSingleTile(uint32 mapId, uint32 gx, uint32 gy);
+
+            int svc();
+
+        private:
+            void discoverTiles();
+            bool buildNavMeshParams(uint32 mapId);
+            void runTasks(uint32 threads);
+
+            // a tile is done when its file is complete and was written by this generator version
+            bool isTileDone(uint32 mapId, uint32 gx, uint32 gy) const;
+            bool buildTile(uint32 mapId, uint32 gx, uint32 gy, TerrainBuilder& terrain, rcContext& context);
+            bool writeTile(uint32 mapId, uint32 gx, uint32 gy, unsigned char const* data, uint32 size) const;
+
+            std::string _dataPath;
+            bool _rebuild;
+            bool _skipLiquid;
+            float _maxWalkableAngle;
+
+            TileList _tiles;
+
+            ACE_Thread_Mutex _lock;                         // guards the task queue, counters and console output
+            std::deque<TileTask> _tasks;
+            uint32 _totalTasks;
+            uint32 _built;
+            uint32 _skipped;
+            uint32 _failed;
+    };
+}
+
+#endif
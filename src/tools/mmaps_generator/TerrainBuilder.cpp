@@ -0,0 +1,494 @@
+/*
+ * Copyright (C) 2005-2011 MaNGOS <http://www.getmangos.com/>
+ * Copyright (C) 2008-2011 Trinity <http://www.trinitycore.org/>
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "TerrainBuilder.h"
+#include "MMapDefines.h"
+
+#include "ModelInstance.h"
+#include "WorldModel.h"
+#include "VMapDefinitions.h"
+#include "BoundingIntervalHierarchy.h"
+
+#include <G3D/Matrix3.h>
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+    // layout of the extracted .map files, see src/tools/extractor/map.cpp
+
+    union u_map_magic
+    {
+        char asChar[4];
+        uint32 asUInt;
+    };
+
+    const u_map_magic MapMagic        = { {'M','A','P','S'} };
+    const u_map_magic MapVersionMagic = { {'v','1','.','1'} };
+    const u_map_magic MapHeightMagic  = { {'M','H','G','T'} };
+    const u_map_magic MapLiquidMagic  = { {'M','L','I','Q'} };
+
+    struct map_fileheader
+    {
+        uint32 mapMagic;
+        uint32 versionMagic;
+        uint32 buildMagic;
+        uint32 areaMapOffset;
+        uint32 areaMapSize;
+        uint32 heightMapOffset;
+        uint32 heightMapSize;
+        uint32 liquidMapOffset;
+        uint32 liquidMapSize;
+    };
+
+    #define MAP_HEIGHT_NO_HEIGHT  0x0001
+    #define MAP_HEIGHT_AS_INT16   0x0002
+    #define MAP_HEIGHT_AS_INT8    0x0004
+
+    struct map_heightHeader
+    {
+        uint32 fourcc;
+        uint32 flags;
+        float  gridHeight;
+        float  gridMaxHeight;
+    };
+
+    #define MAP_LIQUID_NO_TYPE    0x0001
+    #define MAP_LIQUID_NO_HEIGHT  0x0002
+
+    struct map_liquidHeader
+    {
+        uint32 fourcc;
+        uint16 flags;
+        uint16 liquidType;
+        uint8  offsetX;
+        uint8  offsetY;
+        uint8  width;
+        uint8  height;
+        float  liquidLevel;
+    };
+
+    #define MAP_LIQUID_TYPE_MAGMA       0x04
+    #define MAP_LIQUID_TYPE_SLIME       0x08
+
+    #define V9_SIZE     129
+    #define V8_SIZE     128
+
+    // water shallower than this stays walkable ground, deeper water is swum on its surface
+    const float WADE_DEPTH = 1.5f;
+
+    const float INVALID_LEVEL = -500000.0f;
+
+    // the vmaps are stored mirrored around the center of the world
+    const float MAP_MID = 32.0f * MMAP::GRID_SIZE;
+
+    uint8 GetLiquidArea(uint8 liquidType)
+    {
+        if (liquidType & MAP_LIQUID_TYPE_MAGMA)
+            return NAV_MAGMA;
+        if (liquidType & MAP_LIQUID_TYPE_SLIME)
+            return NAV_SLIME;
+        return NAV_WATER;
+    }
+
+    bool ReadHeights(FILE* file, uint32 offset, std::vector<float>& v9, std::vector<float>& v8)
+    {
+        map_heightHeader header;
+        fseek(file, offset, SEEK_SET);
+        if (fread(&header, sizeof(header), 1, file) != 1 || header.fourcc != MapHeightMagic.asUInt)
+            return false;
+
+        v9.assign(V9_SIZE * V9_SIZE, header.gridHeight);
+        v8.assign(V8_SIZE * V8_SIZE, header.gridHeight);
+
+        if (header.flags & MAP_HEIGHT_NO_HEIGHT)
+            return true;
+
+        if (header.flags & MAP_HEIGHT_AS_INT16)
+        {
+            std::vector<uint16> raw9(V9_SIZE * V9_SIZE), raw8(V8_SIZE * V8_SIZE);
+            if (fread(&raw9[0], sizeof(uint16), raw9.size(), file) != raw9.size() ||
+                fread(&raw8[0], sizeof(uint16), raw8.size(), file) != raw8.size())
+                return false;
+
+            float multiplier = (header.gridMaxHeight - header.gridHeight) / 65535;
+            for (size_t i = 0; i < raw9.size(); ++i)
+                v9[i] = raw9[i] * multiplier + header.gridHeight;
+            for (size_t i = 0; i < raw8.size(); ++i)
+                v8[i] = raw8[i] * multiplier + header.gridHeight;
+        }
+        else if (header.flags & MAP_HEIGHT_AS_INT8)
+        {
+            std::vector<uint8> raw9(V9_SIZE * V9_SIZE), raw8(V8_SIZE * V8_SIZE);
+            if (fread(&raw9[0], sizeof(uint8), raw9.size(), file) != raw9.size() ||
+                fread(&raw8[0], sizeof(uint8), raw8.size(), file) != raw8.size())
+                return false;
+
+            float multiplier = (header.gridMaxHeight - header.gridHeight) / 255;
+            for (size_t i = 0; i < raw9.size(); ++i)
+                v9[i] = raw9[i] * multiplier + header.gridHeight;
+            for (size_t i = 0; i < raw8.size(); ++i)
+                v8[i] = raw8[i] * multiplier + header.gridHeight;
+        }
+        else
+        {
+            if (fread(&v9[0], sizeof(float), v9.size(), file) != v9.size() ||
+                fread(&v8[0], sizeof(float), v8.size(), file) != v8.size())
+                return false;
+        }
+
+        return true;
+    }
+
+    // liquid of a grid, levels are given for the V9 points
+    struct GridLiquid
+    {
+        GridLiquid() : type(0), offX(0), offY(0), width(0), height(0), level(INVALID_LEVEL) { }
+
+        uint8 GetType(int i, int j) const
+        {
+            return types.empty() ? type : types[(i >> 3) * 16 + (j >> 3)];
+        }
+
+        float GetLevel(int i, int j) const
+        {
+            int li = i - offY;
+            int lj = j - offX;
+            if (li < 0 || li >= height || lj < 0 || lj >= width)
+                return INVALID_LEVEL;
+
+            return levels.empty() ? level : levels[li * width + lj];
+        }
+
+        uint8 type;
+        int offX, offY, width, height;
+        float level;
+        std::vector<uint8> types;
+        std::vector<float> levels;
+    };
+
+    bool ReadLiquid(FILE* file, uint32 offset, GridLiquid& liquid)
+    {
+        map_liquidHeader header;
+        fseek(file, offset, SEEK_SET);
+        if (fread(&header, sizeof(header), 1, file) != 1 || header.fourcc != MapLiquidMagic.asUInt)
+            return false;
+
+        liquid.type = uint8(header.liquidType);
+        liquid.offX = header.offsetX;
+        liquid.offY = header.offsetY;
+        liquid.width = header.width;
+        liquid.height = header.height;
+        liquid.level = header.liquidLevel;
+
+        if (!(header.flags & MAP_LIQUID_NO_TYPE))
+        {
+            liquid.types.resize(16 * 16);
+            if (fread(&liquid.types[0], sizeof(uint8), liquid.types.size(), file) != liquid.types.size())
+                return false;
+        }
+
+        if (!(header.flags & MAP_LIQUID_NO_HEIGHT) && header.width && header.height)
+        {
+            liquid.levels.resize(header.width * header.height);
+            if (fread(&liquid.levels[0], sizeof(float), liquid.levels.size(), file) != liquid.levels.size())
+                return false;
+        }
+
+        return true;
+    }
+
+    bool ReadChunk(FILE* file, char const* chunk, uint32 length)
+    {
+        char buffer[8];
+        return length <= sizeof(buffer) && fread(buffer, sizeof(char), length, file) == length && !memcmp(buffer, chunk, length);
+    }
+}
+
+namespace MMAP
+{
+    TerrainBuilder::TerrainBuilder(std::string const& dataPath, bool skipLiquid) :
+        _dataPath(dataPath), _skipLiquid(skipLiquid)
+    {
+    }
+
+    void TerrainBuilder::loadTerrain(uint32 mapId, uint32 gx, uint32 gy, MeshData& meshData) const
+    {
+        // world x/y covered by the grid, grown by one height map quad
+        float const quad = GRID_SIZE / V8_SIZE;
+        float clipMin[2] = { (31.0f - gx) * GRID_SIZE - quad, (31.0f - gy) * GRID_SIZE - quad };
+        float clipMax[2] = { (32.0f - gx) * GRID_SIZE + quad, (32.0f - gy) * GRID_SIZE + quad };
+
+        for (int x = int(gx) - 1; x <= int(gx) + 1; ++x)
+            for (int y = int(gy) - 1; y <= int(gy) + 1; ++y)
+                if (x >= 0 && y >= 0 && x < 64 && y < 64)
+                    loadGridMap(mapId, uint32(x), uint32(y), clipMin, clipMax, meshData);
+    }
+
+    bool TerrainBuilder::loadGridMap(uint32 mapId, uint32 gx, uint32 gy, float const* clipMin, float const* clipMax, MeshData& meshData) const
+    {
+        char fileName[32];
+        snprintf(fileName, sizeof(fileName), "maps/%03u%02u%02u.map", mapId, gx, gy);
+
+        FILE* file = fopen((_dataPath + fileName).c_str(), "rb");
+        if (!file)
+            return false;
+
+        map_fileheader header;
+        if (fread(&header, sizeof(header), 1, file) != 1 || header.mapMagic != MapMagic.asUInt || header.versionMagic != MapVersionMagic.asUInt)
+        {
+            printf("%s is not a compatible map file, skipped\n", fileName);
+            fclose(file);
+            return false;
+        }
+
+        std::vector<float> v9, v8;
+        if (!ReadHeights(file, header.heightMapOffset, v9, v8))
+        {
+            printf("%s has no valid height data, skipped\n", fileName);
+            fclose(file);
+            return false;
+        }
+
+        GridLiquid liquid;
+        if (!_skipLiquid && header.liquidMapOffset && !ReadLiquid(file, header.liquidMapOffset, liquid))
+            liquid = GridLiquid();
+
+        fclose(file);
+
+        // height map point (i, j) lies at world x = x0 - i * quad, y = y0 - j * quad
+        float const quad = GRID_SIZE / V8_SIZE;
+        float const x0 = (32.0f - gx) * GRID_SIZE;
+        float const y0 = (32.0f - gy) * GRID_SIZE;
+
+        for (int i = 0; i < V8_SIZE; ++i)
+        {
+            float xHigh = x0 - i * quad;
+            float xLow = xHigh - quad;
+            if (xLow > clipMax[0] || xHigh < clipMin[0])
+                continue;
+
+            for (int j = 0; j < V8_SIZE; ++j)
+            {
+                float yHigh = y0 - j * quad;
+                float yLow = yHigh - quad;
+                if (yLow > clipMax[1] || yHigh < clipMin[1])
+                    continue;
+
+                float h1 = v9[i * V9_SIZE + j];
+                float h2 = v9[(i + 1) * V9_SIZE + j];
+                float h3 = v9[i * V9_SIZE + j + 1];
+                float h4 = v9[(i + 1) * V9_SIZE + j + 1];
+                float h5 = v8[i * V8_SIZE + j];
+
+                uint8 area = NAV_GROUND;
+                if (uint8 liquidType = liquid.GetType(i, j))
+                {
+                    float l1 = liquid.GetLevel(i, j);
+                    float l2 = liquid.GetLevel(i + 1, j);
+                    float l3 = liquid.GetLevel(i, j + 1);
+                    float l4 = liquid.GetLevel(i + 1, j + 1);
+                    float minLevel = std::min(std::min(l1, l2), std::min(l3, l4));
+                    float maxTerrain = std::max(std::max(std::max(h1, h2), std::max(h3, h4)), h5);
+
+                    if (minLevel > INVALID_LEVEL && minLevel > maxTerrain)
+                    {
+                        if (minLevel - maxTerrain >= WADE_DEPTH)
+                        {
+                            // deep liquid, only its surface can be moved on
+                            int base = meshData.vertexCount();
+                            meshData.addVertex(xHigh, yHigh, l1);
+                            meshData.addVertex(xLow, yHigh, l2);
+                            meshData.addVertex(xHigh, yLow, l3);
+                            meshData.addVertex(xLow, yLow, l4);
+                            meshData.addTriangle(base, base + 1, base + 3, GetLiquidArea(liquidType));
+                            meshData.addTriangle(base, base + 3, base + 2, GetLiquidArea(liquidType));
+                            continue;
+                        }
+
+                        // shallow water is waded through, shallow lava still hurts
+                        if (GetLiquidArea(liquidType) != NAV_WATER)
+                            area = GetLiquidArea(liquidType);
+                    }
+                }
+
+                // four triangles around the center point, counter clockwise seen from above
+                int base = meshData.vertexCount();
+                meshData.addVertex(xHigh, yHigh, h1);
+                meshData.addVertex(xLow, yHigh, h2);
+                meshData.addVertex(xHigh, yLow, h3);
+                meshData.addVertex(xLow, yLow, h4);
+                meshData.addVertex(xHigh - quad / 2, yHigh - quad / 2, h5);
+                meshData.addTriangle(base, base + 1, base + 4, area);
+                meshData.addTriangle(base + 1, base + 3, base + 4, area);
+                meshData.addTriangle(base + 3, base + 2, base + 4, area);
+                meshData.addTriangle(base + 2, base, base + 4, area);
+            }
+        }
+
+        return true;
+    }
+
+    void TerrainBuilder::loadModels(uint32 mapId, uint32 gx, uint32 gy, MeshData& meshData) const
+    {
+        float clipMin[2] = { (31.0f - gx) * GRID_SIZE - BASE_UNIT_DIM * VERTEX_PER_TILE, (31.0f - gy) * GRID_SIZE - BASE_UNIT_DIM * VERTEX_PER_TILE };
+        float clipMax[2] = { (32.0f - gx) * GRID_SIZE + BASE_UNIT_DIM * VERTEX_PER_TILE, (32.0f - gy) * GRID_SIZE + BASE_UNIT_DIM * VERTEX_PER_TILE };
+
+        char fileName[32];
+        snprintf(fileName, sizeof(fileName), "vmaps/%03u.vmtree", mapId);
+
+        FILE* file = fopen((_dataPath + fileName).c_str(), "rb");
+        if (!file)
+            return;
+
+        char tiled = 0;
+        bool success = ReadChunk(file, VMAP::VMAP_MAGIC, 8) && fread(&tiled, sizeof(char), 1, file) == 1;
+        if (success && !tiled)
+        {
+            // maps without terrain have exactly one global model stored in the tree file
+            BIH tree;
+            VMAP::ModelSpawn spawn;
+            if (ReadChunk(file, "NODE", 4) && tree.readFromFile(file) && ReadChunk(file, "GOBJ", 4) &&
+                VMAP::ModelSpawn::readFromFile(file, spawn))
+                loadModel(spawn, clipMin, clipMax, meshData);
+        }
+        fclose(file);
+
+        if (!success || !tiled)
+            return;
+
+        // tile files are named after [gy, gx], see StaticMapTree::getTileFileName
+        snprintf(fileName, sizeof(fileName), "vmaps/%03u_%02u_%02u.vmtile", mapId, gy, gx);
+        file = fopen((_dataPath + fileName).c_str(), "rb");
+        if (!file)
+            return;
+
+        uint32 numSpawns = 0;
+        if (ReadChunk(file, VMAP::VMAP_MAGIC, 8) && fread(&numSpawns, sizeof(uint32), 1, file) == 1)
+        {
+            for (uint32 i = 0; i < numSpawns; ++i)
+            {
+                VMAP::ModelSpawn spawn;
+                uint32 referencedNode;
+                if (!VMAP::ModelSpawn::readFromFile(file, spawn) || fread(&referencedNode, sizeof(uint32), 1, file) != 1)
+                {
+                    printf("%s is corrupted after %u of %u spawns\n", fileName, i, numSpawns);
+                    break;
+                }
+
+                loadModel(spawn, clipMin, clipMax, meshData);
+            }
+        }
+        fclose(file);
+    }
+
+    bool TerrainBuilder::loadModel(VMAP::ModelSpawn const& spawn, float const* clipMin, float const* clipMax, MeshData& meshData) const
+    {
+        VMAP::WorldModel model;
+        if (!model.readFile(_dataPath + "vmaps/" + spawn.name + ".vmo"))
+        {
+            printf("could not load model %s\n", spawn.name.c_str());
+            return false;
+        }
+
+        // same placement the server uses for its line of sight checks, see ModelInstance
+        G3D::Matrix3 rotation = G3D::Matrix3::fromEulerAnglesZYX(G3D::pi()*spawn.iRot.y/180.f, G3D::pi()*spawn.iRot.x/180.f, G3D::pi()*spawn.iRot.z/180.f);
+
+        // m2 models have the opposite winding of wmo groups
+        bool isM2 = spawn.flags & VMAP::MOD_M2;
+
+        std::vector<VMAP::GroupModel> const& groups = model.GetGroupModels();
+        std::vector<G3D::Vector3> worldVerts;
+        std::vector<int> remap;
+        for (std::vector<VMAP::GroupModel>::const_iterator group = groups.begin(); group != groups.end(); ++group)
+        {
+            G3D::Vector3 const* verts = group->GetVertices();
+            VMAP::MeshTriangle const* tris = group->GetTriangles();
+            uint32 vertCount = group->GetVertexCount();
+            uint32 triCount = group->GetTriangleCount();
+
+            worldVerts.resize(vertCount);
+            remap.assign(vertCount, -1);
+            for (uint32 i = 0; i < vertCount; ++i)
+            {
+                G3D::Vector3 v = rotation * (verts[i] * spawn.iScale) + spawn.iPos;
+                worldVerts[i] = G3D::Vector3(MAP_MID - v.x, MAP_MID - v.y, v.z);
+            }
+
+            for (VMAP::MeshTriangle const* tri = tris; tri != tris + triCount; ++tri)
+            {
+                G3D::Vector3 const& a = worldVerts[tri->idx0];
+                G3D::Vector3 const& b = worldVerts[tri->idx1];
+                G3D::Vector3 const& c = worldVerts[tri->idx2];
+
+                // the tile only rasterizes what lies inside its bounds
+                if (std::max(std::max(a.x, b.x), c.x) < clipMin[0] || std::min(std::min(a.x, b.x), c.x) > clipMax[0] ||
+                    std::max(std::max(a.y, b.y), c.y) < clipMin[1] || std::min(std::min(a.y, b.y), c.y) > clipMax[1])
+                    continue;
+
+                uint32 idx[3] = { tri->idx0, isM2 ? tri->idx2 : tri->idx1, isM2 ? tri->idx1 : tri->idx2 };
+                for (int k = 0; k < 3; ++k)
+                {
+                    if (remap[idx[k]] < 0)
+                    {
+                        remap[idx[k]] = meshData.vertexCount();
+                        meshData.addVertex(worldVerts[idx[k]].x, worldVerts[idx[k]].y, worldVerts[idx[k]].z);
+                    }
+                }
+
+                meshData.addTriangle(remap[idx[0]], remap[idx[1]], remap[idx[2]], NAV_GROUND);
+            }
+        }
+
+        return true;
+    }
+
+    bool TerrainBuilder::getGlobalModelBounds(uint32 mapId, uint32& minX, uint32& minY, uint32& maxX, uint32& maxY) const
+    {
+        char fileName[32];
+        snprintf(fileName, sizeof(fileName), "vmaps/%03u.vmtree", mapId);
+
+        FILE* file = fopen((_dataPath + fileName).c_str(), "rb");
+        if (!file)
+            return false;
+
+        char tiled = 1;
+        BIH tree;
+        VMAP::ModelSpawn spawn;
+        bool success = ReadChunk(file, VMAP::VMAP_MAGIC, 8) && fread(&tiled, sizeof(char), 1, file) == 1 && !tiled &&
+            ReadChunk(file, "NODE", 4) && tree.readFromFile(file) && ReadChunk(file, "GOBJ", 4) &&
+            VMAP::ModelSpawn::readFromFile(file, spawn);
+        fclose(file);
+
+        if (!success)
+            return false;
+
+        // bounds are stored mirrored, the highest vmap coordinate is the lowest world coordinate
+        G3D::Vector3 const& low = spawn.iBound.low();
+        G3D::Vector3 const& high = spawn.iBound.high();
+        minX = uint32(std::max(0.0f, std::min(63.0f, 32.0f - (MAP_MID - low.x) / GRID_SIZE)));
+        maxX = uint32(std::max(0.0f, std::min(63.0f, 32.0f - (MAP_MID - high.x) / GRID_SIZE)));
+        minY = uint32(std::max(0.0f, std::min(63.0f, 32.0f - (MAP_MID - low.y) / GRID_SIZE)));
+        maxY = uint32(std::max(0.0f, std::min(63.0f, 32.0f - (MAP_MID - high.y) / GRID_SIZE)));
+        return true;
+    }
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2005-2011 MaNGOS <http://www.getmangos.com/>
+ * Copyright (C) 2008-2011 Trinity <http://www.trinitycore.org/>
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef _MMAP_TERRAIN_BUILDER_H
+#define _MMAP_TERRAIN_BUILDER_H
+
+#include "PathCommon.h"
+
+#include <string>
+#include <vector>
+
+namespace VMAP
+{
+    class ModelSpawn;
+}
+
+namespace MMAP
+{
+    // triangle soup of one grid in Recast coordinates (y, z, x), one area id per triangle
+    struct MeshData
+    {
+        std::vector<float> verts;
+        std::vector<int> tris;
+        std::vector<uint8> areas;
+
+        void addVertex(float x, float y, float z)
+        {
+            verts.push_back(y);
+            verts.push_back(z);
+            verts.push_back(x);
+        }
+
+        void addTriangle(int a, int b, int c, uint8 area)
+        {
+            tris.push_back(a);
+            tris.push_back(b);
+            tris.push_back(c);
+            areas.push_back(area);
+        }
+
+        int vertexCount() const { return int(verts.size() / 3); }
+        int triangleCount() const { return int(areas.size()); }
+    };
+
+    // reads the terrain of the extracted .map files and the models of the vmaps output
+    class TerrainBuilder
+    {
+        public:
+            TerrainBuilder(std::string const& dataPath, bool skipLiquid);
+
+            // terrain of the grid and a border strip of the neighbour grids, so tile edges line up
+            void loadTerrain(uint32 mapId, uint32 gx, uint32 gy, MeshData& meshData) const;
+
+            // vmap models placed on the grid (or the global model of maps without terrain)
+            void loadModels(uint32 mapId, uint32 gx, uint32 gy, MeshData& meshData) const;
+
+            // grid coordinates covered by the global model of a map without terrain
+            bool getGlobalModelBounds(uint32 mapId, uint32& minX, uint32& minY, uint32& maxX, uint32& maxY) const;
+
+        private:
+            bool loadGridMap(uint32 mapId, uint32 gx, uint32 gy, float const* clipMin, float const* clipMax, MeshData& meshData) const;
+            bool loadModel(VMAP::ModelSpawn const& spawn, float const* clipMin, float const* clipMax, MeshData& meshData) const;
+
+            std::string _dataPath;
+            bool _skipLiquid;
+    };
+}
+
+#endif
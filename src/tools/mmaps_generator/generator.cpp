@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2005-2011 MaNGOS <http://www.getmangos.com/>
+ * Copyright (C) 2008-2011 Trinity <http://www.trinitycore.org/>
+ * Copyright (C) 2011-2012 Project SkyFire <http://www.projectskyfire.org/>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "MapBuilder.h"
+
+#include <ace/OS_NS_sys_stat.h>
+#include <ace/OS_NS_unistd.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace MMAP;
+
+void printUsage(char const* name)
+{
+    printf("\nusage: %s [options]\n", name);
+    printf("Reads maps/ and vmaps/ of the current directory and writes the navmesh tiles to mmaps/.\n");
+    printf("Tiles already built by this version are skipped, an interrupted run resumes where it stopped.\n\n");
+    printf("  --map <id>          build only the given map\n");
+    printf("  --tile <x>,<y>      build only the given grid of --map, always rebuilt\n");
+    printf("  --threads <count>   number of worker threads, defaults to the number of processors\n");
+    printf("  --rebuild           rebuild tiles that are already up to date\n");
+    printf("  --skipLiquid        do not add liquid surfaces to the navmesh\n");
+    printf("  --maxAngle <deg>    steepest walkable slope, defaults to 60\n");
+    printf("  --help              show this text\n");
+}
+
+int main(int argc, char* argv[])
+{
+    int mapId = -1;
+    int tileX = -1;
+    int tileY = -1;
+    long threads = ACE_OS::num_processors_online();
+    bool rebuild = false;
+    bool skipLiquid = false;
+    float maxAngle = 60.0f;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        char const* arg = argv[i];
+        char const* param = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "--map") == 0 && param)
+        {
+            mapId = atoi(param);
+            ++i;
+        }
+        else if (strcmp(arg, "--tile") == 0 && param)
+        {
+            if (sscanf(param, "%d,%d", &tileX, &tileY) != 2 || tileX < 0 || tileX > 63 || tileY < 0 || tileY > 63)
+            {
+                printf("Invalid tile '%s', expected <x>,<y> between 0 and 63\n", param);
+                return 1;
+            }
+            ++i;
+        }
+        else if (strcmp(arg, "--threads") == 0 && param)
+        {
+            threads = atol(param);
+            ++i;
+        }
+        else if (strcmp(arg, "--maxAngle") == 0 && param)
+        {
+            maxAngle = float(atof(param));
+            if (maxAngle <= 0.0f || maxAngle >= 90.0f)
+            {
+                printf("Invalid slope angle '%s'\n", param);
+                return 1;
+            }
+            ++i;
+        }
+        else if (strcmp(arg, "--rebuild") == 0)
+            rebuild = true;
+        else if (strcmp(arg, "--skipLiquid") == 0)
+            skipLiquid = true;
+        else if (strcmp(arg, "--help") == 0)
+        {
+            printUsage(argv[0]);
+            return 0;
+        }
+        else
+        {
+            printf("Unknown option '%s'\n", arg);
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (tileX >= 0 && mapId < 0)
+    {
+        printf("--tile requires --map\n");
+        return 1;
+    }
+
+    if (threads < 1)
+        threads = 1;
+
+    ACE_OS::mkdir("mmaps");
+
+    MapBuilder builder("./", rebuild, skipLiquid, maxAngle);
+    if (tileX >= 0)
+        builder.buildSingleTile(uint32(mapId), uint32(tileX), uint32(tileY));
+    else
+        builder.buildMaps(mapId, uint32(threads));
+
+    return 0;
+}